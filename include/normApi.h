@@ -11,6 +11,15 @@
 #include <winsock2.h>
 #include <windows.h>
 #include <basetsd.h>  // for UINT32/INT32, etc types
+#ifndef NORM_NO_IOVEC
+// Win32 has no <sys/uio.h>, so a compatible "struct iovec" is provided here
+// for NormStreamWritev() (define NORM_NO_IOVEC if another library provides one)
+struct iovec
+{
+    void*   iov_base;
+    size_t  iov_len;
+};
+#endif // !NORM_NO_IOVEC
 #ifdef NORM_USE_DLL
 #ifdef _NORM_API_BUILD
 #define NORM_API_LINKAGE __declspec(dllexport)  // to support building of "Norm.dll"
@@ -23,6 +32,7 @@
 #else
 #include <sys/types.h>  // for "off_t"
 #include <stdint.h>     // for proper uint32_t, etc definitions
+#include <sys/uio.h>    // for "struct iovec"
 typedef int8_t INT8;
 typedef int16_t INT16;
 #ifdef _USING_X11
@@ -163,6 +173,19 @@ typedef enum NormRepairBoundary
     NORM_BOUNDARY_OBJECT
 } NormRepairBoundary;
     
+// Latency histograms (see NormGetLatencyPercentile())
+NORM_API_LINKAGE
+typedef enum NormLatencyType
+{
+    NORM_LATENCY_TX_FIRST_SEND,        // object enqueue to first transmission
+    NORM_LATENCY_TX_OBJECT_SENT,       // object enqueue to NORM_TX_OBJECT_SENT
+    NORM_LATENCY_TX_REPAIR,            // NACK receipt to first repair transmission
+    NORM_LATENCY_RX_OBJECT_COMPLETED,  // object first packet to NORM_RX_OBJECT_COMPLETED
+    NORM_LATENCY_RX_BLOCK_DECODE,      // FEC block decode time
+    NORM_LATENCY_EVENT_DELIVERY,       // NORM thread notification to NormGetNextEvent()
+    NORM_LATENCY_TYPE_COUNT            // (all types for NormResetLatency())
+} NormLatencyType;
+
 NORM_API_LINKAGE
 typedef enum NormEventType
 {
@@ -205,6 +228,85 @@ typedef struct
     NormObjectHandle    object;
 } NormEvent;
     
+// Per-shard load statistics (see NormSetShardCount())
+typedef struct
+{
+    unsigned int        sessionCount;     // sessions assigned to the shard
+    unsigned long       eventCount;       // notifications posted by the shard
+    unsigned long       ringPromptCount;  // stream ring service prompts handled
+} NormShardStats;
+
+// Structured statistics (see NormGetSessionStats(), NormNodeGetStats() and
+// NormObjectGetStats()).  The app sets the "version" member to the
+// NORM_STATS_VERSION it was built with before the call and only the
+// members of that version are filled in.  New members are only ever
+// appended for later versions.  The snapshots are published by the NORM
+// thread every 100 msec while a session has traffic, so they may lag the
+// protocol state by that much.
+#define NORM_STATS_VERSION 1
+
+typedef struct
+{
+    unsigned int        version;          // NORM_STATS_VERSION
+    // Message traffic (all NORM message types)
+    unsigned long long  bytesSent;
+    unsigned long long  packetsSent;
+    unsigned long long  bytesReceived;
+    unsigned long long  packetsReceived;
+    // Sender repair
+    unsigned long long  repairsSent;      // NORM_DATA sent for blocks in repair
+    unsigned long       nacksReceived;
+    // Receiver repair (totals for all remote senders)
+    unsigned long       nacksSent;
+    unsigned long       nacksSuppressed;
+    unsigned long       fecDecodes;       // blocks recovered with FEC decoding
+    // Sender buffer pool
+    unsigned long       bufferUsage;      // bytes
+    unsigned long       bufferPeak;       // bytes
+    unsigned long       bufferOverruns;
+    // Sender rate and congestion control
+    double              txRate;           // bytes/sec
+    double              grtt;             // advertised GRTT (sec)
+    double              ccRtt;            // current limiting receiver (CLR) RTT (sec)
+    double              ccLoss;           // CLR loss fraction
+    // Remote sender timer lag (late expiration)
+    double              timerLag;         // most recent (sec)
+    double              timerLagMax;      // maximum (sec)
+} NormSessionStats;
+
+// Remote sender statistics (kept by the receiver)
+typedef struct
+{
+    unsigned int        version;          // NORM_STATS_VERSION
+    unsigned long long  bytesReceived;
+    unsigned long long  packetsReceived;
+    unsigned long long  goodputBytes;     // object source data received or decoded
+    unsigned long       nacksSent;
+    unsigned long       nacksSuppressed;
+    unsigned long       fecDecodes;
+    unsigned long       objectsCompleted;
+    unsigned long       objectsPending;
+    unsigned long       objectsFailed;
+    unsigned long       resyncs;
+    unsigned long       bufferUsage;      // bytes
+    unsigned long       bufferPeak;       // bytes
+    unsigned long       bufferOverruns;
+    double              grtt;             // sender advertised GRTT (sec)
+    double              ccRtt;            // our RTT to the sender (sec)
+    double              ccLoss;           // our loss estimate
+    double              ccRate;           // sender advertised rate (bytes/sec)
+    double              rxRate;           // measured receive rate (bytes/sec)
+} NormNodeStats;
+
+typedef struct
+{
+    unsigned int        version;          // NORM_STATS_VERSION
+    unsigned long long  packetsSent;      // NORM_DATA (sender)
+    unsigned long long  repairsSent;      // NORM_DATA sent for blocks in repair (sender)
+    unsigned long long  packetsReceived;  // NORM_DATA and NORM_INFO (receiver)
+    unsigned long       fecDecodes;       // (receiver)
+} NormObjectStats;
+
 
 // For setting custom NORM_OBJECT_DATA alloc/free functions
 typedef char* (*NormAllocFunctionHandle)(size_t);
@@ -239,6 +341,43 @@ bool NormSuspendInstance(NormInstanceHandle instanceHandle);
 NORM_API_LINKAGE 
 void NormResumeInstance(NormInstanceHandle instanceHandle);
 
+// Runs the instance's sessions across "shardCount" NORM protocol threads
+// (the default is 1).  New sessions are assigned to the shard with the
+// fewest sessions unless pinned with "NormCreateSessionOnShard()".  Events
+// from all shards are merged into the instance's "NormGetNextEvent()"
+// stream (in order per session, but not across shards).  Sessions can't
+// migrate, so the shard count may only be changed while the instance has
+// no sessions.
+NORM_API_LINKAGE 
+bool NormSetShardCount(NormInstanceHandle instanceHandle, unsigned int shardCount);
+
+NORM_API_LINKAGE 
+unsigned int NormGetShardCount(NormInstanceHandle instanceHandle);
+
+NORM_API_LINKAGE 
+bool NormGetShardStats(NormInstanceHandle instanceHandle, 
+                       unsigned int       shardIndex, 
+                       NormShardStats*    shardStats);
+
+// Publishes session and remote sender statistics every "interval" seconds
+// into a shared memory segment (named "norm.<pid>.<n>" if "segmentName" is
+// NULL) that external monitors such as "normStat" read without any API
+// calls.  An "interval" <= 0.0 disables the export and removes the segment.
+NORM_API_LINKAGE
+bool NormSetMetricsExport(NormInstanceHandle instanceHandle,
+                          const char*        segmentName DEFAULT((const char*)0),
+                          double             interval DEFAULT(1.0));
+
+// Writes the message trace of sessions with NormSetMessageTrace() enabled
+// as compact binary records to "traceFile" instead of as debug log text.
+// Records are queued on a lock-free ring per NORM thread and written by a
+// background thread (dropping records rather than ever blocking protocol
+// operation) and the "normTraceDecode" tool converts the file to the text
+// trace or "n2m" MGEN log format.  A NULL "traceFile" closes the file.
+NORM_API_LINKAGE
+bool NormSetMessageTraceFile(NormInstanceHandle instanceHandle,
+                             const char*        traceFile);
+
 
 // This MUST be set to enable NORM_OBJECT_FILE reception!
 // (otherwise received files are ignored)
@@ -251,6 +390,16 @@ bool NormSetCacheDirectory(NormInstanceHandle instanceHandle,
 NORM_API_LINKAGE 
 bool NormGetNextEvent(NormInstanceHandle instanceHandle, NormEvent* theEvent, bool waitForEvent DEFAULT(true));
 
+// Retrieves up to "maxEvents" pending events in one call (with a single
+// suspension of the NORM thread) and returns the number retrieved.  The
+// handles of all returned events remain valid until the next call to
+// "NormGetNextEvent()", "NormGetNextEvents()", or "NormReleasePreviousEvent()"
+NORM_API_LINKAGE 
+unsigned int NormGetNextEvents(NormInstanceHandle instanceHandle, 
+                               NormEvent*         eventArray, 
+                               unsigned int       maxEvents,
+                               bool               waitForEvent DEFAULT(true));
+
 // The "NormGetDescriptor()" function returns a HANDLE (WIN32) or
 // a file descriptor (UNIX) which can be used for async notification
 // of pending NORM events. On WIN32, the returned HANDLE can be used 
@@ -282,9 +431,20 @@ NormSessionHandle NormCreateSession(NormInstanceHandle instanceHandle,
                                     UINT16             sessionPort,
                                     NormNodeId         localNodeId);
 
+// Creates a session pinned to the given shard (see NormSetShardCount())
+NORM_API_LINKAGE 
+NormSessionHandle NormCreateSessionOnShard(NormInstanceHandle instanceHandle,
+                                           const char*        sessionAddress,
+                                           UINT16             sessionPort,
+                                           NormNodeId         localNodeId,
+                                           unsigned int       shardIndex);
+
 NORM_API_LINKAGE 
 void NormDestroySession(NormSessionHandle sessionHandle);
 
+NORM_API_LINKAGE 
+unsigned int NormGetSessionShard(NormSessionHandle sessionHandle);
+
 NORM_API_LINKAGE 
 NormInstanceHandle NormGetInstance(NormSessionHandle sessionHandle);
 
@@ -367,6 +527,26 @@ void NormSetRxPortReuse(NormSessionHandle sessionHandle,
 NORM_API_LINKAGE
 UINT16 NormGetRxPort(NormSessionHandle sessionHandle);
 
+// Receive fan-out spreads one busy session's reception across cores.  The
+// app creates "memberCount" receive sessions with the same address, port and
+// local NormNodeId (e.g., one per shard with "NormCreateSessionOnShard()"),
+// and calls this for each _before_ "NormStartReceiver()".  Their rx sockets
+// share the port via SO_REUSEPORT and datagrams are steered by NORM sender id
+// (a BPF program on Linux), so each remote sender is owned by one member.
+NORM_API_LINKAGE
+bool NormSetRxFanout(NormSessionHandle sessionHandle,
+                     unsigned int      memberIndex,
+                     unsigned int      memberCount);
+
+// Kernel receive timestamps (SO_TIMESTAMPNS, where supported) let the
+// session's GRTT/RTT and loss estimation use each datagram's arrival time 
+// instead of the time it was read from the socket.  Call _before_ 
+// "NormStartSender()" or "NormStartReceiver()".  Returns false if the
+// platform does not support it.
+NORM_API_LINKAGE
+bool NormSetRxTimestamping(NormSessionHandle sessionHandle,
+                           bool              enable);
+
 NORM_API_LINKAGE
 bool NormGetRxBindAddress(NormSessionHandle sessionHandle, char* addr, unsigned int& addrLen, UINT16& port);
 
@@ -434,12 +614,48 @@ void NormSetDebugLevel(unsigned int level);
 NORM_API_LINKAGE
 unsigned int NormGetDebugLevel();
 
+// Defers the formatting of NORM's per-packet debug messages: only their
+// raw arguments are queued (to a lock-free ring) and a background thread
+// formats and logs them so debug logging distorts protocol timing less.
+// (Other debug output is still logged immediately and so may appear out
+//  of order with respect to deferred messages, and deferred messages are
+//  dropped if the ring overflows.)  Builds can also compile out these
+//  messages above a given level with the NORM_DEBUG_MAX macro (e.g.,
+//  -DNORM_DEBUG_MAX=PL_INFO).
+NORM_API_LINKAGE
+bool NormSetDebugAsync(bool state);
+
 NORM_API_LINKAGE
 void NormSetReportInterval(NormSessionHandle sessionHandle, double interval);
 
 NORM_API_LINKAGE
 double NormGetReportInterval(NormSessionHandle sessionHandle);
 
+// The NormGet*Stats() functions copy out a consistent snapshot that the
+// NORM thread publishes as it runs, so they may be called from any thread
+// (frequently, if desired) without pausing protocol operation.  Set
+// "stats->version" to NORM_STATS_VERSION first.
+NORM_API_LINKAGE
+bool NormGetSessionStats(NormSessionHandle sessionHandle,
+                         NormSessionStats* stats);
+
+// Latency histograms kept per session (see NormLatencyType).  Values are
+// recorded with about 3% precision and the percentile query returns the
+// latency (sec) at or below which "percentile" (0.0 - 100.0) of the samples
+// fall, or -1.0 if there are none.  NORM_LATENCY_TYPE_COUNT resets all.
+NORM_API_LINKAGE
+unsigned long NormGetLatencyCount(NormSessionHandle sessionHandle,
+                                  NormLatencyType   latencyType);
+
+NORM_API_LINKAGE
+double NormGetLatencyPercentile(NormSessionHandle sessionHandle,
+                                NormLatencyType   latencyType,
+                                double            percentile);
+
+NORM_API_LINKAGE
+void NormResetLatency(NormSessionHandle sessionHandle,
+                      NormLatencyType   latencyType DEFAULT(NORM_LATENCY_TYPE_COUNT));
+
 /** NORM Sender Functions */
 
 NORM_API_LINKAGE
@@ -495,6 +711,10 @@ NORM_API_LINKAGE
 void NormSetAutoParity(NormSessionHandle sessionHandle,
                        unsigned char     autoParity);
 
+NORM_API_LINKAGE 
+void NormSetTxNackBatching(NormSessionHandle sessionHandle,
+                           bool              state);
+
 NORM_API_LINKAGE 
 void NormSetGrttEstimate(NormSessionHandle sessionHandle,
                          double            grttEstimate);
@@ -567,6 +787,17 @@ unsigned int NormStreamWrite(NormObjectHandle streamHandle,
                              const char*      buffer,
                              unsigned int     numBytes);
 
+// Gather-write version of NormStreamWrite().  All of the "iov" fragments are
+// copied to the stream under a single NORM thread lock.  A zero-length iovec
+// entry marks an end-of-message boundary between fragment groups and "eom"
+// marks the end of the last group.  Returns number of bytes copied (which
+// may be less than the sum of the iov_len values if the stream fills up)
+NORM_API_LINKAGE 
+unsigned int NormStreamWritev(NormObjectHandle    streamHandle,
+                              const struct iovec* iov,
+                              unsigned int        iovCount,
+                              bool                eom DEFAULT(false));
+
 NORM_API_LINKAGE 
 void NormStreamFlush(NormObjectHandle streamHandle, 
                      bool             eom DEFAULT(false),
@@ -580,7 +811,20 @@ NORM_API_LINKAGE
 void NormStreamSetPushEnable(NormObjectHandle streamHandle, 
                              bool             pushEnable);
 
-NORM_API_LINKAGE 
+// Attaches a lock-free ring of (at least) "ringSize" bytes between the calling
+// application thread and the NORM thread.  NormStreamWrite(), NormStreamMarkEom(),
+// NormStreamFlush() (sender) and NormStreamRead() (receiver) then no longer lock
+// the NORM thread; it drains or fills the ring itself and notifications are posted
+// upon ring empty/non-empty (or full) transitions.  Only a single application
+// thread may access a stream with a ring (and NormStreamFlush() with NORM_FLUSH_NONE
+// then only marks any "eom").  A receive ring should be set upon
+// NORM_RX_OBJECT_NEW and NormStreamReadAcquire() is not supported with it.
+// A "ringSize" of zero removes an (empty) ring.
+NORM_API_LINKAGE
+bool NormStreamSetRingSize(NormObjectHandle streamHandle,
+                           unsigned int     ringSize);
+
+NORM_API_LINKAGE
 bool NormStreamHasVacancy(NormObjectHandle streamHandle);
 
 NORM_API_LINKAGE
@@ -639,6 +883,12 @@ bool NormGetAckEx(NormSessionHandle sessionHandle,
                   char*             buffer,
                   unsigned int*     buflen);
 
+NORM_API_LINKAGE
+bool NormGetAckingAggregate(NormSessionHandle sessionHandle,
+                            NormNodeId        nodeId,
+                            unsigned int*     memberCount,
+                            unsigned int*     ackedCount);
+
 NORM_API_LINKAGE 
 bool NormSendCommand(NormSessionHandle  sessionHandle,
                      const char*        cmdBuffer, 
@@ -681,6 +931,30 @@ NORM_API_LINKAGE
 void NormNodeSetUnicastNack(NormNodeHandle   remoteSender,
                             bool             unicastNacks);
 
+NORM_API_LINKAGE 
+void NormSetLocalRepair(NormSessionHandle sessionHandle,
+                        bool              enable,
+                        unsigned char     ttl DEFAULT(1));
+
+NORM_API_LINKAGE 
+bool NormSetLocalRepairPeer(NormSessionHandle sessionHandle,
+                            const char*       peerAddress,
+                            UINT16            peerPort);
+
+NORM_API_LINKAGE 
+bool NormSetAckAggregator(NormSessionHandle sessionHandle,
+                          NormNodeId        aggregatorId,
+                          const char*       aggregatorAddress DEFAULT((const char*)0),
+                          UINT16            aggregatorPort DEFAULT(0));
+
+NORM_API_LINKAGE 
+bool NormAddAggregateMember(NormSessionHandle sessionHandle,
+                            NormNodeId        memberId);
+
+NORM_API_LINKAGE 
+void NormRemoveAggregateMember(NormSessionHandle sessionHandle,
+                               NormNodeId        memberId);
+
 NORM_API_LINKAGE 
 void NormSetDefaultSyncPolicy(NormSessionHandle sessionHandle,
                               NormSyncPolicy    syncPolicy);
@@ -726,6 +1000,19 @@ bool NormStreamRead(NormObjectHandle   streamHandle,
                     char*              buffer,
                     unsigned int*      numBytes);
 
+// Zero-copy alternative to NormStreamRead().  On input, "iovCount" is the
+// number of "iov" entries available; on output it is the number of in-order
+// stream data slices that "iov" now points to.  The slice memory remains
+// valid (and the stream buffer space occupied) until NormStreamReadRelease()
+// is called.  Returns false upon a stream break, like NormStreamRead().
+NORM_API_LINKAGE 
+bool NormStreamReadAcquire(NormObjectHandle streamHandle,
+                           struct iovec*    iov,
+                           unsigned int*    iovCount);
+
+NORM_API_LINKAGE 
+void NormStreamReadRelease(NormObjectHandle streamHandle);
+
 NORM_API_LINKAGE 
 bool NormStreamSeekMsgStart(NormObjectHandle streamHandle);
 
@@ -757,6 +1044,10 @@ NormSize NormObjectGetSize(NormObjectHandle objectHandle);
 NORM_API_LINKAGE 
 NormSize NormObjectGetBytesPending(NormObjectHandle objectHandle);
 
+NORM_API_LINKAGE 
+bool NormObjectGetStats(NormObjectHandle objectHandle,
+                        NormObjectStats* stats);
+
 NORM_API_LINKAGE 
 void NormObjectCancel(NormObjectHandle objectHandle);
 
@@ -810,6 +1101,10 @@ const void* NormNodeGetUserData(NormNodeHandle nodeHandle);
 NORM_API_LINKAGE
 double NormNodeGetGrtt(NormNodeHandle remoteSender);
 
+NORM_API_LINKAGE
+bool NormNodeGetStats(NormNodeHandle remoteSender,
+                      NormNodeStats* stats);
+
 
 NORM_API_LINKAGE
 bool NormNodeGetCommand(NormNodeHandle remoteSender,
@@ -0,0 +1,32 @@
+#ifndef _NORM_ATOMIC
+#define _NORM_ATOMIC
+
+// Atomic access macros shared by the NORM code that passes state between
+// the NORM protocol thread and application (or helper) threads without
+// locks (e.g. the NormStreamRing, NormStatsLock and NormTraceLog).  LOAD
+// and STORE have acquire and release semantics, respectively, FENCE is a
+// full fence and WRITE_FENCE/READ_FENCE are release/acquire fences.
+
+#include "protoDefs.h"   // for UINT32 (and <windows.h> on WIN32)
+
+#ifdef WIN32
+#define NORM_ATOMIC_LOAD(x)         (MemoryBarrier(), (x))
+#define NORM_ATOMIC_STORE(x, v)     do {MemoryBarrier(); (x) = (v);} while (0)
+#define NORM_ATOMIC_FENCE()         MemoryBarrier()
+#define NORM_ATOMIC_WRITE_FENCE()   MemoryBarrier()
+#define NORM_ATOMIC_READ_FENCE()    MemoryBarrier()
+#define NORM_ATOMIC_SWAP(x, v)      ((UINT32)InterlockedExchange((volatile LONG*)&(x), (LONG)(v)))
+#define NORM_ATOMIC_CAS(x, e, v)    (InterlockedCompareExchange((volatile LONG*)&(x), (LONG)(v), (LONG)(e)) == (LONG)(e))
+#define NORM_ATOMIC_ADD(x, v)       InterlockedExchangeAdd((volatile LONG*)&(x), (LONG)(v))
+#else
+#define NORM_ATOMIC_LOAD(x)         __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define NORM_ATOMIC_STORE(x, v)     __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define NORM_ATOMIC_FENCE()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define NORM_ATOMIC_WRITE_FENCE()   __atomic_thread_fence(__ATOMIC_RELEASE)
+#define NORM_ATOMIC_READ_FENCE()    __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define NORM_ATOMIC_SWAP(x, v)      __atomic_exchange_n(&(x), (v), __ATOMIC_ACQ_REL)
+#define NORM_ATOMIC_CAS(x, e, v)    __sync_bool_compare_and_swap(&(x), (e), (v))
+#define NORM_ATOMIC_ADD(x, v)       __atomic_fetch_add(&(x), (v), __ATOMIC_RELAXED)
+#endif // if/else WIN32
+
+#endif // _NORM_ATOMIC
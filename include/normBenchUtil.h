@@ -0,0 +1,51 @@
+#ifndef _NORM_BENCH_UTIL
+#define _NORM_BENCH_UTIL
+
+// Timing and event wait helpers shared by the NORM benchmark and test
+// programs (normBench, normBlockBench, normNodeBench, normTimerBench and
+// normLeaseTest)
+
+#include "normApi.h"
+#include "protokit.h"  // for ProtoSystemTime()
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/select.h>
+#endif // if/else WIN32
+
+// Current system time (sec)
+inline double NormBenchCurrentTime()
+{
+    struct timeval currentTime;
+    ProtoSystemTime(currentTime);
+    return (currentTime.tv_sec + 1.0e-06*currentTime.tv_usec);
+}
+
+// Time elapsed since "startTime" (usec)
+inline double NormBenchElapsedUsec(const struct timeval& startTime)
+{
+    struct timeval currentTime;
+    ProtoSystemTime(currentTime);
+    return (1.0e+06*(currentTime.tv_sec - startTime.tv_sec) +
+            (currentTime.tv_usec - startTime.tv_usec));
+}
+
+// Waits up to "timeout" seconds for the instance to have a pending event
+inline bool NormBenchWaitForEvent(NormInstanceHandle instance, double timeout)
+{
+#ifdef WIN32
+    return (WAIT_OBJECT_0 == WaitForSingleObject(NormGetDescriptor(instance), (DWORD)(1000.0*timeout)));
+#else
+    NormDescriptor fd = NormGetDescriptor(instance);
+    fd_set fdSet;
+    FD_ZERO(&fdSet);
+    FD_SET(fd, &fdSet);
+    struct timeval timeoutTime;
+    timeoutTime.tv_sec = (long)timeout;
+    timeoutTime.tv_usec = (long)(1.0e+06*(timeout - (double)timeoutTime.tv_sec));
+    return (select(fd + 1, &fdSet, NULL, NULL, &timeoutTime) > 0);
+#endif // if/else WIN32
+}
+
+#endif // _NORM_BENCH_UTIL
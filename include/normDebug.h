@@ -0,0 +1,116 @@
+#ifndef _NORM_DEBUG
+#define _NORM_DEBUG
+
+#include "normStats.h"  // for NORM_ATOMIC_LOAD/STORE/CAS
+#include "protokit.h"   // for PLOG(), GetDebugLevel(), ProtoDispatcher
+
+#include <stdarg.h>     // for va_list
+
+// NLOG() is used in place of PLOG() for the debug output of the per-packet
+// code paths.  Sites above the compile-time NORM_DEBUG_MAX level (e.g.,
+// build with -DNORM_DEBUG_MAX=PL_INFO) compile out entirely and the rest
+// check the run-time debug level before any of their arguments are
+// evaluated.  While the deferred debug logger is running (see
+// NormSetDebugAsync()), NormLog() only copies the raw arguments (and any
+// "%s" strings) into a lock-free ring and a background thread does the
+// formatting and output so logging distorts protocol timing less.
+// (The "format" must be a string literal since only its pointer is kept,
+//  and NLOG() is not for PL_ALWAYS output)
+
+#ifndef NORM_DEBUG_MAX
+#define NORM_DEBUG_MAX  PL_DETAIL
+#endif // !NORM_DEBUG_MAX
+
+#define NLOG(level, ...) \
+    do {if (((level) <= NORM_DEBUG_MAX) && ((unsigned int)(level) <= GetDebugLevel())) \
+            NormLog((level), __VA_ARGS__);} while (0)
+
+void NormLog(ProtoDebugLevel level, const char* format, ...);
+
+// The NormDebugLogger queues messages from any thread to a bounded
+// multi-producer ring (whose slots carry their own sequence numbers) that
+// its background thread drains.  Messages are dropped (and counted) rather
+// than blocking a producer when the ring is full.  Formats the ring can't
+// represent (e.g., "*" widths or too many arguments) are simply formatted
+// and logged immediately by the caller.
+class NormDebugLogger
+{
+    public:
+        enum
+        {
+            RECORD_COUNT    = 4096,  // (must be a power of 2)
+            ARG_MAX         = 10,
+            TEXT_MAX        = 120,   // for copied "%s" strings
+            LOG_LINE_MAX    = 2048
+        };
+
+        NormDebugLogger();
+        ~NormDebugLogger();
+
+        static NormDebugLogger& Instance();  // (process-wide logger)
+
+        bool Start(double drainInterval = 0.010);
+        void Stop();
+        bool IsRunning() const
+            {return (0 != NORM_ATOMIC_LOAD(running));}
+
+        // Returns false if the caller must log the message itself
+        // (i.e., the format isn't supported) and true if it was queued
+        // or dropped because the ring is full
+        bool Post(ProtoDebugLevel level, const char* format, va_list args);
+
+        // The argument classes of printf() conversions
+        enum ArgType
+        {
+            ARG_NONE,       // "%%"
+            ARG_INT,
+            ARG_LONG,
+            ARG_LONG_LONG,
+            ARG_SIZE,
+            ARG_DOUBLE,
+            ARG_STRING,
+            ARG_POINTER,
+            ARG_INVALID     // (not supported)
+        };
+        // Returns pointer past the conversion beginning at "ptr" (a '%')
+        static const char* ParseConversion(const char* ptr, ArgType& argType);
+
+    private:
+        union Arg
+        {
+            long long       i;
+            double          d;
+            const void*     p;
+            unsigned int    offset;  // of ARG_STRING in "text"
+        };
+        struct Record
+        {
+            UINT32          sequence;   // slot sequence (see Post())
+            UINT8           level;
+            UINT8           arg_count;
+            UINT16          text_len;
+            const char*     format;
+            Arg             arg[ARG_MAX];
+            char            text[TEXT_MAX];
+        };
+
+#ifndef SIMULATE
+        bool OnDrainTimeout(ProtoTimer& theTimer);
+#endif // !SIMULATE
+        void Drain();
+        void Output(const Record& record);
+
+        Record*             record_list;
+        UINT32              enqueue_pos;   // (claimed by producers)
+        UINT32              dequeue_pos;   // (drain thread only)
+        UINT32              drop_count;
+        UINT32              drop_logged;
+        UINT32              running;
+#ifndef SIMULATE
+        ProtoDispatcher     dispatcher;    // background drain thread
+        ProtoTimer          drain_timer;
+#endif // !SIMULATE
+
+};  // end class NormDebugLogger
+
+#endif // _NORM_DEBUG
@@ -0,0 +1,102 @@
+#ifndef _NORM_HISTOGRAM
+#define _NORM_HISTOGRAM
+
+#include "protoDefs.h"  // for UINT32
+
+#include <stdlib.h>     // for qsort()
+#include <math.h>       // for ceil()
+
+#ifdef WIN32
+#include <intrin.h>  // for _BitScanReverse()
+#else
+#include <sys/time.h>  // for struct timeval
+#endif // if/else WIN32
+
+#ifdef WIN32
+inline unsigned int NormMsb32(UINT32 x)  // (x must be non-zero)
+    {unsigned long index; _BitScanReverse(&index, x); return (unsigned int)index;}
+#else
+inline unsigned int NormMsb32(UINT32 x)  // (x must be non-zero)
+    {return (31 - (unsigned int)__builtin_clz(x));}
+#endif // if/else WIN32
+
+// NormHistogram is a log-linear ("HDR" style) histogram of latency values
+// in microseconds.  Values below 2*SUB_COUNT have their own buckets and
+// each power-of-two range above that is split into SUB_COUNT linear
+// sub-buckets, so any recorded value is reported within 1/SUB_COUNT (about
+// 3%) of its actual value over the full 32-bit (~71 minute) range with a
+// fixed bucket array and constant time recording.  It is not thread-safe
+// (the NORM thread records and API calls read with the thread suspended).
+class NormHistogram
+{
+    public:
+        NormHistogram();
+
+        void Reset();
+        void Record(UINT32 usec)
+        {
+            counts[GetIndex(usec)]++;
+            total_count++;
+            total_sum += usec;
+            if (usec < min_value) min_value = usec;
+            if (usec > max_value) max_value = usec;
+        }
+        void RecordInterval(const struct timeval& startTime,
+                            const struct timeval& endTime);
+
+        unsigned long GetCount() const
+            {return total_count;}
+        UINT32 GetMin() const
+            {return ((0 != total_count) ? min_value : 0);}
+        UINT32 GetMax() const
+            {return max_value;}
+        double GetMean() const
+            {return ((0 != total_count) ? ((double)total_sum / (double)total_count) : 0.0);}
+        // Returns the value (usec) at or below which "percent" of the
+        // recorded values fall (0.0 gives the min and 100.0 the max)
+        UINT32 GetPercentile(double percent) const;
+
+    private:
+        enum
+        {
+            SUB_BITS     = 5,
+            SUB_COUNT    = (1 << SUB_BITS),
+            BUCKET_COUNT = ((2 + 31 - SUB_BITS) * SUB_COUNT)
+        };
+        static unsigned int GetIndex(UINT32 value)
+        {
+            if (value < (2 * SUB_COUNT)) return value;
+            unsigned int shift = NormMsb32(value) - SUB_BITS;
+            return ((SUB_COUNT * shift) + (value >> shift));
+        }
+        static UINT32 GetHighestEquivalent(unsigned int index);
+
+        UINT32              counts[BUCKET_COUNT];
+        unsigned long       total_count;
+        unsigned long long  total_sum;
+        UINT32              min_value;
+        UINT32              max_value;
+
+};  // end class NormHistogram
+
+// Tools that keep every sample rather than a NormHistogram (e.g. normBench
+// and normVsim) sort their sample list and take nearest rank percentiles
+inline int NormCompareSamples(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return ((x < y) ? -1 : ((x > y) ? 1 : 0));
+}
+inline void NormSortSamples(double* sampleList, unsigned long sampleCount)
+    {qsort(sampleList, sampleCount, sizeof(double), NormCompareSamples);}
+// (returns 0.0 for an empty list)
+inline double NormSamplePercentile(const double* sortedList, unsigned long sampleCount, double percent)
+{
+    if (0 == sampleCount) return 0.0;
+    unsigned long rank = (unsigned long)ceil(0.01 * percent * sampleCount);
+    if (0 == rank) rank = 1;
+    if (rank > sampleCount) rank = sampleCount;
+    return sortedList[rank - 1];
+}
+
+#endif // _NORM_HISTOGRAM
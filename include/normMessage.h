@@ -332,7 +332,9 @@ class NormHeaderExtension
             FTI         =  64,  // FEC Object Transmission Information (FTI) extension
             CC_FEEDBACK =   3,  // NORM-CC Feedback extension
             CC_RATE     = 128,  // NORM-CC Rate extension
-            APP_ACK     =  65   // app-defined ACK extension (see NormSetWatermarkEx())
+            APP_ACK     =  65,  // app-defined ACK extension (see NormSetWatermarkEx())
+            LOCAL_REPAIR=  66,  // marks NORM_DATA resent by a local repair peer
+            AGG_ACK     =  67   // watermark ACK summary from an ACK aggregator
         }; 
             
         NormHeaderExtension();
@@ -1541,6 +1543,63 @@ class NormCCRateExtension : public NormHeaderExtension
         };
 };  // end class NormCCRateExtension
 
+// This (non-RFC 5740) extension is attached to NORM_DATA messages that a
+// receiver acting as a local repair peer retransmits on the sender's behalf.
+// (The message source id remains that of the original sender.)
+class NormLocalRepairExtension : public NormHeaderExtension
+{
+    public:
+        virtual void Init(UINT32* theBuffer, UINT16 numBytes)
+        {
+            AttachBuffer(theBuffer, numBytes);
+            SetType(LOCAL_REPAIR);
+            SetWords(2);
+            ((UINT16*)buffer)[RESERVED_OFFSET] = 0;
+        }
+        void SetRepairerId(NormNodeId repairerId)
+            {buffer[REPAIRER_ID_OFFSET] = htonl(repairerId);}
+        NormNodeId GetRepairerId() const
+            {return (ntohl(buffer[REPAIRER_ID_OFFSET]));}
+        
+    private:
+        enum
+        {
+            RESERVED_OFFSET    = (LENGTH_OFFSET + 1)/2,
+            REPAIRER_ID_OFFSET = ((RESERVED_OFFSET*2)+2)/4
+        };
+};  // end class NormLocalRepairExtension
+
+// An ACK aggregator's NORM_ACK(FLUSH) carries this to summarize how many
+// of its aggregated member nodes have acknowledged the watermark
+class NormAggregateAckExtension : public NormHeaderExtension
+{
+    public:
+        virtual void Init(UINT32* theBuffer, UINT16 numBytes)
+        {
+            AttachBuffer(theBuffer, numBytes);
+            SetType(AGG_ACK);
+            SetWords(2);
+            ((UINT16*)buffer)[RESERVED_OFFSET] = 0;
+        }
+        void SetMemberCount(UINT16 count)
+            {((UINT16*)buffer)[MEMBER_COUNT_OFFSET] = htons(count);}
+        void SetAckedCount(UINT16 count)
+            {((UINT16*)buffer)[ACKED_COUNT_OFFSET] = htons(count);}
+        
+        UINT16 GetMemberCount() const
+            {return (ntohs(((UINT16*)buffer)[MEMBER_COUNT_OFFSET]));}
+        UINT16 GetAckedCount() const
+            {return (ntohs(((UINT16*)buffer)[ACKED_COUNT_OFFSET]));}
+        
+    private:
+        enum
+        {
+            RESERVED_OFFSET     = (LENGTH_OFFSET + 1)/2,
+            MEMBER_COUNT_OFFSET = RESERVED_OFFSET + 1,
+            ACKED_COUNT_OFFSET  = MEMBER_COUNT_OFFSET + 1
+        };
+};  // end class NormAggregateAckExtension
+
 // This implementation currently assumes "fec_id"= 129
 class NormRepairRequest
 {
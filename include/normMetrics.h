@@ -0,0 +1,158 @@
+#ifndef _NORM_METRICS
+#define _NORM_METRICS
+
+#include "normStats.h"  // for NormStatsLock
+
+// The NormMetrics class manages a shared memory "metrics segment" where a
+// NORM API instance periodically publishes the statistics of its sessions
+// and their remote senders so that external monitors (e.g., the "normStat"
+// tool) can watch every NORM process on a host without any API calls.
+//
+// The segment is a Header followed by SHARD_SESSION_MAX session slots and
+// SHARD_SENDER_MAX remote sender slots per NORM thread shard.  Each shard's
+// NORM thread is the only writer of its own slots, which it rewrites on
+// every publication (in-use slots are kept contiguous), and each slot is a
+// NormStatsLock so readers copy out consistent entries lock-free.  The
+// Header records the layout version and struct sizes and a reader must
+// not interpret a segment whose values differ from its own.
+//
+// (Segments are POSIX shared memory objects named "/norm.<pid>.<n>" by
+//  default, and are not currently supported on WIN32 or Android)
+
+#define NORM_METRICS_MAGIC      0x4e4f524d  // "NORM"
+#define NORM_METRICS_VERSION    1
+#define NORM_METRICS_PREFIX     "norm."
+
+class NormMetrics
+{
+    public:
+        enum
+        {
+            SHARD_SESSION_MAX   = 32,
+            SHARD_SENDER_MAX    = 256,
+            ADDR_STRING_MAX     = 64
+        };
+
+        struct Header
+        {
+            UINT32      magic;          // NORM_METRICS_MAGIC
+            UINT32      version;        // NORM_METRICS_VERSION
+            UINT32      header_size;    // sizeof(Header)
+            UINT32      session_size;   // sizeof(SessionSlot)
+            UINT32      sender_size;    // sizeof(SenderSlot)
+            UINT32      process_id;
+            UINT32      shard_count;
+            UINT32      session_max;    // shard_count * SHARD_SESSION_MAX
+            UINT32      sender_max;     // shard_count * SHARD_SENDER_MAX
+            UINT32      interval_msec;  // publication interval
+        };
+
+        enum SessionFlag
+        {
+            SESSION_SENDER   = 0x01,
+            SESSION_RECEIVER = 0x02
+        };
+
+        struct SessionEntry
+        {
+            UINT32              in_use;
+            UINT32              flags;         // SessionFlag bits
+            UINT32              local_id;      // local NormNodeId
+            UINT32              shard;
+            UINT32              sender_count;  // remote senders (incl. unpublished)
+            UINT32              reserved;
+            char                address[ADDR_STRING_MAX];  // "<addr>/<port>"
+            double              update_time;   // (sec) of this publication
+            unsigned long long  sent_bytes;
+            unsigned long long  sent_packets;
+            unsigned long long  recv_bytes;
+            unsigned long long  recv_packets;
+            unsigned long long  tx_repairs;
+            unsigned long long  nacks_received;
+            unsigned long long  nacks_sent;
+            unsigned long long  nacks_suppressed;
+            unsigned long long  fec_decodes;
+            unsigned long long  buffer_usage;
+            unsigned long long  buffer_peak;
+            unsigned long long  buffer_overruns;
+            double              tx_rate;
+            double              grtt;
+            double              cc_rtt;
+            double              cc_loss;
+            double              timer_lag;
+            double              timer_lag_max;
+        };
+
+        struct SenderEntry
+        {
+            UINT32              in_use;
+            UINT32              session;       // index of its session slot
+            UINT32              node_id;
+            UINT32              reserved;
+            char                address[ADDR_STRING_MAX];  // "<addr>/<port>"
+            double              update_time;
+            unsigned long long  recv_bytes;
+            unsigned long long  recv_packets;
+            unsigned long long  goodput_bytes;
+            unsigned long long  nacks_sent;
+            unsigned long long  nacks_suppressed;
+            unsigned long long  fec_decodes;
+            unsigned long long  objects_completed;
+            unsigned long long  objects_pending;
+            unsigned long long  objects_failed;
+            unsigned long long  resyncs;
+            unsigned long long  buffer_usage;
+            unsigned long long  buffer_peak;
+            unsigned long long  buffer_overruns;
+            unsigned long long  stream_usage;   // stream buffer usage
+            unsigned long long  stream_peak;
+            unsigned long long  stream_overruns;
+            double              grtt;
+            double              rtt;
+            double              loss;
+            double              send_rate;
+            double              recv_rate;
+        };
+
+        typedef NormStatsLock<SessionEntry> SessionSlot;
+        typedef NormStatsLock<SenderEntry>  SenderSlot;
+
+        NormMetrics();
+        ~NormMetrics();
+
+        // Writer: creates (or replaces) and maps the named segment
+        bool Create(const char* segmentName, unsigned int shardCount, double interval);
+        // Reader: maps an existing segment read-only and validates its Header
+        bool Open(const char* segmentName);
+        void Close();  // (the writer also removes the segment)
+
+        bool IsOpen() const
+            {return (NULL != header);}
+        const char* GetName() const
+            {return segment_name;}
+        const Header* GetHeader() const
+            {return header;}
+
+        const SessionSlot* GetSessionSlot(unsigned int index) const
+            {return (session_slot + index);}
+        const SenderSlot* GetSenderSlot(unsigned int index) const
+            {return (sender_slot + index);}
+
+        // Writer: called by a shard's NORM thread to rewrite its slots
+        void Publish(unsigned int shardIndex, class NormSessionMgr& sessionMgr);
+
+    private:
+        bool Map(const char* segmentName, bool create, size_t size);
+
+        char                    segment_name[128];
+        bool                    is_owner;
+        size_t                  segment_size;
+        Header*                 header;
+        SessionSlot*            session_slot;
+        SenderSlot*             sender_slot;
+        unsigned int*           session_used;  // (writer) published per shard
+        unsigned int*           sender_used;
+
+};  // end class NormMetrics
+
+#endif // _NORM_METRICS
@@ -4,12 +4,12 @@
 #include "normMessage.h"
 #include "normObject.h"
 #include "normEncoder.h"
+#include "normTimer.h"
+#include "normStats.h"
 #include "protokit.h"
 
 class NormNode
 {
-    friend class NormNodeTree;
-    friend class NormNodeTreeIterator;
     friend class NormNodeList;
     friend class NormNodeListIterator;
     
@@ -72,8 +72,7 @@ class NormNode
         ProtoAddress        addr;
         unsigned int        reference_count;
         const void*         user_data;
-        // We keep NormNodes in a binary tree (TBD) make this a ProtoTree
-        NormNode*           parent;
+        // Links for NormNodeList membership
         NormNode*           right;
         NormNode*           left;
 };  // end class NormNode
@@ -199,6 +198,7 @@ class NormAckingNode : public NormNode
         {
             ack_received = false;
             req_count = maxAttempts;   
+            agg_member_count = agg_acked_count = 0;
         }
         void DecrementReqCount() {if (req_count > 0) req_count--;}
         void ResetReqCount(unsigned int maxAttempts) 
@@ -207,9 +207,22 @@ class NormAckingNode : public NormNode
         bool AckReceived() const {return ack_received;}
         void MarkAckReceived() {ack_received = true;}
         
+        // Position in the sender's dense acking node index
+        unsigned int GetAckingIndex() const {return acking_index;}
+        void SetAckingIndex(unsigned int index) {acking_index = index;}
+        
         bool SetAckEx(const char* buffer, UINT16 numBytes);
         bool GetAckEx(char* buffer, unsigned int* buflen);
         
+        // Summary reported by a node acting as an ACK aggregator
+        void SetAggregateCounts(UINT16 memberCount, UINT16 ackedCount)
+        {
+            agg_member_count = memberCount;
+            agg_acked_count = ackedCount;
+        }
+        UINT16 GetAggregateMemberCount() const {return agg_member_count;}
+        UINT16 GetAggregateAckedCount() const {return agg_acked_count;}
+        
         /*
         const char* GetAppAckContent() const
             {return (const char*)ack_ex_buffer;}
@@ -219,8 +232,11 @@ class NormAckingNode : public NormNode
     private:
         bool            ack_received; // was ack received?
         unsigned int    req_count;    // remaining request attempts
+        unsigned int    acking_index;
         char*           ack_ex_buffer;
         unsigned int    ack_ex_length;
+        UINT16          agg_member_count;
+        UINT16          agg_acked_count;
         
 };  // end NormAckingNode
 
@@ -267,6 +283,10 @@ class NormCCNode : public NormNode
        void SetRate(double value) {rate = value;}
        void SetCCSequence(UINT16 value) {cc_sequence = value;}
        
+       // Position in the sender's NormCCNodeHeap
+       unsigned int GetHeapIndex() const {return heap_index;}
+       void SetHeapIndex(unsigned int index) {heap_index = index;}
+       
     private:
         bool            is_clr;         // true if worst path representative
         bool            is_plr;         // true if worst path candidate
@@ -282,6 +302,7 @@ class NormCCNode : public NormNode
         double          loss;           // loss fraction
         double          rate;           // in bytes per second
         UINT16          cc_sequence;
+        unsigned int    heap_index;
 };  // end class NormCCNode
 
 class NormSenderNode : public NormNode, public ProtoTree::Item
@@ -357,7 +378,18 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         void HandleObjectMessage(const NormObjectMsg& msg);
         void HandleCCFeedback(UINT8 ccFlags, double ccRate);
         void HandleNackMessage(const NormNackMsg& nack);
+        void HandleLocalRepairRequest(const NormNackMsg& nack, bool relay);
+        // Notes a block just repaired locally (by us or another repair peer)
+        // so requests for it are held off (see HandleLocalRepairRequest())
+        void NoteLocalRepair(const NormObjectId&    objectId, 
+                             const NormBlockId&     blockId,
+                             const struct timeval&  currentTime);
         void HandleAckMessage(const NormAckMsg& ack);
+        // Clears ACK aggregator state
+        void ResetAggregate();
+        // Keeps ACK aggregator state across insertion (or removal) of the
+        // session's aggregate member at "index"
+        void UpdateAggregateMember(UINT16 index, bool inserted);
         
         bool Open(UINT16 instanceId);
         UINT16 GetInstanceId() {return instance_id;}
@@ -461,6 +493,7 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         
         UINT16 Decode(char** segmentList, UINT16 numData, UINT16 erasureCount)
         {
+            decode_count++;
             return decoder->Decode(segmentList, numData, erasureCount, erasure_loc);
         }
         
@@ -490,9 +523,16 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
             {return recv_goodput.GetScaledValue(1.0 / interval);}
         
         void IncrementRecvTotal(unsigned long count) 
-            {recv_total.Increment(count);}
+        {
+            recv_total.Increment(count);
+            recv_bytes += count;
+            recv_packets++;
+        }
         void IncrementRecvGoodput(unsigned long count) 
-            {recv_goodput.Increment(count);}
+        {
+            recv_goodput.Increment(count);
+            goodput_bytes += count;
+        }
         void ResetRecvStats() 
         {
             recv_total.Reset();
@@ -507,6 +547,32 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         unsigned long PendingCount() const {return rx_table.GetCount();}
         unsigned long FailureCount() const {return failure_count;}
         
+        // Statistics snapshot (may be read from any thread)
+        struct Stats
+        {
+            unsigned long long  recv_bytes;
+            unsigned long long  recv_packets;
+            unsigned long long  goodput_bytes;
+            unsigned long       nacks_sent;
+            unsigned long       nacks_suppressed;
+            unsigned long       fec_decodes;
+            unsigned long       objects_completed;
+            unsigned long       objects_pending;
+            unsigned long       objects_failed;
+            unsigned long       resyncs;
+            unsigned long       buffer_usage;
+            unsigned long       buffer_peak;
+            unsigned long       buffer_overruns;
+            double              grtt;
+            double              rtt;
+            double              loss;
+            double              send_rate;
+            double              recv_rate;
+        };
+        void GetStats(Stats& snapshot) const
+            {stats_lock.Read(snapshot);}
+        void UpdateStats();  // publishes current statistics (and those of rx objects)
+        
         class CmdBuffer
         {
             public:
@@ -583,14 +649,22 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
                          NormBlockId            blockId,
                          NormSegmentId          segmentId);
     
-        bool OnActivityTimeout(ProtoTimer& theTimer);
-        bool OnRepairTimeout(ProtoTimer& theTimer);
-        bool OnCCTimeout(ProtoTimer& theTimer);
-        bool OnAckTimeout(ProtoTimer& theTimer);
+        bool OnActivityTimeout(NormTimer& theTimer);
+        bool OnRepairTimeout(NormTimer& theTimer);
+        bool OnCCTimeout(NormTimer& theTimer);
+        bool OnAckTimeout(NormTimer& theTimer);
         
         void AttachCCFeedback(NormAckMsg& ack);
+        bool StartAggregate(NormObjectId    objectId,
+                            NormBlockId     blockId,
+                            NormSegmentId   segmentId);
+        void HandleAggregateAck(const NormAckFlushMsg& ack);
+        bool AggregateAckReady() const;
         void HandleRepairContent(const UINT32* buffer, UINT16 bufferLen);
         void FragmentNack(NormNackMsg& superNack);
+        bool LocalRepairHeldOff(const NormObjectId&     objectId, 
+                                const NormBlockId&      blockId,
+                                const struct timeval&   currentTime) const;
         
         
          
@@ -625,17 +699,31 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         NormBlockPool           block_pool;
         NormSegmentPool         segment_pool;
         NormDecoder*            decoder;
+        
+        // Recent local repairs (hashed by object and block id) so a
+        // repair peer answers a loss event once, not once per NACK
+        enum {LOCAL_REPAIR_SLOTS = 64};
+        class LocalRepairSlot
+        {
+            public:
+                LocalRepairSlot() : valid(false) {}
+                NormObjectId    object_id;
+                NormBlockId     block_id;
+                struct timeval  repair_time;
+                bool            valid;
+        };
+        LocalRepairSlot         local_repair_slots[LOCAL_REPAIR_SLOTS];
         unsigned int*           erasure_loc;
         unsigned int*           retrieval_loc;
         char**                  retrieval_pool;
         unsigned int            retrieval_index;
         
         bool                    sender_active;
-        ProtoTimer              activity_timer;
-        ProtoTimer              repair_timer;
+        NormTimer               activity_timer;
+        NormTimer               repair_timer;
         
         // Watermark acknowledgement
-        ProtoTimer              ack_timer;
+        NormTimer               ack_timer;
 	    bool			        ack_pending;
         NormObjectId            watermark_object_id;
         NormBlockId             watermark_block_id;
@@ -643,6 +731,18 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         bool                    ack_ex_pending;
         char*                   ack_ex_buffer;
         unsigned int            ack_ex_length;
+        bool                    ack_via_aggregator;
+        
+        // ACK aggregator state (member watermark ACKs received)
+        UINT32*                 agg_mask_words;
+        NormBlockMask           agg_ack_mask;
+        UINT16                  agg_ack_count;
+        unsigned int            agg_flush_count;
+        bool                    agg_ack_held;
+        bool                    agg_valid;
+        NormObjectId            agg_object_id;
+        NormBlockId             agg_block_id;
+        NormSegmentId           agg_segment_id;
         
         // Remote sender grtt measurement state       
         double                  grtt_estimate;
@@ -660,7 +760,7 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         bool                    cc_enable;
         bool                    cc_feedback_needed;
         double                  cc_rate;           // ccRate at start of cc_timer
-        ProtoTimer              cc_timer;
+        NormTimer               cc_timer;
         double                  rtt_estimate;
         UINT8                   rtt_quantized;
         bool                    rtt_confirmed;
@@ -691,12 +791,18 @@ class NormSenderNode : public NormNode, public ProtoTree::Item
         unsigned long           suppress_count;
         unsigned long           completion_count;
         unsigned long           failure_count;     // usually due to re-syncs
+        unsigned long long      recv_bytes;
+        unsigned long long      recv_packets;
+        unsigned long long      goodput_bytes;
+        unsigned long           decode_count;
+        NormStatsLock<Stats>    stats_lock;
         
 };  // end class NormSenderNode
     
     
-// Used for binary trees of NormNodes sorted by NormNodeId
-// (TBD - update to use ProtoTree instead?
+// Used to index NormNodes by NormNodeId.  Lookups use an open-addressing
+// (linear probing) hash table, so sequential node ids can't degrade them,
+// and a NormNodeId-sorted array provides ordered iteration.
 class NormNodeTree
 {    
     friend class NormNodeTreeIterator;
@@ -706,16 +812,35 @@ class NormNodeTree
         NormNodeTree();
         ~NormNodeTree();
         NormNode* FindNodeById(NormNodeId nodeId) const;
-        void AttachNode(NormNode *theNode);
+        bool AttachNode(NormNode *theNode);
         void DetachNode(NormNode *theNode);   
-        NormNode* GetRoot() const {return root;}
+        NormNode* GetHead() const  // lowest NormNodeId
+            {return ((0 != node_count) ? node_array[0] : NULL);}
+        unsigned int GetCount() const {return node_count;}
+        bool IsEmpty() const {return (0 == node_count);}
         void Destroy();    // delete all nodes in tree
        
     private: 
+        static unsigned int Hash(NormNodeId nodeId)
+        {
+            UINT32 h = (UINT32)nodeId * 0x9e3779b1;  // Fibonacci hashing mix
+            return (h ^ (h >> 16));
+        }
+        bool Grow();
+        // Index of first sorted entry with id >= (or > if "upper") "nodeId"
+        unsigned int Search(NormNodeId nodeId, bool upper) const;
+        
     // Members
-        NormNode* root;
+        NormNode**      hash_table;   // (hash_mask + 1) slots, at most half full
+        unsigned int    hash_mask;
+        NormNode**      node_array;   // sorted by NormNodeId
+        unsigned int    node_count;
+        unsigned int    array_size;
 };  // end class NormNodeTree
 
+// Iterates in NormNodeId order.  Nodes may be attached or detached during
+// iteration (the iterator resynchronizes with a binary search when it sees
+// that the tree has changed, which assumes node ids are unique in the tree)
 class NormNodeTreeIterator
 {
     public:
@@ -725,7 +850,9 @@ class NormNodeTreeIterator
 
     private:
         const NormNodeTree& tree;
-        NormNode*           next;
+        unsigned int        index;    // sorted array index of next node
+        const NormNode*     prev;     // node last returned (only compared, never dereferenced)
+        NormNodeId          prev_id;
 };  // end class NormNodeTreeIterator
         
 class NormNodeList
@@ -773,6 +900,50 @@ class NormNodeListIterator
         NormNode*           next;
 };  // end class NormNodeListIterator
 
+// A sender's NORM-CC feedback state: the current limiting receiver (CLR)
+// is kept at index zero (see Head()) and the candidate limiting receivers
+// in an indexed heap with the candidate to be replaced first (inactive, 
+// else RTT-confirmed, else highest rate) at its root (see GetWeakest())
+class NormCCNodeHeap
+{
+    public:
+        enum {CANDIDATE_MAX = 4};
+        
+        NormCCNodeHeap();
+        ~NormCCNodeHeap();
+        
+        unsigned int GetCount() const {return count;}
+        bool IsFull() const {return (count >= (1 + CANDIDATE_MAX));}
+        NormCCNode* Head() const 
+            {return ((0 != count) ? node_array[0] : NULL);}
+        NormCCNode* GetNode(unsigned int index) const
+            {return ((index < count) ? node_array[index] : NULL);}
+        NormCCNode* GetWeakest() const 
+            {return ((count > 1) ? node_array[1] : NULL);}
+        NormCCNode* FindNodeById(NormNodeId nodeId) const;
+        
+        // The first node appended becomes the CLR entry
+        bool Append(NormCCNode* theNode);
+        // Call after a candidate's activity, RTT status, or rate changes
+        void Update(NormCCNode* theNode);
+        // Restores heap order after multiple candidates have changed
+        void Heapify();
+        void Destroy();  // delete all nodes
+        
+    private:
+        static bool IsWeaker(const NormCCNode* a, const NormCCNode* b);
+        void Place(NormCCNode* theNode, unsigned int index)
+        {
+            node_array[index] = theNode;
+            theNode->SetHeapIndex(index);
+        }
+        void SiftUp(unsigned int index);
+        void SiftDown(unsigned int index);
+        
+        NormCCNode*     node_array[1 + CANDIDATE_MAX];
+        unsigned int    count;
+};  // end class NormCCNodeHeap
+
 // Used to track remote client sender nodes for server/listener sessions
 class NormClientTree : public ProtoTreeTemplate<NormSenderNode>
 {
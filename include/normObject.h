@@ -4,10 +4,12 @@
 #include "normSegment.h"  // NORM segmentation classes
 #include "normEncoder.h"
 #include "normFile.h"
+#include "normRing.h"
+#include "normStats.h"
 
 #include <stdio.h>
 
-#define USE_PROTO_TREE 1  // for more better performing NormObjectTable?
+// (see normSegment.h regarding USE_PROTO_TREE)
 
 #ifdef USE_PROTO_TREE
 #include "protoTree.h"
@@ -165,6 +167,38 @@ class NormObject
         
         NormObjectSize GetBytesPending() const;
         
+        // Statistics snapshot (may be read from any thread)
+        struct Stats
+        {
+            unsigned long long  tx_packets;   // NORM_DATA built for transmission
+            unsigned long long  tx_repairs;   // (those for blocks in repair)
+            unsigned long long  rx_packets;   // NORM_DATA and NORM_INFO received
+            unsigned long       fec_decodes;
+        };
+        void GetStats(Stats& snapshot) const
+            {stats_lock.Read(snapshot);}
+        void UpdateStats()
+        {
+            stats_lock.BeginUpdate() = stats;
+            stats_lock.EndUpdate();
+        }
+        
+        // Latency measurement start (sender enqueue or receiver first
+        // packet time) and sender first transmission status
+        void SetLatencyStart(const struct timeval& startTime)
+        {
+            latency_start = startTime;
+            tx_first_pending = true;
+        }
+        const struct timeval& GetLatencyStart() const
+            {return latency_start;}
+        bool ClearTxFirstPending()  // (returns previous status)
+        {
+            bool pending = tx_first_pending;
+            tx_first_pending = false;
+            return pending;
+        }
+        
         bool IsPending(bool flush = true) const;
         bool IsRepairPending();
         bool IsPendingInfo() {return pending_info;}
@@ -281,8 +315,15 @@ class NormObject
         const ProtoTime& GetLastNackTime() const
             {return last_nack_time;}
         
-        double GetNackAge() const
-            {return ProtoTime::Delta(ProtoTime().GetCurrentTime(), last_nack_time);}
+        double GetNackAge(const ProtoTime& currentTime) const
+            {return ProtoTime::Delta(currentTime, last_nack_time);}
+        
+        // Used by a receiver acting as a local repair peer to rebuild, on the
+        // sender's behalf, a NORM_DATA message for a segment it holds
+        bool BuildLocalRepairMsg(NormDataMsg&   data,
+                                 NormBlockId    blockId,
+                                 NormSegmentId  segmentId,
+                                 NormNodeId     repairerId);
         
     protected:
         NormObject(Type                     theType, 
@@ -291,6 +332,7 @@ class NormObject
                    const NormObjectId&      objectId); 
     
         void Accept() {accepted = true;}
+        bool AttachFtiExtension(NormObjectMsg* msg);
 
 #ifdef USE_PROTO_TREE    
         // Proto::Tree item required overrides
@@ -341,10 +383,12 @@ class NormObject
         bool                  accepted;
         bool                  notify_on_update;
         
+        Stats                 stats;       // (published by UpdateStats())
+        NormStatsLock<Stats>  stats_lock;
+        struct timeval        latency_start;
+        bool                  tx_first_pending;
+        
         const void*           user_data;  // for NORM API usage only
-#ifndef USE_PROTO_TREE       
-        NormObject*           next;
-#endif  
 };  // end class NormObject
 
 
@@ -500,6 +544,14 @@ class NormStreamObject : public NormObject
         bool Read(char* buffer, unsigned int* buflen, bool findMsgStart = false);
         UINT32 Write(const char* buffer, UINT32 len, bool eom = false);
         
+        // Zero-copy "leased" reads.  On input "count" is the number of array
+        // entries available; on output it is the number of in-order segment
+        // slices handed to the caller.  The leased segments are returned to
+        // the "segment_pool" only upon ReadRelease().
+        bool ReadAcquire(const char** bufferArray, unsigned int* lengthArray, unsigned int* count);
+        void ReadRelease();
+        unsigned int GetReadLeaseCount() const {return read_lease_count;}
+        
         UINT32 GetCurrentReadOffset() {return read_offset;}
         
         unsigned int GetCurrentBufferUsage() const  // in segments
@@ -524,6 +576,14 @@ class NormStreamObject : public NormObject
                                   NormSegmentId segmentId, 
                                   const char*   buffer);
         
+        // Receive-side WriteSegment() variant that stores the received
+        // payload zero-padded so the stream buffer segment can also serve
+        // as the sender's FEC cache copy (via RetrieveSegment())
+        bool AdoptSegment(NormBlockId   blockId, 
+                          NormSegmentId segmentId, 
+                          const char*   buffer)
+            {return StoreSegment(blockId, segmentId, buffer, true);}
+        
         virtual UINT16 ReadSegment(NormBlockId    blockId, 
                                    NormSegmentId  segmentId,
                                    char*          buffer);
@@ -531,6 +591,12 @@ class NormStreamObject : public NormObject
         virtual char* RetrieveSegment(NormBlockId   blockId,
                                       NormSegmentId segmentId);
         
+        // Returns NULL if the segment is not (or no longer) buffered
+        const char* FindBufferedSegment(NormBlockId blockId, NormSegmentId segmentId)
+        {
+            NormBlock* block = stream_buffer.Find(blockId);
+            return ((NULL != block) ? block->GetSegment(segmentId) : NULL);
+        }
         
         // For receive stream, we can rewind to earliest buffered offset
         void Rewind(); 
@@ -580,10 +646,28 @@ class NormStreamObject : public NormObject
             {return ((blockId == read_index.block) && (segmentId == read_index.segment));}
         
         bool PassiveReadCheck(NormBlockId blockId, NormSegmentId segmentId);
+        
+        // Optional API thread <-> NORM thread ring (owned by the stream)
+        void SetRing(NormStreamRing* theRing)
+        {
+            if (NULL != api_ring) delete api_ring;
+            api_ring = theRing;
+        }
+        NormStreamRing* GetRing() const {return api_ring;}
          
     private:
-        bool ReadPrivate(char* buffer, unsigned int* buflen, bool findMsgStart = false);
+        bool ReadPrivate(char*          buffer, 
+                         unsigned int*  buflen, 
+                         bool           findMsgStart = false,
+                         const char**   leaseArray = NULL,
+                         unsigned int*  leaseLengths = NULL);
+        bool StoreSegment(NormBlockId   blockId, 
+                          NormSegmentId segmentId, 
+                          const char*   buffer,
+                          bool          padSegment);
         void Terminate();
+        // Returns any stream_buffer blocks (and their segments) to the pools
+        void EmptyStreamBuffer();
         
         class Index
         {
@@ -616,6 +700,12 @@ class NormStreamObject : public NormObject
         bool                        stream_broken;
         bool                        stream_closing;
         
+        // Receive segments detached and leased to the app by ReadAcquire()
+        // (the "segment_pool" is sized with "read_lease_max" extra segments)
+        char**                      read_lease;
+        unsigned int                read_lease_max;
+        unsigned int                read_lease_count;
+        NormStreamRing*             api_ring;
         
         // For threaded API purposes
         UINT32                      block_pool_threshold;
@@ -663,8 +753,8 @@ class NormObjectTable
         
         NormObjectTable();
         ~NormObjectTable();
-        bool Init(UINT16 rangeMax, UINT16 tableSize = 256);
-        void SetRangeMax(UINT16 rangeMax);
+        bool Init(UINT16 rangeMax);
+        bool SetRangeMax(UINT16 rangeMax);
         void Destroy();
         
         UINT16 GetRangeMax() const {return range_max;}
@@ -711,15 +801,18 @@ class NormObjectTable
 #endif // if/else USE_PROTO_TREE
             
     private:
-#ifndef USE_PROTO_TREE
-        NormObject* Next(NormObject* o) const {return o->next;}    
-#endif
-    
 #ifdef USE_PROTO_TREE
         NormObjectTree  tree;
 #else        
+        // The ring always covers "range_max" ids, so each
+        // object in the table has a slot of its own
+        bool Resize(UINT16 rangeMax);
+        NormObject* FindNext(const NormObjectId& objectId) const;
+        NormObject* FindPrev(const NormObjectId& objectId) const;
         NormObject**    table;
-        UINT16          hash_mask;       
+        UINT32          ring_mask;  // (ring size - 1)
+        UINT32*         slot_storage;
+        NormBlockMask   slot_mask;  // set for occupied ring slots
 #endif // if/else USE_PROTO_TREE
         UINT16          range_max;  // max range of objects that can be kept
         UINT16          range;      // zero if "object table" is empty
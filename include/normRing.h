@@ -0,0 +1,284 @@
+#ifndef _NORM_RING
+#define _NORM_RING
+
+#include "normAtomic.h"  // for NORM_ATOMIC_LOAD/STORE/FENCE/SWAP
+#include "protoDefs.h"   // for UINT32, etc
+#include "protoDebug.h"  // for PLOG(), ASSERT()
+
+#include <string.h>      // for memcpy()
+
+// The NormStreamRing is a lock-free, single-producer/single-consumer
+// byte ring used by the NORM API to pass stream data between an
+// application thread and the NORM protocol thread without suspending
+// the NORM thread for each NormStreamWrite() or NormStreamRead() call.
+// For a transmit stream, the application is the producer and the NORM
+// thread the consumer (and vice versa for a receive stream).  Each side
+// only ever writes its own indices, so acquire/release access to them
+// (plus a full fence where "empty" or "blocked" state is tested) is all
+// the synchronization needed.  Transmit rings also carry a short queue
+// of "marks" (end-of-message and flush requests at a given ring offset).
+
+class NormStreamRing
+{
+    public:
+        NormStreamRing(void* theOwner, bool isSender)
+         : owner(theOwner), is_sender(isSender), buffer(NULL), mask(0), head(0), tail(0),
+           mark_head(0), mark_tail(0), blocked(0), prompt(0), broken(0),
+           seek_pending(false), seek_synced(false), seek_index(0),
+           list(NULL), prev(NULL), next(NULL) {}
+        ~NormStreamRing()
+        {
+            if (NULL != list) list->Remove(*this);
+            if (NULL != buffer) delete[] buffer;
+        }
+
+        // Ring size is rounded up to a power of two (of at most 2^31)
+        bool Init(unsigned int size)
+        {
+            if (size > 0x80000000)
+            {
+                PLOG(PL_ERROR, "NormStreamRing::Init() error: size %u too large\n", size);
+                return false;
+            }
+            unsigned int ringSize = 1;
+            while (ringSize < size) ringSize <<= 1;
+            if (NULL == (buffer = new char[ringSize]))
+            {
+                PLOG(PL_FATAL, "NormStreamRing::Init() new buffer error: %s\n", GetErrorString());
+                return false;
+            }
+            mask = ringSize - 1;
+            return true;
+        }
+
+        void* GetOwner() const {return owner;}
+        bool IsSender() const {return is_sender;}
+        unsigned int GetSize() const {return (mask + 1);}
+
+        // These can be called from either side
+        unsigned int GetCount() const
+            {return (NORM_ATOMIC_LOAD(head) - NORM_ATOMIC_LOAD(tail));}
+        bool IsEmpty() const
+            {return ((0 == GetCount()) && (NORM_ATOMIC_LOAD(mark_head) == NORM_ATOMIC_LOAD(mark_tail)));}
+        // Bytes the producer may currently write (transmit data is held
+        // off while the mark queue is nearly full so an end-of-message
+        // can always be marked after a write)
+        unsigned int GetSpace() const
+        {
+            if ((NORM_ATOMIC_LOAD(mark_head) - NORM_ATOMIC_LOAD(mark_tail)) >= (MARK_MAX - 1)) return 0;
+            return ((mask + 1) - GetCount());
+        }
+
+        // Producer side: copies in up to "numBytes" and returns the number written.
+        // "wasEmpty" is set when the consumer had drained the ring before this
+        // write (i.e., the consumer may be idle and need to be signaled)
+        unsigned int Write(const char* data, unsigned int numBytes, bool& wasEmpty)
+        {
+            unsigned int space = GetSpace();
+            if (numBytes > space) numBytes = space;
+            UINT32 offset = head & mask;
+            UINT32 chunk = (mask + 1) - offset;
+            if (chunk > numBytes) chunk = numBytes;
+            memcpy(buffer + offset, data, chunk);
+            memcpy(buffer, data + chunk, numBytes - chunk);
+            wasEmpty = Commit(numBytes);
+            return numBytes;
+        }
+        // Producer side: contiguous free space for filling in place
+        char* AccessWrite(unsigned int& numBytes)
+        {
+            unsigned int space = GetSpace();
+            UINT32 offset = head & mask;
+            UINT32 chunk = (mask + 1) - offset;
+            numBytes = (chunk < space) ? chunk : space;
+            return (buffer + offset);
+        }
+        // Producer side: publishes "numBytes" written (returns "wasEmpty")
+        bool Commit(unsigned int numBytes)
+        {
+            if (0 == numBytes) return false;
+            UINT32 h = head;
+            NORM_ATOMIC_STORE(head, h + numBytes);
+            NORM_ATOMIC_FENCE();
+            return ((NORM_ATOMIC_LOAD(tail) == h) &&
+                    (NORM_ATOMIC_LOAD(mark_tail) == mark_head));
+        }
+        // Producer side: queues a mark at the current write offset
+        // (returns false if the mark queue is full, else sets "wasEmpty")
+        bool PushMark(bool eom, int flushMode, bool& wasEmpty)
+        {
+            UINT32 mh = mark_head;
+            if ((mh - NORM_ATOMIC_LOAD(mark_tail)) >= MARK_MAX) return false;
+            Mark& mark = mark_list[mh % MARK_MAX];
+            mark.offset = head;
+            mark.eom = eom;
+            mark.flush_mode = flushMode;
+            NORM_ATOMIC_STORE(mark_head, mh + 1);
+            NORM_ATOMIC_FENCE();
+            wasEmpty = ((NORM_ATOMIC_LOAD(tail) == head) &&
+                        (NORM_ATOMIC_LOAD(mark_tail) == mh));
+            return true;
+        }
+
+        // Consumer side: copies out up to "numBytes" and returns the number read
+        unsigned int Read(char* data, unsigned int numBytes)
+        {
+            UINT32 count = NORM_ATOMIC_LOAD(head) - tail;
+            if (numBytes > count) numBytes = count;
+            UINT32 offset = tail & mask;
+            UINT32 chunk = (mask + 1) - offset;
+            if (chunk > numBytes) chunk = numBytes;
+            memcpy(data, buffer + offset, chunk);
+            memcpy(data + chunk, buffer, numBytes - chunk);
+            Consume(numBytes);
+            return numBytes;
+        }
+        // Consumer side: contiguous pending data for draining in place
+        const char* AccessRead(unsigned int& numBytes)
+        {
+            UINT32 count = NORM_ATOMIC_LOAD(head) - tail;
+            UINT32 offset = tail & mask;
+            UINT32 chunk = (mask + 1) - offset;
+            numBytes = (chunk < count) ? chunk : count;
+            return (buffer + offset);
+        }
+        // Consumer side: releases "numBytes" of space back to the producer
+        void Consume(unsigned int numBytes)
+        {
+            if (0 == numBytes) return;
+            NORM_ATOMIC_STORE(tail, tail + numBytes);
+            NORM_ATOMIC_FENCE();
+        }
+        UINT32 GetReadIndex() const {return tail;}
+
+        class Mark
+        {
+            public:
+                UINT32  offset;      // ring (write) offset the mark applies at
+                bool    eom;
+                int     flush_mode;  // NormStreamObject::FlushMode
+        };
+        // Consumer side: oldest pending mark (or NULL)
+        const Mark* PeekMark() const
+        {
+            if (NORM_ATOMIC_LOAD(mark_head) == mark_tail) return NULL;
+            return &mark_list[mark_tail % MARK_MAX];
+        }
+        void PopMark()
+        {
+            NORM_ATOMIC_STORE(mark_tail, mark_tail + 1);
+            NORM_ATOMIC_FENCE();
+        }
+
+        // The producer calls Block() upon finding no space.  It sets the
+        // "blocked" flag and rechecks, so a consumer that frees space and
+        // then finds the flag set (via Unblock()) knows the producer must be
+        // signaled.  Block() returns false (and clears the flag) if space
+        // became available in the meantime.
+        bool Block()
+        {
+            NORM_ATOMIC_SWAP(blocked, 1);
+            NORM_ATOMIC_FENCE();
+            if (0 == GetSpace()) return true;
+            NORM_ATOMIC_SWAP(blocked, 0);
+            return false;
+        }
+        bool Unblock()
+            {return ((0 != NORM_ATOMIC_LOAD(blocked)) && (0 != NORM_ATOMIC_SWAP(blocked, 0)));}
+
+        // Coalesces prompts to the NORM thread (returns true if newly set)
+        bool SetPrompt()
+            {return (0 == NORM_ATOMIC_SWAP(prompt, 1));}
+        bool ClearPrompt()
+            {return ((0 != NORM_ATOMIC_LOAD(prompt)) && (0 != NORM_ATOMIC_SWAP(prompt, 0)));}
+
+        // Receive stream break, set by the producer after the last data
+        // preceding the break is committed
+        void SetBroken()
+            {NORM_ATOMIC_STORE(broken, 1);}
+        bool IsBroken() const
+            {return (0 != NORM_ATOMIC_LOAD(broken));}
+        void ClearBroken()
+            {NORM_ATOMIC_STORE(broken, 0);}
+
+        // Receive message start seeking is done by the NORM thread before
+        // filling the ring (these are only accessed with the NORM thread
+        // suspended or by the NORM thread itself)
+        void SetSeekPending()
+        {
+            seek_pending = true;
+            seek_synced = false;
+        }
+        bool SeekPending() const {return seek_pending;}
+        void SetSeekSynced()
+        {
+            seek_pending = false;
+            seek_synced = true;
+            seek_index = head;
+        }
+        // True if the ring content begins at the message start found
+        bool IsSeekSynced() const
+            {return (seek_synced && (tail == seek_index));}
+        
+        // Rings serviced by a given NORM thread are kept on a List that
+        // is only modified by the NORM thread (or while it is suspended)
+        class List
+        {
+            public:
+                List() : head(NULL) {}
+                ~List()
+                {
+                    while (NULL != head) Remove(*head);
+                }
+                void Prepend(NormStreamRing& ring)
+                {
+                    ASSERT(NULL == ring.list);
+                    ring.list = this;
+                    ring.prev = NULL;
+                    if (NULL != (ring.next = head)) head->prev = &ring;
+                    head = &ring;
+                }
+                void Remove(NormStreamRing& ring)
+                {
+                    ASSERT(this == ring.list);
+                    if (NULL != ring.prev)
+                        ring.prev->next = ring.next;
+                    else
+                        head = ring.next;
+                    if (NULL != ring.next) ring.next->prev = ring.prev;
+                    ring.list = NULL;
+                    ring.prev = ring.next = NULL;
+                }
+                NormStreamRing* GetHead() const {return head;}
+
+            private:
+                NormStreamRing* head;
+        };  // end class NormStreamRing::List
+
+        NormStreamRing* GetNext() const {return next;}
+
+    private:
+        enum {MARK_MAX = 64};
+
+        void*               owner;
+        bool                is_sender;
+        char*               buffer;
+        UINT32              mask;
+        UINT32              head;       // written by producer only
+        UINT32              tail;       // written by consumer only
+        Mark                mark_list[MARK_MAX];
+        UINT32              mark_head;  // written by producer only
+        UINT32              mark_tail;  // written by consumer only
+        UINT32              blocked;
+        UINT32              prompt;
+        UINT32              broken;
+        bool                seek_pending;
+        bool                seek_synced;
+        UINT32              seek_index;
+
+        List*               list;
+        NormStreamRing*     prev;
+        NormStreamRing*     next;
+};  // end class NormStreamRing
+
+#endif // _NORM_RING
@@ -4,7 +4,15 @@
 #include "normMessage.h"
 #include "protoBitmask.h"
 
-#define USE_PROTO_TREE 1  // for more better performing NormBlockBuffer?
+#include <string.h>  // for memset()
+#ifdef WIN32
+#include <intrin.h>  // for _BitScanForward(), __popcnt()
+#endif // WIN32
+
+// NormBlockBuffer (and NormObjectTable) index their blocks (objects) with
+// a power-of-two ring addressed by the low bits of the block (object) id.
+// Define USE_PROTO_TREE to use ProtoSortedTree indexing instead.
+//#define USE_PROTO_TREE 1
 
 
 // Norm uses preallocated (or dynamically allocated) pools of 
@@ -46,6 +54,103 @@ class NormSegmentPool
         bool            overrun_flag;
 };  // end class NormSegmentPool
 
+#ifdef WIN32
+inline unsigned int NormCtz32(UINT32 x)  // (x must be non-zero)
+    {unsigned long index; _BitScanForward(&index, x); return (unsigned int)index;}
+inline unsigned int NormClz32(UINT32 x)  // (x must be non-zero)
+    {unsigned long index; _BitScanReverse(&index, x); return (unsigned int)(31 - index);}
+inline unsigned int NormPopcnt32(UINT32 x)
+    {return (unsigned int)__popcnt(x);}
+#else
+inline unsigned int NormCtz32(UINT32 x)  // (x must be non-zero)
+    {return (unsigned int)__builtin_ctz(x);}
+inline unsigned int NormClz32(UINT32 x)  // (x must be non-zero)
+    {return (unsigned int)__builtin_clz(x);}
+inline unsigned int NormPopcnt32(UINT32 x)
+    {return (unsigned int)__builtin_popcount(x);}
+#endif // if/else WIN32
+
+// NormBlockMask is the fixed-size symbol bitmask NormBlock uses for its
+// pending and repair state.  It provides the subset of the ProtoBitmask
+// interface NormBlock needs, but its words are storage provided by the
+// block (see NormBlock::Init()) and set bits are located and counted a 
+// word at a time (count-trailing-zeros and population count).
+class NormBlockMask
+{
+    public:
+        NormBlockMask() : mask(NULL), num_bits(0), num_words(0) {}
+        
+        static UINT32 GetWordCount(UINT32 numBits)
+            {return ((numBits + 31) >> 5);}
+        void Init(UINT32* words, UINT32 numBits)
+        {
+            mask = words;
+            num_bits = numBits;
+            num_words = GetWordCount(numBits);
+            Clear();
+        }
+        void Destroy()
+        {
+            mask = NULL;
+            num_bits = num_words = 0;
+        }
+        UINT32 GetSize() const {return num_bits;}
+        
+        void Clear()
+            {if (NULL != mask) memset(mask, 0, num_words*sizeof(UINT32));}
+        bool Set(UINT32 index)
+        {
+            if (index >= num_bits) return false;
+            mask[index >> 5] |= ((UINT32)0x01 << (index & 31));
+            return true;
+        }
+        void Unset(UINT32 index)
+            {if (index < num_bits) mask[index >> 5] &= ~((UINT32)0x01 << (index & 31));}
+        bool Test(UINT32 index) const
+            {return ((index < num_bits) && (0 != (mask[index >> 5] & ((UINT32)0x01 << (index & 31)))));}
+        bool IsSet() const
+        {
+            for (UINT32 i = 0; i < num_words; i++)
+                if (0 != mask[i]) return true;
+            return false;
+        }
+        bool SetBits(UINT32 index, UINT32 count);
+        void UnsetBits(UINT32 index, UINT32 count);
+        // Finds the first set bit at or after "index"
+        bool GetFirstSet(UINT32& index) const
+        {
+            index = 0;
+            return GetNextSet(index);
+        }
+        bool GetNextSet(UINT32& index) const;
+        // Finds the last set bit at or before "index"
+        bool GetPrevSet(UINT32& index) const;
+        // Number of set bits in the range [index, index+count)
+        UINT32 GetCount(UINT32 index, UINT32 count) const;
+        
+        // These require masks of the same size
+        void Add(const NormBlockMask& b)    // this = this | b
+        {
+            for (UINT32 i = 0; i < num_words; i++)
+                mask[i] |= b.mask[i];
+        }
+        void Xor(const NormBlockMask& b)    // this = this ^ b
+        {
+            for (UINT32 i = 0; i < num_words; i++)
+                mask[i] ^= b.mask[i];
+        }
+        void XCopy(const NormBlockMask& b)  // this = b & ~this
+        {
+            for (UINT32 i = 0; i < num_words; i++)
+                mask[i] = b.mask[i] & ~mask[i];
+        }
+            
+    private:
+        UINT32*     mask;
+        UINT32      num_bits;
+        UINT32      num_words;
+};  // end class NormBlockMask
+
 #ifdef USE_PROTO_TREE
 class NormBlock : public ProtoSortedTree::Item
 #else
@@ -65,7 +170,15 @@ class NormBlock
         ~NormBlock();
         const NormBlockId& GetId() const {return blk_id;}
         void SetId(NormBlockId& x) {blk_id = x;}
-        bool Init(UINT16 totalSize);
+        
+        // A block's pending and repair masks and its segment table are laid
+        // out in one contiguous region (the masks first, so for blocks of up
+        // to 256 symbols both share a single cache line).  NormBlockPool 
+        // provides this "storage" from a cache-aligned slab; otherwise the
+        // block allocates its own.
+        enum {CACHE_LINE_SIZE = 64};
+        static unsigned int GetStorageSize(UINT16 totalSize);
+        bool Init(UINT16 totalSize, char* storage = NULL);
         void Destroy();   
         
         void SetFlag(NormBlock::Flag flag) {flags |= flag;}
@@ -103,7 +216,7 @@ class NormBlock
         }    
         
         // Sender routines
-        void TxInit(NormBlockId& blockId, UINT16 ndata, UINT16 autoParity)
+        void TxInit(NormBlockId& blockId, UINT16 ndata, UINT16 autoParity, const ProtoTime& currentTime)
         {
             blk_id = blockId;
             pending_mask.Clear();
@@ -114,7 +227,7 @@ class NormBlock
             parity_offset = autoParity;  
             flags = 0;
             seg_size_max = 0;
-            last_nack_time.GetCurrentTime();
+            last_nack_time = currentTime;
         }
         void TxRecover(NormBlockId& blockId, UINT16 ndata, UINT16 nparity)
         {
@@ -224,6 +337,8 @@ class NormBlock
             {repair_mask.Unset(s);}
         void ClearRepairs()
             {repair_mask.Clear();}
+        UINT16 GetPendingCount(NormSymbolId firstId, UINT16 count) const
+            {return (UINT16)pending_mask.GetCount(firstId, count);}
         bool IsPending(NormSymbolId s) const
             {return pending_mask.Test(s);}
         bool IsPending() const
@@ -252,8 +367,8 @@ class NormBlock
             {last_nack_time = theTime;}
         const ProtoTime& GetLastNackTime() const
             {return last_nack_time;}
-        double GetNackAge() const
-            {return ProtoTime::Delta(ProtoTime().GetCurrentTime(), last_nack_time);}
+        double GetNackAge(const ProtoTime& currentTime) const
+            {return ProtoTime::Delta(currentTime, last_nack_time);}
         
         //void DisplayPendingMask(FILE* f) {pending_mask.Display(f);}
         
@@ -270,20 +385,21 @@ class NormBlock
             {return ProtoTree::GetNativeEndian();}    
 #endif  // USE_PROTO_TREE
             
-        NormBlockId  blk_id;
-        UINT16       size;
-        char**       segment_table;
+        NormBlockId   blk_id;
+        UINT16        size;
+        char**        segment_table;
         
-        int          flags;
-        UINT16       erasure_count;
-        UINT16       parity_count;  // how many fresh parity we are currently planning to send
-        UINT16       parity_offset; // offset from where our fresh parity will be sent
-        UINT16       seg_size_max;
+        int           flags;
+        UINT16        erasure_count;
+        UINT16        parity_count;  // how many fresh parity we are currently planning to send
+        UINT16        parity_offset; // offset from where our fresh parity will be sent
+        UINT16        seg_size_max;
         
-        ProtoBitmask pending_mask;
-        ProtoBitmask repair_mask;
-        ProtoTime    last_nack_time;  // for stream flow control
-        NormBlock*   next;            // used for NormBlockPool
+        NormBlockMask pending_mask;
+        NormBlockMask repair_mask;
+        char*         own_storage;     // non-NULL if not pool provided
+        ProtoTime     last_nack_time;  // for stream flow control
+        NormBlock*    next;            // used for NormBlockPool
 };  // end class NormBlock
 
 class NormBlockPool
@@ -327,6 +443,7 @@ class NormBlockPool
         UINT32          blk_count;
         unsigned long   overruns;
         bool            overrun_flag;
+        char*           slab;  // storage for all of the pool's blocks
 };  // end class NormBlockPool
 
 #ifdef USE_PROTO_TREE
@@ -339,8 +456,13 @@ class NormBlockBuffer
         class Iterator;
         friend class NormBlockBuffer::Iterator;
             
+        // Default upper bound on the ring size (a buffer whose blocks span
+        // more than this many ids chains blocks sharing a ring slot)
+        enum {RING_SIZE_MAX = 4096};
+            
         NormBlockBuffer();
         ~NormBlockBuffer();
+        // The ring is sized to cover "rangeMax" up to "tableSize" slots
         bool Init(unsigned long rangeMax, unsigned long tableSize, UINT32 fecBlockMask);
         void Destroy();
         
@@ -395,9 +517,12 @@ class NormBlockBuffer
 #ifdef USE_PROTO_TREE
         NormBlockTree   tree;
 #else    
-        static NormBlock* Next(NormBlock* b) {return b->next;}    
-        NormBlock**     table;
-        unsigned long   hash_mask; 
+        NormBlock* FindNext(const NormBlockId& blockId) const;
+        NormBlock* FindPrev(const NormBlockId& blockId) const;
+        NormBlock**     table;      // ring of block chains indexed by id
+        unsigned long   ring_mask;  // (ring size - 1)
+        UINT32*         slot_storage;
+        NormBlockMask   slot_mask;  // set for occupied ring slots
 #endif // if/else USE_PROTO_TREE      
         unsigned long   range_max;  // max range of blocks that can be buffered
         unsigned long   range;      // zero if "block buffer" is empty
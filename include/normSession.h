@@ -5,6 +5,8 @@
 #include "normObject.h"
 #include "normNode.h"
 #include "normEncoder.h"
+#include "normHistogram.h"
+#include "normTrace.h"
 
 #include "protokit.h"
 
@@ -106,6 +108,12 @@ class NormSessionMgr
     
         NormController* GetController() const {return controller;}
         
+        class NormSession* GetTopSession() const {return top_session;}
+        
+        // Binary message trace ring of this (NORM thread's) manager's
+        // sessions (if NULL, NormTrace() text is logged instead)
+        void SetTraceRing(NormTraceRing* ring) {trace_ring = ring;}
+        NormTraceRing* GetTraceRing() const {return trace_ring;}
         
         void SetDataFreeFunction(NormDataObject::DataFreeFunctionHandle freeFunc)
             {data_free_func = freeFunc;}
@@ -120,9 +128,77 @@ class NormSessionMgr
         NormDataObject::DataFreeFunctionHandle  data_free_func;
         
         class NormSession*       top_session;  // top of NormSession list
+        NormTraceRing*           trace_ring;
               
 };  // end class NormSessionMgr
 
+// When sender NACK batching is enabled, the repair request content of NACKs
+// received during the NACK aggregation period is collected here.  At the
+// end of the period the items are sorted into (object, level, block, segment)
+// order and overlapping or adjacent intervals (e.g., the same loss reported
+// by many receivers) are merged so that repair state is updated in a single pass.
+class NormRepairPlan
+{
+    public:
+        enum Level {OBJECT = 0, INFO = 1, BLOCK = 2, SEGMENT = 3};
+
+        class Item
+        {
+            friend class NormRepairPlan;
+            public:
+                Level GetLevel() const {return (Level)level;}
+                NormObjectId GetObjectId() const {return NormObjectId(object_id);}
+                NormBlockId GetFirstBlockId() const {return NormBlockId(block_first);}
+                NormBlockId GetLastBlockId() const {return NormBlockId(block_last);}
+                NormSegmentId GetFirstSegmentId() const {return segment_first;}
+                NormSegmentId GetLastSegmentId() const {return segment_last;}
+                UINT16 GetErasureCount() const {return erasure_count;}
+
+            private:
+                UINT32          seq;            // arrival order
+                UINT32          object_key;     // object offset from plan "base"
+                INT32           block_key;      // block offset from group's first block
+                INT32           block_key_last;
+                UINT32          block_first;
+                UINT32          block_last;
+                UINT16          object_id;
+                NormSegmentId   segment_first;
+                NormSegmentId   segment_last;
+                UINT16          erasure_count;  // NACK's cumulative erasures for block
+                UINT8           level;
+        };  // end class NormRepairPlan::Item
+
+        NormRepairPlan();
+        ~NormRepairPlan();
+
+        void Destroy();
+        void Clear() {item_count = 0;}
+        bool IsEmpty() const {return (0 == item_count);}
+        unsigned int GetCount() const {return item_count;}
+        const Item& GetItem(unsigned int index) const
+            {return item_list[index];}
+
+        bool Append(Level           level,
+                    NormObjectId    objectId,
+                    NormBlockId     firstBlockId,
+                    NormBlockId     lastBlockId,
+                    NormSegmentId   firstSegmentId,
+                    NormSegmentId   lastSegmentId,
+                    UINT16          erasureCount);
+
+        // Sorts and merges items (objects ordered relative to "objectBase")
+        void Merge(NormObjectId objectBase, UINT32 blockMask);
+
+    private:
+        static int CompareObject(const void* a, const void* b);
+        static int CompareBlock(const void* a, const void* b);
+
+        Item*           item_list;
+        unsigned int    item_count;
+        unsigned int    item_size;
+        UINT32          item_seq;
+};  // end class NormRepairPlan
+
 
 class NormSession
 {
@@ -236,6 +312,21 @@ class NormSession
         
         UINT16 GetRxPort() const;
         
+        // Receive fan-out: "memberCount" sessions (typically each on its own
+        // NORM thread shard) bind the same session port with SO_REUSEPORT and
+        // each remote sender is owned by exactly one member, so per-sender
+        // state needs no locking.  MUST be called _before_ receiver startup.
+        bool SetRxFanout(unsigned int memberIndex, unsigned int memberCount);
+        
+        // Kernel receive timestamps (SO_TIMESTAMPNS or SO_TIMESTAMP) give the
+        // datagram arrival time used for GRTT/RTT and loss estimation so that 
+        // queueing while the NORM thread is busy isn't counted as round trip 
+        // time.  Returns false if not supported.  MUST be called _before_ 
+        // sender or receiver startup.
+        bool SetRxTimestamping(bool enable);
+        bool GetRxTimestamping() const
+            {return rx_timestamping;}
+        
         const ProtoAddress& GetRxBindAddr() const
             {return rx_bind_addr;}
         
@@ -255,6 +346,8 @@ class NormSession
         static double CalculateRate(double size, double rtt, double loss);
         
         NormSessionMgr& GetSessionMgr() {return session_mgr;}
+        NormSession* GetNext() const {return next;}
+        const NormNodeTree& GetSenderTree() const {return sender_tree;}
         
         bool SetTxSocketBuffer(unsigned int bufferSize)
             {return tx_socket->SetTxBufferSize(bufferSize);}
@@ -356,6 +449,11 @@ class NormSession
         };
         MessageStatus SendMessage(NormMsg& msg);
         void ActivateTimer(ProtoTimer& timer) {session_mgr.ActivateTimer(timer);}
+        void ActivateTimer(NormTimer& timer) {timer_wheel.ActivateTimer(timer);}
+        // Protocol timing should use this instead of ProtoSystemTime() so that
+        // packet processing can use the time cached for the current dispatch
+        void GetCurrentTime(struct timeval& currentTime) const
+            {session_clock.GetCurrentTime(currentTime);}
         
         void SetUserData(const void* userData) 
             {user_data = userData;}
@@ -421,6 +519,8 @@ class NormSession
         // Set "prevNodeId = NORM_NODE_NONE" to init this iteration (returns "false" when done)
         bool SenderGetNextAckingNode(NormNodeId& prevNodeId, AckingStatus* ackingStatus = NULL);
         bool SenderGetAckEx(NormNodeId nodeId, char* buffer, unsigned int* buflen);
+        // Member and acknowledged counts reported by an acking node that is an ACK aggregator
+        bool SenderGetAckingAggregate(NormNodeId nodeId, unsigned int* memberCount, unsigned int* ackedCount);
         
         NormAckingNode* SenderFindAckingNode(NormNodeId nodeId) const
         {
@@ -458,6 +558,11 @@ class NormSession
         UINT16 SenderExtraParity() const {return extra_parity;}
         void SenderSetExtraParity(UINT16 extraParity)
             {extra_parity = extraParity;}
+        // When enabled, NACK content received during the NACK aggregation
+        // period is collected and merged into one repair plan at its end
+        bool SenderNackBatching() const {return tx_nack_batching;}
+        void SenderSetNackBatching(bool state)
+            {tx_nack_batching = state;}
         
         INT32 Difference(NormBlockId a, NormBlockId b) const
             {return NormBlockId::Difference(a, b, fec_block_mask);}
@@ -579,6 +684,48 @@ class NormSession
         bool ReceiverGetUnicastNacks() const 
             {return unicast_nacks;}
         
+        // A receiver with "local_repair" enabled answers NACKs from nearby
+        // receivers with segments it holds (multicast with the given "ttl"
+        // or, if zero, unicast to the NACKing receiver) and relays any
+        // remaining requests of NACKs sent directly to it on to the sender.
+        // A block it (or another peer) just repaired isn't resent for the
+        // NACK backoff window.
+        void ReceiverSetLocalRepair(bool state, UINT8 theTTL)
+        {
+            local_repair = state;
+            local_repair_ttl = theTTL;
+        }
+        bool ReceiverGetLocalRepair() const 
+            {return local_repair;}
+        UINT8 ReceiverGetLocalRepairTtl() const
+            {return local_repair_ttl;}
+        // Receivers direct their NACKs to a local repair peer, if set (valid)
+        void ReceiverSetLocalRepairPeer(const ProtoAddress& peerAddr)
+            {local_repair_peer = peerAddr;}
+        const ProtoAddress& ReceiverGetLocalRepairPeer() const
+            {return local_repair_peer;}
+        bool ReceiverSendLocalRepairMsg(NormMsg& msg, UINT8 theTTL);
+        
+        // ACK aggregation: a member receiver sends its watermark ACKs to its
+        // aggregator (and answers FLUSH commands listing the aggregator id)
+        // while the aggregator acknowledges a watermark upstream once its 
+        // members have (or with a summary of those that have if they don't)
+        void ReceiverSetAckAggregator(NormNodeId aggregatorId, const ProtoAddress& aggregatorAddr)
+        {
+            ack_aggregator_id = aggregatorId;
+            ack_aggregator_addr = aggregatorAddr;
+        }
+        NormNodeId ReceiverGetAckAggregatorId() const
+            {return ack_aggregator_id;}
+        const ProtoAddress& ReceiverGetAckAggregatorAddr() const
+            {return ack_aggregator_addr;}
+        bool ReceiverAddAggregateMember(NormNodeId nodeId);
+        void ReceiverRemoveAggregateMember(NormNodeId nodeId);
+        UINT16 ReceiverGetAggregateMemberCount() const
+            {return agg_member_count;}
+        // Returns the member's index in the (sorted) member list or -1
+        int ReceiverGetAggregateMemberIndex(NormNodeId nodeId) const;
+        
         void ReceiverSetSilent(bool state) 
             {receiver_silent = state;}
         bool ReceiverIsSilent() const {return receiver_silent;}
@@ -640,6 +787,67 @@ class NormSession
         void SetRxLoss(double percent) {rx_loss_rate = percent;}
         void SetReportTimerInterval(double interval) {report_timer.SetInterval(interval);}
         double GetReportTimerInterval() {return report_timer.GetInterval();} 
+        
+        // Statistics snapshot (may be read from any thread)
+        struct Stats
+        {
+            unsigned long long  sent_bytes;
+            unsigned long long  sent_packets;
+            unsigned long long  recv_bytes;
+            unsigned long long  recv_packets;
+            unsigned long long  tx_repairs;
+            unsigned long       nacks_received;
+            unsigned long       nacks_sent;
+            unsigned long       nacks_suppressed;
+            unsigned long       fec_decodes;
+            unsigned long       buffer_usage;
+            unsigned long       buffer_peak;
+            unsigned long       buffer_overruns;
+            double              tx_rate;
+            double              grtt;
+            double              cc_rtt;
+            double              cc_loss;
+            double              timer_lag;
+            double              timer_lag_max;
+        };
+        void GetStats(Stats& snapshot) const
+            {stats_lock.Read(snapshot);}
+        // Publishes current statistics (NORM thread only; this is also
+        // done every 100 msec while the session has traffic)
+        void UpdateStats();
+        void SenderCountRepair() 
+        {
+            stats.tx_repairs++;
+            if (tx_repair_latency_pending)
+            {
+                tx_repair_latency_pending = false;
+                RecordLatency(TX_REPAIR, tx_repair_nack_time);
+            }
+        }
+        void ReceiverCountNackSuppressed() 
+            {stats.nacks_suppressed++;}
+        void ReceiverCountFecDecode() 
+            {stats.fec_decodes++;}
+        
+        // Latency histograms (NORM thread only, or with it suspended)
+        enum LatencyType
+        {
+            TX_FIRST_SEND,        // object enqueue to first transmission
+            TX_OBJECT_SENT,       // object enqueue to TX_OBJECT_SENT
+            TX_REPAIR,            // NACK receipt to first repair transmission
+            RX_OBJECT_COMPLETED,  // object first packet to RX_OBJECT_COMPLETED
+            RX_BLOCK_DECODE,      // FEC block decode time
+            EVENT_DELIVERY,       // notification to API event retrieval
+            LATENCY_TYPE_COUNT
+        };
+        NormHistogram& AccessLatencyHistogram(LatencyType type)
+            {return latency_histogram[type];}
+        void RecordLatency(LatencyType type, const struct timeval& startTime)
+        {
+            struct timeval currentTime;
+            GetCurrentTime(currentTime);
+            latency_histogram[type].RecordInterval(startTime, currentTime);
+        }
 
 #ifdef SIMULATE   
         // Simulation specific methods
@@ -667,13 +875,39 @@ class NormSession
         bool OnFlushTimeout(ProtoTimer& theTimer);
         bool OnProbeTimeout(ProtoTimer& theTimer);
         bool OnReportTimeout(ProtoTimer& theTimer);
+        bool OnStatsTimeout(ProtoTimer& theTimer);
+        // Traces to the binary trace ring, if set, else NormTrace() text
+        void TraceMessage(const struct timeval& currentTime, const NormMsg& msg,
+                          bool sent, UINT8 fecM, UINT16 instId);
         bool OnCmdTimeout(ProtoTimer& theTimer);
         bool OnFlowControlTimeout(ProtoTimer& theTimer);
         bool OnUserTimeout(ProtoTimer& theTimer);
         
         void TxSocketRecvHandler(ProtoSocket& theSocket, ProtoSocket::Event theEvent);
         void RxSocketRecvHandler(ProtoSocket& theSocket, ProtoSocket::Event theEvent);        
-        void HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecn = false);
+        bool AttachRxFanoutFilter();
+        bool EnableRxTimestamps(ProtoSocket& theSocket);
+        bool RecvTimestamped(ProtoSocket&    theSocket,
+                             char*           buffer,
+                             unsigned int&   numBytes,
+                             ProtoAddress&   srcAddr,
+                             ProtoAddress*   dstAddr,
+                             struct timeval& rxTime);
+        static NormNodeId GetRxFanoutKey(const NormMsg& msg)
+        {
+            // Receiver feedback is keyed on the sender it is addressed to
+            switch (msg.GetType())
+            {
+                case NormMsg::NACK:
+                    return static_cast<const NormNackMsg&>(msg).GetSenderId();
+                case NormMsg::ACK:
+                    return static_cast<const NormAckMsg&>(msg).GetSenderId();
+                default:
+                    return msg.GetSourceId();
+            }
+        }
+        void HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecn = false, 
+                                  const struct timeval* rxTime = NULL);
         
         // This is used when raw packet capture is enabled
         void OnPktCapture(ProtoChannel&              theChannel,
@@ -682,6 +916,15 @@ class NormSession
         // Sender message handling routines
         void SenderHandleNackMessage(const struct timeval& currentTime, 
                                      NormNackMsg&          nack);
+        // Returns false (with "requestOffset" at the first request not fully
+        // batched) if the repair plan is full
+        bool SenderBatchRepairContent(NormNackMsg& nack, UINT16& requestOffset);
+        void SenderDispatchRepairPlan(const struct timeval& currentTime);
+        void SenderUpdateRepairMin(NormObjectId  objectId,
+                                   NormBlockId   blockId,
+                                   NormSegmentId segmentId,
+                                   bool          wholeObject);
+        void SenderStartRepairAggregation();
         void SenderHandleAckMessage(const struct timeval& currentTime, 
                                     const NormAckMsg&     ack,
                                     bool                  wasUnicast);
@@ -700,6 +943,8 @@ class NormSession
         //bool SenderQueueSquelch(NormObjectId objectId);
         void SenderQueueFlush();
         bool SenderQueueWatermarkFlush();
+        void SenderMarkAckReceived(NormAckingNode* node);
+        void SenderResetAckingNode(NormAckingNode* node, int robustFactor);
         bool SenderBuildRepairAdv(NormCmdRepairAdvMsg& cmd);
         void SenderUpdateGroupSize();
         bool SenderQueueAppCmd();  
@@ -711,10 +956,12 @@ class NormSession
         void ReceiverHandleCommand(const struct timeval& currentTime,
                                    const NormCmdMsg&     msg,
                                    bool                  ecnStatus);
-        void ReceiverHandleNackMessage(const NormNackMsg& nack);
+        void ReceiverHandleNackMessage(const NormNackMsg& nack, bool wasUnicast);
         void ReceiverHandleAckMessage(const NormAckMsg& ack);
         
         NormSessionMgr&                 session_mgr;
+        NormClock                       session_clock; // cached per dispatch (receive batch or timeout)
+        NormTimerWheel                  timer_wheel;   // for remote sender (NormSenderNode) timers
         bool                            notify_pending;
         ProtoTimer                      tx_timer;
         UINT16                          tx_port;
@@ -727,6 +974,11 @@ class NormSession
         bool                            rx_port_reuse; // enable rx_socket port (sessionPort) reuse when true
         ProtoAddress                    rx_bind_addr;
         ProtoAddress                    rx_connect_addr;
+        unsigned int                    rx_fanout_index;  // this session's receive fan-out member index
+        unsigned int                    rx_fanout_count;  // receive fan-out group size (1 == no fan-out)
+        bool                            rx_timestamping;  // use kernel receive timestamps when true
+        bool                            rx_socket_tstamp; // rx_socket has kernel timestamps enabled
+        bool                            tx_socket_tstamp; // tx_socket has kernel timestamps enabled
         
         
         ProtoAddressList                dst_addr_list;  // list of local addresses
@@ -735,6 +987,14 @@ class NormSession
         ProtoTimer                      report_timer;
         UINT16                          tx_sequence;
         
+        Stats                           stats;       // (published by UpdateStats())
+        NormStatsLock<Stats>            stats_lock;
+        ProtoTimer                      stats_timer;
+        unsigned long long              stats_packet_count;  // as of last stats_timer timeout
+        NormHistogram                   latency_histogram[LATENCY_TYPE_COUNT];
+        struct timeval                  tx_repair_nack_time;  // NACK aggregation start
+        bool                            tx_repair_latency_pending;
+        
         // General session parameters
         NormNodeId                      local_node_id;
         ProtoAddress                    address;         // session destination address/port
@@ -772,6 +1032,8 @@ class NormSession
         ProtoSlidingMask                tx_pending_mask;
         ProtoSlidingMask                tx_repair_mask;
         ProtoTimer                      repair_timer;
+        bool                            tx_nack_batching;
+        NormRepairPlan                  tx_repair_plan;
         NormBlockPool                   block_pool;
         NormSegmentPool                 segment_pool;
         NormEncoder*                    encoder;
@@ -793,6 +1055,11 @@ class NormSession
         NormNodeTree                    acking_node_tree;
         unsigned int                    acking_node_count;
         unsigned int                    acking_success_count;
+        NormAckingNode**                acking_node_index;  // dense index (in order of addition)
+        unsigned int                    acking_index_size;  // allocated index slots
+        UINT32*                         acking_mask_words;
+        NormBlockMask                   acking_ack_mask;    // set for indexed nodes that have ACKed
+        NormAckingNode*                 acking_node_none;   // NORM_NODE_NONE entry, if any
         TrackingStatus                  acking_auto_populate;  // whether / how to "auto populate" acking node list
         bool                            watermark_pending;
         bool                            watermark_flushes;
@@ -839,7 +1106,7 @@ class NormSession
         bool                            cc_enable;
         bool                            cc_adjust;
         UINT16                          cc_sequence;
-        NormNodeList                    cc_node_list;
+        NormCCNodeHeap                  cc_node_heap;
         bool                            cc_slow_start;
         bool                            cc_active;
         NormNode::Accumulator           sent_accumulator;  // for sentRate measurement
@@ -868,6 +1135,14 @@ class NormSession
         NormNodeTree                    sender_tree;
         unsigned long                   remote_sender_buffer_size;
         bool                            unicast_nacks;
+        bool                            local_repair;
+        UINT8                           local_repair_ttl;
+        ProtoAddress                    local_repair_peer;
+        NormNodeId                      ack_aggregator_id;
+        ProtoAddress                    ack_aggregator_addr;
+        NormNodeId*                     agg_member_list;
+        UINT16                          agg_member_count;
+        UINT16                          agg_member_max;
         bool                            receiver_silent;
         bool                            rcvr_ignore_info;
         INT32                           rcvr_max_delay;
@@ -19,6 +19,7 @@ class NormSimAgent : public NormController, public ProtoMessageSink
 		bool StartSender();  // start sender
         bool StartReceiver();  // start receiver
         bool IsActive() {return (NULL != session);}
+        NormSession* GetSession() const {return session;}
         void Stop();
         
         
@@ -45,6 +46,12 @@ class NormSimAgent : public NormController, public ProtoMessageSink
         CmdType CommandType(const char* cmd);
         virtual unsigned long GetAgentId() = 0;
         ProtoMessageSink*      msg_sink; 
+        
+        virtual void Notify(NormController::Event event,
+                            class NormSessionMgr* sessionMgr,
+                            class NormSession*    session,
+                            class NormSenderNode* sender,
+                            class NormObject*     object);
 
 #ifdef OPNET
         void HandleMessage(char*             buffer, 
@@ -56,11 +63,6 @@ class NormSimAgent : public NormController, public ProtoMessageSink
     private:
         void OnInputReady();
         bool FlushStream(bool eom);// = true);
-        virtual void Notify(NormController::Event event,
-                            class NormSessionMgr* sessionMgr,
-                            class NormSession*    session,
-                            class NormSenderNode* sender,
-                            class NormObject*     object);
         
         void ActivateTimer(ProtoTimer& theTimer)
             {session_mgr.ActivateTimer(theTimer);}
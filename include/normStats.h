@@ -0,0 +1,58 @@
+#ifndef _NORM_STATS
+#define _NORM_STATS
+
+#include "normAtomic.h"  // for NORM_ATOMIC_LOAD/STORE
+#include "protoDefs.h"   // for UINT32
+
+#include <string.h>      // for memset(), memcpy()
+
+// The NormStatsLock is a single-writer sequence lock ("seqlock") used to
+// publish a consistent snapshot of a session, remote sender, or object's
+// statistics ("STATS" is a plain struct).  The NORM protocol thread is the
+// only writer and publishes the snapshot from its (unlocked) counters
+// periodically rather than per packet (see NormSession::OnStatsTimeout()),
+// while other threads copy it out with NormStatsLock::Read().  The sequence
+// is odd while an update is in progress and a reader simply retries its
+// copy if the sequence was odd or changed during the copy, so the writer
+// is never blocked.
+
+template <class STATS>
+class NormStatsLock
+{
+    public:
+        NormStatsLock() : sequence(0)
+            {memset(&stats, 0, sizeof(STATS));}
+
+        // Writer (NORM thread) side: the returned snapshot may be
+        // modified until the matching EndUpdate() call
+        STATS& BeginUpdate()
+        {
+            NORM_ATOMIC_STORE(sequence, sequence + 1);  // (now odd)
+            NORM_ATOMIC_WRITE_FENCE();
+            return stats;
+        }
+        void EndUpdate()
+            {NORM_ATOMIC_STORE(sequence, sequence + 1);}
+
+        // Reader (any thread) side
+        void Read(STATS& snapshot) const
+        {
+            while (true)
+            {
+                UINT32 seq = NORM_ATOMIC_LOAD(sequence);
+                if (0 == (seq & 0x01))
+                {
+                    memcpy(&snapshot, &stats, sizeof(STATS));
+                    NORM_ATOMIC_READ_FENCE();
+                    if (seq == NORM_ATOMIC_LOAD(sequence)) return;
+                }
+            }
+        }
+
+    private:
+        UINT32  sequence;
+        STATS   stats;
+
+};  // end class NormStatsLock
+
+#endif // _NORM_STATS
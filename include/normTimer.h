@@ -0,0 +1,233 @@
+#ifndef _NORM_TIMER
+#define _NORM_TIMER
+
+#include "normSegment.h"  // for NormCtz32()
+#include "protokit.h"
+
+// Define NORM_CLOCK_TSC to have NormClock derive its cached time from the
+// (x86) processor time stamp counter instead of reading the system clock
+//#define NORM_CLOCK_TSC 1
+
+#ifdef NORM_CLOCK_TSC
+#ifdef WIN32
+#include <intrin.h>     // for __rdtsc()
+#else
+#include <x86intrin.h>  // for __rdtsc()
+#endif // if/else WIN32
+inline unsigned long long NormReadTsc()
+    {return (unsigned long long)__rdtsc();}
+#endif // NORM_CLOCK_TSC
+
+// NormClock caches the current time for a single dispatch (a socket receive
+// batch or a timeout) of its session so that the message handling and
+// message building that dispatch does (receive timestamps, GRTT response
+// and probe send times, flow control NACK ages, etc) doesn't read the
+// system clock over and over.  Outside of a NormClock::Scope the system
+// clock is read directly.  The cached time is held non-decreasing across
+// small system clock steps backwards, so it is meant for protocol timing,
+// not wall-clock precision.  With NORM_CLOCK_TSC defined, a cache refresh
+// reads the time stamp counter and the system clock is read only to
+// recalibrate it about once per CALIBRATION_INTERVAL.
+class NormClock
+{
+    public:
+        NormClock();
+
+        void GetCurrentTime(struct timeval& currentTime) const
+        {
+            if (cached)
+                currentTime = cached_time;
+            else
+                ::ProtoSystemTime(currentTime);
+        }
+        bool IsCached() const
+            {return cached;}
+        void Update();  // refreshes (and holds) the cached time
+        void Release()
+            {cached = false;}
+
+        // Holds a cached time for the scope's lifetime (nested scopes
+        // just use the outermost scope's cached time)
+        class Scope
+        {
+            public:
+                Scope(NormClock& theClock)
+                  : norm_clock(theClock), outer(theClock.IsCached())
+                    {if (!outer) norm_clock.Update();}
+                ~Scope()
+                    {if (!outer) norm_clock.Release();}
+            private:
+                NormClock&  norm_clock;
+                bool        outer;
+        };
+
+    private:
+        enum {BACKSTEP_MAX = 1000000};  // usec (larger steps are followed)
+        bool                    cached;
+        struct timeval          cached_time;
+#ifdef NORM_CLOCK_TSC
+        enum
+        {
+            CALIBRATION_MIN      = 10000,   // usec
+            CALIBRATION_INTERVAL = 1000000  // usec
+        };
+        void ReadTsc(struct timeval& currentTime);
+        unsigned long long      tsc_base;
+        struct timeval          time_base;
+        double                  tsc_per_usec;
+#endif // NORM_CLOCK_TSC
+};  // end class NormClock
+
+// NormTimer is the timer type used for the per-remote-sender protocol
+// timers (activity, repair, cc, and ack) of a NormSenderNode.  It mirrors
+// the subset of the ProtoTimer interface these use, but is scheduled into
+// its session's NormTimerWheel rather than the shared ProtoTimerMgr so
+// that receiver sessions with many remote senders don't pay the timer
+// manager's (list) insert/remove cost for the frequent backoff and
+// activity timer rescheduling.  The repeat count semantics are the same
+// as for ProtoTimer (-1 = repeat forever, 0 = one-shot, and the count seen
+// by the timeout handler is decremented after it returns "true").
+class NormTimer
+{
+    friend class NormTimerWheel;
+
+    public:
+        NormTimer();
+        ~NormTimer();
+
+        template <class LT>
+        bool SetListener(LT* theListener, bool(LT::*timeoutHandler)(NormTimer&))
+        {
+            if (NULL != listener) delete listener;
+            listener = (NULL != theListener) ?
+                            new TimerListener<LT>(theListener, timeoutHandler) : NULL;
+            return ((NULL == theListener) || (NULL != listener));
+        }
+
+        void SetInterval(double theInterval)
+            {interval = (theInterval > 0.0) ? theInterval : 0.0;}
+        double GetInterval() const
+            {return interval;}
+        void SetRepeat(int numRepeat)
+            {repeat = numRepeat;}
+        int GetRepeat() const
+            {return repeat;}
+        void ResetRepeat()
+            {repeat_count = repeat;}
+        void SetRepeatCount(int repeatCount)
+            {repeat_count = repeatCount;}
+        int GetRepeatCount() const
+            {return repeat_count;}
+        void DecrementRepeatCount()
+            {if (repeat_count > 0) repeat_count--;}
+
+        bool IsActive() const
+            {return (NULL != wheel);}
+        void Deactivate();
+        void Reschedule();  // restarts the active timer's interval from now
+
+    private:
+        class Listener
+        {
+            public:
+                virtual ~Listener() {}
+                virtual bool OnTimeout(NormTimer& theTimer) = 0;
+        };
+        template <class LT>
+        class TimerListener : public Listener
+        {
+            public:
+                TimerListener(LT* theListener, bool(LT::*timeoutHandler)(NormTimer&))
+                  : listener(theListener), handler(timeoutHandler) {}
+                bool OnTimeout(NormTimer& theTimer)
+                    {return (listener->*handler)(theTimer);}
+            private:
+                LT*     listener;
+                bool    (LT::*handler)(NormTimer&);
+        };
+
+        bool DoTimeout()
+            {return ((NULL != listener) ? listener->OnTimeout(*this) : true);}
+
+        Listener*               listener;
+        double                  interval;
+        int                     repeat;
+        int                     repeat_count;
+
+        // NormTimerWheel state
+        class NormTimerWheel*   wheel;       // non-NULL while active
+        UINT32                  expire_tick;
+        int                     level;       // -1 when not in a wheel slot
+        unsigned int            slot;
+        NormTimer*              prev;
+        NormTimer*              next;
+
+};  // end class NormTimer
+
+// NormTimerWheel is a hierarchical timing wheel.  Level "k" has SLOT_COUNT
+// slots of (SLOT_COUNT^k) ticks each.  A timer is placed at the lowest
+// level whose span covers its expiration and is "cascaded" down a level
+// when the wheel reaches the start of its slot, so insert and remove are
+// constant time.  A per-level slot occupancy mask lets the wheel find its
+// next event (and skip empty intervals) a word at a time, and the wheel
+// is driven by a single ProtoTimer that is scheduled for that next event.
+// Timer expiration has TICK_USEC resolution.
+class NormTimerWheel
+{
+    public:
+        enum
+        {
+            TICK_USEC   = 100,
+            LEVEL_BITS  = 5,
+            SLOT_COUNT  = (1 << LEVEL_BITS),  // (one UINT32 occupancy mask per level)
+            LEVEL_COUNT = 5                   // (longer timers are re-cascaded)
+        };
+
+        NormTimerWheel(ProtoTimerMgr& timerMgr, NormClock& theClock);
+        ~NormTimerWheel();
+
+        void ActivateTimer(NormTimer& timer);
+        void DeactivateTimer(NormTimer& timer);
+        void RescheduleTimer(NormTimer& timer);
+
+        unsigned int GetTimerCount() const
+            {return timer_count;}
+        // Timer expiration lag (sec) for the most recent and latest expirations
+        double GetLag() const
+            {return (1.0e-06 * (double)lag_ticks * TICK_USEC);}
+        double GetLagMax() const
+            {return (1.0e-06 * (double)lag_max_ticks * TICK_USEC);}
+
+        static UINT32 GetTick(const struct timeval& theTime)
+        {
+            return ((UINT32)theTime.tv_sec * (UINT32)(1000000 / TICK_USEC) +
+                    ((UINT32)theTime.tv_usec / (UINT32)TICK_USEC));
+        }
+
+    private:
+        bool OnWheelTimeout(ProtoTimer& theTimer);
+
+        void ScheduleTimer(NormTimer& timer);
+        UINT32 Insert(NormTimer& timer, bool cascade = false);
+        void Remove(NormTimer& timer);
+        void Cascade(unsigned int level, unsigned int slot);
+        void Expire(unsigned int slot);
+        bool GetNextEvent(UINT32& eventTick) const;
+        void Advance(UINT32 nowTick);
+        void UpdateWakeup(UINT32 eventTick, const struct timeval& currentTime);
+
+        ProtoTimerMgr&          timer_mgr;
+        NormClock&              wheel_clock;
+        ProtoTimer              wheel_timer;
+        UINT32                  wake_tick;
+        UINT32                  current_tick;
+        bool                    advancing;
+        unsigned int            timer_count;
+        UINT32                  lag_ticks;
+        UINT32                  lag_max_ticks;
+        UINT32                  slot_mask[LEVEL_COUNT];
+        NormTimer*              slot_list[LEVEL_COUNT][SLOT_COUNT];
+
+};  // end class NormTimerWheel
+
+#endif // _NORM_TIMER
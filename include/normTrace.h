@@ -0,0 +1,146 @@
+#ifndef _NORM_TRACE
+#define _NORM_TRACE
+
+#include "normMessage.h"  // for NormMsg, NormNodeId
+#include "normStats.h"    // for NORM_ATOMIC_LOAD/STORE
+
+#ifndef SIMULATE
+#include "protoDispatcher.h"  // for the drain thread
+#endif // !SIMULATE
+
+#include <stdio.h>   // for FILE
+
+// Binary message trace.  NormTrace() formats a text line through PLOG for
+// every message sent and received, which is too costly to leave enabled
+// in production.  Instead, a NormTraceLog can be attached to a NORM thread's
+// NormSessionMgr so that its sessions with tracing enabled fill a fixed
+// size NormTraceRecord (with the message fields NormTrace() would print)
+// into a lock-free single-producer ring owned by that thread.  A background
+// thread periodically drains the rings to the trace file and the offline
+// "normTraceDecode" tool renders the records in the NormTrace() text format
+// or the "n2m" MGEN log format.  If the drain thread falls behind, records
+// are dropped (never blocking the NORM thread) and a "drop" record noting
+// the count is written in their place.
+//
+// (A trace file is a NormTraceHeader followed by records in host byte order)
+
+#define NORM_TRACE_MAGIC     0x4e545243  // "NTRC"
+#define NORM_TRACE_VERSION   1
+
+struct NormTraceHeader
+{
+    UINT32  magic;         // NORM_TRACE_MAGIC
+    UINT16  version;       // NORM_TRACE_VERSION
+    UINT16  record_size;   // sizeof(NormTraceRecord)
+};  // end struct NormTraceHeader
+
+struct NormTraceRecord
+{
+    enum Flag
+    {
+        FLAG_SENT       = 0x01,  // else received
+        FLAG_CLR        = 0x02,  // ACK/NACK with CLR cc feedback
+        FLAG_WATERMARK  = 0x04,  // CMD(FLUSH) with acking nodes
+        FLAG_STREAM     = 0x08,  // stream DATA ("aux" is the offset)
+        FLAG_RATE       = 0x10,  // CMD(CC) with "cc_rate"
+        FLAG_DROP       = 0x80   // "aux" records were dropped (ring overrun)
+    };
+    enum AddrType
+    {
+        ADDR_NONE       = 0,
+        ADDR_IPV4       = 4,
+        ADDR_IPV6       = 6
+    };
+
+    UINT32  sec;           // message send/recv time
+    UINT32  usec;
+    UINT32  local_id;      // NormNodeId of tracing node
+    UINT32  block_id;      // DATA, CMD(FLUSH|SQUELCH), ACK(FLUSH)
+    UINT32  aux;           // stream offset, CMD(CC) sequence, ACK_REQ type, drop count
+    UINT16  length;
+    UINT16  sequence;      // INFO, DATA, CMD
+    UINT16  instance_id;
+    UINT16  object_id;
+    UINT16  symbol_id;
+    UINT16  cc_rate;       // quantized CMD(CC) rate (see NormUnquantizeRate())
+    UINT16  port;          // of destination (if sent) or source address
+    UINT8   addr_type;     // AddrType
+    UINT8   msg_type;      // NormMsg::Type
+    UINT8   sub_type;      // NormCmdMsg::Flavor or NormAck::Type
+    UINT8   flags;         // Flag bits
+    UINT8   reserved[2];
+    UINT8   addr[16];
+};  // end struct NormTraceRecord
+
+// One NORM thread's record ring.  The NORM thread is the only producer
+// (Trace()) and the NormTraceLog drain thread the only consumer (Drain())
+class NormTraceRing
+{
+    friend class NormTraceLog;
+
+    public:
+        enum {DEFAULT_SIZE = 8192};  // records (must be a power of 2)
+
+        NormTraceRing();
+        ~NormTraceRing();
+
+        bool Init(unsigned int numRecords = DEFAULT_SIZE);
+        void Destroy();
+
+        // Producer: records the same message fields as NormTrace()
+        void Trace(const struct timeval&    currentTime,
+                   NormNodeId               localId,
+                   const NormMsg&           msg,
+                   bool                     sent,
+                   UINT8                    fecM,
+                   UINT16                   instId);
+
+        // Consumer: writes pending records (and any drop record) to "filePtr"
+        bool Drain(FILE* filePtr);
+
+        unsigned long GetDropCount() const
+            {return NORM_ATOMIC_LOAD(drop_count);}
+
+    private:
+        NormTraceRecord*    buffer;
+        UINT32              mask;
+        UINT32              head;          // written only by producer
+        UINT32              tail;          // written only by consumer
+        UINT32              drop_count;    // written only by producer
+        UINT32              drop_written;  // (consumer) drops recorded in file
+        NormTraceRing*      next;          // NormTraceLog list linkage
+
+};  // end class NormTraceRing
+
+#ifndef SIMULATE
+// The NormTraceLog owns the trace file, the rings of the NORM threads that
+// trace to it, and the background thread that drains them.
+class NormTraceLog
+{
+    public:
+        enum {DEFAULT_INTERVAL_MSEC = 100};
+
+        NormTraceLog();
+        ~NormTraceLog();
+
+        bool Open(const char* path, double drainInterval = 1.0e-03*DEFAULT_INTERVAL_MSEC);
+        void Close();  // (producers must be detached first)
+        bool IsOpen() const
+            {return (NULL != file_ptr);}
+
+        // Returns a new ring for a NORM thread (freed on Close())
+        NormTraceRing* AddRing(unsigned int numRecords = NormTraceRing::DEFAULT_SIZE);
+
+    private:
+        bool OnDrainTimeout(ProtoTimer& theTimer);
+        void Drain();
+
+        FILE*               file_ptr;
+        NormTraceRing*      ring_list;
+        ProtoDispatcher     dispatcher;    // background drain thread
+        ProtoTimer          drain_timer;
+
+};  // end class NormTraceLog
+#endif // !SIMULATE
+
+#endif // _NORM_TRACE
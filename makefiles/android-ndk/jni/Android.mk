@@ -16,16 +16,21 @@ LOCAL_EXPORT_CFLAGS := $(LOCAL_CFLAGS)
 LOCAL_SRC_FILES := \
 	../../../src/common/galois.cpp \
 	../../../src/common/normApi.cpp \
+	../../../src/common/normDebug.cpp \
 	../../../src/common/normEncoder.cpp \
 	../../../src/common/normEncoderMDP.cpp \
 	../../../src/common/normEncoderRS16.cpp \
 	../../../src/common/normEncoderRS8.cpp \
 	../../../src/common/normFile.cpp \
+	../../../src/common/normHistogram.cpp \
 	../../../src/common/normMessage.cpp \
+	../../../src/common/normMetrics.cpp \
 	../../../src/common/normNode.cpp \
 	../../../src/common/normObject.cpp \
 	../../../src/common/normSegment.cpp \
-	../../../src/common/normSession.cpp
+	../../../src/common/normSession.cpp \
+	../../../src/common/normTimer.cpp \
+	../../../src/common/normTrace.cpp
 include $(BUILD_STATIC_LIBRARY)
 
 include $(CLEAR_VARS)
@@ -1,12 +1,19 @@
 #define _NORM_API_BUILD	// force 'dllexport' in "normApi.h"
 #include "normApi.h"
 #include "normSession.h"
+#include "normMetrics.h"
+#include "normDebug.h"
 
 #ifdef WIN32
 #ifndef _WIN32_WCE
 #include <io.h>  // for _mktemp()
 #endif // !_WIN32_WCE
-#endif // WIN32
+#else
+#include <poll.h>
+#ifdef USE_EVENTFD
+#include <sys/eventfd.h>
+#endif // USE_EVENTFD
+#endif // if/else WIN32
 
 // const defs
 extern NORM_API_LINKAGE
@@ -25,6 +32,9 @@ const NormObjectHandle NORM_OBJECT_INVALID = ((NormObjectHandle)0);
 extern NORM_API_LINKAGE
 const NormDescriptor NORM_DESCRIPTOR_INVALID = ProtoDispatcher::INVALID_DESCRIPTOR;
 
+// Max stream slices returned per NormStreamReadAcquire() call
+#define NORM_STREAM_LEASE_MAX 64
+
 
 /** The "NormInstance" class is a C++ helper class that keeps
  *  state for an instance of the NORM API.  It acts as a
@@ -34,7 +44,7 @@ const NormDescriptor NORM_DESCRIPTOR_INVALID = ProtoDispatcher::INVALID_DESCRIPT
 class NormInstance : public NormController
 {
     public:
-        NormInstance();
+        NormInstance(NormInstance* shardParent = NULL, unsigned int shardIndex = 0);
         virtual ~NormInstance();
         
         void Notify(NormController::Event   event,
@@ -48,31 +58,72 @@ class NormInstance : public NormController
         
         void Stop()  // pause NORM protocol engine
         {
-            dispatcher.Stop();
+            for (unsigned int i = shard_count; i > 0;)
+                GetShard(--i)->dispatcher.Stop();
             Notify(NormController::EVENT_INVALID, &session_mgr, NULL, NULL, NULL);
         }
         bool Start()
         {
-            if (dispatcher.StartThread(priority_boost))
+            for (unsigned int i = 0; i < shard_count; i++)
             {
-                return true;
-            }
-            else
-            {
-                PLOG(PL_FATAL, "NormInstance::Resume() error restarting NORM thread\n");
-                return false;
+                if (!GetShard(i)->dispatcher.StartThread(priority_boost))
+                {
+                    PLOG(PL_FATAL, "NormInstance::Resume() error restarting NORM thread\n");
+                    return false;
+                }
             }
+            return true;
         }
         
+        // Sessions may be sharded across multiple NORM protocol threads.  Each
+        // extra shard is a subordinate NormInstance with its own dispatcher and
+        // session manager, so API calls on a session (or its nodes and objects)
+        // suspend only that session's shard.  Shards post notifications to 
+        // their own queue and signal the parent's notification descriptor.
+        bool SetShardCount(unsigned int shardCount);
+        unsigned int GetShardCount() const {return shard_count;}
+        NormInstance* GetShard(unsigned int index)
+            {return ((0 == index) ? this : shard_list[index - 1]);}
+        unsigned int GetShardIndex() const {return shard_index;}
+        NormInstance* GetParent() 
+            {return ((NULL != shard_parent) ? shard_parent : this);}
+        unsigned int SelectShard() const;
+        bool SuspendShards();
+        void ResumeShards();
+        unsigned int GetShardEvents(NormEvent* eventArray, unsigned int maxEvents, bool waitForEvent);
+        void GetShardStats(NormShardStats& stats) const
+        {
+            stats.sessionCount = session_count;
+            stats.eventCount = event_count;
+            stats.ringPromptCount = ring_prompt_count;
+        }
+        
+        // Shared memory metrics export (see NormSetMetricsExport()).  The
+        // parent instance owns the segment and each shard's NORM thread 
+        // publishes its own sessions from its "metrics_timer".
+        bool SetMetricsExport(const char* segmentName, double interval);
+        bool OnMetricsTimeout(ProtoTimer& theTimer);
+        
+#ifndef SIMULATE
+        // Binary message trace file (see NormSetMessageTraceFile()).  The
+        // parent instance owns the NormTraceLog, which holds a trace ring
+        // for each shard's NORM thread.
+        bool SetTraceFile(const char* traceFile);
+#endif // !SIMULATE
+        
         bool WaitForEvent();
         bool GetNextEvent(NormEvent* theEvent);
+        unsigned int GetNextEvents(NormEvent* eventArray, unsigned int maxEvents);
         bool SetCacheDirectory(const char* cachePath);
         
         void SetAllocationFunctions(NormAllocFunctionHandle allocFunc, 
                                     NormFreeFunctionHandle  freeFunc)
         {
-            data_alloc_func = allocFunc;
-            session_mgr.SetDataFreeFunction(freeFunc);
+            for (unsigned int i = 0; i < shard_count; i++)
+            {
+                GetShard(i)->data_alloc_func = allocFunc;
+                GetShard(i)->session_mgr.SetDataFreeFunction(freeFunc);
+            }
         }
         
         void ReleasePreviousEvent();
@@ -87,6 +138,13 @@ class NormInstance : public NormController
         
         UINT32 CountCompletedObjects(NormSession* theSession);
         
+        // Lock-free stream I/O rings (see NormStreamSetRingSize())
+        bool SetStreamRing(NormStreamObject& stream, unsigned int ringSize);
+        unsigned int WriteStreamRing(NormStreamRing& ring, const char* buffer, unsigned int numBytes);
+        bool MarkStreamRing(NormStreamRing& ring, bool eom, NormStreamObject::FlushMode flushMode);
+        bool ReadStreamRing(NormStreamRing& ring, char* buffer, unsigned int* numBytes);
+        NormController::Event ServiceStreamRing(NormStreamObject& stream, NormController::Event event);
+        
         ProtoDispatcher::Descriptor GetDescriptor() const
         {
 #ifdef WIN32
@@ -119,7 +177,8 @@ class NormInstance : public NormController
         class Notification : public ProtoList::Item
         {
             public:
-                NormEvent   event;
+                NormEvent       event;
+                struct timeval  notify_time;  // (for EVENT_DELIVERY latency)
             
             class Queue : public ProtoListTemplate<Notification> {};
         };  // end class NormInstance::Notification
@@ -128,14 +187,42 @@ class NormInstance : public NormController
         bool                        priority_boost;
         NormSessionMgr              session_mgr;   
         NormAllocFunctionHandle     data_alloc_func;
+        unsigned int                session_count;
         
     private:
+        Notification* NewNotification();
+        // Queues a notification without the Notify() event handling
+        void QueueNotification(NormController::Event   event,
+                               class NormSession*      session,
+                               class NormNode*         node,
+                               class NormObject*       object);
+        void AppendNotification(Notification&          next,
+                                NormController::Event  event,
+                                class NormSession*     session,
+                                class NormNode*        node,
+                                class NormObject*      object);
+        Notification* DequeueNotification();
+        void SignalNotification();
+        
+        void PromptStreamRing(NormStreamRing& ring);
+        static void DoRingPrompt(ProtoDispatcher::Descriptor descriptor, 
+                                 ProtoDispatcher::Event      theEvent, 
+                                 const void*                 userData);
+        void OnRingPrompt();
+        
         void ResetNotificationEvent()
         {
+            // (a sharded instance resets its shared descriptor only in GetShardEvents())
+            if ((NULL != shard_parent) || (shard_count > 1)) return;
+            ResetNotificationDescriptor();
+        }
+        void ResetNotificationDescriptor()
+        {
 #ifdef WIN32
             if (0 == ResetEvent(notify_event))
                 PLOG(PL_ERROR, "NormInstance::ResetNotificationEvent() ResetEvent error: %s\n", GetErrorString());
 #else
+           // (an eventfd counter is reset by a single read)
            char byte[32];
            while (read(notify_fd[0], byte, 32) > 0);  // TBD - error check
 #endif // if/else WIN32/UNIX
@@ -143,34 +230,67 @@ class NormInstance : public NormController
          
         Notification::Queue         notify_pool;
         Notification::Queue         notify_queue; 
-        Notification*               previous_notification;
+        Notification::Queue         previous_queue;  // dispatched events (for garbage collection)
         
         const char*                 rx_cache_path;
         
 #ifdef WIN32
         HANDLE                      notify_event;
 #else
-        int                         notify_fd[2];  // TBD - use eventfd on Linux for this, may EVT_USER on MacOS
+        int                         notify_fd[2];  // both refer to one eventfd if USE_EVENTFD, else a pipe
 #endif // if/else WIN32/UNIX
+        
+        // Stream rings and the descriptor app threads use to prompt the NORM thread
+        NormStreamRing::List        ring_list;
+        NormStreamObject*           ring_service_stream;       // (stream being serviced by Notify())
+        bool                        ring_completion_deferred;  // (its RX_OBJECT_COMPLETED is pending)
+#ifdef WIN32
+        HANDLE                      ring_event;
+#else
+        int                         ring_fd[2];    // both refer to one eventfd if USE_EVENTFD, else a pipe
+#endif // if/else WIN32/UNIX
+        
+        // Protocol thread shards (index 0 is the parent instance itself)
+        NormInstance*               shard_parent;
+        unsigned int                shard_index;
+        unsigned int                shard_count;
+        NormInstance**              shard_list;    // shards 1 .. shard_count-1
+        unsigned int                shard_next;    // round-robin event collection start
+        unsigned long               event_count;
+        unsigned long               ring_prompt_count;
+        
+        NormMetrics                 metrics;       // (parent only)
+        ProtoTimer                  metrics_timer;
+#ifndef SIMULATE
+        NormTraceLog                trace_log;     // (parent only)
+#endif // !SIMULATE
 };  // end class NormInstance
 
 
 ////////////////////////////////////////////////////
 // NormInstance implementation
-NormInstance::NormInstance()
+NormInstance::NormInstance(NormInstance* shardParent, unsigned int shardIndex)
  : priority_boost(false),
    session_mgr(static_cast<ProtoTimerMgr&>(dispatcher), 
                static_cast<ProtoSocket::Notifier&>(dispatcher),
                static_cast<ProtoChannel::Notifier*>(&dispatcher)),
-   data_alloc_func(NULL), previous_notification(NULL), rx_cache_path(NULL)
+   data_alloc_func(NULL), session_count(0), rx_cache_path(NULL),
+   ring_service_stream(NULL), ring_completion_deferred(false),
+   shard_parent(shardParent), shard_index(shardIndex), shard_count(1),
+   shard_list(NULL), shard_next(0), event_count(0), ring_prompt_count(0)
 {
 #ifdef WIN32
     notify_event = NULL;
+    ring_event = NULL;
 #else
     notify_fd[0] = notify_fd[1] = -1;
+    ring_fd[0] = ring_fd[1] = -1;
 #endif // if/else WIN32/UNIX
     dispatcher.SetUserData(&session_mgr);  // for debugging
     session_mgr.SetController(static_cast<NormController*>(this));
+    metrics_timer.SetListener(this, &NormInstance::OnMetricsTimeout);
+    metrics_timer.SetInterval(1.0);
+    metrics_timer.SetRepeat(-1);
 }
 
 NormInstance::~NormInstance()
@@ -207,6 +327,9 @@ bool NormInstance::SetCacheDirectory(const char* cachePath)
         }
         dispatcher.ResumeThread();
     }
+    // (each shard keeps its own copy for its NORM thread)
+    for (unsigned int i = 1; result && (i < shard_count); i++)
+        result = shard_list[i - 1]->SetCacheDirectory(cachePath);
     return result;
 }  // end NormInstance::SetCacheDirectory()
 
@@ -225,23 +348,47 @@ void NormInstance::Notify(NormController::Event   event,
             return;
         case SEND_ERROR:
             TRACE("got SEND_ERROR\n");
+            break;
+        case TX_QUEUE_VACANCY:
+        case TX_QUEUE_EMPTY:
+        case RX_OBJECT_UPDATED:
+            // Streams with an API ring are serviced here and the app is 
+            // notified only upon ring empty/non-empty (or full) transitions
+            if ((NULL != object) && (NormObject::STREAM == object->GetType()) &&
+                (NULL != static_cast<NormStreamObject*>(object)->GetRing()))
+            {
+                ring_service_stream = static_cast<NormStreamObject*>(object);
+                event = ServiceStreamRing(*ring_service_stream, event);
+                ring_service_stream = NULL;
+                if (ring_completion_deferred)
+                {
+                    // The stream end was read into the ring, so its completion
+                    // is queued after the data notification (if any)
+                    ring_completion_deferred = false;
+                    if (EVENT_INVALID != event) 
+                        QueueNotification(event, session, node, object);
+                    QueueNotification(RX_OBJECT_COMPLETED, session, node, object);
+                    object->Release();  // (retained when deferred)
+                    return;
+                }
+                if (EVENT_INVALID == event) return;
+            }
+            break;
+        case RX_OBJECT_COMPLETED:
+            if ((NULL != ring_service_stream) && (object == ring_service_stream))
+            {
+                // (posted by the ring servicing above once it's done)
+                object->Retain();
+                ring_completion_deferred = true;
+                return;
+            }
+            break;
         default:
             break;
     }
     
-    // (TBD) set a limit on how many pending notifications
-    // we allow to queue up (it could be large and probably
-    // we could base it on how much memory space the pending
-    // notifications are allowed to consume.
-    Notification* next = notify_pool.RemoveHead();
-    if (NULL == next)
-    {
-        if (NULL == (next = new Notification))
-        {
-            PLOG(PL_FATAL, "NormInstance::Notify() new Notification error: %s\n", GetErrorString());
-            return;   
-        }
-    }
+    Notification* next = NewNotification();
+    if (NULL == next) return;
     
     switch (event)
     { 
@@ -371,6 +518,39 @@ void NormInstance::Notify(NormController::Event   event,
             break;
     }  // end switch(event)
     
+    AppendNotification(*next, event, session, node, object);
+}  // end NormInstance::Notify()
+
+NormInstance::Notification* NormInstance::NewNotification()
+{
+    // (TBD) set a limit on how many pending notifications
+    // we allow to queue up (it could be large and probably
+    // we could base it on how much memory space the pending
+    // notifications are allowed to consume.
+    Notification* next = notify_pool.RemoveHead();
+    if (NULL == next)
+    {
+        if (NULL == (next = new Notification))
+            PLOG(PL_FATAL, "NormInstance::NewNotification() new Notification error: %s\n", GetErrorString());
+    }
+    return next;
+}  // end NormInstance::NewNotification()
+
+void NormInstance::QueueNotification(NormController::Event   event,
+                                     class NormSession*      session,
+                                     class NormNode*         node,
+                                     class NormObject*       object)
+{
+    Notification* next = NewNotification();
+    if (NULL != next) AppendNotification(*next, event, session, node, object);
+}  // end NormInstance::QueueNotification()
+
+void NormInstance::AppendNotification(Notification&          next,
+                                      NormController::Event  event,
+                                      class NormSession*     session,
+                                      class NormNode*        node,
+                                      class NormObject*      object)
+{
     // "Retain" any valid "object" or "sender" handles for API access
     if (NORM_OBJECT_INVALID != object)
         ((NormObject*)object)->Retain();
@@ -378,34 +558,44 @@ void NormInstance::Notify(NormController::Event   event,
         ((NormNode*)node)->Retain();
     
     bool doNotify = notify_queue.IsEmpty();
-    next->event.type = (NormEventType)event;
-    next->event.session = session;
-    next->event.sender = node;
-    next->event.object = object;
-    notify_queue.Append(*next);
+    next.event.type = (NormEventType)event;
+    next.event.session = session;
+    next.event.sender = node;
+    next.event.object = object;
+    if (NULL != session) ProtoSystemTime(next.notify_time);
+    notify_queue.Append(next);
+    event_count++;
     
-    if (doNotify)
-    {
+    if (doNotify) SignalNotification();
+}  // end NormInstance::AppendNotification()
+
+void NormInstance::SignalNotification()
+{
+    // Shards signal their parent's (i.e. the app-visible) descriptor
+    NormInstance* target = GetParent();
 #ifdef WIN32
-        if (0 == SetEvent(notify_event))
+    if (0 == SetEvent(target->notify_event))
+    {
+        PLOG(PL_ERROR, "NormInstance::SignalNotification() SetEvent() error: %s\n",
+                       GetErrorString());
+    }
+#else
+#ifdef USE_EVENTFD
+    uint64_t byte = 1;
+#else
+    char byte = 0;
+#endif // if/else USE_EVENTFD
+    while ((ssize_t)sizeof(byte) != write(target->notify_fd[1], &byte, sizeof(byte)))
+    {
+        if ((EINTR != errno) && (EAGAIN != errno))
         {
-            PLOG(PL_ERROR, "NormInstance::Notify() SetEvent() error: %s\n",
+            PLOG(PL_FATAL, "NormInstance::SignalNotification() write() error: %s\n",
                            GetErrorString());
+            break;
         }
-#else
-        char byte = 0;
-        while (1 != write(notify_fd[1], &byte, 1))
-        {
-            if ((EINTR != errno) && (EAGAIN != errno))
-            {
-                PLOG(PL_FATAL, "NormInstance::Notify() write() error: %s\n",
-                               GetErrorString());
-                break;
-            }
-        }    
+    }    
 #endif // if/else WIN32/UNIX  
-    }  
-}  // end NormInstance::Notify()
+}  // end NormInstance::SignalNotification()
 
 // Purge any notifications associated with a specific object
 void NormInstance::PurgeObjectNotifications(NormObjectHandle objectHandle)
@@ -425,12 +615,16 @@ void NormInstance::PurgeObjectNotifications(NormObjectHandle objectHandle)
             notify_pool.Append(*next);
         }
     }
-    if ((NULL != previous_notification) && (objectHandle == previous_notification->event.object))
+    Notification::Queue::Iterator previousIterator(previous_queue);
+    while (NULL != (next = previousIterator.GetNextItem()))
     {
-        // "Release" any previously-retained object or node handle
-        ((NormObject*)(previous_notification->event.object))->Release();
-        notify_pool.Append(*previous_notification);   
-        previous_notification = NULL;   
+        if (objectHandle == next->event.object)
+        {
+            // "Release" any previously-retained object handle
+            ((NormObject*)objectHandle)->Release();
+            previous_queue.Remove(*next);
+            notify_pool.Append(*next);
+        }
     }
     // TBD - check if event queue is emptied and reset event/fd
 }  // end NormInstance::PurgeObjectNotifications()
@@ -452,15 +646,19 @@ void NormInstance::PurgeNodeNotifications(NormNodeHandle nodeHandle)
             notify_pool.Append(*next);
         }
     }
-    if ((NULL != previous_notification) && (nodeHandle == previous_notification->event.sender))
+    Notification::Queue::Iterator previousIterator(previous_queue);
+    while (NULL != (next = previousIterator.GetNextItem()))
     {
-        // "Release" any previously-retained object or node handle
-        if (NORM_OBJECT_INVALID != previous_notification->event.object)
-            ((NormObject*)(previous_notification->event.object))->Release();
-        else
-            ((NormNode*)(previous_notification->event.sender))->Release();
-        notify_pool.Append(*previous_notification);   
-        previous_notification = NULL;   
+        if (nodeHandle == next->event.sender)
+        {
+            // "Release" any previously-retained object or node handle
+            if (NORM_OBJECT_INVALID != next->event.object)
+                ((NormObject*)(next->event.object))->Release();
+            else
+                ((NormNode*)(next->event.sender))->Release();
+            previous_queue.Remove(*next);
+            notify_pool.Append(*next);
+        }
     }
     if (notify_queue.IsEmpty()) ResetNotificationEvent();
 }  // end NormInstance::PurgeNodeNotifications()
@@ -483,15 +681,19 @@ void NormInstance::PurgeSessionNotifications(NormSessionHandle sessionHandle)
             notify_pool.Append(*next);
         }   
     }
-    if ((NULL != previous_notification) && (sessionHandle == previous_notification->event.session))
+    Notification::Queue::Iterator previousIterator(previous_queue);
+    while (NULL != (next = previousIterator.GetNextItem()))
     {
-        // "Release" any previously-retained object or node handle
-        if (NORM_OBJECT_INVALID != previous_notification->event.object)
-            ((NormObject*)(previous_notification->event.object))->Release();
-        else if (NORM_NODE_INVALID != previous_notification->event.sender)
-            ((NormNode*)(previous_notification->event.sender))->Release();
-        notify_pool.Append(*previous_notification);   
-        previous_notification = NULL;   
+        if (sessionHandle == next->event.session)
+        {
+            // "Release" any previously-retained object or node handle
+            if (NORM_OBJECT_INVALID != next->event.object)
+                ((NormObject*)(next->event.object))->Release();
+            else if (NORM_NODE_INVALID != next->event.sender)
+                ((NormNode*)(next->event.sender))->Release();
+            previous_queue.Remove(*next);
+            notify_pool.Append(*next);
+        }
     }
     if (notify_queue.IsEmpty()) ResetNotificationEvent();
 }  // end NormInstance::PurgeSessionNotifications()
@@ -519,20 +721,11 @@ void NormInstance::PurgeNotifications(NormSessionHandle sessionHandle, NormEvent
     if (notify_queue.IsEmpty()) ResetNotificationEvent();
 }  // end NormInstance::PurgeNotifications()
 
-// NormInstance::dispatcher MUST be suspended _before_ calling this
-bool NormInstance::GetNextEvent(NormEvent* theEvent)
+// Removes the next notification from the "notify_queue" and keeps it
+// in the "previous_queue" so its handles stay valid until released
+// (NormInstance::dispatcher MUST be suspended _before_ calling this)
+NormInstance::Notification* NormInstance::DequeueNotification()
 {
-    // First, do any garbage collection for "previous_notification"
-    if (NULL != previous_notification)
-    {
-        // "Release" any previously-retained object or node handle
-        if (NORM_OBJECT_INVALID != previous_notification->event.object)
-            ((NormObject*)(previous_notification->event.object))->Release();
-        else if (NORM_NODE_INVALID != previous_notification->event.sender)
-            ((NormNode*)(previous_notification->event.sender))->Release();
-        notify_pool.Append(*previous_notification);   
-        previous_notification = NULL;   
-    }
     Notification* next;
     while (NULL != (next = notify_queue.RemoveHead()))
     {
@@ -566,9 +759,28 @@ bool NormInstance::GetNextEvent(NormEvent* theEvent)
         }
 	    break;
     }
+    if (NULL != next) 
+    {
+        if (NORM_SESSION_INVALID != next->event.session)
+        {
+            struct timeval currentTime;
+            ProtoSystemTime(currentTime);
+            NormSession* session = (NormSession*)next->event.session;
+            session->AccessLatencyHistogram(NormSession::EVENT_DELIVERY).RecordInterval(next->notify_time, currentTime);
+        }
+        previous_queue.Append(*next);  // keep dispatched event for garbage collection
+    }
+    return next;
+}  // end NormInstance::DequeueNotification()
+
+// NormInstance::dispatcher MUST be suspended _before_ calling this
+bool NormInstance::GetNextEvent(NormEvent* theEvent)
+{
+    // First, do any garbage collection for previously dispatched events
+    ReleasePreviousEvent();
+    Notification* next = DequeueNotification();
     if (NULL != next)
     {
-        previous_notification = next;  // keep dispatched event for garbage collection
         if (NULL != theEvent) *theEvent = next->event;
     }
     else if (NULL != theEvent)
@@ -582,6 +794,22 @@ bool NormInstance::GetNextEvent(NormEvent* theEvent)
     return (NULL != next); 
 }  // end NormInstance::GetNextEvent()
 
+// NormInstance::dispatcher MUST be suspended _before_ calling this
+unsigned int NormInstance::GetNextEvents(NormEvent* eventArray, unsigned int maxEvents)
+{
+    ReleasePreviousEvent();
+    unsigned int count = 0;
+    Notification* next;
+    while ((count < maxEvents) && (NULL != (next = DequeueNotification())))
+    {
+        // (a trailing NORM_EVENT_INVALID is only passed on by itself)
+        if ((NORM_EVENT_INVALID == next->event.type) && (0 != count)) break;
+        eventArray[count++] = next->event;
+    }
+    if (notify_queue.IsEmpty()) ResetNotificationEvent();
+    return count;
+}  // end NormInstance::GetNextEvents()
+
 bool NormInstance::WaitForEvent()
 {
     if (!dispatcher.IsThreaded()) 
@@ -592,17 +820,18 @@ bool NormInstance::WaitForEvent()
 #ifdef WIN32
     WaitForSingleObject(notify_event, INFINITE);
 #else
-    fd_set fdSet;
-    FD_ZERO(&fdSet);
-    FD_SET(notify_fd[0], &fdSet);
+    // (poll() is used so the descriptor value is not limited by FD_SETSIZE)
+    struct pollfd pfd;
+    pfd.fd = notify_fd[0];
+    pfd.events = POLLIN;
     while (1)
     {
-        if (0 > select(notify_fd[0] + 1, &fdSet, (fd_set*)NULL, 
-                       (fd_set*)NULL, (struct timeval*)NULL))
+        pfd.revents = 0;
+        if (0 > poll(&pfd, 1, -1))
         {
             if (EINTR != errno)
             {
-                PLOG(PL_FATAL, "NormInstance::WaitForEvent() select() error: %s\n",
+                PLOG(PL_FATAL, "NormInstance::WaitForEvent() poll() error: %s\n",
                         GetErrorString());
                 return false;   
             }
@@ -620,31 +849,72 @@ bool NormInstance::WaitForEvent()
 bool NormInstance::Startup(bool priorityBoost)
 {
     // 1) Create descriptor to use for event notification
+    //    (shards signal their parent's descriptor instead)
+    if (NULL == shard_parent)
+    {
+#ifdef WIN32
+        // Create initially non-signalled, manual reset event
+        notify_event = CreateEvent(NULL, TRUE, FALSE, NULL);  
+        if (NULL == notify_event)
+        {
+            PLOG(PL_FATAL, "NormInstance::Startup() CreateEvent() error: %s\n", GetErrorString());
+            return false;
+        }
+#elif defined(USE_EVENTFD)
+        // Linux eventfd is a single, non-blocking counter descriptor whose
+        // signaled state coalesces any number of pending notifications
+        notify_fd[0] = notify_fd[1] = eventfd(0, EFD_NONBLOCK);
+        if (notify_fd[0] < 0)
+        {
+            PLOG(PL_FATAL, "NormInstance::Startup() eventfd() error: %s\n", GetErrorString());
+            return false;
+        }
+#else
+        if (0 != pipe(notify_fd))
+        {
+            PLOG(PL_FATAL, "NormInstance::Startup() pipe() error: %s\n", GetErrorString());
+            return false;
+        }
+        // make reading non-blocking
+        if(-1 == fcntl(notify_fd[0], F_SETFL, fcntl(notify_fd[0], F_GETFL, 0)  | O_NONBLOCK))
+        {
+            PLOG(PL_FATAL, "NormInstance::Startup() fcntl(F_SETFL(O_NONBLOCK)) error: %s\n", GetErrorString());
+            close(notify_fd[0]);
+            close(notify_fd[1]);
+            notify_fd[0] = notify_fd[1] = -1;
+            return false;
+        }
+#endif // if/else WIN32/UNIX
+    }
+    // 2) Create descriptor app threads use to prompt stream ring service
 #ifdef WIN32
-    // Create initially non-signalled, manual reset event
-    notify_event = CreateEvent(NULL, TRUE, FALSE, NULL);  
-    if (NULL == notify_event)
+    // Create initially non-signalled, auto reset event
+    ring_event = CreateEvent(NULL, FALSE, FALSE, NULL);  
+    if (NULL == ring_event)
     {
-        PLOG(PL_FATAL, "NormInstance::Startup() CreateEvent() error: %s\n", GetErrorString());
+        PLOG(PL_FATAL, "NormInstance::Startup() CreateEvent(ring_event) error: %s\n", GetErrorString());
         return false;
     }
+    if (!dispatcher.InstallGenericInput(ring_event, DoRingPrompt, this))
+#elif defined(USE_EVENTFD)
+    ring_fd[0] = ring_fd[1] = eventfd(0, EFD_NONBLOCK);
+    if ((ring_fd[0] < 0) || !dispatcher.InstallGenericInput(ring_fd[0], DoRingPrompt, this))
 #else
-    if (0 != pipe(notify_fd))
+    if (0 != pipe(ring_fd))
     {
-        PLOG(PL_FATAL, "NormInstance::Startup() pipe() error: %s\n", GetErrorString());
+        PLOG(PL_FATAL, "NormInstance::Startup() pipe(ring_fd) error: %s\n", GetErrorString());
         return false;
     }
-    // make reading non-blocking
-    if(-1 == fcntl(notify_fd[0], F_SETFL, fcntl(notify_fd[0], F_GETFL, 0)  | O_NONBLOCK))
+    // make both ends non-blocking (prompts are coalesced so the pipe never fills)
+    if ((-1 == fcntl(ring_fd[0], F_SETFL, fcntl(ring_fd[0], F_GETFL, 0)  | O_NONBLOCK)) ||
+        (-1 == fcntl(ring_fd[1], F_SETFL, fcntl(ring_fd[1], F_GETFL, 0)  | O_NONBLOCK)) ||
+        !dispatcher.InstallGenericInput(ring_fd[0], DoRingPrompt, this))
+#endif // if/else WIN32/UNIX
     {
-        PLOG(PL_FATAL, "NormInstance::Startup() fcntl(F_SETFL(O_NONBLOCK)) error: %s\n", GetErrorString());
-        close(notify_fd[0]);
-        close(notify_fd[1]);
-        notify_fd[0] = notify_fd[1] = -1;
+        PLOG(PL_FATAL, "NormInstance::Startup() error installing ring prompt descriptor\n");
         return false;
     }
-#endif // if/else WIN32/UNIX
-    // 2) Start thread
+    // 3) Start thread
     priority_boost = priorityBoost;
     return dispatcher.StartThread(priorityBoost);
 }  // end NormInstance::Startup()
@@ -653,16 +923,16 @@ bool NormInstance::Startup(bool priorityBoost)
 
 void NormInstance::ReleasePreviousEvent()
 {
-    // Garbage collect our "previous_notification"
-    if (NULL != previous_notification)
+    // Garbage collect previously dispatched events
+    Notification* previous;
+    while (NULL != (previous = previous_queue.RemoveHead()))
     {
         // Release any previously-retained object or node handles
-        if (NORM_OBJECT_INVALID != previous_notification->event.object)
-            ((NormObject*)(previous_notification->event.object))->Release();
-        else if (NORM_NODE_INVALID != previous_notification->event.sender)
-            ((NormNode*)(previous_notification->event.sender))->Release();
-        notify_pool.Append(*previous_notification);   
-        previous_notification = NULL;   
+        if (NORM_OBJECT_INVALID != previous->event.object)
+            ((NormObject*)(previous->event.object))->Release();
+        else if (NORM_NODE_INVALID != previous->event.sender)
+            ((NormNode*)(previous->event.sender))->Release();
+        notify_pool.Append(*previous);   
     }
 }  // end NormInstance::ReleasePreviousEvent()
 
@@ -670,16 +940,34 @@ NORM_API_LINKAGE
 void NormReleasePreviousEvent(NormInstanceHandle instanceHandle)
 {
     NormInstance* instance = (NormInstance*)instanceHandle;
-    if (instance && instance->dispatcher.SuspendThread())
+    if (NULL == instance) return;
+    for (unsigned int i = 0; i < instance->GetShardCount(); i++)
     {
-        instance->ReleasePreviousEvent();
-        instance->dispatcher.ResumeThread();
+        NormInstance* shard = instance->GetShard(i);
+        if (shard->dispatcher.SuspendThread())
+        {
+            shard->ReleasePreviousEvent();
+            shard->dispatcher.ResumeThread();
+        }
     }
 }  // end NormReleasePreviousEvent()
 
 
 void NormInstance::Shutdown()
 {
+    if ((NULL == shard_parent) && metrics.IsOpen()) SetMetricsExport(NULL, 0.0);
+#ifndef SIMULATE
+    if ((NULL == shard_parent) && trace_log.IsOpen()) SetTraceFile(NULL);
+#endif // !SIMULATE
+    // Shards (and their sessions) go first since they signal our descriptor
+    for (unsigned int i = 1; i < shard_count; i++)
+        delete shard_list[i - 1];
+    if (NULL != shard_list)
+    {
+        delete[] shard_list;
+        shard_list = NULL;
+    }
+    shard_count = 1;
     dispatcher.Stop();
 #ifdef WIN32
     if (NULL != notify_event)
@@ -690,10 +978,27 @@ void NormInstance::Shutdown()
 #else
     if (notify_fd[0] >= 0)
     {
-        close(notify_fd[0]);  // close read end of pipe
-        close(notify_fd[1]);  // close write end of pipe
+        close(notify_fd[0]);  // close read end of pipe (or the eventfd)
+        if (notify_fd[1] != notify_fd[0])
+            close(notify_fd[1]);  // close write end of pipe
         notify_fd[0] = notify_fd[1] = -1;
     }
+#endif // if/else WIN32/UNIX
+#ifdef WIN32
+    if (NULL != ring_event)
+    {
+        dispatcher.RemoveGenericInput(ring_event);
+        CloseHandle(ring_event);
+        ring_event = NULL;
+    }
+#else
+    if (ring_fd[0] >= 0)
+    {
+        dispatcher.RemoveGenericInput(ring_fd[0]);
+        close(ring_fd[0]);
+        if (ring_fd[1] != ring_fd[0]) close(ring_fd[1]);
+        ring_fd[0] = ring_fd[1] = -1;
+    }
 #endif // if/else WIN32/UNIX
     if (rx_cache_path)
     {
@@ -701,17 +1006,8 @@ void NormInstance::Shutdown()
         rx_cache_path = NULL;   
     }
     
-    // Garbage collect our "previous_notification"
-    if (NULL != previous_notification)
-    {
-        // Release any previously-retained object or node handles
-        if (NORM_OBJECT_INVALID != previous_notification->event.object)
-            ((NormObject*)(previous_notification->event.object))->Release();
-        else if (NORM_NODE_INVALID != previous_notification->event.sender)
-            ((NormNode*)(previous_notification->event.sender))->Release();
-        notify_pool.Append(*previous_notification);   
-        previous_notification = NULL;   
-    }
+    // Garbage collect previously dispatched events
+    ReleasePreviousEvent();
     
     Notification* next;
     while (NULL != (next = notify_queue.RemoveHead()))
@@ -762,6 +1058,478 @@ UINT32 NormInstance::CountCompletedObjects(NormSession* session)
 } // end NormInstance::CountCompletedObjects()
 */
 
+bool NormInstance::SetStreamRing(NormStreamObject& stream, unsigned int ringSize)
+{
+    // (called with NORM thread suspended)
+    NormStreamRing* ring = stream.GetRing();
+    if (NULL != ring)
+    {
+        if (ring->IsSender()) 
+            ServiceStreamRing(stream, NormController::EVENT_INVALID);
+        if (!ring->IsEmpty())
+        {
+            PLOG(PL_ERROR, "NormInstance::SetStreamRing() error: existing ring not empty\n");
+            return false;
+        }
+        stream.SetRing(NULL);
+    }
+    if (0 == ringSize) return true;
+    if (NULL == (ring = new NormStreamRing(&stream, (NULL == stream.GetSender()))))
+    {
+        PLOG(PL_ERROR, "NormInstance::SetStreamRing() new NormStreamRing error: %s\n", GetErrorString());
+        return false;
+    }
+    if (!ring->Init(ringSize))
+    {
+        delete ring;
+        return false;
+    }
+    stream.SetRing(ring);
+    ring_list.Prepend(*ring);
+    // Prime a receive ring with any data already buffered, since
+    // the stream won't post another update until it is read dry
+    if (!ring->IsSender())
+        Notify(RX_OBJECT_UPDATED, &session_mgr, &stream.GetSession(), stream.GetSender(), &stream);
+    return true;
+}  // end NormInstance::SetStreamRing()
+
+// Moves data between a stream and its ring (on the NORM thread or with
+// it suspended) and returns the event, if any, to post to the app
+NormController::Event NormInstance::ServiceStreamRing(NormStreamObject&     stream, 
+                                                      NormController::Event event)
+{
+    NormStreamRing& ring = *stream.GetRing();
+    NormController::Event result = EVENT_INVALID;
+    stream.Retain();  // since reading may end (and delete) the stream
+    if (ring.IsSender())
+    {
+        // Drain app data and marks into the stream buffer.  As with NormStreamWritev(),
+        // auto flushing is deferred until the drain is done
+        NormStreamObject::FlushMode saveFlushMode = stream.GetFlushMode();
+        stream.SetFlushMode(NormStreamObject::FLUSH_NONE);
+        bool drained = false;
+        while (true)
+        {
+            unsigned int numBytes;
+            const char* data = ring.AccessRead(numBytes);
+            const NormStreamRing::Mark* mark = ring.PeekMark();
+            if (NULL != mark)
+            {
+                UINT32 markDelta = mark->offset - ring.GetReadIndex();
+                if (markDelta > numBytes)
+                    mark = NULL;  // mark is beyond this contiguous chunk
+                else
+                    numBytes = markDelta;
+            }
+            if (0 != numBytes)
+            {
+                UINT32 count = stream.Write(data, numBytes, false);
+                ring.Consume(count);
+                if (0 != count) drained = true;
+                if (count < numBytes) break;  // stream buffer full, resume upon vacancy
+            }
+            if (NULL != mark)
+            {
+                if (NormStreamObject::FLUSH_NONE != mark->flush_mode)
+                {
+                    stream.SetFlushMode((NormStreamObject::FlushMode)mark->flush_mode);
+                    stream.Flush(mark->eom);
+                    stream.SetFlushMode(NormStreamObject::FLUSH_NONE);
+                }
+                else
+                {
+                    stream.Write(NULL, 0, mark->eom);
+                }
+                ring.PopMark();
+                drained = true;
+            }
+            else if (0 == numBytes)
+            {
+                break;  // ring is empty
+            }
+        }
+        stream.SetFlushMode(saveFlushMode);
+        if (drained && (NormStreamObject::FLUSH_NONE != saveFlushMode))
+            stream.Write(NULL, 0, false);
+        if ((0 != ring.GetSpace()) && ring.Unblock())
+            result = TX_QUEUE_VACANCY;  // app had found the ring full
+        else if ((TX_QUEUE_EMPTY == event) && !drained && ring.IsEmpty())
+            result = TX_QUEUE_EMPTY;
+    }
+    else if (!ring.IsBroken())  // (filling resumes once app has seen the break)
+    {
+        if (ring.SeekPending())
+        {
+            unsigned int numBytes = 0;
+            if (stream.Read(NULL, &numBytes, true))
+                ring.SetSeekSynced();
+        }
+        // Fill the ring from the stream buffer until one or the other runs dry
+        while (!ring.SeekPending())
+        {
+            unsigned int numBytes;
+            char* space = ring.AccessWrite(numBytes);
+            if (0 == numBytes)
+            {
+                if (ring.Block()) break;  // app prompts us once it has read
+                continue;
+            }
+            if (!stream.Read(space, &numBytes))
+            {
+                ring.SetBroken();  // reported to app once preceding data is read
+                result = RX_OBJECT_UPDATED;
+                break;
+            }
+            if (0 == numBytes) break;
+            if (ring.Commit(numBytes)) result = RX_OBJECT_UPDATED;
+        }
+    }
+    stream.Release();
+    return result;
+}  // end NormInstance::ServiceStreamRing()
+
+unsigned int NormInstance::WriteStreamRing(NormStreamRing& ring, const char* buffer, unsigned int numBytes)
+{
+    unsigned int result = 0;
+    bool prompt = false;
+    while (true)
+    {
+        bool wasEmpty;
+        result += ring.Write(buffer + result, numBytes - result, wasEmpty);
+        if (wasEmpty) prompt = true;
+        if ((result == numBytes) || ring.Block()) break;
+    }
+    if (prompt) PromptStreamRing(ring);
+    return result;
+}  // end NormInstance::WriteStreamRing()
+
+bool NormInstance::MarkStreamRing(NormStreamRing& ring, bool eom, NormStreamObject::FlushMode flushMode)
+{
+    bool wasEmpty;
+    if (!ring.PushMark(eom, flushMode, wasEmpty))
+    {
+        // Mark queue is full, so drain what we can while the NORM thread is suspended
+        NormStreamObject* stream = (NormStreamObject*)ring.GetOwner();
+        if (!dispatcher.SuspendThread()) return false;
+        Notify(TX_QUEUE_VACANCY, &session_mgr, &stream->GetSession(), NULL, stream);
+        bool result = ring.PushMark(eom, flushMode, wasEmpty);
+        dispatcher.ResumeThread();
+        if (!result)
+        {
+            PLOG(PL_ERROR, "NormInstance::MarkStreamRing() error: stream ring mark queue full\n");
+            return false;
+        }
+    }
+    if (wasEmpty) PromptStreamRing(ring);
+    return true;
+}  // end NormInstance::MarkStreamRing()
+
+bool NormInstance::ReadStreamRing(NormStreamRing& ring, char* buffer, unsigned int* numBytes)
+{
+    bool broken = ring.IsBroken();  // tested first since data preceding break is committed first
+    *numBytes = ring.Read(buffer, *numBytes);
+    if (broken && (0 == *numBytes))
+    {
+        ring.ClearBroken();
+        PromptStreamRing(ring);  // to resume filling
+        return false;
+    }
+    if (ring.Unblock()) PromptStreamRing(ring);
+    return true;
+}  // end NormInstance::ReadStreamRing()
+
+void NormInstance::PromptStreamRing(NormStreamRing& ring)
+{
+    if (!ring.SetPrompt()) return;  // already prompted
+#ifdef WIN32
+    if (0 == SetEvent(ring_event))
+        PLOG(PL_ERROR, "NormInstance::PromptStreamRing() SetEvent() error: %s\n", GetErrorString());
+#else
+#ifdef USE_EVENTFD
+    uint64_t byte = 1;
+#else
+    char byte = 0;
+#endif // if/else USE_EVENTFD
+    while ((ssize_t)sizeof(byte) != write(ring_fd[1], &byte, sizeof(byte)))
+    {
+        if (EINTR != errno)
+        {
+            // EAGAIN means prompts are already pending (or counter saturated)
+            if (EAGAIN != errno)
+                PLOG(PL_ERROR, "NormInstance::PromptStreamRing() write() error: %s\n", GetErrorString());
+            break;
+        }
+    }
+#endif // if/else WIN32/UNIX
+}  // end NormInstance::PromptStreamRing()
+
+void NormInstance::DoRingPrompt(ProtoDispatcher::Descriptor descriptor, 
+                                ProtoDispatcher::Event      theEvent, 
+                                const void*                 userData)
+{
+    NormInstance* instance = (NormInstance*)userData;
+    instance->OnRingPrompt();
+}  // end NormInstance::DoRingPrompt()
+
+void NormInstance::OnRingPrompt()
+{
+#ifndef WIN32
+    char byte[32];
+    while (read(ring_fd[0], byte, 32) > 0);
+#endif // !WIN32
+    ring_prompt_count++;
+    NormStreamRing* next = ring_list.GetHead();
+    while (NULL != next)
+    {
+        NormStreamRing* ring = next;
+        next = ring->GetNext();  // (servicing may delete the ring's stream)
+        if (ring->ClearPrompt())
+        {
+            NormStreamObject* stream = (NormStreamObject*)ring->GetOwner();
+            Notify(ring->IsSender() ? TX_QUEUE_VACANCY : RX_OBJECT_UPDATED,
+                   &session_mgr, &stream->GetSession(), stream->GetSender(), stream);
+        }
+    }
+}  // end NormInstance::OnRingPrompt()
+
+bool NormInstance::SetShardCount(unsigned int shardCount)
+{
+    if (0 == shardCount) shardCount = 1;
+    if (shardCount == shard_count) return true;
+    // Sessions can't migrate between shards, so re-sharding needs idle shards
+    for (unsigned int i = 0; i < shard_count; i++)
+    {
+        if (0 != GetShard(i)->session_count)
+        {
+            PLOG(PL_ERROR, "NormInstance::SetShardCount() error: instance has active sessions\n");
+            return false;
+        }
+    }
+    NormInstance** shardList = NULL;
+    if ((shardCount > 1) && (NULL == (shardList = new NormInstance*[shardCount - 1])))
+    {
+        PLOG(PL_FATAL, "NormInstance::SetShardCount() new shardList error: %s\n", GetErrorString());
+        return false;
+    }
+    unsigned int i;
+    for (i = 1; i < shardCount; i++)
+    {
+        if (i < shard_count)
+        {
+            shardList[i - 1] = shard_list[i - 1];
+            continue;
+        }
+        NormInstance* shard = new NormInstance(this, i);
+        if (NULL == shard)
+        {
+            PLOG(PL_FATAL, "NormInstance::SetShardCount() new shard error: %s\n", GetErrorString());
+        }
+        else if (!shard->Startup(priority_boost))
+        {
+            PLOG(PL_FATAL, "NormInstance::SetShardCount() shard startup error\n");
+            delete shard;
+            shard = NULL;
+        }
+        if (NULL == shard)
+        {
+            // Undo any shards created above
+            while (--i >= shard_count) delete shardList[i - 1];
+            delete[] shardList;
+            return false;
+        }
+        if (NULL != rx_cache_path) shard->SetCacheDirectory(rx_cache_path);
+        shard->data_alloc_func = data_alloc_func;
+        shard->session_mgr.SetDataFreeFunction(session_mgr.GetDataFreeFunction());
+        // (rings of any removed shards are kept until the trace file closes)
+#ifndef SIMULATE
+        if (trace_log.IsOpen()) shard->session_mgr.SetTraceRing(trace_log.AddRing());
+#endif // !SIMULATE
+        shardList[i - 1] = shard;
+    }
+    for (i = shardCount; i < shard_count; i++)
+        delete shard_list[i - 1];
+    if (NULL != shard_list) delete[] shard_list;
+    shard_list = shardList;
+    shard_count = shardCount;
+    shard_next = 0;
+    // The metrics segment has per-shard slots, so it is recreated
+    if (metrics.IsOpen())
+    {
+        char segmentName[128];
+        strncpy(segmentName, metrics.GetName(), 127);
+        segmentName[127] = '\0';
+        SetMetricsExport(segmentName, metrics_timer.GetInterval());
+    }
+    return true;
+}  // end NormInstance::SetShardCount()
+
+bool NormInstance::SetMetricsExport(const char* segmentName, double interval)
+{
+    if (!SuspendShards()) return false;
+    for (unsigned int i = 0; i < shard_count; i++)
+    {
+        ProtoTimer& timer = GetShard(i)->metrics_timer;
+        if (timer.IsActive()) timer.Deactivate();
+    }
+    metrics.Close();
+    bool result = true;
+    if (interval > 0.0)
+    {
+        char defaultName[64];
+        if (NULL == segmentName)
+        {
+            static unsigned int instanceCount = 0;
+#ifdef WIN32
+            unsigned long processId = (unsigned long)GetCurrentProcessId();
+#else
+            unsigned long processId = (unsigned long)getpid();
+#endif // if/else WIN32
+            snprintf(defaultName, 64, NORM_METRICS_PREFIX "%lu.%u", processId, instanceCount++);
+            segmentName = defaultName;
+        }
+        if (metrics.Create(segmentName, shard_count, interval))
+        {
+            for (unsigned int i = 0; i < shard_count; i++)
+            {
+                NormInstance* shard = GetShard(i);
+                shard->metrics_timer.SetInterval(interval);
+                shard->dispatcher.ActivateTimer(shard->metrics_timer);
+            }
+        }
+        else
+        {
+            PLOG(PL_ERROR, "NormInstance::SetMetricsExport() error creating metrics segment\n");
+            result = false;
+        }
+    }
+    ResumeShards();
+    return result;
+}  // end NormInstance::SetMetricsExport()
+
+bool NormInstance::OnMetricsTimeout(ProtoTimer& /*theTimer*/)
+{
+    GetParent()->metrics.Publish(shard_index, session_mgr);
+    return true;
+}  // end NormInstance::OnMetricsTimeout()
+
+#ifndef SIMULATE
+bool NormInstance::SetTraceFile(const char* traceFile)
+{
+    // Producers are detached before the log (and their rings) are closed
+    if (!SuspendShards()) return false;
+    unsigned int i;
+    for (i = 0; i < shard_count; i++)
+        GetShard(i)->session_mgr.SetTraceRing(NULL);
+    ResumeShards();
+    trace_log.Close();
+    if (NULL == traceFile) return true;
+    if (!trace_log.Open(traceFile))
+    {
+        PLOG(PL_ERROR, "NormInstance::SetTraceFile() error opening trace file\n");
+        return false;
+    }
+    if (!SuspendShards())
+    {
+        trace_log.Close();
+        return false;
+    }
+    for (i = 0; i < shard_count; i++)
+    {
+        NormTraceRing* ring = trace_log.AddRing();
+        if (NULL == ring) break;
+        GetShard(i)->session_mgr.SetTraceRing(ring);
+    }
+    ResumeShards();
+    if (i < shard_count)
+    {
+        PLOG(PL_ERROR, "NormInstance::SetTraceFile() error adding trace ring\n");
+        SetTraceFile(NULL);
+        return false;
+    }
+    return true;
+}  // end NormInstance::SetTraceFile()
+#endif // !SIMULATE
+
+unsigned int NormInstance::SelectShard() const
+{
+    // Least sessions (a heuristic snapshot, so no shard locking is needed)
+    unsigned int index = 0;
+    unsigned int minCount = session_count;
+    for (unsigned int i = 1; i < shard_count; i++)
+    {
+        if (shard_list[i - 1]->session_count < minCount)
+        {
+            index = i;
+            minCount = shard_list[i - 1]->session_count;
+        }
+    }
+    return index;
+}  // end NormInstance::SelectShard()
+
+bool NormInstance::SuspendShards()
+{
+    for (unsigned int i = 0; i < shard_count; i++)
+    {
+        if (!GetShard(i)->dispatcher.SuspendThread())
+        {
+            while (i > 0) GetShard(--i)->dispatcher.ResumeThread();
+            return false;
+        }
+    }
+    return true;
+}  // end NormInstance::SuspendShards()
+
+void NormInstance::ResumeShards()
+{
+    for (unsigned int i = shard_count; i > 0;)
+        GetShard(--i)->dispatcher.ResumeThread();
+}  // end NormInstance::ResumeShards()
+
+// Merges events from all shards, suspending each shard in turn while its
+// queue is serviced (the instance must NOT be suspended when this is called)
+unsigned int NormInstance::GetShardEvents(NormEvent* eventArray, unsigned int maxEvents, bool waitForEvent)
+{
+    while (true)
+    {
+        // The shared descriptor is reset _before_ the queues are checked so a
+        // shard posting an event meanwhile will signal it again
+        ResetNotificationDescriptor();
+        unsigned int count = 0;
+        bool pending = false;
+        bool invalid = false;
+        unsigned int start = shard_next;
+        for (unsigned int i = 0; i < shard_count; i++)
+        {
+            NormInstance* shard = GetShard((start + i) % shard_count);
+            if (!shard->dispatcher.SuspendThread()) continue;
+            shard->ReleasePreviousEvent();
+            Notification* next;
+            while ((count < maxEvents) && (NULL != (next = shard->DequeueNotification())))
+            {
+                if (NORM_EVENT_INVALID == next->event.type)
+                    invalid = true;  // only passed on if no other events are found
+                else
+                    eventArray[count++] = next->event;
+            }
+            if (!shard->notify_queue.IsEmpty()) pending = true;
+            shard->dispatcher.ResumeThread();
+        }
+        shard_next = (start + 1) % shard_count;  // rotate for fairness
+        if (pending) SignalNotification();
+        if ((0 == count) && invalid)
+        {
+            eventArray[0].type = NORM_EVENT_INVALID;
+            eventArray[0].session = NORM_SESSION_INVALID;
+            eventArray[0].sender = NORM_NODE_INVALID;
+            eventArray[0].object = NORM_OBJECT_INVALID;
+            count = 1;
+        }
+        if ((0 != count) || !waitForEvent) return count;
+        if (!WaitForEvent()) return 0;
+    }
+}  // end NormInstance::GetShardEvents()
+
+
 //////////////////////////////////////////////////////////////////////////
 // NORM API FUNCTION IMPLEMENTATIONS
 //
@@ -823,7 +1591,7 @@ bool NormSuspendInstance(NormInstanceHandle instanceHandle)
 {
     NormInstance* instance = (NormInstance*)instanceHandle;
     if (instance) 
-        return instance->dispatcher.SuspendThread();  // stops NORM protocol thread
+        return instance->SuspendShards();  // stops NORM protocol thread(s)
     else
         return false;
 }  // end NormSuspendInstance()
@@ -832,9 +1600,71 @@ NORM_API_LINKAGE
 void NormResumeInstance(NormInstanceHandle instanceHandle)
 {
     NormInstance* instance = (NormInstance*)instanceHandle;
-    if (instance) instance->dispatcher.ResumeThread();  
+    if (instance) instance->ResumeShards();  
 }  // end NormResumeInstance()
 
+NORM_API_LINKAGE
+bool NormSetShardCount(NormInstanceHandle instanceHandle, unsigned int shardCount)
+{
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    if (instance)
+        return instance->SetShardCount(shardCount);
+    else
+        return false;
+}  // end NormSetShardCount()
+
+NORM_API_LINKAGE
+unsigned int NormGetShardCount(NormInstanceHandle instanceHandle)
+{
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    return ((NULL != instance) ? instance->GetShardCount() : 0);
+}  // end NormGetShardCount()
+
+NORM_API_LINKAGE
+bool NormGetShardStats(NormInstanceHandle instanceHandle, 
+                       unsigned int       shardIndex, 
+                       NormShardStats*    shardStats)
+{
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    if ((NULL == instance) || (NULL == shardStats) || (shardIndex >= instance->GetShardCount()))
+        return false;
+    NormInstance* shard = instance->GetShard(shardIndex);
+    if (shard->dispatcher.SuspendThread())
+    {
+        shard->GetShardStats(*shardStats);
+        shard->dispatcher.ResumeThread();
+        return true;
+    }
+    return false;
+}  // end NormGetShardStats()
+
+NORM_API_LINKAGE
+bool NormSetMetricsExport(NormInstanceHandle instanceHandle,
+                          const char*        segmentName,
+                          double             interval)
+{
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    if (instance)
+        return instance->SetMetricsExport(segmentName, interval);
+    else
+        return false;
+}  // end NormSetMetricsExport()
+
+NORM_API_LINKAGE
+bool NormSetMessageTraceFile(NormInstanceHandle instanceHandle,
+                             const char*        traceFile)
+{
+#ifndef SIMULATE
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    if (instance)
+        return instance->SetTraceFile(traceFile);
+    else
+        return false;
+#else
+    return false;  // (no trace drain thread in simulation builds)
+#endif // if/else !SIMULATE
+}  // end NormSetMessageTraceFile()
+
 
 NORM_API_LINKAGE
 bool NormSetCacheDirectory(NormInstanceHandle instanceHandle, 
@@ -876,7 +1706,20 @@ bool NormGetNextEvent(NormInstanceHandle instanceHandle, NormEvent* theEvent, bo
 {
     NormInstance* instance = (NormInstance*)instanceHandle;
     bool result = false;
-    if (instance)
+    if (instance && (instance->GetShardCount() > 1))
+    {
+        NormEvent event;
+        result = (0 != instance->GetShardEvents(&event, 1, waitForEvent));
+        if (!result)
+        {
+            event.type = NORM_EVENT_INVALID;
+            event.session = NORM_SESSION_INVALID;
+            event.sender = NORM_NODE_INVALID;
+            event.object = NORM_OBJECT_INVALID;
+        }
+        if (NULL != theEvent) *theEvent = event;
+    }
+    else if (instance)
     {
         if (instance->dispatcher.SuspendThread())
         {
@@ -904,6 +1747,40 @@ bool NormGetNextEvent(NormInstanceHandle instanceHandle, NormEvent* theEvent, bo
     return result;  
 }  // end NormGetNextEvent()
 
+NORM_API_LINKAGE 
+unsigned int NormGetNextEvents(NormInstanceHandle instanceHandle, 
+                               NormEvent*         eventArray, 
+                               unsigned int       maxEvents,
+                               bool               waitForEvent)
+{
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    unsigned int count = 0;
+    if (instance && (NULL != eventArray) && (0 != maxEvents))
+    {
+        if (instance->GetShardCount() > 1)
+        {
+            count = instance->GetShardEvents(eventArray, maxEvents, waitForEvent);
+        }
+        else if (instance->dispatcher.SuspendThread())
+        {
+            if (waitForEvent)
+            {
+                if (instance->NotifyQueueIsEmpty()) 
+                {
+                    // no pending events, so resume and wait
+                    instance->dispatcher.ResumeThread();
+                    if (!instance->WaitForEvent()) return 0;
+                    // re-suspend thread after wait
+                    if (!instance->dispatcher.SuspendThread()) return 0;
+                }
+            }
+            count = instance->GetNextEvents(eventArray, maxEvents);
+            instance->dispatcher.ResumeThread();
+        }
+    }
+    return count;  
+}  // end NormGetNextEvents()
+
 
 NORM_API_LINKAGE
 bool NormIsUnicastAddress(const char* address)
@@ -923,18 +1800,38 @@ NormSessionHandle NormCreateSession(NormInstanceHandle instanceHandle,
                                     UINT16             sessionPort,
                                     NormNodeId         localNodeId)
 {
-    // (TBD) wrap this with SuspendThread/ResumeThread ???
     NormInstance* instance = (NormInstance*)instanceHandle;
-    if (instance && instance->dispatcher.SuspendThread())
+    if (NULL == instance) return NORM_SESSION_INVALID;
+    return NormCreateSessionOnShard(instanceHandle, sessionAddr, sessionPort, 
+                                    localNodeId, instance->SelectShard());
+}  // end NormCreateSession()
+
+NORM_API_LINKAGE
+NormSessionHandle NormCreateSessionOnShard(NormInstanceHandle instanceHandle,
+                                           const char*        sessionAddr,
+                                           UINT16             sessionPort,
+                                           NormNodeId         localNodeId,
+                                           unsigned int       shardIndex)
+{
+    NormInstance* instance = (NormInstance*)instanceHandle;
+    if (NULL == instance) return NORM_SESSION_INVALID;
+    if (shardIndex >= instance->GetShardCount())
+    {
+        PLOG(PL_ERROR, "NormCreateSessionOnShard() error: invalid shard index %u\n", shardIndex);
+        return NORM_SESSION_INVALID;
+    }
+    NormInstance* shard = instance->GetShard(shardIndex);
+    if (shard->dispatcher.SuspendThread())
     {
         NormSession* session = 
-            instance->session_mgr.NewSession(sessionAddr, sessionPort, localNodeId);
-        instance->dispatcher.ResumeThread();
+            shard->session_mgr.NewSession(sessionAddr, sessionPort, localNodeId);
+        if (NULL != session) shard->session_count++;
+        shard->dispatcher.ResumeThread();
         if (NULL != session) 
             return ((NormSessionHandle)session);
     }
     return NORM_SESSION_INVALID;
-}  // end NormCreateSession()
+}  // end NormCreateSessionOnShard()
 
 NORM_API_LINKAGE
 void NormDestroySession(NormSessionHandle sessionHandle)
@@ -948,6 +1845,7 @@ void NormDestroySession(NormSessionHandle sessionHandle)
             session->Close();
             session->GetSessionMgr().DeleteSession(session);
             instance->PurgeSessionNotifications(sessionHandle);
+            if (instance->session_count > 0) instance->session_count--;
         }
         instance->dispatcher.ResumeThread();
     }
@@ -956,10 +1854,18 @@ void NormDestroySession(NormSessionHandle sessionHandle)
 NORM_API_LINKAGE 
 NormInstanceHandle NormGetInstance(NormSessionHandle sessionHandle)
 {
-    
-    return (NormInstanceHandle)NormInstance::GetInstanceFromSession(sessionHandle);
+    // (returns the app-visible instance, not the session's shard)
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    return (NormInstanceHandle)((NULL != instance) ? instance->GetParent() : NULL);
 }  // end NormGetIntance()
 
+NORM_API_LINKAGE 
+unsigned int NormGetSessionShard(NormSessionHandle sessionHandle)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    return ((NULL != instance) ? instance->GetShardIndex() : 0);
+}  // end NormGetSessionShard()
+
 NORM_API_LINKAGE
 void NormSetUserData(NormSessionHandle sessionHandle, const void* userData)
 {
@@ -1304,6 +2210,43 @@ void NormSetRxPortReuse(NormSessionHandle sessionHandle,
 }  // end NormSetRxPortReuse()
 
 
+NORM_API_LINKAGE
+bool NormSetRxFanout(NormSessionHandle sessionHandle,
+                     unsigned int      memberIndex,
+                     unsigned int      memberCount)
+{
+    bool result = false;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (NULL != instance)
+    {
+        if (instance->dispatcher.SuspendThread())
+        {    
+            NormSession* session = (NormSession*)sessionHandle;
+            if (session) result = session->SetRxFanout(memberIndex, memberCount);
+            instance->dispatcher.ResumeThread();
+        }
+    } 
+    return result;
+}  // end NormSetRxFanout()
+
+NORM_API_LINKAGE
+bool NormSetRxTimestamping(NormSessionHandle sessionHandle,
+                           bool              enable)
+{
+    bool result = false;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (NULL != instance)
+    {
+        if (instance->dispatcher.SuspendThread())
+        {    
+            NormSession* session = (NormSession*)sessionHandle;
+            if (session) result = session->SetRxTimestamping(enable);
+            instance->dispatcher.ResumeThread();
+        }
+    } 
+    return result;
+}  // end NormSetRxTimestamping()
+
 NORM_API_LINKAGE
 void NormSetEcnSupport(NormSessionHandle sessionHandle, bool ecnEnable, bool ignoreLoss, bool tolerateLoss)
 {
@@ -1514,6 +2457,15 @@ unsigned int NormGetDebugLevel()
     return GetDebugLevel();
 }
 
+NORM_API_LINKAGE
+bool NormSetDebugAsync(bool state)
+{
+    if (state)
+        return NormDebugLogger::Instance().Start();
+    NormDebugLogger::Instance().Stop();
+    return true;
+}  // end NormSetDebugAsync()
+
 NORM_API_LINKAGE
 void NormSetReportInterval(NormSessionHandle sessionHandle, double interval)
 {
@@ -1542,6 +2494,98 @@ double NormGetReportInterval(NormSessionHandle sessionHandle)
     return result;
 }  // end NormGetReportInterval()
 
+// Note the stats getters only read the snapshot the NORM thread publishes
+// (see NormSession::OnStatsTimeout()) and never suspend it.  A caller built
+// against an older NORM_STATS_VERSION gets only that version's members (all
+// of the current members are version 1; members added for a later version
+// are filled in under an "if (stats->version >= N)" test).
+NORM_API_LINKAGE
+bool NormGetSessionStats(NormSessionHandle sessionHandle,
+                         NormSessionStats* stats)
+{
+    NormSession* session = (NormSession*)sessionHandle;
+    if ((NULL == session) || (NULL == stats) || 
+        (0 == stats->version) || (stats->version > NORM_STATS_VERSION))
+        return false;
+    NormSession::Stats snapshot;
+    session->GetStats(snapshot);
+    stats->bytesSent = snapshot.sent_bytes;
+    stats->packetsSent = snapshot.sent_packets;
+    stats->bytesReceived = snapshot.recv_bytes;
+    stats->packetsReceived = snapshot.recv_packets;
+    stats->repairsSent = snapshot.tx_repairs;
+    stats->nacksReceived = snapshot.nacks_received;
+    stats->nacksSent = snapshot.nacks_sent;
+    stats->nacksSuppressed = snapshot.nacks_suppressed;
+    stats->fecDecodes = snapshot.fec_decodes;
+    stats->bufferUsage = snapshot.buffer_usage;
+    stats->bufferPeak = snapshot.buffer_peak;
+    stats->bufferOverruns = snapshot.buffer_overruns;
+    stats->txRate = snapshot.tx_rate;
+    stats->grtt = snapshot.grtt;
+    stats->ccRtt = snapshot.cc_rtt;
+    stats->ccLoss = snapshot.cc_loss;
+    stats->timerLag = snapshot.timer_lag;
+    stats->timerLagMax = snapshot.timer_lag_max;
+    return true;
+}  // end NormGetSessionStats()
+
+NORM_API_LINKAGE
+unsigned long NormGetLatencyCount(NormSessionHandle sessionHandle,
+                                  NormLatencyType   latencyType)
+{
+    unsigned long count = 0;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if ((NULL != instance) && (latencyType < NORM_LATENCY_TYPE_COUNT) &&
+        instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        count = session->AccessLatencyHistogram((NormSession::LatencyType)latencyType).GetCount();
+        instance->dispatcher.ResumeThread();
+    }
+    return count;
+}  // end NormGetLatencyCount()
+
+NORM_API_LINKAGE
+double NormGetLatencyPercentile(NormSessionHandle sessionHandle,
+                                NormLatencyType   latencyType,
+                                double            percentile)
+{
+    double latency = -1.0;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if ((NULL != instance) && (latencyType < NORM_LATENCY_TYPE_COUNT) &&
+        instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        NormHistogram& histogram = session->AccessLatencyHistogram((NormSession::LatencyType)latencyType);
+        if (0 != histogram.GetCount())
+            latency = 1.0e-06 * (double)histogram.GetPercentile(percentile);
+        instance->dispatcher.ResumeThread();
+    }
+    return latency;
+}  // end NormGetLatencyPercentile()
+
+NORM_API_LINKAGE
+void NormResetLatency(NormSessionHandle sessionHandle,
+                      NormLatencyType   latencyType)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if ((NULL != instance) && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        if (NORM_LATENCY_TYPE_COUNT == latencyType)
+        {
+            for (unsigned int i = 0; i < NormSession::LATENCY_TYPE_COUNT; i++)
+                session->AccessLatencyHistogram((NormSession::LatencyType)i).Reset();
+        }
+        else if (latencyType < NORM_LATENCY_TYPE_COUNT)
+        {
+            session->AccessLatencyHistogram((NormSession::LatencyType)latencyType).Reset();
+        }
+        instance->dispatcher.ResumeThread();
+    }
+}  // end NormResetLatency()
+
 /** NORM Sender Functions */
 
 NORM_API_LINKAGE
@@ -1693,6 +2737,18 @@ void NormSetAutoParity(NormSessionHandle sessionHandle, unsigned char autoParity
     }
 }  // end NormSetAutoParity()
 
+NORM_API_LINKAGE
+void NormSetTxNackBatching(NormSessionHandle sessionHandle, bool state)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        if (session) session->SenderSetNackBatching(state);
+        instance->dispatcher.ResumeThread();
+    }
+}  // end NormSetTxNackBatching()
+
 NORM_API_LINKAGE
 void NormSetGrttEstimate(NormSessionHandle sessionHandle,
                          double            grttEstimate)
@@ -1899,6 +2955,14 @@ void NormStreamClose(NormObjectHandle streamHandle, bool graceful)
             NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
             if (instance && instance->dispatcher.SuspendThread())
             {
+                NormStreamRing* ring = stream->GetRing();
+                if (NULL != ring)
+                {
+                    instance->ServiceStreamRing(*stream, NormController::EVENT_INVALID);
+                    if (!ring->IsEmpty())
+                        PLOG(PL_WARN, "NormStreamClose() warning: closing with %u bytes still in stream ring\n",
+                                      ring->GetCount());
+                }
                 stream->Close(true);  // graceful stream closure
                 instance->dispatcher.ResumeThread();
             }  
@@ -1930,30 +2994,122 @@ unsigned int NormStreamWrite(NormObjectHandle   streamHandle,
     //       using  ProtoDispatcher::SuspendThread() should be sufficient since the underlying
     //       protolib time scheduling, etc. code actually invokes SignalThread() on an
     //       as-needed basis.  Thus, using SuspendThread() (lighter weight) should suffice
+    if (NORM_OBJECT_INVALID == streamHandle) return 0;
     unsigned int result = 0;
     NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
-    if ((NULL != instance) && instance->dispatcher.SuspendThread())
+    if (NULL == instance) return 0;
+    NormStreamObject* stream = 
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    NormStreamRing* ring = stream->GetRing();
+    if (NULL != ring)
+    {
+        // Lock-free path, the NORM thread drains the ring
+        result = instance->WriteStreamRing(*ring, buffer, numBytes);
+    }
+    else if (instance->dispatcher.SuspendThread())
     {
-        NormStreamObject* stream = 
-            static_cast<NormStreamObject*>((NormObject*)streamHandle);
         result = stream->Write(buffer, numBytes, false);
         instance->dispatcher.ResumeThread();
     }
     return result;
 }  // end NormStreamWrite()
 
+NORM_API_LINKAGE
+unsigned int NormStreamWritev(NormObjectHandle    streamHandle,
+                              const struct iovec* iov,
+                              unsigned int        iovCount,
+                              bool                eom)
+{
+    if (NORM_OBJECT_INVALID == streamHandle) return 0;
+    unsigned int result = 0;
+    NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
+    if (NULL == instance) return 0;
+    NormStreamObject* stream =
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    NormStreamRing* ring = stream->GetRing();
+    if (NULL != ring)
+    {
+        // Lock-free path (auto flushing is deferred by the ring drain)
+        bool complete = true;
+        for (unsigned int i = 0; i < iovCount; i++)
+        {
+            unsigned int len = (unsigned int)iov[i].iov_len;
+            if (0 == len)
+            {
+                if (!instance->MarkStreamRing(*ring, true, NormStreamObject::FLUSH_NONE))
+                {
+                    complete = false;
+                    break;
+                }
+                continue;
+            }
+            unsigned int count = instance->WriteStreamRing(*ring, (const char*)iov[i].iov_base, len);
+            result += count;
+            if (count < len)
+            {
+                complete = false;  // ring is full
+                break;
+            }
+        }
+        if (complete && eom)
+            instance->MarkStreamRing(*ring, true, NormStreamObject::FLUSH_NONE);
+    }
+    else if (instance->dispatcher.SuspendThread())
+    {
+        // Auto flushing is deferred until all fragments are copied so
+        // that fragments of a message share segments as they would if
+        // the application had assembled them into a single buffer
+        NormStreamObject::FlushMode saveFlushMode = stream->GetFlushMode();
+        stream->SetFlushMode(NormStreamObject::FLUSH_NONE);
+        bool complete = true;
+        for (unsigned int i = 0; i < iovCount; i++)
+        {
+            UINT32 len = (UINT32)iov[i].iov_len;
+            if (0 == len)
+            {
+                // Zero-length entry marks a message boundary
+                stream->Write(NULL, 0, true);
+                continue;
+            }
+            UINT32 count = stream->Write((const char*)iov[i].iov_base, len, false);
+            result += count;
+            if (count < len)
+            {
+                complete = false;  // stream buffer is full
+                break;
+            }
+        }
+        stream->SetFlushMode(saveFlushMode);
+        if (complete && (eom || (NormStreamObject::FLUSH_NONE != saveFlushMode)))
+            stream->Write(NULL, 0, eom);
+        instance->dispatcher.ResumeThread();
+    }
+    return result;
+}  // end NormStreamWritev()
+
 NORM_API_LINKAGE
 void NormStreamFlush(NormObjectHandle streamHandle, 
                      bool             eom,
                      NormFlushMode    flushMode)
 {
+    if (NORM_OBJECT_INVALID == streamHandle) return;
     NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
-    if ((NULL != instance) && instance->dispatcher.SuspendThread())
+    if (NULL == instance) return;
+    NormStreamObject* stream = 
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    NormStreamObject::FlushMode mode = (NormStreamObject::FlushMode)flushMode;
+    NormStreamRing* ring = stream->GetRing();
+    if (NULL != ring)
+    {
+        // Flush is applied by the NORM thread when the ring drains to here
+        // (NORM_FLUSH_NONE only marks any "eom" without flushing)
+        if ((NormStreamObject::FLUSH_NONE != mode) || eom)
+            instance->MarkStreamRing(*ring, eom, mode);
+    }
+    else if (instance->dispatcher.SuspendThread())
     {
-        NormStreamObject* stream = 
-            static_cast<NormStreamObject*>((NormObject*)streamHandle);
         NormStreamObject::FlushMode saveFlushMode = stream->GetFlushMode();
-        stream->SetFlushMode((NormStreamObject::FlushMode)flushMode);
+        stream->SetFlushMode(mode);
         stream->Flush(eom);
         stream->SetFlushMode(saveFlushMode);
         instance->dispatcher.ResumeThread();
@@ -1979,7 +3135,7 @@ void NormStreamSetPushEnable(NormObjectHandle streamHandle, bool state)
 }  // end NormStreamSetPushEnable()
 
 NORM_API_LINKAGE
-bool NormStreamHasVacancy(NormObjectHandle streamHandle)
+bool NormStreamSetRingSize(NormObjectHandle streamHandle, unsigned int ringSize)
 {
     bool result = false;
     NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
@@ -1987,6 +3143,25 @@ bool NormStreamHasVacancy(NormObjectHandle streamHandle)
     {
         NormStreamObject* stream = 
             static_cast<NormStreamObject*>((NormObject*)streamHandle);
+        result = instance->SetStreamRing(*stream, ringSize);
+        instance->dispatcher.ResumeThread();
+    }
+    return result;
+}  // end NormStreamSetRingSize()
+
+NORM_API_LINKAGE
+bool NormStreamHasVacancy(NormObjectHandle streamHandle)
+{
+    bool result = false;
+    NormStreamObject* stream = 
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    // (a receive ring's free space has nothing to do with sender vacancy)
+    NormStreamRing* ring = (NULL != stream) ? stream->GetRing() : NULL;
+    if ((NULL != ring) && ring->IsSender())
+        return (0 != ring->GetSpace());
+    NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
         if (NULL != stream)
             result = stream->HasVacancy();
         instance->dispatcher.ResumeThread();
@@ -1998,11 +3173,17 @@ NORM_API_LINKAGE
 unsigned int NormStreamGetVacancy(NormObjectHandle streamHandle, unsigned int bytesWanted)
 {
     bool result = false;
+    NormStreamObject* stream = 
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    NormStreamRing* ring = (NULL != stream) ? stream->GetRing() : NULL;
+    if ((NULL != ring) && ring->IsSender())
+    {
+        unsigned int space = ring->GetSpace();
+        return (((0 != bytesWanted) && (bytesWanted < space)) ? bytesWanted : space);
+    }
     NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
     if (instance && instance->dispatcher.SuspendThread())
     {
-        NormStreamObject* stream = 
-            static_cast<NormStreamObject*>((NormObject*)streamHandle);
         if (NULL != stream)
             result = stream->GetVacancy(bytesWanted);
         instance->dispatcher.ResumeThread();
@@ -2013,12 +3194,18 @@ unsigned int NormStreamGetVacancy(NormObjectHandle streamHandle, unsigned int by
 NORM_API_LINKAGE
 void NormStreamMarkEom(NormObjectHandle streamHandle)
 {
+    if (NORM_OBJECT_INVALID == streamHandle) return;
     NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
-    if (instance && instance->dispatcher.SuspendThread())
+    if (NULL == instance) return;
+    NormStreamObject* stream = 
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    if (NULL != stream->GetRing())
     {
-        NormStreamObject* stream = 
-            static_cast<NormStreamObject*>((NormObject*)streamHandle);
-        if (stream) stream->Write(NULL, 0, true);
+        instance->MarkStreamRing(*stream->GetRing(), true, NormStreamObject::FLUSH_NONE);
+    }
+    else if (instance->dispatcher.SuspendThread())
+    {
+        stream->Write(NULL, 0, true);
         instance->dispatcher.ResumeThread();
     }
 }  // end NormStreamMarkEom()
@@ -2266,6 +3453,23 @@ bool NormGetAckEx(NormSessionHandle sessionHandle,
     return false;
 }  // end NormGetAckEx()
 
+NORM_API_LINKAGE
+bool NormGetAckingAggregate(NormSessionHandle sessionHandle,
+                            NormNodeId        nodeId,
+                            unsigned int*     memberCount,
+                            unsigned int*     ackedCount)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        bool result = session->SenderGetAckingAggregate(nodeId, memberCount, ackedCount);
+        instance->dispatcher.ResumeThread();
+        return result;
+    }
+    return false;
+}  // end NormGetAckingAggregate()
+
 
 NORM_API_LINKAGE 
 bool NormSendCommand(NormSessionHandle  sessionHandle,
@@ -2433,6 +3637,104 @@ void NormNodeSetUnicastNack(NormNodeHandle   nodeHandle,
     }
 }  // end NormNodeSetUnicastNack()
 
+NORM_API_LINKAGE
+void NormSetLocalRepair(NormSessionHandle sessionHandle,
+                        bool              enable,
+                        unsigned char     ttl)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        session->ReceiverSetLocalRepair(enable, ttl);
+        instance->dispatcher.ResumeThread();
+    }
+}  // end NormSetLocalRepair()
+
+NORM_API_LINKAGE
+bool NormSetLocalRepairPeer(NormSessionHandle sessionHandle,
+                            const char*       peerAddress,
+                            UINT16            peerPort)
+{
+    ProtoAddress peerAddr;
+    if (NULL != peerAddress)
+    {
+        if (!peerAddr.ResolveFromString(peerAddress))
+        {
+            PLOG(PL_ERROR, "NormSetLocalRepairPeer() error: invalid peer address \"%s\"\n", peerAddress);
+            return false;
+        }
+        peerAddr.SetPort(peerPort);
+    }
+    bool result = false;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        session->ReceiverSetLocalRepairPeer(peerAddr);  // invalid address clears peer
+        result = true;
+        instance->dispatcher.ResumeThread();
+    }
+    return result;
+}  // end NormSetLocalRepairPeer()
+
+NORM_API_LINKAGE
+bool NormSetAckAggregator(NormSessionHandle sessionHandle,
+                          NormNodeId        aggregatorId,
+                          const char*       aggregatorAddress,
+                          UINT16            aggregatorPort)
+{
+    // (an invalid (NULL) address means ACKs are sent as usual for the aggregator to overhear)
+    ProtoAddress aggregatorAddr;
+    if ((NORM_NODE_NONE != aggregatorId) && (NULL != aggregatorAddress))
+    {
+        if (!aggregatorAddr.ResolveFromString(aggregatorAddress))
+        {
+            PLOG(PL_ERROR, "NormSetAckAggregator() error: invalid aggregator address \"%s\"\n", aggregatorAddress);
+            return false;
+        }
+        aggregatorAddr.SetPort(aggregatorPort);
+    }
+    bool result = false;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        session->ReceiverSetAckAggregator(aggregatorId, aggregatorAddr);
+        result = true;
+        instance->dispatcher.ResumeThread();
+    }
+    return result;
+}  // end NormSetAckAggregator()
+
+NORM_API_LINKAGE
+bool NormAddAggregateMember(NormSessionHandle sessionHandle,
+                            NormNodeId        memberId)
+{
+    bool result = false;
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        result = session->ReceiverAddAggregateMember(memberId);
+        instance->dispatcher.ResumeThread();
+    }
+    return result;
+}  // end NormAddAggregateMember()
+
+NORM_API_LINKAGE
+void NormRemoveAggregateMember(NormSessionHandle sessionHandle,
+                               NormNodeId        memberId)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromSession(sessionHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormSession* session = (NormSession*)sessionHandle;
+        session->ReceiverRemoveAggregateMember(memberId);
+        instance->dispatcher.ResumeThread();
+    }
+}  // end NormRemoveAggregateMember()
+
 NORM_API_LINKAGE 
 void NormSetDefaultSyncPolicy(NormSessionHandle sessionHandle,
                               NormSyncPolicy    syncPolicy)
@@ -2547,6 +3849,30 @@ NORM_API_LINKAGE
 bool NormStreamRead(NormObjectHandle   streamHandle,
                     char*              buffer,
                     unsigned int*      numBytes)
+{
+    bool result = false;
+    NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
+    if (NULL == instance) return false;
+    NormStreamObject* stream = 
+        static_cast<NormStreamObject*>((NormObject*)streamHandle);
+    NormStreamRing* ring = stream->GetRing();
+    if (NULL != ring)
+    {
+        // Lock-free path, the NORM thread fills the ring
+        result = instance->ReadStreamRing(*ring, buffer, numBytes);
+    }
+    else if (instance->dispatcher.SuspendThread())
+    {
+        result = stream->Read(buffer, numBytes);
+        instance->dispatcher.ResumeThread();
+    }
+    return result;
+}  // end NormStreamRead()
+
+NORM_API_LINKAGE
+bool NormStreamReadAcquire(NormObjectHandle streamHandle,
+                           struct iovec*    iov,
+                           unsigned int*    iovCount)
 {
     bool result = false;
     NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
@@ -2554,11 +3880,45 @@ bool NormStreamRead(NormObjectHandle   streamHandle,
     {
         NormStreamObject* stream = 
             static_cast<NormStreamObject*>((NormObject*)streamHandle);
-        result = stream->Read(buffer, numBytes);
+        const char* bufferArray[NORM_STREAM_LEASE_MAX];
+        unsigned int lengthArray[NORM_STREAM_LEASE_MAX];
+        unsigned int count = (*iovCount < NORM_STREAM_LEASE_MAX) ? *iovCount : NORM_STREAM_LEASE_MAX;
+        if (NULL != stream->GetRing())
+        {
+            PLOG(PL_ERROR, "NormStreamReadAcquire() error: stream has a ring (see NormStreamSetRingSize())\n");
+            count = 0;
+        }
+        else
+        {
+            result = stream->ReadAcquire(bufferArray, lengthArray, &count);
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            iov[i].iov_base = (void*)bufferArray[i];
+            iov[i].iov_len = lengthArray[i];
+        }
+        *iovCount = count;
         instance->dispatcher.ResumeThread();
     }
+    else
+    {
+        *iovCount = 0;
+    }
     return result;
-}  // end NormStreamRead()
+}  // end NormStreamReadAcquire()
+
+NORM_API_LINKAGE
+void NormStreamReadRelease(NormObjectHandle streamHandle)
+{
+    NormInstance* instance = NormInstance::GetInstanceFromObject(streamHandle);
+    if (instance && instance->dispatcher.SuspendThread())
+    {
+        NormStreamObject* stream = 
+            static_cast<NormStreamObject*>((NormObject*)streamHandle);
+        stream->ReadRelease();
+        instance->dispatcher.ResumeThread();
+    }
+}  // end NormStreamReadRelease()
 
 NORM_API_LINKAGE
 bool NormStreamSeekMsgStart(NormObjectHandle streamHandle)
@@ -2569,8 +3929,27 @@ bool NormStreamSeekMsgStart(NormObjectHandle streamHandle)
     {
         NormStreamObject* stream = 
             static_cast<NormStreamObject*>((NormObject*)streamHandle);
-        unsigned int numBytes = 0;
-        result = stream->Read(NULL, &numBytes, true);
+        NormStreamRing* ring = stream->GetRing();
+        if (NULL == ring)
+        {
+            unsigned int numBytes = 0;
+            result = stream->Read(NULL, &numBytes, true);
+        }
+        else if (ring->IsSeekSynced())
+        {
+            result = true;  // NORM thread already found message start for ring content
+        }
+        else
+        {
+            // Buffered ring content precedes the seek and is discarded, then
+            // the NORM thread seeks (now or upon update) before filling the ring
+            ring->Consume(ring->GetCount());
+            ring->ClearBroken();
+            ring->SetSeekPending();
+            instance->Notify(NormController::RX_OBJECT_UPDATED, &instance->session_mgr, 
+                             &stream->GetSession(), stream->GetSender(), stream);
+            result = !ring->SeekPending();
+        }
         instance->dispatcher.ResumeThread();
     }
     return result;
@@ -2582,9 +3961,15 @@ UINT32 NormStreamGetReadOffset(NormObjectHandle streamHandle)
 {
     NormStreamObject* stream = static_cast<NormStreamObject*>((NormObject*)streamHandle);
     if (stream)
-        return stream->GetCurrentReadOffset();
+    {
+        // (bytes still in a receive ring haven't been read by the app yet)
+        NormStreamRing* ring = stream->GetRing();
+        return (stream->GetCurrentReadOffset() - ((NULL != ring) ? ring->GetCount() : 0));
+    }
     else
+    {
         return 0;
+    }
 }  // end NormStreamGetReadOffset()
 
 NORM_API_LINKAGE 
@@ -2669,6 +4054,22 @@ NormSize NormObjectGetBytesPending(NormObjectHandle objectHandle)
     return bytesPending;
 }  // end NormObjectGetBytesPending()
 
+NORM_API_LINKAGE 
+bool NormObjectGetStats(NormObjectHandle objectHandle,
+                        NormObjectStats* stats)
+{
+    if ((NORM_OBJECT_INVALID == objectHandle) || (NULL == stats) || 
+        (0 == stats->version) || (stats->version > NORM_STATS_VERSION))
+        return false;
+    NormObject::Stats snapshot;
+    ((NormObject*)objectHandle)->GetStats(snapshot);
+    stats->packetsSent = snapshot.tx_packets;
+    stats->repairsSent = snapshot.tx_repairs;
+    stats->packetsReceived = snapshot.rx_packets;
+    stats->fecDecodes = snapshot.fec_decodes;
+    return true;
+}  // end NormObjectGetStats()
+
 NORM_API_LINKAGE
 void NormObjectCancel(NormObjectHandle objectHandle)
 {
@@ -2898,6 +4299,38 @@ double NormNodeGetGrtt(NormNodeHandle nodeHandle)
     }
 }  // end NormNodeGetGrtt()
 
+NORM_API_LINKAGE
+bool NormNodeGetStats(NormNodeHandle nodeHandle,
+                      NormNodeStats* stats)
+{
+    NormNode* node = (NormNode*)nodeHandle;
+    if ((NULL == node) || (NormNode::SENDER != node->GetType()) || 
+        (NULL == stats) || (0 == stats->version) || 
+        (stats->version > NORM_STATS_VERSION))
+        return false;
+    NormSenderNode::Stats snapshot;
+    static_cast<NormSenderNode*>(node)->GetStats(snapshot);
+    stats->bytesReceived = snapshot.recv_bytes;
+    stats->packetsReceived = snapshot.recv_packets;
+    stats->goodputBytes = snapshot.goodput_bytes;
+    stats->nacksSent = snapshot.nacks_sent;
+    stats->nacksSuppressed = snapshot.nacks_suppressed;
+    stats->fecDecodes = snapshot.fec_decodes;
+    stats->objectsCompleted = snapshot.objects_completed;
+    stats->objectsPending = snapshot.objects_pending;
+    stats->objectsFailed = snapshot.objects_failed;
+    stats->resyncs = snapshot.resyncs;
+    stats->bufferUsage = snapshot.buffer_usage;
+    stats->bufferPeak = snapshot.buffer_peak;
+    stats->bufferOverruns = snapshot.buffer_overruns;
+    stats->grtt = snapshot.grtt;
+    stats->ccRtt = snapshot.rtt;
+    stats->ccLoss = snapshot.loss;
+    stats->ccRate = snapshot.send_rate;
+    stats->rxRate = snapshot.recv_rate;
+    return true;
+}  // end NormNodeGetStats()
+
 NORM_API_LINKAGE
 bool NormNodeGetCommand(NormNodeHandle nodeHandle,
                         char*          cmdBuffer,
@@ -0,0 +1,682 @@
+// The "normBench" harness is an end-to-end benchmark of the NORM protocol
+// through the NORM API.  It runs one sender and N receiver sessions in a
+// single process (over loopback multicast by default or the interface
+// given) with optional transmit and receive loss applied by NormSetTxLoss()
+// and NormSetRxLoss().  The workload (data objects, files, or a stream of
+// messages) is run for each combination of the comma-separated rate,
+// segment size, block size, parity and congestion control lists given and
+// a CSV line of results is printed for each run:
+//
+//   goodput_mbps      - mean goodput per receiver (first enqueue to last delivery)
+//   cpu_sec_per_gb    - process CPU time (sender and all receivers) per GB delivered
+//   repair_overhead   - sender repair segments sent per source segment
+//   latency_p50/p99   - enqueue (or stream write) to receiver delivery (sec)
+//
+// usage: normBench [workload data|file|stream[,...]][receivers <count>]
+//                  [size <bytes>][count <objects>][rate <bps>[,...]]
+//                  [segment <bytes>[,...]][block <count>[,...]][parity <count>[,...]]
+//                  [cc on|off[,...]][txloss <percent>][rxloss <percent>]
+//                  [addr <addr>/<port>][interface <name>][buffer <bytes>]
+//                  [grtt <sec>][shards <count>][cache <dir>][timeout <sec>]
+//                  [repeat <count>][noheader][debug <level>]
+//
+// (For "stream", "size" is the message size and "count" the message count)
+
+#include "normApi.h"
+#include "normBenchUtil.h"  // for NormBenchCurrentTime(), NormBenchWaitForEvent()
+#include "normHistogram.h"  // for NormSortSamples(), NormSamplePercentile()
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), atof()
+#include <string.h>  // for strcmp(), strchr()
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>  // for getrusage()
+#endif // if/else WIN32
+
+enum Workload {WORKLOAD_DATA, WORKLOAD_FILE, WORKLOAD_STREAM};
+
+// A parsed comma-separated list of option values
+class ValueList
+{
+    public:
+        enum {VALUE_MAX = 16};
+
+        ValueList() : count(0) {}
+        bool Parse(const char* text);
+
+        double          value[VALUE_MAX];
+        unsigned int    count;
+};  // end class ValueList
+
+bool ValueList::Parse(const char* text)
+{
+    count = 0;
+    while ('\0' != *text)
+    {
+        if (VALUE_MAX == count) return false;
+        if (!strncmp(text, "on", 2))
+            value[count++] = 1.0;
+        else if (!strncmp(text, "off", 3))
+            value[count++] = 0.0;
+        else if (!strncmp(text, "data", 4))
+            value[count++] = WORKLOAD_DATA;
+        else if (!strncmp(text, "file", 4))
+            value[count++] = WORKLOAD_FILE;
+        else if (!strncmp(text, "stream", 6))
+            value[count++] = WORKLOAD_STREAM;
+        else if (1 != sscanf(text, "%lf", &value[count++]))
+            return false;
+        const char* next = strchr(text, ',');
+        if (NULL == next) break;
+        text = next + 1;
+    }
+    return (0 != count);
+}  // end ValueList::Parse()
+
+// Run parameters (one combination of the option lists)
+struct BenchConfig
+{
+    Workload        workload;
+    unsigned int    receiverCount;
+    unsigned int    size;
+    unsigned int    count;
+    double          rate;
+    unsigned int    segment;
+    unsigned int    block;
+    unsigned int    parity;
+    bool            cc;
+    double          txLoss;
+    double          rxLoss;
+    char            addr[64];
+    UINT16          port;
+    const char*     iface;
+    unsigned int    bufferSpace;
+    double          grtt;
+    unsigned int    shardCount;
+    const char*     cachePath;
+    double          timeout;
+};  // end struct BenchConfig
+
+// Process (user + system) CPU time (sec)
+static double CpuTime()
+{
+#ifdef WIN32
+    FILETIME createTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &createTime, &exitTime, &kernelTime, &userTime))
+        return 0.0;
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (1.0e-07 * (double)(kernel.QuadPart + user.QuadPart));
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage)) return 0.0;
+    return (usage.ru_utime.tv_sec + 1.0e-06*usage.ru_utime.tv_usec +
+            usage.ru_stime.tv_sec + 1.0e-06*usage.ru_stime.tv_usec);
+#endif // if/else WIN32
+}  // end CpuTime()
+
+static void EncodeIndex(char* buffer, UINT32 index)
+{
+    index = htonl(index);
+    memcpy(buffer, &index, 4);
+}  // end EncodeIndex()
+
+static UINT32 DecodeIndex(const char* buffer)
+{
+    UINT32 index;
+    memcpy(&index, buffer, 4);
+    return ntohl(index);
+}  // end DecodeIndex()
+
+class BenchReceiver
+{
+    public:
+        BenchReceiver();
+        ~BenchReceiver();
+
+        NormSessionHandle   session;
+        NormObjectHandle    rx_stream;
+        char*               msg_buffer;     // (stream workload)
+        unsigned int        msg_offset;
+        bool                msg_seek;       // resync to a message start
+        unsigned long       completed;
+        unsigned long       failed;
+        unsigned long long  bytes;
+};  // end class BenchReceiver
+
+BenchReceiver::BenchReceiver()
+ : session(NORM_SESSION_INVALID), rx_stream(NORM_OBJECT_INVALID),
+   msg_buffer(NULL), msg_offset(0), msg_seek(false), completed(0), failed(0), bytes(0)
+{
+}
+
+BenchReceiver::~BenchReceiver()
+{
+    if (NULL != msg_buffer) delete[] msg_buffer;
+}
+
+class BenchRun
+{
+    public:
+        BenchRun(const BenchConfig& theConfig);
+        ~BenchRun();
+
+        bool Setup();
+        bool Run();
+        void PrintResult(bool timedOut);
+
+    private:
+        void Send();
+        bool SendMessage();
+        void OnEvent(const NormEvent& theEvent);
+        void OnRxObjectCompleted(BenchReceiver& receiver, NormObjectHandle object);
+        void ReadStream(BenchReceiver& receiver);
+        void AddLatency(UINT32 index);
+        bool IsDone() const
+            {return (done_count == config.receiverCount);}
+
+        const BenchConfig&  config;
+        NormInstanceHandle  instance;
+        NormSessionHandle   tx_session;
+        BenchReceiver*      receiver_list;
+        char*               tx_buffer;
+        NormObjectHandle    tx_stream;
+        unsigned int        tx_index;       // next object/message to send
+        unsigned int        tx_offset;      // (stream message write offset)
+        double*             tx_time;        // enqueue time of each object/message
+        double*             latency_list;
+        unsigned long       latency_count;
+        unsigned int        done_count;     // receivers with all delivered
+        double              start_time;
+        double              end_time;
+        double              cpu_start;
+        double              cpu_end;
+        char                tx_file[PATH_MAX];
+};  // end class BenchRun
+
+BenchRun::BenchRun(const BenchConfig& theConfig)
+ : config(theConfig), instance(NORM_INSTANCE_INVALID),
+   tx_session(NORM_SESSION_INVALID), receiver_list(NULL), tx_buffer(NULL),
+   tx_stream(NORM_OBJECT_INVALID), tx_index(0), tx_offset(0), tx_time(NULL),
+   latency_list(NULL), latency_count(0), done_count(0),
+   start_time(0.0), end_time(0.0), cpu_start(0.0), cpu_end(0.0)
+{
+    tx_file[0] = '\0';
+}
+
+BenchRun::~BenchRun()
+{
+    // (destroying the instance destroys its sessions)
+    if (NORM_INSTANCE_INVALID != instance) NormDestroyInstance(instance);
+    if ('\0' != tx_file[0]) remove(tx_file);
+    if (NULL != receiver_list) delete[] receiver_list;
+    if (NULL != tx_buffer) delete[] tx_buffer;
+    if (NULL != tx_time) delete[] tx_time;
+    if (NULL != latency_list) delete[] latency_list;
+}
+
+bool BenchRun::Setup()
+{
+    tx_buffer = new char[config.size];
+    tx_time = new double[config.count];
+    latency_list = new double[config.count * config.receiverCount];
+    receiver_list = new BenchReceiver[config.receiverCount];
+    if ((NULL == tx_buffer) || (NULL == tx_time) ||
+        (NULL == latency_list) || (NULL == receiver_list))
+    {
+        perror("normBench new run state error");
+        return false;
+    }
+    for (unsigned int i = 0; i < config.size; i++)
+        tx_buffer[i] = (char)('a' + (i % 26));
+    if (WORKLOAD_FILE == config.workload)
+    {
+        // The same source file is enqueued "count" times
+        snprintf(tx_file, PATH_MAX, "%s%cnormBench.tx", config.cachePath, PROTO_PATH_DELIMITER);
+        FILE* filePtr = fopen(tx_file, "wb");
+        if (NULL == filePtr)
+        {
+            perror("normBench fopen() error");
+            tx_file[0] = '\0';
+            return false;
+        }
+        bool result = (1 == fwrite(tx_buffer, config.size, 1, filePtr));
+        fclose(filePtr);
+        if (!result)
+        {
+            perror("normBench fwrite() error");
+            return false;
+        }
+    }
+
+    if (NORM_INSTANCE_INVALID == (instance = NormCreateInstance()))
+    {
+        fprintf(stderr, "normBench error: unable to create NORM instance\n");
+        return false;
+    }
+    if ((config.shardCount > 1) && !NormSetShardCount(instance, config.shardCount))
+    {
+        fprintf(stderr, "normBench error: unable to set shard count\n");
+        return false;
+    }
+    if ((WORKLOAD_FILE == config.workload) && !NormSetCacheDirectory(instance, config.cachePath))
+    {
+        fprintf(stderr, "normBench error: unable to set cache directory\n");
+        return false;
+    }
+
+    // Receivers are nodes 1 through N and the sender is node N+1, all sharing
+    // the session port (receivers are created first so none miss the start)
+    for (unsigned int i = 0; i <= config.receiverCount; i++)
+    {
+        NormSessionHandle session = NormCreateSession(instance, config.addr, config.port, (NormNodeId)(i + 1));
+        if (NORM_SESSION_INVALID == session)
+        {
+            fprintf(stderr, "normBench error: unable to create session\n");
+            return false;
+        }
+        NormSetRxPortReuse(session, true);
+        NormSetMulticastLoopback(session, true);
+        if ((NULL != config.iface) && !NormSetMulticastInterface(session, config.iface))
+        {
+            fprintf(stderr, "normBench error: unable to set interface \"%s\"\n", config.iface);
+            return false;
+        }
+        NormSetGrttEstimate(session, config.grtt);
+        if (i < config.receiverCount)
+        {
+            BenchReceiver& receiver = receiver_list[i];
+            receiver.session = session;
+            NormSetUserData(session, &receiver);
+            NormSetRxLoss(session, config.rxLoss);
+            if (WORKLOAD_STREAM == config.workload)
+            {
+                if (NULL == (receiver.msg_buffer = new char[config.size]))
+                {
+                    perror("normBench new msg_buffer error");
+                    return false;
+                }
+            }
+            if (!NormStartReceiver(session, config.bufferSpace))
+            {
+                fprintf(stderr, "normBench error: unable to start receiver\n");
+                return false;
+            }
+        }
+        else
+        {
+            tx_session = session;
+            NormSetTxLoss(session, config.txLoss);
+            NormSetTxRate(session, config.rate);
+            if (config.cc) NormSetCongestionControl(session, true);
+            if (!NormStartSender(session, NormGetRandomSessionId(), config.bufferSpace,
+                                 config.segment, config.block, config.parity))
+            {
+                fprintf(stderr, "normBench error: unable to start sender\n");
+                return false;
+            }
+            if (WORKLOAD_STREAM == config.workload)
+            {
+                if (NORM_OBJECT_INVALID == (tx_stream = NormStreamOpen(session, config.bufferSpace)))
+                {
+                    fprintf(stderr, "normBench error: unable to open stream\n");
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}  // end BenchRun::Setup()
+
+// Enqueues objects (or writes messages) until the sender has no more room
+void BenchRun::Send()
+{
+    char info[4];
+    while (tx_index < config.count)
+    {
+        if (WORKLOAD_STREAM == config.workload)
+        {
+            if (!SendMessage()) break;
+            continue;
+        }
+        EncodeIndex(info, tx_index);
+        NormObjectHandle object;
+        if (WORKLOAD_FILE == config.workload)
+            object = NormFileEnqueue(tx_session, tx_file, info, 4);
+        else
+            object = NormDataEnqueue(tx_session, tx_buffer, config.size, info, 4);
+        if (NORM_OBJECT_INVALID == object) break;  // (until tx queue vacancy)
+        tx_time[tx_index++] = NormBenchCurrentTime();
+    }
+}  // end BenchRun::Send()
+
+// Writes (the rest of) the current stream message, returning false if the
+// stream filled up first
+bool BenchRun::SendMessage()
+{
+    if (0 == tx_offset) EncodeIndex(tx_buffer, tx_index);
+    tx_offset += NormStreamWrite(tx_stream, tx_buffer + tx_offset, config.size - tx_offset);
+    if (tx_offset < config.size) return false;
+    NormStreamMarkEom(tx_stream);
+    tx_time[tx_index++] = NormBenchCurrentTime();
+    tx_offset = 0;
+    if (tx_index == config.count)
+        NormStreamFlush(tx_stream, true, NORM_FLUSH_ACTIVE);
+    return true;
+}  // end BenchRun::SendMessage()
+
+void BenchRun::AddLatency(UINT32 index)
+{
+    if ((index >= tx_index) || (latency_count == (config.count * config.receiverCount)))
+        return;  // (not one of ours?)
+    latency_list[latency_count++] = NormBenchCurrentTime() - tx_time[index];
+}  // end BenchRun::AddLatency()
+
+void BenchRun::OnRxObjectCompleted(BenchReceiver& receiver, NormObjectHandle object)
+{
+    char info[4];
+    if (4 == NormObjectGetInfo(object, info, 4))
+        AddLatency(DecodeIndex(info));
+    receiver.bytes += (unsigned long long)NormObjectGetSize(object);
+    if (NORM_OBJECT_FILE == NormObjectGetType(object))
+    {
+        char fileName[PATH_MAX];
+        if (NormFileGetName(object, fileName, PATH_MAX)) remove(fileName);
+    }
+    if (++receiver.completed == config.count) done_count++;
+}  // end BenchRun::OnRxObjectCompleted()
+
+void BenchRun::ReadStream(BenchReceiver& receiver)
+{
+    while (true)
+    {
+        if (receiver.msg_seek)
+        {
+            if (!NormStreamSeekMsgStart(receiver.rx_stream)) break;
+            receiver.msg_seek = false;
+        }
+        unsigned int numBytes = config.size - receiver.msg_offset;
+        if (!NormStreamRead(receiver.rx_stream, receiver.msg_buffer + receiver.msg_offset, &numBytes))
+        {
+            // Stream broken, so skip to the next whole message
+            receiver.failed++;
+            receiver.msg_offset = 0;
+            receiver.msg_seek = true;
+            continue;
+        }
+        if (0 == numBytes) break;
+        receiver.msg_offset += numBytes;
+        if (receiver.msg_offset < config.size) continue;
+        AddLatency(DecodeIndex(receiver.msg_buffer));
+        receiver.bytes += config.size;
+        receiver.msg_offset = 0;
+        if (++receiver.completed == config.count) done_count++;
+    }
+}  // end BenchRun::ReadStream()
+
+void BenchRun::OnEvent(const NormEvent& theEvent)
+{
+    if (theEvent.session == tx_session)
+    {
+        switch (theEvent.type)
+        {
+            case NORM_TX_QUEUE_VACANCY:
+            case NORM_TX_QUEUE_EMPTY:
+                Send();
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+    BenchReceiver* receiver = (BenchReceiver*)NormGetUserData(theEvent.session);
+    if (NULL == receiver) return;
+    switch (theEvent.type)
+    {
+        case NORM_RX_OBJECT_NEW:
+            if (WORKLOAD_STREAM == config.workload)
+                receiver->rx_stream = theEvent.object;
+            break;
+        case NORM_RX_OBJECT_UPDATED:
+            if (theEvent.object == receiver->rx_stream)
+                ReadStream(*receiver);
+            break;
+        case NORM_RX_OBJECT_COMPLETED:
+            if (theEvent.object == receiver->rx_stream)
+                receiver->rx_stream = NORM_OBJECT_INVALID;
+            else
+                OnRxObjectCompleted(*receiver, theEvent.object);
+            break;
+        case NORM_RX_OBJECT_ABORTED:
+            if (theEvent.object == receiver->rx_stream)
+                receiver->rx_stream = NORM_OBJECT_INVALID;
+            receiver->failed++;
+            break;
+        default:
+            break;
+    }
+}  // end BenchRun::OnEvent()
+
+// Returns true if all receivers got all objects within the timeout
+// (call after a successful Setup())
+bool BenchRun::Run()
+{
+    cpu_start = CpuTime();
+    start_time = NormBenchCurrentTime();
+    Send();
+    double deadline = start_time + config.timeout;
+    while (!IsDone())
+    {
+        double currentTime = NormBenchCurrentTime();
+        if (currentTime >= deadline) break;
+        double waitTime = deadline - currentTime;
+        if (!NormBenchWaitForEvent(instance, (waitTime < 0.100) ? waitTime : 0.100)) continue;
+        NormEvent theEvent;
+        while (!IsDone() && NormGetNextEvent(instance, &theEvent, false))
+            OnEvent(theEvent);
+    }
+    end_time = NormBenchCurrentTime();
+    cpu_end = CpuTime();
+    return IsDone();
+}  // end BenchRun::Run()
+
+void BenchRun::PrintResult(bool timedOut)
+{
+    static const char* const WORKLOAD_NAME[] = {"data", "file", "stream"};
+    double elapsed = end_time - start_time;
+    unsigned long long totalBytes = 0;
+    unsigned long completed = 0;
+    unsigned long failed = 0;
+    if (NULL != receiver_list)
+    {
+        for (unsigned int i = 0; i < config.receiverCount; i++)
+        {
+            totalBytes += receiver_list[i].bytes;
+            completed += receiver_list[i].completed;
+            failed += receiver_list[i].failed;
+        }
+    }
+    double goodput = (elapsed > 0.0) ?
+        (8.0e-06 * (double)totalBytes / config.receiverCount / elapsed) : 0.0;
+    double cpuPerGb = (0 != totalBytes) ?
+        ((cpu_end - cpu_start) / (1.0e-09 * (double)totalBytes)) : -1.0;
+    // Repair overhead relative to the source segments of the workload
+    double repairOverhead = -1.0;
+    unsigned long nacksReceived = 0;
+    NormSessionStats stats;
+    stats.version = NORM_STATS_VERSION;
+    if ((NORM_SESSION_INVALID != tx_session) && NormGetSessionStats(tx_session, &stats))
+    {
+        double sourceSegments = (WORKLOAD_STREAM == config.workload) ?
+            (double)((((unsigned long long)config.size * config.count) + config.segment - 1) / config.segment) :
+            (double)config.count * ((config.size + config.segment - 1) / config.segment);
+        if (sourceSegments > 0.0)
+            repairOverhead = (double)stats.repairsSent / sourceSegments;
+        nacksReceived = stats.nacksReceived;
+    }
+    if (NULL != latency_list)
+        NormSortSamples(latency_list, latency_count);
+    printf("%s,%u,%u,%u,%.0f,%u,%u,%u,%s,%.3f,%.3f,%s,%.6f,%lu,%lu,%.3f,%.3f,%.4f,%lu,%.6f,%.6f\n",
+           WORKLOAD_NAME[config.workload], config.receiverCount, config.size, config.count,
+           config.rate, config.segment, config.block, config.parity, config.cc ? "on" : "off",
+           config.txLoss, config.rxLoss, timedOut ? "timeout" : "ok", elapsed, completed, failed,
+           goodput, cpuPerGb, repairOverhead, nacksReceived,
+           NormSamplePercentile(latency_list, latency_count, 50.0),
+           NormSamplePercentile(latency_list, latency_count, 99.0));
+    fflush(stdout);
+}  // end BenchRun::PrintResult()
+
+static void Usage()
+{
+    fprintf(stderr, "usage: normBench [workload data|file|stream[,...]][receivers <count>]\n"
+                    "                 [size <bytes>][count <objects>][rate <bps>[,...]]\n"
+                    "                 [segment <bytes>[,...]][block <count>[,...]][parity <count>[,...]]\n"
+                    "                 [cc on|off[,...]][txloss <percent>][rxloss <percent>]\n"
+                    "                 [addr <addr>/<port>][interface <name>][buffer <bytes>]\n"
+                    "                 [grtt <sec>][shards <count>][cache <dir>][timeout <sec>]\n"
+                    "                 [repeat <count>][noheader][debug <level>]\n");
+}  // end Usage()
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    memset(&config, 0, sizeof(BenchConfig));
+    config.receiverCount = 4;
+    config.size = 1000000;
+    config.count = 100;
+    config.txLoss = 0.0;
+    config.rxLoss = 0.0;
+    strcpy(config.addr, "224.1.2.3");
+    config.port = 6003;
+    config.iface = NULL;
+    config.bufferSpace = 4*1024*1024;
+    config.grtt = 0.010;
+    config.shardCount = 1;
+    config.cachePath = "/tmp";
+    config.timeout = 60.0;
+    unsigned int repeatCount = 1;
+    bool header = true;
+
+    ValueList workloadList, rateList, segmentList, blockList, parityList, ccList;
+    workloadList.Parse("data");
+    rateList.Parse("100e+06");
+    segmentList.Parse("1400");
+    blockList.Parse("64");
+    parityList.Parse("16");
+    ccList.Parse("off");
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* cmd = argv[i];
+        bool noArg = (!strcmp(cmd, "noheader"));
+        if (!noArg && (++i >= argc))
+        {
+            Usage();
+            return -1;
+        }
+        const char* val = noArg ? NULL : argv[i];
+        bool result = true;
+        if (!strcmp(cmd, "noheader"))
+            header = false;
+        else if (!strcmp(cmd, "workload"))
+            result = workloadList.Parse(val);
+        else if (!strcmp(cmd, "receivers"))
+            result = (0 != (config.receiverCount = atoi(val)));
+        else if (!strcmp(cmd, "size"))
+            result = (0 != (config.size = atoi(val)));
+        else if (!strcmp(cmd, "count"))
+            result = (0 != (config.count = atoi(val)));
+        else if (!strcmp(cmd, "rate"))
+            result = rateList.Parse(val);
+        else if (!strcmp(cmd, "segment"))
+            result = segmentList.Parse(val);
+        else if (!strcmp(cmd, "block"))
+            result = blockList.Parse(val);
+        else if (!strcmp(cmd, "parity"))
+            result = parityList.Parse(val);
+        else if (!strcmp(cmd, "cc"))
+            result = ccList.Parse(val);
+        else if (!strcmp(cmd, "txloss"))
+            config.txLoss = atof(val);
+        else if (!strcmp(cmd, "rxloss"))
+            config.rxLoss = atof(val);
+        else if (!strcmp(cmd, "addr"))
+        {
+            const char* ptr = strchr(val, '/');
+            unsigned int len = (NULL != ptr) ? (unsigned int)(ptr - val) : (unsigned int)strlen(val);
+            result = (len < 64);
+            if (result)
+            {
+                strncpy(config.addr, val, len);
+                config.addr[len] = '\0';
+                if (NULL != ptr) config.port = (UINT16)atoi(ptr + 1);
+            }
+        }
+        else if (!strcmp(cmd, "interface"))
+            config.iface = val;
+        else if (!strcmp(cmd, "buffer"))
+            result = (0 != (config.bufferSpace = atoi(val)));
+        else if (!strcmp(cmd, "grtt"))
+            result = ((config.grtt = atof(val)) > 0.0);
+        else if (!strcmp(cmd, "shards"))
+            result = (0 != (config.shardCount = atoi(val)));
+        else if (!strcmp(cmd, "cache"))
+            config.cachePath = val;
+        else if (!strcmp(cmd, "timeout"))
+            result = ((config.timeout = atof(val)) > 0.0);
+        else if (!strcmp(cmd, "repeat"))
+            result = (0 != (repeatCount = atoi(val)));
+        else if (!strcmp(cmd, "debug"))
+            NormSetDebugLevel(atoi(val));
+        else
+            result = false;
+        if (!result)
+        {
+            fprintf(stderr, "normBench error: invalid \"%s\" option\n", cmd);
+            Usage();
+            return -1;
+        }
+    }
+
+    if (header)
+        printf("workload,receivers,size,count,rate,segment,block,parity,cc,txloss,rxloss,"
+               "status,elapsed,completed,failed,goodput_mbps,cpu_sec_per_gb,"
+               "repair_overhead,nacks,latency_p50,latency_p99\n");
+
+    int exitCode = 0;
+    for (unsigned int w = 0; w < workloadList.count; w++)
+    for (unsigned int r = 0; r < rateList.count; r++)
+    for (unsigned int s = 0; s < segmentList.count; s++)
+    for (unsigned int b = 0; b < blockList.count; b++)
+    for (unsigned int p = 0; p < parityList.count; p++)
+    for (unsigned int c = 0; c < ccList.count; c++)
+    {
+        config.workload = (Workload)(int)workloadList.value[w];
+        config.rate = rateList.value[r];
+        config.segment = (unsigned int)segmentList.value[s];
+        config.block = (unsigned int)blockList.value[b];
+        config.parity = (unsigned int)parityList.value[p];
+        config.cc = (0.0 != ccList.value[c]);
+        if ((WORKLOAD_STREAM == config.workload) && (config.size < 4))
+        {
+            fprintf(stderr, "normBench error: stream message size must be at least 4 bytes\n");
+            return -1;
+        }
+        for (unsigned int n = 0; n < repeatCount; n++)
+        {
+            BenchRun run(config);
+            if (!run.Setup()) return -1;
+            bool result = run.Run();
+            run.PrintResult(!result);
+            if (!result) exitCode = 1;
+        }
+    }
+    return exitCode;
+}  // end main()
@@ -0,0 +1,390 @@
+// The "normBlockBench" program times the ring-indexed NormBlockBuffer and
+// NormObjectTable against the ProtoSortedTree indexing they replaced.
+// It models a sliding window: as each new block (object) is inserted,
+// the oldest is removed once the window is full and the window is
+// probed once per segment (as for arriving NORM_DATA).  Random lookups
+// and ordered iteration over the full window are timed separately.  The
+// block window is also run "sparse", with only every "stride"th block id
+// buffered (as for a large object with a few blocks pending repair).
+//
+// usage: normBlockBench [blocks <count>][window <count>][segments <count>]
+//                       [objects <count>][rounds <count>][stride <count>]
+//
+// The tree reference keeps the range bookkeeping the former tree-based
+// NormBlockBuffer::Remove() did (via the removed item's neighbors).
+
+#include "normSession.h"
+#include "normBenchUtil.h"  // for NormBenchElapsedUsec()
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>  // for rand(), atoi()
+#include <string.h>  // for strcmp()
+
+// Tree-indexed reference (ids are kept below any wraparound here)
+class TreeItem : public ProtoSortedTree::Item
+{
+    public:
+        TreeItem() : item_id(0) {}
+        void SetId(UINT32 id) {item_id = id;}
+        UINT32 GetId() const {return item_id;}
+
+    private:
+        const char* GetKey() const
+            {return ((const char*)&item_id);}
+        unsigned int GetKeysize() const
+            {return (8*sizeof(UINT32));}
+        ProtoTree::Endian GetEndian() const
+            {return ProtoTree::GetNativeEndian();}
+
+        UINT32  item_id;
+};  // end class TreeItem
+
+class TreeIndex
+{
+    public:
+        TreeIndex() : range(0), range_lo(0), range_hi(0) {}
+
+        TreeItem* Find(UINT32 id) const
+        {
+            if ((0 == range) || (id < range_lo) || (id > range_hi)) return NULL;
+            return tree.Find((const char*)&id, 8*sizeof(UINT32));
+        }
+        void Insert(TreeItem* item)
+        {
+            UINT32 id = item->GetId();
+            if (0 == range)
+                range_lo = range_hi = id;
+            else if (id < range_lo)
+                range_lo = id;
+            else if (id > range_hi)
+                range_hi = id;
+            range = range_hi - range_lo + 1;
+            tree.Insert(*item);
+        }
+        void Remove(TreeItem* item)
+        {
+            UINT32 id = item->GetId();
+            if (1 == range)
+            {
+                range = 0;
+            }
+            else if (id == range_lo)
+            {
+                const TreeItem* next = static_cast<const TreeItem*>(item->GetNext());
+                if (NULL == next) next = static_cast<const TreeItem*>(tree.GetHead());
+                range_lo = next->GetId();
+                range = range_hi - range_lo + 1;
+            }
+            else if (id == range_hi)
+            {
+                const TreeItem* prev = static_cast<const TreeItem*>(item->GetPrev());
+                if (NULL == prev) prev = static_cast<const TreeItem*>(tree.GetTail());
+                range_hi = prev->GetId();
+                range = range_hi - range_lo + 1;
+            }
+            tree.Remove(*item);
+        }
+        UINT32 RangeLo() const {return range_lo;}
+        unsigned int Iterate() const
+        {
+            unsigned int count = 0;
+            ProtoSortedTreeTemplate<TreeItem>::Iterator iterator(tree, false, (const char*)&range_lo, 8*sizeof(UINT32));
+            TreeItem* item;
+            while (NULL != (item = iterator.GetNextItem()))
+            {
+                if (item->GetId() > range_hi) break;
+                count++;
+            }
+            return count;
+        }
+
+    private:
+        ProtoSortedTreeTemplate<TreeItem>   tree;
+        UINT32                              range;
+        UINT32                              range_lo;
+        UINT32                              range_hi;
+};  // end class TreeIndex
+
+class BenchResult
+{
+    public:
+        BenchResult() : slide_time(0.0), find_time(0.0), iterate_time(0.0) {}
+        void Print(const char* name, unsigned int slideCount, 
+                   unsigned int findCount, unsigned int iterateCount) const
+        {
+            printf("   %-6s slide %8.1f nsec/step  find %6.1f nsec  iterate %6.1f nsec/item\n", name,
+                   1000.0 * slide_time / slideCount, 1000.0 * find_time / findCount,
+                   1000.0 * iterate_time / iterateCount);
+        }
+        double  slide_time;
+        double  find_time;
+        double  iterate_time;
+};  // end class BenchResult
+
+// In-window lookup offsets are precomputed so every index sees the same sequence
+static unsigned int* offset_list = NULL;
+static const unsigned int OFFSET_COUNT = 65536;
+
+static unsigned int GetOffset(unsigned int i, unsigned int span)
+    {return (offset_list[i % OFFSET_COUNT] % span);}
+
+// Sliding window over ring-indexed NormBlockBuffer with block ids spaced
+// by "stride" (returns found count)
+static unsigned int BenchBlockRing(BenchResult& result, NormBlock** blockList, unsigned int blockCount,
+                                   unsigned int windowSize, unsigned int segmentCount, unsigned int roundCount,
+                                   unsigned int stride)
+{
+    unsigned int foundCount = 0;
+    NormBlockBuffer blockBuffer;
+    if (!blockBuffer.Init(blockCount*stride, NormBlockBuffer::RING_SIZE_MAX, 0x00ffffff))
+    {
+        fprintf(stderr, "normBlockBench error: NormBlockBuffer init failure\n");
+        return 0;
+    }
+    struct timeval startTime;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < blockCount; i++)
+    {
+        NormBlock* block = blockList[i % windowSize];
+        if (i >= windowSize) blockBuffer.Remove(block);
+        NormBlockId blockId(i*stride);
+        block->SetId(blockId);
+        blockBuffer.Insert(block);
+        UINT32 lo = blockBuffer.RangeLo().GetValue() / stride;  // (oldest block index)
+        for (unsigned int j = 0; j < segmentCount; j++)
+        {
+            if (NULL != blockBuffer.Find(NormBlockId(stride*(lo + GetOffset(i + j, i - lo + 1)))))
+                foundCount++;
+        }
+    }
+    result.slide_time = NormBenchElapsedUsec(startTime);
+    UINT32 lo = blockBuffer.RangeLo().GetValue() / stride;
+    unsigned int findCount = roundCount * windowSize * segmentCount;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < findCount; i++)
+    {
+        if (NULL != blockBuffer.Find(NormBlockId(stride*(lo + GetOffset(i, windowSize)))))
+            foundCount++;
+    }
+    result.find_time = NormBenchElapsedUsec(startTime);
+    ProtoSystemTime(startTime);
+    for (unsigned int r = 0; r < roundCount; r++)
+    {
+        NormBlockBuffer::Iterator iterator(blockBuffer);
+        while (NULL != iterator.GetNextBlock()) foundCount++;
+    }
+    result.iterate_time = NormBenchElapsedUsec(startTime);
+    for (unsigned int i = 0; i < windowSize; i++)
+        blockBuffer.Remove(blockList[i]);
+    return foundCount;
+}  // end BenchBlockRing()
+
+// Sliding window over ring-indexed NormObjectTable (returns found count)
+static unsigned int BenchObjectRing(BenchResult& result, NormObject** objectList, unsigned int objectCount,
+                                    unsigned int windowSize, unsigned int segmentCount, unsigned int roundCount)
+{
+    unsigned int foundCount = 0;
+    NormObjectTable objectTable;
+    if (!objectTable.Init((UINT16)windowSize))
+    {
+        fprintf(stderr, "normBlockBench error: NormObjectTable init failure\n");
+        return 0;
+    }
+    struct timeval startTime;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        if (i >= windowSize) objectTable.Remove(objectList[i - windowSize]);
+        objectTable.Insert(objectList[i]);
+        UINT16 lo = (UINT16)objectTable.RangeLo();
+        for (unsigned int j = 0; j < segmentCount; j++)
+        {
+            if (NULL != objectTable.Find(NormObjectId((UINT16)(lo + GetOffset(i + j, i - lo + 1)))))
+                foundCount++;
+        }
+    }
+    result.slide_time = NormBenchElapsedUsec(startTime);
+    UINT16 lo = (UINT16)objectTable.RangeLo();
+    unsigned int findCount = roundCount * windowSize * segmentCount;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < findCount; i++)
+    {
+        if (NULL != objectTable.Find(NormObjectId((UINT16)(lo + GetOffset(i, windowSize)))))
+            foundCount++;
+    }
+    result.find_time = NormBenchElapsedUsec(startTime);
+    ProtoSystemTime(startTime);
+    for (unsigned int r = 0; r < roundCount; r++)
+    {
+        NormObjectTable::Iterator iterator(objectTable);
+        while (NULL != iterator.GetNextObject()) foundCount++;
+    }
+    result.iterate_time = NormBenchElapsedUsec(startTime);
+    for (unsigned int i = objectCount - windowSize; i < objectCount; i++)
+        objectTable.Remove(objectList[i]);
+    return foundCount;
+}  // end BenchObjectRing()
+
+// Sliding window over the tree reference with ids spaced by "stride"
+// (returns found count)
+static unsigned int BenchTree(BenchResult& result, TreeItem* itemList, unsigned int itemCount,
+                              unsigned int windowSize, unsigned int segmentCount, unsigned int roundCount,
+                              unsigned int stride)
+{
+    unsigned int foundCount = 0;
+    TreeIndex treeIndex;
+    struct timeval startTime;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < itemCount; i++)
+    {
+        TreeItem* item = itemList + (i % windowSize);
+        if (i >= windowSize) treeIndex.Remove(item);
+        item->SetId(i*stride);
+        treeIndex.Insert(item);
+        UINT32 lo = treeIndex.RangeLo() / stride;
+        for (unsigned int j = 0; j < segmentCount; j++)
+        {
+            if (NULL != treeIndex.Find(stride*(lo + GetOffset(i + j, i - lo + 1))))
+                foundCount++;
+        }
+    }
+    result.slide_time = NormBenchElapsedUsec(startTime);
+    UINT32 lo = treeIndex.RangeLo() / stride;
+    unsigned int findCount = roundCount * windowSize * segmentCount;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < findCount; i++)
+    {
+        if (NULL != treeIndex.Find(stride*(lo + GetOffset(i, windowSize))))
+            foundCount++;
+    }
+    result.find_time = NormBenchElapsedUsec(startTime);
+    ProtoSystemTime(startTime);
+    for (unsigned int r = 0; r < roundCount; r++)
+        foundCount += treeIndex.Iterate();
+    result.iterate_time = NormBenchElapsedUsec(startTime);
+    for (unsigned int i = 0; i < windowSize; i++)
+        treeIndex.Remove(itemList + i);
+    return foundCount;
+}  // end BenchTree()
+
+int main(int argc, char* argv[])
+{
+    unsigned int blockCount = 1000000;
+    unsigned int windowSize = 256;
+    unsigned int segmentCount = 16;
+    unsigned int objectCount = 30000;
+    unsigned int roundCount = 100;
+    unsigned int stride = 64;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "blocks") && (++i < argc))
+            blockCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "window") && (++i < argc))
+            windowSize = atoi(argv[i]);
+        else if (!strcmp(argv[i], "segments") && (++i < argc))
+            segmentCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "objects") && (++i < argc))
+            objectCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "rounds") && (++i < argc))
+            roundCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "stride") && (++i < argc))
+            stride = atoi(argv[i]);
+        else
+        {
+            fprintf(stderr, "usage: normBlockBench [blocks <count>][window <count>][segments <count>]\n"
+                            "                      [objects <count>][rounds <count>][stride <count>]\n");
+            return -1;
+        }
+    }
+    if ((0 == windowSize) || (0 == segmentCount) || (0 == roundCount) || 
+        (windowSize > 0x7fff) || (blockCount < windowSize) || 
+        (objectCount < windowSize) || (objectCount > 0xffff) ||
+        (0 == stride) || ((blockCount / stride) < windowSize))
+    {
+        fprintf(stderr, "normBlockBench error: invalid parameters\n");
+        return -1;
+    }
+
+    offset_list = new unsigned int[OFFSET_COUNT];
+    NormBlock** blockList = new NormBlock*[windowSize];
+    TreeItem* itemList = new TreeItem[windowSize];
+    NormObject** objectList = new NormObject*[objectCount];
+    if ((NULL == offset_list) || (NULL == blockList) || (NULL == itemList) || (NULL == objectList))
+    {
+        perror("normBlockBench new error");
+        return -1;
+    }
+    srand(1);
+    for (unsigned int i = 0; i < OFFSET_COUNT; i++)
+        offset_list[i] = rand();
+    for (unsigned int i = 0; i < windowSize; i++)
+    {
+        if (NULL == (blockList[i] = new NormBlock()))
+        {
+            perror("normBlockBench new NormBlock error");
+            return -1;
+        }
+    }
+    // Objects need a session as their owner (it is never opened)
+    ProtoDispatcher dispatcher;
+    NormSessionMgr sessionMgr(dispatcher, dispatcher, &dispatcher);
+    NormSession* session = sessionMgr.NewSession("127.0.0.1", 6003, 1);
+    if (NULL == session)
+    {
+        fprintf(stderr, "normBlockBench error: unable to create session\n");
+        return -1;
+    }
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        if (NULL == (objectList[i] = new NormDataObject(*session, NULL, NormObjectId((UINT16)i), NULL)))
+        {
+            perror("normBlockBench new NormDataObject error");
+            return -1;
+        }
+    }
+
+    unsigned int findCount = roundCount * windowSize * segmentCount;
+    unsigned int iterateCount = roundCount * windowSize;
+    BenchResult ringResult, treeResult;
+    
+    unsigned int ringCount = BenchBlockRing(ringResult, blockList, blockCount, windowSize, segmentCount, roundCount, 1);
+    unsigned int treeCount = BenchTree(treeResult, itemList, blockCount, windowSize, segmentCount, roundCount, 1);
+    if (ringCount != treeCount)
+        fprintf(stderr, "normBlockBench warning: block index results differ?!\n");
+    printf("normBlockBench: %u blocks, window %u, %u probes/step, %u rounds\n",
+           blockCount, windowSize, segmentCount, roundCount);
+    ringResult.Print("ring:", blockCount, findCount, iterateCount);
+    treeResult.Print("tree:", blockCount, findCount, iterateCount);
+    
+    // (the sparse window spans "stride" times as many ids as blocks)
+    unsigned int sparseCount = blockCount / stride;
+    ringCount = BenchBlockRing(ringResult, blockList, sparseCount, windowSize, segmentCount, roundCount, stride);
+    treeCount = BenchTree(treeResult, itemList, sparseCount, windowSize, segmentCount, roundCount, stride);
+    if (ringCount != treeCount)
+        fprintf(stderr, "normBlockBench warning: sparse block index results differ?!\n");
+    printf("normBlockBench: %u sparse blocks (stride %u), window %u, %u probes/step, %u rounds\n",
+           sparseCount, stride, windowSize, segmentCount, roundCount);
+    ringResult.Print("ring:", sparseCount, findCount, iterateCount);
+    treeResult.Print("tree:", sparseCount, findCount, iterateCount);
+    
+    ringCount = BenchObjectRing(ringResult, objectList, objectCount, windowSize, segmentCount, roundCount);
+    treeCount = BenchTree(treeResult, itemList, objectCount, windowSize, segmentCount, roundCount, 1);
+    if (ringCount != treeCount)
+        fprintf(stderr, "normBlockBench warning: object index results differ?!\n");
+    printf("normBlockBench: %u objects, window %u, %u probes/step, %u rounds\n",
+           objectCount, windowSize, segmentCount, roundCount);
+    ringResult.Print("ring:", objectCount, findCount, iterateCount);
+    treeResult.Print("tree:", objectCount, findCount, iterateCount);
+
+    for (unsigned int i = 0; i < objectCount; i++)
+        objectList[i]->Release();
+    delete[] objectList;
+    sessionMgr.DeleteSession(session);
+    for (unsigned int i = 0; i < windowSize; i++)
+        delete blockList[i];
+    delete[] blockList;
+    delete[] itemList;
+    delete[] offset_list;
+    return 0;
+}  // end main()
@@ -0,0 +1,355 @@
+#include "normDebug.h"
+
+#include <stdio.h>   // for vsnprintf(), snprintf()
+#include <string.h>  // for strlen(), memcpy()
+
+void NormLog(ProtoDebugLevel level, const char* format, ...)
+{
+    va_list args;
+    NormDebugLogger& logger = NormDebugLogger::Instance();
+    if (logger.IsRunning())
+    {
+        va_start(args, format);
+        bool queued = logger.Post(level, format, args);
+        va_end(args);
+        if (queued) return;
+    }
+    // Not deferred, so format and log it now
+    char text[NormDebugLogger::LOG_LINE_MAX];
+    va_start(args, format);
+    vsnprintf(text, NormDebugLogger::LOG_LINE_MAX, format, args);
+    va_end(args);
+    PLOG(level, "%s", text);
+}  // end NormLog()
+
+NormDebugLogger::NormDebugLogger()
+ : record_list(NULL), enqueue_pos(0), dequeue_pos(0),
+   drop_count(0), drop_logged(0), running(0)
+{
+#ifndef SIMULATE
+    drain_timer.SetListener(this, &NormDebugLogger::OnDrainTimeout);
+    drain_timer.SetInterval(0.010);
+    drain_timer.SetRepeat(-1);
+#endif // !SIMULATE
+}
+
+NormDebugLogger::~NormDebugLogger()
+{
+    Stop();
+    if (NULL != record_list)
+    {
+        delete[] record_list;
+        record_list = NULL;
+    }
+}
+
+NormDebugLogger& NormDebugLogger::Instance()
+{
+    static NormDebugLogger logger;
+    return logger;
+}  // end NormDebugLogger::Instance()
+
+bool NormDebugLogger::Start(double drainInterval)
+{
+#ifdef SIMULATE
+    PLOG(PL_ERROR, "NormDebugLogger::Start() error: not supported in simulation\n");
+    return false;
+#else
+    if (IsRunning()) return true;
+    // (the ring is kept after Stop() in case a producer is still posting)
+    if (NULL == record_list)
+    {
+        if (NULL == (record_list = new Record[RECORD_COUNT]))
+        {
+            PLOG(PL_FATAL, "NormDebugLogger::Start() new record_list error: %s\n", GetErrorString());
+            return false;
+        }
+        for (UINT32 i = 0; i < RECORD_COUNT; i++)
+            record_list[i].sequence = i;
+        enqueue_pos = dequeue_pos = 0;
+    }
+    drain_timer.SetInterval(drainInterval);
+    dispatcher.ActivateTimer(drain_timer);
+    if (!dispatcher.StartThread())
+    {
+        PLOG(PL_ERROR, "NormDebugLogger::Start() error starting drain thread\n");
+        drain_timer.Deactivate();
+        return false;
+    }
+    NORM_ATOMIC_STORE(running, 1);
+    return true;
+#endif // if/else SIMULATE
+}  // end NormDebugLogger::Start()
+
+void NormDebugLogger::Stop()
+{
+#ifndef SIMULATE
+    if (!IsRunning()) return;
+    NORM_ATOMIC_STORE(running, 0);
+    dispatcher.Stop();
+    if (drain_timer.IsActive()) drain_timer.Deactivate();
+    Drain();  // (remaining messages)
+#endif // !SIMULATE
+}  // end NormDebugLogger::Stop()
+
+const char* NormDebugLogger::ParseConversion(const char* ptr, ArgType& argType)
+{
+    ptr++;  // skip '%'
+    if ('%' == *ptr)
+    {
+        argType = ARG_NONE;
+        return (ptr + 1);
+    }
+    // flags, width, and precision ('*' isn't supported)
+    while ((NULL != strchr("-+ #0", *ptr)) && ('\0' != *ptr)) ptr++;
+    while ((*ptr >= '0') && (*ptr <= '9')) ptr++;
+    if ('.' == *ptr)
+    {
+        ptr++;
+        while ((*ptr >= '0') && (*ptr <= '9')) ptr++;
+    }
+    // length modifier
+    int longCount = 0;
+    bool sizeArg = false;
+    bool longDouble = false;
+    while (true)
+    {
+        if ('h' == *ptr)
+            ptr++;  // (promoted to int)
+        else if ('l' == *ptr)
+            longCount++, ptr++;
+        else if (('z' == *ptr) || ('t' == *ptr))
+            sizeArg = true, ptr++;
+        else if ('j' == *ptr)
+            longCount = 2, ptr++;
+        else if ('L' == *ptr)
+            longDouble = true, ptr++;
+        else
+            break;
+    }
+    switch (*ptr)
+    {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (sizeArg)
+                argType = ARG_SIZE;
+            else if (longCount > 1)
+                argType = ARG_LONG_LONG;
+            else if (1 == longCount)
+                argType = ARG_LONG;
+            else
+                argType = ARG_INT;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            argType = longDouble ? ARG_INVALID : ARG_DOUBLE;
+            break;
+        case 's':
+            argType = (0 != longCount) ? ARG_INVALID : ARG_STRING;
+            break;
+        case 'p':
+            argType = ARG_POINTER;
+            break;
+        default:  // ('*', "%n", wide chars, etc)
+            argType = ARG_INVALID;
+            return ptr;
+    }
+    return (ptr + 1);
+}  // end NormDebugLogger::ParseConversion()
+
+bool NormDebugLogger::Post(ProtoDebugLevel level, const char* format, va_list args)
+{
+    // Claim a slot: a slot is free for the producer at position "pos" when
+    // its sequence equals "pos" and is ready for the consumer at "pos + 1"
+    Record* record;
+    UINT32 pos = NORM_ATOMIC_LOAD(enqueue_pos);
+    while (true)
+    {
+        record = record_list + (pos & (RECORD_COUNT - 1));
+        INT32 delta = (INT32)(NORM_ATOMIC_LOAD(record->sequence) - pos);
+        if (0 == delta)
+        {
+            if (NORM_ATOMIC_CAS(enqueue_pos, pos, pos + 1)) break;
+            pos = NORM_ATOMIC_LOAD(enqueue_pos);
+        }
+        else if (delta < 0)
+        {
+            NORM_ATOMIC_ADD(drop_count, 1);  // ring is full
+            return true;  // (dropped, not logged)
+        }
+        else
+        {
+            pos = NORM_ATOMIC_LOAD(enqueue_pos);
+        }
+    }
+    // Copy the raw arguments (and strings) into the claimed slot
+    record->level = (UINT8)level;
+    record->format = format;
+    record->arg_count = 0;
+    record->text_len = 0;
+    bool valid = true;
+    const char* ptr = format;
+    while (NULL != (ptr = strchr(ptr, '%')))
+    {
+        ArgType argType;
+        ptr = ParseConversion(ptr, argType);
+        if (ARG_NONE == argType) continue;
+        if ((ARG_INVALID == argType) || (ARG_MAX == record->arg_count))
+        {
+            valid = false;
+            break;
+        }
+        Arg& arg = record->arg[record->arg_count++];
+        switch (argType)
+        {
+            case ARG_INT:
+                arg.i = va_arg(args, int);
+                break;
+            case ARG_LONG:
+                arg.i = va_arg(args, long);
+                break;
+            case ARG_LONG_LONG:
+                arg.i = va_arg(args, long long);
+                break;
+            case ARG_SIZE:
+                arg.i = (long long)va_arg(args, size_t);
+                break;
+            case ARG_DOUBLE:
+                arg.d = va_arg(args, double);
+                break;
+            case ARG_POINTER:
+                arg.p = va_arg(args, void*);
+                break;
+            case ARG_STRING:
+            {
+                const char* string = va_arg(args, const char*);
+                if (NULL == string) string = "(null)";
+                // (strings are truncated to fit the remaining "text" space)
+                unsigned int space = TEXT_MAX - record->text_len;
+                if (0 == space)
+                {
+                    valid = false;
+                    break;
+                }
+                unsigned int length = (unsigned int)strlen(string);
+                if (length >= space) length = space - 1;
+                arg.offset = record->text_len;
+                memcpy(record->text + record->text_len, string, length);
+                record->text[record->text_len + length] = '\0';
+                record->text_len += length + 1;
+                break;
+            }
+            default:
+                break;
+        }
+        if (!valid) break;
+    }
+    if (!valid) record->format = NULL;  // (consumer skips it)
+    NORM_ATOMIC_STORE(record->sequence, pos + 1);  // hand slot to consumer
+    return valid;
+}  // end NormDebugLogger::Post()
+
+#ifndef SIMULATE
+bool NormDebugLogger::OnDrainTimeout(ProtoTimer& /*theTimer*/)
+{
+    Drain();
+    return true;
+}  // end NormDebugLogger::OnDrainTimeout()
+#endif // !SIMULATE
+
+void NormDebugLogger::Drain()
+{
+    if (NULL == record_list) return;
+    while (true)
+    {
+        Record& record = record_list[dequeue_pos & (RECORD_COUNT - 1)];
+        if ((dequeue_pos + 1) != NORM_ATOMIC_LOAD(record.sequence)) break;
+        if (NULL != record.format) Output(record);
+        NORM_ATOMIC_STORE(record.sequence, dequeue_pos + RECORD_COUNT);  // free slot
+        dequeue_pos++;
+    }
+    UINT32 dropCount = NORM_ATOMIC_LOAD(drop_count);
+    if (dropCount != drop_logged)
+    {
+        PLOG(PL_WARN, "NormDebugLogger::Drain() warning: %lu debug messages dropped\n",
+             (unsigned long)(dropCount - drop_logged));
+        drop_logged = dropCount;
+    }
+}  // end NormDebugLogger::Drain()
+
+void NormDebugLogger::Output(const Record& record)
+{
+    // Format each conversion with its argument in turn
+    char text[LOG_LINE_MAX];
+    unsigned int len = 0;
+    unsigned int index = 0;
+    const char* ptr = record.format;
+    while (('\0' != *ptr) && (len < (LOG_LINE_MAX - 1)))
+    {
+        if ('%' != *ptr)
+        {
+            text[len++] = *ptr++;
+            continue;
+        }
+        ArgType argType;
+        const char* end = ParseConversion(ptr, argType);
+        char spec[32];
+        unsigned int specLen = (unsigned int)(end - ptr);
+        if (specLen >= 32) break;  // (not a spec we would have queued)
+        memcpy(spec, ptr, specLen);
+        spec[specLen] = '\0';
+        ptr = end;
+        char* buf = text + len;
+        size_t space = LOG_LINE_MAX - len;
+        int result = 0;
+        if (ARG_NONE == argType)
+        {
+            result = snprintf(buf, space, "%%");
+        }
+        else
+        {
+            const Arg& arg = record.arg[index++];
+            switch (argType)
+            {
+                case ARG_INT:
+                    result = snprintf(buf, space, spec, (int)arg.i);
+                    break;
+                case ARG_LONG:
+                    result = snprintf(buf, space, spec, (long)arg.i);
+                    break;
+                case ARG_LONG_LONG:
+                    result = snprintf(buf, space, spec, arg.i);
+                    break;
+                case ARG_SIZE:
+                    result = snprintf(buf, space, spec, (size_t)arg.i);
+                    break;
+                case ARG_DOUBLE:
+                    result = snprintf(buf, space, spec, arg.d);
+                    break;
+                case ARG_POINTER:
+                    result = snprintf(buf, space, spec, arg.p);
+                    break;
+                case ARG_STRING:
+                    result = snprintf(buf, space, spec, record.text + arg.offset);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (result < 0) break;
+        len += ((size_t)result < space) ? result : (unsigned int)(space - 1);
+    }
+    text[len] = '\0';
+    PLOG((ProtoDebugLevel)record.level, "%s", text);
+}  // end NormDebugLogger::Output()
@@ -0,0 +1,59 @@
+#include "normHistogram.h"
+
+#include <string.h>  // for memset()
+
+NormHistogram::NormHistogram()
+{
+    Reset();
+}
+
+void NormHistogram::Reset()
+{
+    memset(counts, 0, sizeof(counts));
+    total_count = 0;
+    total_sum = 0;
+    min_value = 0xffffffff;
+    max_value = 0;
+}  // end NormHistogram::Reset()
+
+void NormHistogram::RecordInterval(const struct timeval& startTime,
+                                   const struct timeval& endTime)
+{
+    double usec = 1.0e+06 * (double)(endTime.tv_sec - startTime.tv_sec) +
+                  (double)((long)endTime.tv_usec - (long)startTime.tv_usec);
+    // (clock steps may give a negative interval)
+    if (usec < 0.0)
+        usec = 0.0;
+    else if (usec > 4294967295.0)
+        usec = 4294967295.0;
+    Record((UINT32)usec);
+}  // end NormHistogram::RecordInterval()
+
+UINT32 NormHistogram::GetHighestEquivalent(unsigned int index)
+{
+    if (index < (2 * SUB_COUNT)) return index;
+    unsigned int shift = (index / SUB_COUNT) - 1;
+    UINT32 low = (UINT32)(index - (SUB_COUNT * shift)) << shift;
+    return (low + (((UINT32)1 << shift) - 1));
+}  // end NormHistogram::GetHighestEquivalent()
+
+UINT32 NormHistogram::GetPercentile(double percent) const
+{
+    if (0 == total_count) return 0;
+    if (percent <= 0.0) return min_value;
+    if (percent >= 100.0) return max_value;
+    // The value of the sample with rank ceil(count * percent / 100)
+    unsigned long target = (unsigned long)((percent / 100.0) * (double)total_count + 0.999999);
+    if (0 == target) target = 1;
+    unsigned long sum = 0;
+    for (unsigned int i = 0; i < BUCKET_COUNT; i++)
+    {
+        sum += counts[i];
+        if (sum >= target)
+        {
+            UINT32 value = GetHighestEquivalent(i);
+            return ((value < max_value) ? value : max_value);
+        }
+    }
+    return max_value;
+}  // end NormHistogram::GetPercentile()
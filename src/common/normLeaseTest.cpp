@@ -0,0 +1,216 @@
+// The "normLeaseTest" program checks that zero-copy leased stream reads
+// (NormStreamReadAcquire()) don't interfere with FEC decoding.  A sender
+// and receiver session run in one instance over loopback multicast with
+// sender transmit loss and proactive parity so most coding blocks are
+// completed by erasure decoding.  The receiver holds its lease across
+// further packet reception (releasing it after several slices), so
+// segments of blocks still awaiting parity are leased while those blocks
+// are decoded.  The received stream content is verified and
+// the test fails if the stream stalls, is corrupted or no blocks were
+// FEC decoded.
+//
+// usage: normLeaseTest [size <bytes>][loss <percent>][timeout <sec>][debug <level>]
+
+#include "normApi.h"
+#include "normBenchUtil.h"  // for NormBenchCurrentTime(), NormBenchWaitForEvent()
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>  // for atoi(), atof()
+#include <string.h>  // for strcmp()
+
+// (stream byte content is a function of its offset)
+static char PatternByte(unsigned long offset)
+{
+    return (char)(offset % 251);
+}  // end PatternByte()
+
+// (the sender block size below is 16, which is also the stream's lease limit)
+#define LEASE_HOLD 8
+
+int main(int argc, char* argv[])
+{
+    unsigned long streamSize = 4000000;
+    double loss = 10.0;
+    double timeout = 60.0;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((i + 1) >= argc)
+        {
+            fprintf(stderr, "usage: normLeaseTest [size <bytes>][loss <percent>][timeout <sec>][debug <level>]\n");
+            return -1;
+        }
+        const char* cmd = argv[i++];
+        if (!strcmp(cmd, "size"))
+            streamSize = atoi(argv[i]);
+        else if (!strcmp(cmd, "loss"))
+            loss = atof(argv[i]);
+        else if (!strcmp(cmd, "timeout"))
+            timeout = atof(argv[i]);
+        else if (!strcmp(cmd, "debug"))
+            NormSetDebugLevel(atoi(argv[i]));
+        else
+        {
+            fprintf(stderr, "usage: normLeaseTest [size <bytes>][loss <percent>][timeout <sec>][debug <level>]\n");
+            return -1;
+        }
+    }
+
+    NormInstanceHandle instance = NormCreateInstance();
+    NormSessionHandle rxSession = NormCreateSession(instance, "224.1.2.3", 6007, 1);
+    NormSessionHandle txSession = NormCreateSession(instance, "224.1.2.3", 6007, 2);
+    if ((NORM_SESSION_INVALID == rxSession) || (NORM_SESSION_INVALID == txSession))
+    {
+        fprintf(stderr, "normLeaseTest error: unable to create sessions\n");
+        NormDestroyInstance(instance);
+        return -1;
+    }
+    NormSetRxPortReuse(rxSession, true);
+    NormSetRxPortReuse(txSession, true);
+    NormSetMulticastLoopback(rxSession, true);
+    NormSetMulticastLoopback(txSession, true);
+    NormSetGrttEstimate(txSession, 0.010);
+    NormSetTxRate(txSession, 20.0e+06);
+    // Lost source segments are mostly recovered from the proactive parity
+    NormSetTxLoss(txSession, loss);
+    NormSetAutoParity(txSession, 4);
+    if (!NormStartReceiver(rxSession, 4*1024*1024) ||
+        !NormStartSender(txSession, 1, 4*1024*1024, 1024, 16, 8))
+    {
+        fprintf(stderr, "normLeaseTest error: unable to start sender/receiver\n");
+        NormDestroyInstance(instance);
+        return -1;
+    }
+    NormObjectHandle txStream = NormStreamOpen(txSession, 1024*1024);
+    if (NORM_OBJECT_INVALID == txStream)
+    {
+        fprintf(stderr, "normLeaseTest error: unable to open tx stream\n");
+        NormDestroyInstance(instance);
+        return -1;
+    }
+
+    char txBuffer[4096];
+    unsigned long txOffset = 0;
+    unsigned long rxOffset = 0;
+    unsigned long leaseMax = 0;
+    NormObjectHandle rxStream = NORM_OBJECT_INVALID;
+    unsigned int leaseCount = 0;  // slices held
+    bool failed = false;
+    bool completed = false;
+    double startTime = NormBenchCurrentTime();
+    while (!failed && !completed)
+    {
+        if ((NormBenchCurrentTime() - startTime) > timeout)
+        {
+            fprintf(stderr, "normLeaseTest error: timeout (received %lu of %lu bytes)\n", rxOffset, streamSize);
+            failed = true;
+            break;
+        }
+        if (!NormBenchWaitForEvent(instance, 0.100)) continue;
+        NormEvent event;
+        if (!NormGetNextEvent(instance, &event, false)) continue;
+        switch (event.type)
+        {
+            case NORM_TX_QUEUE_VACANCY:
+            case NORM_TX_QUEUE_EMPTY:
+                while (txOffset < streamSize)
+                {
+                    unsigned int count = (unsigned int)(streamSize - txOffset);
+                    if (count > 4096) count = 4096;
+                    for (unsigned int i = 0; i < count; i++)
+                        txBuffer[i] = PatternByte(txOffset + i);
+                    unsigned int written = NormStreamWrite(txStream, txBuffer, count);
+                    txOffset += written;
+                    if (written < count) break;
+                    if (txOffset == streamSize)
+                    {
+                        NormStreamFlush(txStream, true);
+                        NormStreamClose(txStream, true);
+                    }
+                }
+                break;
+
+            case NORM_RX_OBJECT_NEW:
+                rxStream = event.object;
+                break;
+
+            case NORM_RX_OBJECT_UPDATED:
+            {
+                if (event.object != rxStream) break;
+                while (!failed)
+                {
+                    // Up to LEASE_HOLD slices are held before the lease is
+                    // released (fewer than the stream's lease limit so an
+                    // empty acquire always means no more data is ready and
+                    // the next update notification is armed)
+                    if (leaseCount >= LEASE_HOLD)
+                    {
+                        NormStreamReadRelease(rxStream);
+                        leaseCount = 0;
+                    }
+                    struct iovec iov;
+                    unsigned int iovCount = 1;
+                    if (!NormStreamReadAcquire(rxStream, &iov, &iovCount))
+                    {
+                        fprintf(stderr, "normLeaseTest error: stream broken at offset %lu\n", rxOffset);
+                        failed = true;
+                        break;
+                    }
+                    // (an empty acquire returns to the event loop with the lease
+                    //  held while further packets, including parity, are received)
+                    if (0 == iovCount) break;
+                    leaseCount++;
+                    if (leaseCount > leaseMax) leaseMax = leaseCount;
+                    const char* ptr = (const char*)iov.iov_base;
+                    for (unsigned long j = 0; j < (unsigned long)iov.iov_len; j++)
+                    {
+                        if (PatternByte(rxOffset + j) != ptr[j])
+                        {
+                            fprintf(stderr, "normLeaseTest error: content mismatch at offset %lu\n",
+                                    rxOffset + j);
+                            failed = true;
+                            break;
+                        }
+                    }
+                    rxOffset += (unsigned long)iov.iov_len;
+                }
+                break;
+            }
+
+            case NORM_RX_OBJECT_COMPLETED:
+                if (event.object == rxStream) completed = true;
+                break;
+
+            case NORM_RX_OBJECT_ABORTED:
+                if (event.object == rxStream)
+                {
+                    fprintf(stderr, "normLeaseTest error: rx stream aborted\n");
+                    failed = true;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+    if (0 != leaseCount) NormStreamReadRelease(rxStream);
+
+    NormSessionStats stats;
+    memset(&stats, 0, sizeof(NormSessionStats));
+    stats.version = NORM_STATS_VERSION;
+    NormGetSessionStats(rxSession, &stats);
+    if (!failed && (rxOffset != streamSize))
+    {
+        fprintf(stderr, "normLeaseTest error: received %lu of %lu bytes\n", rxOffset, streamSize);
+        failed = true;
+    }
+    if (!failed && (0 == stats.fecDecodes))
+    {
+        fprintf(stderr, "normLeaseTest error: no blocks were FEC decoded (loss too low?)\n");
+        failed = true;
+    }
+    printf("normLeaseTest %s: %lu bytes, %lu FEC decodes, max lease %lu slices, %.3f sec\n",
+           failed ? "FAILED" : "passed", rxOffset, stats.fecDecodes, leaseMax, NormBenchCurrentTime() - startTime);
+    NormDestroyInstance(instance);
+    return (failed ? 1 : 0);
+}  // end main()
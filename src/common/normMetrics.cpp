@@ -0,0 +1,298 @@
+#include "normMetrics.h"
+#include "normSession.h"
+
+// (Android's bionic libc has no POSIX shared memory)
+#if !defined(WIN32) && !defined(ANDROID)
+#define NORM_METRICS_SHM
+#include <sys/mman.h>  // for shm_open(), mmap()
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>    // for ftruncate(), getpid()
+#endif // !WIN32 && !ANDROID
+
+NormMetrics::NormMetrics()
+ : is_owner(false), segment_size(0), header(NULL),
+   session_slot(NULL), sender_slot(NULL),
+   session_used(NULL), sender_used(NULL)
+{
+    segment_name[0] = '\0';
+}
+
+NormMetrics::~NormMetrics()
+{
+    Close();
+}
+
+bool NormMetrics::Create(const char* segmentName, unsigned int shardCount, double interval)
+{
+    Close();
+    if (0 == shardCount) shardCount = 1;
+    session_used = new unsigned int[shardCount];
+    sender_used = new unsigned int[shardCount];
+    if ((NULL == session_used) || (NULL == sender_used))
+    {
+        PLOG(PL_FATAL, "NormMetrics::Create() new used count arrays error: %s\n", GetErrorString());
+        Close();
+        return false;
+    }
+    memset(session_used, 0, shardCount * sizeof(unsigned int));
+    memset(sender_used, 0, shardCount * sizeof(unsigned int));
+    size_t size = sizeof(Header) +
+                  shardCount * SHARD_SESSION_MAX * sizeof(SessionSlot) +
+                  shardCount * SHARD_SENDER_MAX * sizeof(SenderSlot);
+    if (!Map(segmentName, true, size))
+    {
+        Close();
+        return false;
+    }
+    is_owner = true;
+    // (the new segment is zero-filled, so all slots are unused)
+    header->version = NORM_METRICS_VERSION;
+    header->header_size = sizeof(Header);
+    header->session_size = sizeof(SessionSlot);
+    header->sender_size = sizeof(SenderSlot);
+#ifdef NORM_METRICS_SHM
+    header->process_id = (UINT32)getpid();
+#endif // NORM_METRICS_SHM
+    header->shard_count = shardCount;
+    header->session_max = shardCount * SHARD_SESSION_MAX;
+    header->sender_max = shardCount * SHARD_SENDER_MAX;
+    header->interval_msec = (UINT32)(1000.0 * interval + 0.5);
+    session_slot = (SessionSlot*)(header + 1);
+    sender_slot = (SenderSlot*)(session_slot + header->session_max);
+    // Readers validate "magic" last
+    NORM_ATOMIC_STORE(header->magic, (UINT32)NORM_METRICS_MAGIC);
+    return true;
+}  // end NormMetrics::Create()
+
+bool NormMetrics::Open(const char* segmentName)
+{
+    Close();
+    if (!Map(segmentName, false, 0)) return false;
+    if ((segment_size < sizeof(Header)) ||
+        (NORM_METRICS_MAGIC != NORM_ATOMIC_LOAD(header->magic)) ||
+        (NORM_METRICS_VERSION != header->version) ||
+        (sizeof(Header) != header->header_size) ||
+        (sizeof(SessionSlot) != header->session_size) ||
+        (sizeof(SenderSlot) != header->sender_size) ||
+        (segment_size < (sizeof(Header) + header->session_max * sizeof(SessionSlot) +
+                                          header->sender_max * sizeof(SenderSlot))))
+    {
+        PLOG(PL_ERROR, "NormMetrics::Open() error: segment \"%s\" has incompatible layout\n", segmentName);
+        Close();
+        return false;
+    }
+    session_slot = (SessionSlot*)(header + 1);
+    sender_slot = (SenderSlot*)(session_slot + header->session_max);
+    return true;
+}  // end NormMetrics::Open()
+
+bool NormMetrics::Map(const char* segmentName, bool create, size_t size)
+{
+#ifndef NORM_METRICS_SHM
+    PLOG(PL_ERROR, "NormMetrics::Map() error: shared memory metrics not supported on this platform\n");
+    return false;
+#else
+    // (POSIX shared memory object names start with a '/')
+    if ('/' == segmentName[0]) segmentName++;
+    size_t length = strlen(segmentName);
+    if ((0 == length) || (length > (sizeof(segment_name) - 2)) || (NULL != strchr(segmentName, '/')))
+    {
+        PLOG(PL_ERROR, "NormMetrics::Map() error: invalid segment name\n");
+        return false;
+    }
+    segment_name[0] = '/';
+    strcpy(segment_name + 1, segmentName);
+    int fd;
+    if (create)
+    {
+        shm_unlink(segment_name);  // (remove any stale segment of this name)
+        fd = shm_open(segment_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if ((fd >= 0) && (0 != ftruncate(fd, size)))
+        {
+            PLOG(PL_ERROR, "NormMetrics::Map() ftruncate() error: %s\n", GetErrorString());
+            close(fd);
+            shm_unlink(segment_name);
+            fd = -1;
+        }
+    }
+    else
+    {
+        fd = shm_open(segment_name, O_RDONLY, 0);
+        struct stat info;
+        if ((fd >= 0) && (0 != fstat(fd, &info)))
+        {
+            close(fd);
+            fd = -1;
+        }
+        size = (fd >= 0) ? (size_t)info.st_size : 0;
+        if ((fd >= 0) && (size < sizeof(Header)))
+        {
+            PLOG(PL_ERROR, "NormMetrics::Map() error: segment \"%s\" is too small\n", segment_name);
+            close(fd);
+            return false;
+        }
+    }
+    if (fd < 0)
+    {
+        PLOG(PL_ERROR, "NormMetrics::Map() shm_open(%s) error: %s\n", segment_name, GetErrorString());
+        segment_name[0] = '\0';
+        return false;
+    }
+    void* addr = mmap(NULL, size, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // (the mapping remains valid)
+    if (MAP_FAILED == addr)
+    {
+        PLOG(PL_ERROR, "NormMetrics::Map() mmap() error: %s\n", GetErrorString());
+        if (create) shm_unlink(segment_name);
+        segment_name[0] = '\0';
+        return false;
+    }
+    header = (Header*)addr;
+    segment_size = size;
+    return true;
+#endif // if/else !NORM_METRICS_SHM
+}  // end NormMetrics::Map()
+
+void NormMetrics::Close()
+{
+#ifdef NORM_METRICS_SHM
+    if (NULL != header)
+    {
+        munmap((void*)header, segment_size);
+        if (is_owner) shm_unlink(segment_name);
+    }
+#endif // NORM_METRICS_SHM
+    header = NULL;
+    session_slot = NULL;
+    sender_slot = NULL;
+    segment_size = 0;
+    segment_name[0] = '\0';
+    is_owner = false;
+    if (NULL != session_used)
+    {
+        delete[] session_used;
+        session_used = NULL;
+    }
+    if (NULL != sender_used)
+    {
+        delete[] sender_used;
+        sender_used = NULL;
+    }
+}  // end NormMetrics::Close()
+
+static void NormMetricsAddressString(const ProtoAddress& addr, char* buffer, unsigned int buflen)
+{
+    char host[NormMetrics::ADDR_STRING_MAX];
+    host[0] = '\0';
+    if (addr.IsValid()) addr.GetHostString(host, NormMetrics::ADDR_STRING_MAX);
+    snprintf(buffer, buflen, "%s/%hu", host, addr.GetPort());
+}  // end NormMetricsAddressString()
+
+void NormMetrics::Publish(unsigned int shardIndex, NormSessionMgr& sessionMgr)
+{
+    if (!is_owner || (shardIndex >= header->shard_count)) return;
+    struct timeval currentTime;
+    ProtoSystemTime(currentTime);
+    double updateTime = (double)currentTime.tv_sec + 1.0e-06 * (double)currentTime.tv_usec;
+    unsigned int sessionBase = shardIndex * SHARD_SESSION_MAX;
+    unsigned int senderBase = shardIndex * SHARD_SENDER_MAX;
+    unsigned int sessionCount = 0;
+    unsigned int senderCount = 0;
+    NormSession* session = sessionMgr.GetTopSession();
+    while ((NULL != session) && (sessionCount < SHARD_SESSION_MAX))
+    {
+        NormSession::Stats stats;
+        session->UpdateStats();  // (this is the session's NORM thread)
+        session->GetStats(stats);
+        SessionSlot& slot = session_slot[sessionBase + sessionCount];
+        SessionEntry& entry = slot.BeginUpdate();
+        entry.in_use = 1;
+        entry.flags = (session->IsSender() ? SESSION_SENDER : 0) |
+                      (session->IsReceiver() ? SESSION_RECEIVER : 0);
+        entry.local_id = (UINT32)session->LocalNodeId();
+        entry.shard = shardIndex;
+        entry.sender_count = session->GetSenderTree().GetCount();
+        NormMetricsAddressString(session->Address(), entry.address, ADDR_STRING_MAX);
+        entry.update_time = updateTime;
+        entry.sent_bytes = stats.sent_bytes;
+        entry.sent_packets = stats.sent_packets;
+        entry.recv_bytes = stats.recv_bytes;
+        entry.recv_packets = stats.recv_packets;
+        entry.tx_repairs = stats.tx_repairs;
+        entry.nacks_received = stats.nacks_received;
+        entry.nacks_sent = stats.nacks_sent;
+        entry.nacks_suppressed = stats.nacks_suppressed;
+        entry.fec_decodes = stats.fec_decodes;
+        entry.buffer_usage = stats.buffer_usage;
+        entry.buffer_peak = stats.buffer_peak;
+        entry.buffer_overruns = stats.buffer_overruns;
+        entry.tx_rate = stats.tx_rate;
+        entry.grtt = stats.grtt;
+        entry.cc_rtt = stats.cc_rtt;
+        entry.cc_loss = stats.cc_loss;
+        entry.timer_lag = stats.timer_lag;
+        entry.timer_lag_max = stats.timer_lag_max;
+        slot.EndUpdate();
+
+        NormNodeTreeIterator iterator(session->GetSenderTree());
+        NormNode* node;
+        while ((senderCount < SHARD_SENDER_MAX) && (NULL != (node = iterator.GetNextNode())))
+        {
+            NormSenderNode* sender = static_cast<NormSenderNode*>(node);
+            NormSenderNode::Stats nodeStats;
+            sender->UpdateStats();
+            sender->GetStats(nodeStats);
+            SenderSlot& senderSlot = sender_slot[senderBase + senderCount];
+            SenderEntry& senderEntry = senderSlot.BeginUpdate();
+            senderEntry.in_use = 1;
+            senderEntry.session = sessionBase + sessionCount;
+            senderEntry.node_id = (UINT32)node->GetId();
+            NormMetricsAddressString(node->GetAddress(), senderEntry.address, ADDR_STRING_MAX);
+            senderEntry.update_time = updateTime;
+            senderEntry.recv_bytes = nodeStats.recv_bytes;
+            senderEntry.recv_packets = nodeStats.recv_packets;
+            senderEntry.goodput_bytes = nodeStats.goodput_bytes;
+            senderEntry.nacks_sent = nodeStats.nacks_sent;
+            senderEntry.nacks_suppressed = nodeStats.nacks_suppressed;
+            senderEntry.fec_decodes = nodeStats.fec_decodes;
+            senderEntry.objects_completed = nodeStats.objects_completed;
+            senderEntry.objects_pending = nodeStats.objects_pending;
+            senderEntry.objects_failed = nodeStats.objects_failed;
+            senderEntry.resyncs = nodeStats.resyncs;
+            senderEntry.buffer_usage = nodeStats.buffer_usage;
+            senderEntry.buffer_peak = nodeStats.buffer_peak;
+            senderEntry.buffer_overruns = nodeStats.buffer_overruns;
+            senderEntry.stream_usage = sender->CurrentStreamBufferUsage();
+            senderEntry.stream_peak = sender->PeakStreamBufferUsage();
+            senderEntry.stream_overruns = sender->StreamBufferOverunCount();
+            senderEntry.grtt = nodeStats.grtt;
+            senderEntry.rtt = nodeStats.rtt;
+            senderEntry.loss = nodeStats.loss;
+            senderEntry.send_rate = nodeStats.send_rate;
+            senderEntry.recv_rate = nodeStats.recv_rate;
+            senderSlot.EndUpdate();
+            senderCount++;
+        }
+        sessionCount++;
+        session = session->GetNext();
+    }
+    if (NULL != session)
+        PLOG(PL_DEBUG, "NormMetrics::Publish() shard %u has more than %u sessions\n", shardIndex, SHARD_SESSION_MAX);
+
+    // Release slots no longer in use
+    for (unsigned int i = sessionCount; i < session_used[shardIndex]; i++)
+    {
+        SessionSlot& slot = session_slot[sessionBase + i];
+        slot.BeginUpdate().in_use = 0;
+        slot.EndUpdate();
+    }
+    session_used[shardIndex] = sessionCount;
+    for (unsigned int i = senderCount; i < sender_used[shardIndex]; i++)
+    {
+        SenderSlot& slot = sender_slot[senderBase + i];
+        slot.BeginUpdate().in_use = 0;
+        slot.EndUpdate();
+    }
+    sender_used[shardIndex] = senderCount;
+}  // end NormMetrics::Publish()
@@ -1,5 +1,6 @@
 #include "normNode.h"
 #include "normSession.h"
+#include "normDebug.h"  // for NLOG()
 
 #include "normEncoderMDP.h"
 #include "normEncoderRS8.h"  // 8-bit Reed-Solomon encoder of RFC 5510
@@ -7,7 +8,7 @@
 
 NormNode::NormNode(Type nodeType, class NormSession& theSession, NormNodeId nodeId)
  : session(theSession), node_type(nodeType), id(nodeId), reference_count(1), user_data(NULL),
-   parent(NULL), right(NULL), left(NULL)
+   right(NULL), left(NULL)
 {
 }
 
@@ -41,9 +42,12 @@ NormNode::Accumulator::Accumulator()
 
 
 NormCCNode::NormCCNode(class NormSession& theSession, NormNodeId nodeId)
- : NormNode(CC_NODE, theSession, nodeId)
+ : NormNode(CC_NODE, theSession, nodeId), 
+   is_clr(false), is_plr(false), rtt_confirmed(false), is_active(false),
+   rtt(0.0), rtt_sqmean(0.0), rtt_sample(0.0), loss(0.0), rate(0.0), 
+   cc_sequence(0), heap_index(0)
 {
-    
+    feedback_time.tv_sec = feedback_time.tv_usec = 0;
 }
 
 NormCCNode::~NormCCNode()
@@ -69,14 +73,16 @@ NormSenderNode::NormSenderNode(class NormSession& theSession, NormNodeId nodeId)
    is_open(false), preset_fti(false), preset_stream(NULL),
    repair_boundary(BLOCK_BOUNDARY), decoder(NULL), erasure_loc(NULL),
    retrieval_loc(NULL), retrieval_pool(NULL), ack_pending(false), 
-   ack_ex_pending(false), ack_ex_buffer(NULL), ack_ex_length(0),
+   ack_ex_pending(false), ack_ex_buffer(NULL), ack_ex_length(0), ack_via_aggregator(false),
+   agg_mask_words(NULL), agg_ack_count(0), agg_flush_count(0), agg_ack_held(false), agg_valid(false),
    notify_on_grtt_update(true),
    cc_sequence(0), cc_enable(false), cc_feedback_needed(false), cc_rate(0.0), 
    rtt_confirmed(false), is_clr(false), is_plr(false),
    slow_start(true), send_rate(0.0), recv_rate(0.0), recv_rate_prev(0.0),
    nominal_packet_size(0), cmd_buffer_head(NULL), cmd_buffer_tail(NULL),
    cmd_buffer_pool(NULL), resync_count(0),
-   nack_count(0), suppress_count(0), completion_count(0), failure_count(0)
+   nack_count(0), suppress_count(0), completion_count(0), failure_count(0),
+   recv_bytes(0), recv_packets(0), goodput_bytes(0), decode_count(0)
 {
     repair_boundary = session.ReceiverGetDefaultRepairBoundary();
     sync_policy = session.ReceiverGetDefaultSyncPolicy();
@@ -170,6 +176,13 @@ void NormSenderNode::Close()
         ack_ex_buffer = NULL;
         ack_ex_length = 0;
     }
+    ResetAggregate();
+    agg_ack_mask.Destroy();
+    if (NULL != agg_mask_words)
+    {
+        delete[] agg_mask_words;
+        agg_mask_words = NULL;
+    }
     
     // Delete any command buffers from cmd_buffer queue
     while (NULL != cmd_buffer_head)
@@ -468,6 +481,35 @@ unsigned long NormSenderNode::StreamBufferOverunCount()
     return count;
 }  // end NormSenderNode::StreamBufferOverunCount()
 
+void NormSenderNode::UpdateStats()
+{
+    Stats& stats = stats_lock.BeginUpdate();
+    stats.recv_bytes = recv_bytes;
+    stats.recv_packets = recv_packets;
+    stats.goodput_bytes = goodput_bytes;
+    stats.nacks_sent = nack_count;
+    stats.nacks_suppressed = suppress_count;
+    stats.fec_decodes = decode_count;
+    stats.objects_completed = completion_count;
+    stats.objects_pending = PendingCount();
+    stats.objects_failed = failure_count;
+    stats.resyncs = resync_count ? resync_count - 1 : 0;  // ("resync_count" is really a sync count)
+    stats.buffer_usage = CurrentBufferUsage();
+    stats.buffer_peak = PeakBufferUsage();
+    stats.buffer_overruns = BufferOverunCount();
+    stats.grtt = grtt_estimate;
+    stats.rtt = rtt_estimate;
+    stats.loss = LossEstimate();
+    stats.send_rate = send_rate;
+    stats.recv_rate = recv_rate;
+    stats_lock.EndUpdate();
+    // and those of our pending objects
+    NormObjectTable::Iterator it(rx_table);
+    NormObject* obj;
+    while (NULL != (obj = it.GetNextObject()))
+        obj->UpdateStats();
+}  // end NormSenderNode::UpdateStats()
+
 
 bool NormSenderNode::ReadNextCmd(char* buffer, unsigned int* buflen)
 {
@@ -620,7 +662,7 @@ void NormSenderNode::HandleCommand(const struct timeval& currentTime,
     {
         gsize_quantized = gsizeQuantized;
         gsize_estimate = NormUnquantizeGroupSize(gsizeQuantized);
-        PLOG(PL_DEBUG, "NormSenderNode::HandleCommand() node>%lu sender>%lu new group size:%lf\n",
+        NLOG(PL_DEBUG, "NormSenderNode::HandleCommand() node>%lu sender>%lu new group size:%lf\n",
                         (unsigned long)LocalNodeId(), (unsigned long)GetId(), gsize_estimate);
     }
     backoff_factor = (double)cmd.GetBackoffFactor();
@@ -762,7 +804,7 @@ void NormSenderNode::HandleCommand(const struct timeval& currentTime,
 
                     backoffTime = 0.25 * r * maxBackoff + 0.75 * backoffTime;
                     cc_timer.SetInterval(backoffTime);
-                    PLOG(PL_TRACE, "NormSenderNode::HandleCommand() node>%lu begin CC back-off: %lf sec)...\n",
+                    NLOG(PL_TRACE, "NormSenderNode::HandleCommand() node>%lu begin CC back-off: %lf sec)...\n",
                                     (unsigned long)LocalNodeId(), backoffTime);
                     session.ActivateTimer(cc_timer);
                     break;
@@ -778,16 +820,26 @@ void NormSenderNode::HandleCommand(const struct timeval& currentTime,
             // to positively acknowledge the FLUSH
             const NormCmdFlushMsg& flush = (const NormCmdFlushMsg&)cmd;
             bool doAck = false;
+            bool viaAggregator = false;
             UINT16 nodeCount = flush.GetAckingNodeCount();
             NormNodeId localId = LocalNodeId();
+            NormNodeId aggregatorId = session.ReceiverGetAckAggregatorId();
             for (UINT16 i = 0; i < nodeCount; i++)
             {
                 // (TBD) also ACK if NORM_NODE_ANY is listed???
-                if (flush.GetAckingNodeId(i) == localId)
+                NormNodeId nodeId = flush.GetAckingNodeId(i);
+                if (nodeId == localId)
                 {
                     doAck = true;
+                    viaAggregator = false;
                     break;   
                 }
+                else if ((NORM_NODE_NONE != aggregatorId) && (nodeId == aggregatorId))
+                {
+                    // Our aggregator is listed, so we ACK to it (unless we are listed, too)
+                    doAck = true;
+                    viaAggregator = true;
+                }
             } 
             NormObjectId objectId = flush.GetObjectId();
             NormBlockId blockId = 0;
@@ -828,11 +880,21 @@ void NormSenderNode::HandleCommand(const struct timeval& currentTime,
             {
                 if (doAck) // this was a watermark flush
                 {
+                    if (!viaAggregator && (0 != session.ReceiverGetAggregateMemberCount()))
+                    {
+                        // Count the watermark requests we get as an ACK aggregator
+                        if (agg_valid && (objectId == agg_object_id) &&
+                            (blockId == agg_block_id) && (symbolId == agg_segment_id))
+                            agg_flush_count++;
+                        else if (StartAggregate(objectId, blockId, symbolId))
+                            agg_flush_count = 1;
+                    }
                     if (!PassiveRepairCheck(objectId, blockId, symbolId))
                     {
                        watermark_object_id = objectId;
                        watermark_block_id = blockId;  
                        watermark_segment_id = symbolId;
+                       ack_via_aggregator = viaAggregator;
                        
                        // Check for application-extended watermark request (see NormSetWatermarkEx())
                        const char* appAckReq = NULL;
@@ -914,7 +976,7 @@ void NormSenderNode::HandleCommand(const struct timeval& currentTime,
         }  
         case NormCmdMsg::APPLICATION:
         {
-            PLOG(PL_TRACE, "NormSenderNode::HandleCommand(APPLICATION) node>%lu recvd app-defined cmd...\n",
+            NLOG(PL_TRACE, "NormSenderNode::HandleCommand(APPLICATION) node>%lu recvd app-defined cmd...\n",
                             (unsigned long)LocalNodeId());
             const NormCmdAppMsg& appCmd = static_cast<const NormCmdAppMsg&>(cmd);
             // 1) Buffer the received command either using a buffer structure
@@ -1041,8 +1103,154 @@ void NormSenderNode::HandleAckMessage(const NormAckMsg& ack)
             }
         }
     }    
+    // As an ACK aggregator, we track our members' watermark ACKs
+    if ((NormAck::FLUSH == ack.GetAckType()) && (0 != session.ReceiverGetAggregateMemberCount()))
+        HandleAggregateAck(static_cast<const NormAckFlushMsg&>(ack));
 }  // end NormSenderNode::HandleAckMessage()
 
+void NormSenderNode::ResetAggregate()
+{
+    agg_valid = false;
+    agg_ack_count = 0;
+    agg_flush_count = 0;
+    agg_ack_held = false;
+}  // end NormSenderNode::ResetAggregate()
+
+// The member ACKs collected for the current watermark are kept (with
+// their mask bits moved to the members' new indices), so a member list
+// change doesn't drop an aggregate ACK in progress
+void NormSenderNode::UpdateAggregateMember(UINT16 index, bool inserted)
+{
+    if (agg_valid)
+    {
+        UINT32 oldSize = agg_ack_mask.GetSize();
+        UINT32 newSize = session.ReceiverGetAggregateMemberCount();
+        ASSERT(newSize == (inserted ? (oldSize + 1) : (oldSize - 1)));
+        if (0 == newSize)
+        {
+            agg_valid = false;
+            agg_ack_count = 0;
+        }
+        else
+        {
+            UINT32* newWords = new UINT32[NormBlockMask::GetWordCount(newSize)];
+            if (NULL == newWords)
+            {
+                PLOG(PL_ERROR, "NormSenderNode::UpdateAggregateMember() new agg_mask_words error: %s\n", 
+                               GetErrorString());
+                agg_valid = false;
+                agg_ack_count = 0;
+                agg_flush_count = 0;
+            }
+            else
+            {
+                NormBlockMask newMask;
+                newMask.Init(newWords, newSize);
+                UINT32 i = 0;
+                while (agg_ack_mask.GetNextSet(i))
+                {
+                    if (i < index)
+                        newMask.Set(i);
+                    else if (inserted)
+                        newMask.Set(i + 1);
+                    else if (i > index)
+                        newMask.Set(i - 1);
+                    i++;
+                }
+                agg_ack_mask.Destroy();
+                if (NULL != agg_mask_words) delete[] agg_mask_words;
+                agg_mask_words = newWords;
+                agg_ack_mask = newMask;
+                agg_ack_count = (UINT16)agg_ack_mask.GetCount(0, newSize);
+            }
+        }
+    }
+    if (agg_ack_held && AggregateAckReady())
+    {
+        // (e.g., the last member yet to acknowledge was removed)
+        agg_ack_held = false;
+        if (!ack_timer.IsActive()) OnAckTimeout(ack_timer);
+    }
+}  // end NormSenderNode::UpdateAggregateMember()
+
+// Begins collection of member ACKs for a new watermark
+bool NormSenderNode::StartAggregate(NormObjectId    objectId,
+                                    NormBlockId     blockId,
+                                    NormSegmentId   segmentId)
+{
+    ResetAggregate();
+    UINT16 memberCount = session.ReceiverGetAggregateMemberCount();
+    if (agg_ack_mask.GetSize() != memberCount)
+    {
+        agg_ack_mask.Destroy();
+        if (NULL != agg_mask_words) delete[] agg_mask_words;
+        if (NULL == (agg_mask_words = new UINT32[NormBlockMask::GetWordCount(memberCount)]))
+        {
+            PLOG(PL_ERROR, "NormSenderNode::StartAggregate() new agg_mask_words error: %s\n", GetErrorString());
+            return false;
+        }
+        agg_ack_mask.Init(agg_mask_words, memberCount);
+    }
+    else
+    {
+        agg_ack_mask.Clear();
+    }
+    agg_object_id = objectId;
+    agg_block_id = blockId;
+    agg_segment_id = segmentId;
+    agg_valid = true;
+    return true;
+}  // end NormSenderNode::StartAggregate()
+
+void NormSenderNode::HandleAggregateAck(const NormAckFlushMsg& ack)
+{
+    int index = session.ReceiverGetAggregateMemberIndex(ack.GetSourceId());
+    if ((index < 0) || !synchronized || 
+        (ack.GetInstanceId() != instance_id) || (ack.GetFecId() != fec_id)) return;
+    NormObjectId objectId = ack.GetObjectId();
+    NormBlockId blockId = ack.GetFecBlockId(fti_data.GetFecFieldSize());
+    NormSegmentId segmentId = ack.GetFecSymbolId(fti_data.GetFecFieldSize());
+    if (!agg_valid || (objectId != agg_object_id) || 
+        (blockId != agg_block_id) || (segmentId != agg_segment_id))
+    {
+        // A member's ACK may arrive before we get the FLUSH for a new watermark,
+        // but an ACK for an older (object, block, segment) watermark is ignored
+        if (agg_valid)
+        {
+            if (objectId < agg_object_id) return;
+            if (objectId == agg_object_id)
+            {
+                UINT32 fecBlockMask = NormPayloadId::GetFecBlockMask(fec_id, fti_data.GetFecFieldSize());
+                int result = NormBlockId::Compare(blockId, agg_block_id, fecBlockMask);
+                if ((result < 0) || ((0 == result) && (segmentId < agg_segment_id))) return;
+            }
+        }
+        if (!StartAggregate(objectId, blockId, segmentId)) return;
+    }
+    if (agg_ack_mask.Test((UINT32)index)) return;  // redundant ACK
+    agg_ack_mask.Set((UINT32)index);
+    agg_ack_count++;
+    if (agg_ack_held && AggregateAckReady())
+    {
+        // Our last member has acknowledged, so we can acknowledge upstream
+        agg_ack_held = false;
+        if (!ack_timer.IsActive()) OnAckTimeout(ack_timer);
+    }
+}  // end NormSenderNode::HandleAggregateAck()
+
+// An ACK aggregator holds its own watermark ACK until all members have
+// acknowledged or the watermark has been requested again (the sender
+// is still waiting), in which case it reports how many have acknowledged
+bool NormSenderNode::AggregateAckReady() const
+{
+    if (ack_via_aggregator || (0 == session.ReceiverGetAggregateMemberCount()))
+        return true;
+    if (!agg_valid || (agg_object_id != watermark_object_id) ||
+        (agg_block_id != watermark_block_id) || (agg_segment_id != watermark_segment_id))
+        return false;
+    return ((agg_ack_count >= agg_ack_mask.GetSize()) || (agg_flush_count > 1));
+}  // end NormSenderNode::AggregateAckReady()
+
 void NormSenderNode::HandleNackMessage(const NormNackMsg& nack)
 {
     // Does the CC feedback of this NACK suppress our CC feedback
@@ -1063,6 +1271,190 @@ void NormSenderNode::HandleNackMessage(const NormNackMsg& nack)
         HandleRepairContent(nack.GetRepairContent(), nack.GetRepairContentLength());
 }  // end NormSenderNode::HandleNackMessage()
 
+// A receiver acting as a local repair peer answers the SEGMENT and BLOCK
+// repair requests of a NACK from nearby receivers for source (or cached
+// parity) segments it holds.  When "relay" is set (the NACK was sent 
+// directly to us), the requests we could not answer are passed on to 
+// the sender in a copy of the NACK trimmed to those requests.
+void NormSenderNode::HandleLocalRepairRequest(const NormNackMsg& nack, bool relay)
+{
+    if (nack.GetInstanceId() != instance_id) return;
+    NormDataMsg* data = (NormDataMsg*)session.GetMessageFromPool();
+    NormNackMsg* relayNack = relay ? (NormNackMsg*)session.GetMessageFromPool() : NULL;
+    if ((NULL == data) || (relay && (NULL == relayNack)))
+    {
+        PLOG(PL_WARN, "NormSenderNode::HandleLocalRepairRequest() node>%lu Warning! "
+                      "message pool empty ...\n", (unsigned long)LocalNodeId());
+        if (NULL != data) session.ReturnMessageToPool(data);
+        if (NULL != relayNack) session.ReturnMessageToPool(relayNack);
+        return;
+    }
+    if (relay)
+    {
+        relayNack->InitFrom(nack);
+        relayNack->SetDestination(GetAddress());
+    }
+    // Repairs are scoped by TTL or unicast back to the NACKing receiver
+    UINT8 repairTtl = session.ReceiverGetLocalRepairTtl();
+    ProtoAddress repairDst;
+    if (0 != repairTtl)
+    {
+        repairDst = session.Address();
+    }
+    else
+    {
+        repairDst = nack.GetSource();
+        repairDst.SetPort(session.GetRxPort());
+    }
+    struct timeval currentTime;
+    session.GetCurrentTime(currentTime);
+    UINT8 fecM = fti_data.GetFecFieldSize();
+    unsigned int repairCount = 0;
+    unsigned int holdoffCount = 0;
+    UINT16 requestOffset = 0;
+    UINT16 requestLength = 0;
+    NormRepairRequest req;
+    while (0 != (requestLength = nack.UnpackRepairRequest(req, requestOffset)))
+    {
+        requestOffset += requestLength;
+        NormRepairRequest::Form requestForm = req.GetForm();
+        bool segmentLevel = req.FlagIsSet(NormRepairRequest::SEGMENT);
+        bool blockLevel = !segmentLevel && req.FlagIsSet(NormRepairRequest::BLOCK);
+        if (!(segmentLevel || blockLevel) || req.FlagIsSet(NormRepairRequest::INFO))
+        {
+            // OBJECT and INFO requests are left to the sender
+            if (relay) relayNack->AppendRepairRequest(req);
+            continue;
+        }
+        NormRepairRequest relayReq;
+        bool relayPending = false;
+        if (relay)
+        {
+            relayNack->AttachRepairRequest(relayReq, nack.GetRepairContentLength());
+            relayReq.SetForm(requestForm);
+            relayReq.SetFlags(req.GetFlags());
+        }
+        NormRepairRequest::Iterator iterator(req, fec_id, fecM);
+        NormObjectId nextObjectId, lastObjectId;
+        NormBlockId nextBlockId, lastBlockId;
+        UINT16 nextBlockLen, lastBlockLen;
+        NormSegmentId nextSegmentId, lastSegmentId;
+        while (iterator.NextRepairItem(&nextObjectId, &nextBlockId, &nextBlockLen, &nextSegmentId))
+        {
+            if (NormRepairRequest::RANGES == requestForm)
+            {
+                if (!iterator.NextRepairItem(&lastObjectId, &lastBlockId, &lastBlockLen, &lastSegmentId))
+                {
+                    PLOG(PL_ERROR, "NormSenderNode::HandleLocalRepairRequest() node>%lu recvd incomplete RANGE request!\n",
+                                    (unsigned long)LocalNodeId());
+                    break;
+                }
+            }
+            else
+            {
+                lastObjectId = nextObjectId;
+                lastBlockId = nextBlockId;
+                lastBlockLen = nextBlockLen;
+                lastSegmentId = nextSegmentId;
+            }
+            // Only requests within a single block are answered locally
+            bool answered = false;
+            NormObject* obj = ((nextObjectId == lastObjectId) && (nextBlockId == lastBlockId)) ?
+                                    rx_table.Find(nextObjectId) : NULL;
+            if ((NULL != obj) && LocalRepairHeldOff(nextObjectId, nextBlockId, currentTime))
+            {
+                // The block was just repaired (by us or another peer) for another
+                // NACK of the same loss, so the requester is likely served already
+                // (and will NACK again if not)
+                answered = true;
+                holdoffCount++;
+            }
+            else if (NULL != obj)
+            {
+                UINT32 firstId = segmentLevel ? nextSegmentId : 0;
+                UINT32 lastId = segmentLevel ? lastSegmentId : (obj->GetBlockSize(nextBlockId) - 1);
+                unsigned int blockRepairCount = 0;
+                answered = true;
+                for (UINT32 segmentId = firstId; segmentId <= lastId; segmentId++)
+                {
+                    if (!obj->BuildLocalRepairMsg(*data, nextBlockId, (NormSegmentId)segmentId, LocalNodeId()))
+                    {
+                        answered = false;
+                        break;
+                    }
+                    // Fill in the header as the sender would have
+                    data->SetSequence(0);
+                    data->SetSourceId(GetId());
+                    data->SetInstanceId(instance_id);
+                    data->SetGrtt(grtt_quantized);
+                    data->SetBackoffFactor((unsigned char)backoff_factor);
+                    data->SetGroupSize(gsize_quantized);
+                    data->SetDestination(repairDst);
+                    if (session.ReceiverSendLocalRepairMsg(*data, repairTtl))
+                        blockRepairCount++;
+                }
+                if (0 != blockRepairCount)
+                {
+                    NoteLocalRepair(nextObjectId, nextBlockId, currentTime);
+                    repairCount += blockRepairCount;
+                }
+            }
+            if (!answered && relay)
+            {
+                if (NormRepairRequest::RANGES == requestForm)
+                    relayReq.AppendRepairRange(fec_id, fecM, nextObjectId, nextBlockId, nextBlockLen, nextSegmentId,
+                                               lastObjectId, lastBlockId, lastBlockLen, lastSegmentId);
+                else
+                    relayReq.AppendRepairItem(fec_id, fecM, nextObjectId, nextBlockId, nextBlockLen, nextSegmentId);
+                relayPending = true;
+            }
+        }  // end while (iterator.NextRepairItem())
+        if (relayPending) relayNack->PackRepairRequest(relayReq);
+    }  // end while (nack.UnpackRepairRequest())
+    if ((0 != repairCount) || (0 != holdoffCount))
+        PLOG(PL_DEBUG, "NormSenderNode::HandleLocalRepairRequest() node>%lu sent %u local repairs "
+                       "(%u requests held off) for node>%lu\n", (unsigned long)LocalNodeId(), 
+                       repairCount, holdoffCount, (unsigned long)nack.GetSourceId());
+    if (relay && (0 != relayNack->GetRepairContentLength()))
+        session.ReceiverSendLocalRepairMsg(*relayNack, repairTtl);
+    session.ReturnMessageToPool(data);
+    if (NULL != relayNack) session.ReturnMessageToPool(relayNack);
+}  // end NormSenderNode::HandleLocalRepairRequest()
+
+void NormSenderNode::NoteLocalRepair(const NormObjectId&    objectId, 
+                                     const NormBlockId&     blockId,
+                                     const struct timeval&  currentTime)
+{
+    // (a colliding entry is simply replaced)
+    LocalRepairSlot& slot = 
+        local_repair_slots[(((UINT16)objectId)*31 + blockId.GetValue()) % LOCAL_REPAIR_SLOTS];
+    slot.object_id = objectId;
+    slot.block_id = blockId;
+    slot.repair_time = currentTime;
+    slot.valid = true;
+}  // end NormSenderNode::NoteLocalRepair()
+
+// A block repaired locally is held off for the NACK backoff window (at
+// least a GRTT), since the NACKs of other receivers for the same loss 
+// arrive within it
+bool NormSenderNode::LocalRepairHeldOff(const NormObjectId&     objectId, 
+                                        const NormBlockId&      blockId,
+                                        const struct timeval&   currentTime) const
+{
+    const LocalRepairSlot& slot = 
+        local_repair_slots[(((UINT16)objectId)*31 + blockId.GetValue()) % LOCAL_REPAIR_SLOTS];
+    if (!slot.valid || (slot.object_id != objectId) || (slot.block_id != blockId)) 
+        return false;
+    double age = (double)(currentTime.tv_sec - slot.repair_time.tv_sec);
+    if (currentTime.tv_usec > slot.repair_time.tv_usec)
+        age += 1.0e-06*(double)(currentTime.tv_usec - slot.repair_time.tv_usec);
+    else
+        age -= 1.0e-06*(double)(slot.repair_time.tv_usec - currentTime.tv_usec);
+    double holdoff = grtt_estimate*backoff_factor;
+    if (holdoff < grtt_estimate) holdoff = grtt_estimate;
+    return (age < holdoff);
+}  // end NormSenderNode::LocalRepairHeldOff()
+
 // Receivers use this method to process NACK content overheard from other 
 // receivers or via NORM_CMD(REPAIR_ADV) messages received from the sender.  
 // Such content can "suppress" pending NACKs
@@ -1449,7 +1841,7 @@ void NormSenderNode::HandleObjectMessage(const NormObjectMsg& msg)
     {
         gsize_quantized = gsizeQuantized;
         gsize_estimate = NormUnquantizeGroupSize(gsizeQuantized);
-        PLOG(PL_DEBUG, "NormSenderNode::HandleObjectMessage() node>%lu sender>%lu new group size: %lf\n",
+        NLOG(PL_DEBUG, "NormSenderNode::HandleObjectMessage() node>%lu sender>%lu new group size: %lf\n",
                         (unsigned long)LocalNodeId(), (unsigned long)GetId(), gsize_estimate);
     }
     backoff_factor = (double)msg.GetBackoffFactor();
@@ -1541,7 +1933,7 @@ void NormSenderNode::HandleObjectMessage(const NormObjectMsg& msg)
     {
         if (allocateBuffers)
         {
-            PLOG(PL_DEBUG, "NormSenderNode::HandleObjectMessage() node>%lu allocating sender>%lu buffers ...\n",
+            NLOG(PL_DEBUG, "NormSenderNode::HandleObjectMessage() node>%lu allocating sender>%lu buffers ...\n",
                             (unsigned long)LocalNodeId(), (unsigned long)GetId());
             // Currently,, our implementation requires the FEC Object Transmission Information
             // to properly allocate resources for FEC buffering and decoding
@@ -1752,6 +2144,9 @@ void NormSenderNode::HandleObjectMessage(const NormObjectMsg& msg)
                 ASSERT(rx_table.CanInsert(objectId));
                 ASSERT(rx_pending_mask.Test(objectId));
                 if (doInsert) rx_table.Insert(obj);
+                struct timeval currentTime;
+                session.GetCurrentTime(currentTime);
+                obj->SetLatencyStart(currentTime);  // (first packet time)
                 // Pull out FTI parameters from header extension if we didn't get it above
                 if (!gotFTI)
                 {
@@ -1798,7 +2193,7 @@ void NormSenderNode::HandleObjectMessage(const NormObjectMsg& msg)
                                     stream->StreamUpdateStatus(syncId);
                                 }
                             }    
-                            PLOG(PL_DETAIL, "NormSenderNode::HandleObjectMessage() node>%lu sender>%lu new obj>%hu\n", 
+                            NLOG(PL_DETAIL, "NormSenderNode::HandleObjectMessage() node>%lu sender>%lu new obj>%hu\n", 
                                             (unsigned long)LocalNodeId(), (unsigned long)GetId(), (UINT16)objectId);
                         }
                         else
@@ -1868,6 +2263,7 @@ void NormSenderNode::HandleObjectMessage(const NormObjectMsg& msg)
             {
                 // Streams never complete unless they are "closed" by sender
                 // and this is handled within stream control code in "normObject.cpp"
+                session.RecordLatency(NormSession::RX_OBJECT_COMPLETED, obj->GetLatencyStart());
                 session.Notify(NormController::RX_OBJECT_COMPLETED, this, obj);
                 DeleteObject(obj);
                 obj = NULL;
@@ -2289,7 +2685,7 @@ void NormSenderNode::RepairCheck(NormObject::CheckLevel checkLevel,
 
 // When repair timer fires, possibly build a NACK
 // and queue for transmission to this sender node
-bool NormSenderNode::OnRepairTimeout(ProtoTimer& /*theTimer*/)
+bool NormSenderNode::OnRepairTimeout(NormTimer& /*theTimer*/)
 {
     switch(repair_timer.GetRepeatCount())
     {
@@ -2524,7 +2920,9 @@ bool NormSenderNode::OnRepairTimeout(ProtoTimer& /*theTimer*/)
                     nack->SetSenderId(GetId());
                     nack->SetInstanceId(instance_id);
                     // GRTT response is deferred until transmit time
-                    if (unicast_nacks)
+                    if (session.ReceiverGetLocalRepairPeer().IsValid() && !session.ReceiverGetLocalRepair())
+                        nack->SetDestination(session.ReceiverGetLocalRepairPeer());
+                    else if (unicast_nacks)
                         nack->SetDestination(GetAddress());
                     else
                         nack->SetDestination(session.Address());
@@ -2563,6 +2961,7 @@ bool NormSenderNode::OnRepairTimeout(ProtoTimer& /*theTimer*/)
                     if (!session.ReceiverIsSilent())
                     {
                         suppress_count++;
+                        session.ReceiverCountNackSuppressed();
                         PLOG(PL_DEBUG, "NormSenderNode::OnRepairTimeout() node>%lu sender>%lu NACK SUPPRESSED ...\n",
                                         (unsigned long)LocalNodeId(), (unsigned long)GetId());
                     }
@@ -2623,7 +3022,9 @@ void NormSenderNode::FragmentNack(NormNackMsg& superNack)
     }
     nack->InitFrom(superNack);
     // GRTT response is deferred until transmit time
-    if (unicast_nacks)
+    if (session.ReceiverGetLocalRepairPeer().IsValid() && !session.ReceiverGetLocalRepair())
+        nack->SetDestination(session.ReceiverGetLocalRepairPeer());
+    else if (unicast_nacks)
         nack->SetDestination(GetAddress());
     else
         nack->SetDestination(session.Address());
@@ -2798,7 +3199,7 @@ void NormSenderNode::Activate(bool isObjectMsg)
     }
 }  // end NormSenderNode::Activate()
 
-bool NormSenderNode::OnActivityTimeout(ProtoTimer& /*theTimer*/)
+bool NormSenderNode::OnActivityTimeout(NormTimer& /*theTimer*/)
 {
     if (sender_active)
     {
@@ -2817,7 +3218,7 @@ bool NormSenderNode::OnActivityTimeout(ProtoTimer& /*theTimer*/)
         PLOG(PL_INFO, "NormSenderNode::OnActivityTimeout() node>%lu for sender>%lu\n",
                         (unsigned long)LocalNodeId(), (unsigned long)GetId());
         struct timeval currentTime;
-        ::ProtoSystemTime(currentTime);
+        session.GetCurrentTime(currentTime);
         UpdateRecvRate(currentTime, 0);
         if (synchronized)
         {
@@ -2986,10 +3387,11 @@ void NormSenderNode::AttachCCFeedback(NormAckMsg& ack)
     ext.SetCCSequence(cc_sequence);
 }  // end NormSenderNode::AttachCCFeedback()
 
-bool NormSenderNode::OnCCTimeout(ProtoTimer& /*theTimer*/)
+bool NormSenderNode::OnCCTimeout(NormTimer& /*theTimer*/)
 {
     // Build and send NORM_ACK(CC)
-    if (ack_pending && !ack_ex_pending && (1 == cc_timer.GetRepeatCount()))
+    if (ack_pending && !ack_ex_pending && !ack_via_aggregator && 
+        AggregateAckReady() && (1 == cc_timer.GetRepeatCount()))
     {
         // Send ACK flush right away (CC feedback is included)
         if (ack_timer.IsActive()) ack_timer.Deactivate();
@@ -3060,11 +3462,16 @@ bool NormSenderNode::OnCCTimeout(ProtoTimer& /*theTimer*/)
     return true;
 }  // end NormSenderNode::OnCCTimeout()
 
-bool NormSenderNode::OnAckTimeout(ProtoTimer& /*theTimer*/)
+bool NormSenderNode::OnAckTimeout(NormTimer& /*theTimer*/)
 {
     // Build and send NORM_ACK(FLUSH)
     if (ack_ex_pending)
         return true;  // Will acknowledge when application services RX_ACK_REQUEST notification
+    if (!AggregateAckReady())
+    {
+        agg_ack_held = true;
+        return true;  // Will acknowledge when aggregated members have (see HandleAggregateAck())
+    }
     NormAckFlushMsg* ack = (NormAckFlushMsg*)session.GetMessageFromPool();
     if (NULL != ack)
     {
@@ -3081,6 +3488,13 @@ bool NormSenderNode::OnAckTimeout(ProtoTimer& /*theTimer*/)
             ext.SetContent(ack_ex_buffer, ack_ex_length);
             ack->PackExtension(ext);
         }
+        if (!ack_via_aggregator && agg_valid && (0 != session.ReceiverGetAggregateMemberCount()))
+        {
+            NormAggregateAckExtension ext;
+            ack->AttachExtension(ext);
+            ext.SetMemberCount((UINT16)agg_ack_mask.GetSize());
+            ext.SetAckedCount(agg_ack_count);
+        }
         
         ack->SetObjectId(watermark_object_id);
         
@@ -3096,7 +3510,9 @@ bool NormSenderNode::OnAckTimeout(ProtoTimer& /*theTimer*/)
         
         ack->SetFecPayloadId(fec_id, watermark_block_id.GetValue(), watermark_segment_id, blockLen, fti_data.GetFecFieldSize());
         
-        if (unicast_nacks)
+        if (ack_via_aggregator && session.ReceiverGetAckAggregatorAddr().IsValid())
+            ack->SetDestination(session.ReceiverGetAckAggregatorAddr());
+        else if (unicast_nacks)
             ack->SetDestination(GetAddress());
         else
             ack->SetDestination(session.Address());
@@ -3105,6 +3521,7 @@ bool NormSenderNode::OnAckTimeout(ProtoTimer& /*theTimer*/)
 	    if (session.SendMessage(*ack))
 	    {
             ack_pending = false;
+            agg_ack_held = false;
             cc_feedback_needed = false;
             if (cc_enable && !is_clr && !is_plr && session.Address().IsMulticast())
             {
@@ -3138,9 +3555,9 @@ bool NormSenderNode::OnAckTimeout(ProtoTimer& /*theTimer*/)
 
 NormAckingNode::NormAckingNode(class NormSession& theSession, NormNodeId nodeId)
  : NormNode(ACKER, theSession, nodeId), 
-   ack_received(false), req_count(theSession.GetTxRobustFactor()),
-   ack_ex_buffer(NULL), ack_ex_length(0)
-    
+   ack_received(false), req_count(theSession.GetTxRobustFactor()), acking_index(0),
+   ack_ex_buffer(NULL), ack_ex_length(0),
+   agg_member_count(0), agg_acked_count(0)
 {
 }
 
@@ -3199,7 +3616,7 @@ bool NormAckingNode::GetAckEx(char* buffer, unsigned int* buflen)
 }  // end NormAckingNode::GetAckEx()
 
 NormNodeTree::NormNodeTree()
- : root(NULL)
+ : hash_table(NULL), hash_mask(0), node_array(NULL), node_count(0), array_size(0)
 {
 
 }
@@ -3212,126 +3629,137 @@ NormNodeTree::~NormNodeTree()
 
 NormNode *NormNodeTree::FindNodeById(NormNodeId nodeId) const
 {
-    NormNode* x = root;
-    while(x && (x->id != nodeId))
+    if (0 == node_count) return NULL;
+    unsigned int i = Hash(nodeId) & hash_mask;
+    NormNode* x;
+    while (NULL != (x = hash_table[i]))
     {
-		if (nodeId < x->id)
-            x = x->left;
-        else
-            x = x->right;
+        if (nodeId == x->GetId()) return x;
+        i = (i + 1) & hash_mask;
     }
-    return x;   
+    return NULL;   
 }  // end NormNodeTree::FindNodeById() 
 
+unsigned int NormNodeTree::Search(NormNodeId nodeId, bool upper) const
+{
+    unsigned int lo = 0;
+    unsigned int hi = node_count;
+    while (lo < hi)
+    {
+        unsigned int mid = (lo + hi) >> 1;
+        NormNodeId midId = node_array[mid]->GetId();
+        if ((midId < nodeId) || (upper && (midId == nodeId)))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}  // end NormNodeTree::Search()
 
+// Doubles the sorted array and rebuilds the hash table at twice that size
+bool NormNodeTree::Grow()
+{
+    unsigned int arraySize = (0 != array_size) ? (array_size << 1) : 16;
+    unsigned int tableSize = arraySize << 1;
+    NormNode** nodeArray = new NormNode*[arraySize];
+    NormNode** hashTable = new NormNode*[tableSize];
+    if ((NULL == nodeArray) || (NULL == hashTable))
+    {
+        PLOG(PL_FATAL, "NormNodeTree::Grow() new index error: %s\n", GetErrorString());
+        if (NULL != nodeArray) delete[] nodeArray;
+        if (NULL != hashTable) delete[] hashTable;
+        return false;
+    }
+    memset(hashTable, 0, tableSize * sizeof(NormNode*));
+    unsigned int mask = tableSize - 1;
+    for (unsigned int n = 0; n < node_count; n++)
+    {
+        NormNode* node = node_array[n];
+        nodeArray[n] = node;
+        unsigned int i = Hash(node->GetId()) & mask;
+        while (NULL != hashTable[i]) i = (i + 1) & mask;
+        hashTable[i] = node;
+    }
+    if (NULL != node_array) delete[] node_array;
+    if (NULL != hash_table) delete[] hash_table;
+    node_array = nodeArray;
+    hash_table = hashTable;
+    array_size = arraySize;
+    hash_mask = mask;
+    return true;
+}  // end NormNodeTree::Grow()
 
-void NormNodeTree::AttachNode(NormNode *node)
+bool NormNodeTree::AttachNode(NormNode *node)
 {
     ASSERT(NULL != node);
+    if ((node_count == array_size) && !Grow()) return false;
     node->Retain();
-    node->left = NULL;
-    node->right = NULL;
-    NormNode *x = root;
-    while (x)
-    {
-        if (node->id < x->id)
-        {
-            if (!x->left)
-            {
-                x->left = node;
-                node->parent = x;
-                return;
-            }
-            else
-            {
-                x = x->left;
-            }
-        }
-        else
-        {
-           if (!x->right)
-           {
-               x->right = node;
-               node->parent = x;
-               return;
-           }
-           else
-           {
-               x = x->right;
-           }   
-        }
-    }
-    root = node;  // root _was_ NULL
+    // Insert into hash table ...
+    unsigned int i = Hash(node->GetId()) & hash_mask;
+    while (NULL != hash_table[i]) i = (i + 1) & hash_mask;
+    hash_table[i] = node;
+    // ... and into sorted array (after any entries with the same id)
+    unsigned int index = Search(node->GetId(), true);
+    memmove(node_array + index + 1, node_array + index, (node_count - index) * sizeof(NormNode*));
+    node_array[index] = node;
+    node_count++;
+    return true;
 }  // end NormNodeTree::AttachNode()
 
 
 void NormNodeTree::DetachNode(NormNode* node)
 {
     ASSERT(NULL != node);
-    NormNode* x;
-    NormNode* y;
-    if (!node->left || !node->right)
+    // Find and remove hash table entry, shifting back any subsequent
+    // entries of the probe sequence that would otherwise become unreachable
+    if (0 == node_count) return;
+    unsigned int i = Hash(node->GetId()) & hash_mask;
+    while (node != hash_table[i])
     {
-        y = node;
+        if (NULL == hash_table[i]) return;  // not in tree
+        i = (i + 1) & hash_mask;
     }
-    else
+    unsigned int j = i;
+    while (true)
     {
-        if (node->right)
-        {
-            y = node->right;
-            while (y->left) y = y->left;
-        }
-        else
-        {
-            x = node;
-            y = node->parent;
-            while(y && (y->right == x))
-            {
-                x = y;
-                y = y->parent;
-            }
-        }
+        j = (j + 1) & hash_mask;
+        NormNode* x = hash_table[j];
+        if (NULL == x) break;
+        unsigned int k = Hash(x->GetId()) & hash_mask;  // "home" slot of "x"
+        // "x" stays put if its home is cyclically within (i, j]
+        if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) continue;
+        hash_table[i] = x;
+        i = j;
     }
-    if (y->left)
-        x = y->left;
-    else
-        x = y->right;
-    if (x) x->parent = y->parent;
-    if (!y->parent)
-        root = x;
-    else if (y == y->parent->left)
-        y->parent->left = x;
-    else
-        y->parent->right = x;
-    
-    if (node != y)
-    {
-        if ((y->parent = node->parent))
-        {
-            if (y->id < y->parent->id)
-                y->parent->left = y;
-            else
-                y->parent->right = y;
-        }
-        else
-        {
-            root = y;
-        }
-        if ((y->left = node->left)) y->left->parent = y;
-        if ((y->right = node->right)) y->right->parent = y;
-    }      
+    hash_table[i] = NULL;
+    // Remove from sorted array
+    unsigned int index = Search(node->GetId(), false);
+    while (node_array[index] != node) index++;
+    node_count--;
+    memmove(node_array + index, node_array + index + 1, (node_count - index) * sizeof(NormNode*));
     node->Release();  
 }  // end NormNodeTree::DetachNode()
 
 
 void NormNodeTree::Destroy()
 {
-    NormNode* n;
-    while ((n = root)) 
+    while (0 != node_count) 
     {
+        NormNode* n = node_array[node_count - 1];
         DetachNode(n);
         n->Release();
     }
+    if (NULL != hash_table)
+    {
+        delete[] hash_table;
+        hash_table = NULL;
+    }
+    if (NULL != node_array)
+    {
+        delete[] node_array;
+        node_array = NULL;
+    }
+    hash_mask = array_size = 0;
 }  // end NormNodeTree::Destroy()
 
 NormNodeTreeIterator::NormNodeTreeIterator(const NormNodeTree& t, NormNode* prevNode)
@@ -3342,49 +3770,37 @@ NormNodeTreeIterator::NormNodeTreeIterator(const NormNodeTree& t, NormNode* prev
 
 void NormNodeTreeIterator::Reset(NormNode* prevNode)
 {
-    NormNode* x = tree.root;
-    if (NULL != x)
+    prev = prevNode;
+    if (NULL == prevNode)
     {
-        if (NULL == prevNode)
-        {
-            while (x->left) x = x->left;
-            next = x;
-        }
-        else
-        {
-            next = prevNode;
-            GetNextNode();  // sets "next" to return subsequent node
-        }
+        index = 0;
     }
     else
     {
-        next = NULL;   
+        prev_id = prevNode->GetId();
+        index = tree.Search(prev_id, false);
+        while ((index < tree.node_count) && (prevNode != tree.node_array[index]) &&
+               (prev_id == tree.node_array[index]->GetId()))
+        {
+            index++;
+        }
+        if ((index < tree.node_count) && (prevNode == tree.node_array[index])) 
+            index++;  // next node follows "prevNode"
     }
 }  // end NormNodeTreeIterator::Reset()
 
 NormNode* NormNodeTreeIterator::GetNextNode()
 {
-    NormNode* n = next;
-    if (n)
+    // If the tree changed since the last call, resume after "prev_id"
+    if ((NULL != prev) && 
+        ((0 == index) || (index > tree.node_count) || (prev != tree.node_array[index - 1])))
     {
-        if (next->right)
-        {
-            NormNode* y = n->right;
-            while (y->left) y = y->left;
-            next = y;
-        }
-        else
-        {
-            NormNode* x = n;
-            NormNode* y = n->parent;
-            while(y && (y->right == x))
-            {
-                x = y;
-                y = y->parent;
-            }
-            next = y;
-        }
+        index = tree.Search(prev_id, true);
     }
+    if (index >= tree.node_count) return NULL;
+    NormNode* n = tree.node_array[index++];
+    prev = n;
+    prev_id = n->GetId();
     return n;
 }  // end NormNodeTreeIterator::GetNextNode()
 
@@ -3450,6 +3866,103 @@ void NormNodeList::Destroy()
     }   
 }  // end NormNodeList::Destroy()
 
+NormCCNodeHeap::NormCCNodeHeap()
+ : count(0)
+{
+}
+
+NormCCNodeHeap::~NormCCNodeHeap()
+{
+    Destroy();
+}
+
+NormCCNode* NormCCNodeHeap::FindNodeById(NormNodeId nodeId) const
+{
+    // (the heap is small and bounded, so a scan is fine here)
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (nodeId == node_array[i]->GetId())
+            return node_array[i];
+    }
+    return NULL;
+}  // end NormCCNodeHeap::FindNodeById()
+
+bool NormCCNodeHeap::Append(NormCCNode* theNode)
+{
+    ASSERT(NULL != theNode);
+    if (IsFull()) return false;
+    theNode->Retain();
+    Place(theNode, count++);
+    if (count > 1) SiftUp(count - 1);
+    return true;
+}  // end NormCCNodeHeap::Append()
+
+void NormCCNodeHeap::Update(NormCCNode* theNode)
+{
+    unsigned int index = theNode->GetHeapIndex();
+    ASSERT((index < count) && (theNode == node_array[index]));
+    if (0 == index) return;  // CLR entry is not part of the heap
+    SiftUp(index);
+    SiftDown(theNode->GetHeapIndex());
+}  // end NormCCNodeHeap::Update()
+
+void NormCCNodeHeap::Heapify()
+{
+    // (heap root is at index 1, so children of "i" are at "2*i" and "2*i+1")
+    if (count < 3) return;
+    for (unsigned int i = (count - 1) / 2; i >= 1; i--)
+        SiftDown(i);
+}  // end NormCCNodeHeap::Heapify()
+
+void NormCCNodeHeap::Destroy()
+{
+    while (0 != count)
+    {
+        NormCCNode* theNode = node_array[--count];
+        theNode->Release();
+        theNode->Release();
+    }
+}  // end NormCCNodeHeap::Destroy()
+
+// Returns true if candidate "a" should be replaced before candidate "b"
+bool NormCCNodeHeap::IsWeaker(const NormCCNode* a, const NormCCNode* b)
+{
+    if (a->IsActive() != b->IsActive())
+        return !a->IsActive();
+    else if (a->HasRtt() != b->HasRtt())
+        return a->HasRtt();  // (keep candidates whose RTT is still to be confirmed)
+    else
+        return (a->GetRate() > b->GetRate());
+}  // end NormCCNodeHeap::IsWeaker()
+
+void NormCCNodeHeap::SiftUp(unsigned int index)
+{
+    NormCCNode* theNode = node_array[index];
+    while (index > 1)
+    {
+        unsigned int parent = index >> 1;
+        if (!IsWeaker(theNode, node_array[parent])) break;
+        Place(node_array[parent], index);
+        index = parent;
+    }
+    Place(theNode, index);
+}  // end NormCCNodeHeap::SiftUp()
+
+void NormCCNodeHeap::SiftDown(unsigned int index)
+{
+    NormCCNode* theNode = node_array[index];
+    unsigned int child;
+    while ((child = (index << 1)) < count)
+    {
+        if (((child + 1) < count) && IsWeaker(node_array[child + 1], node_array[child]))
+            child++;
+        if (!IsWeaker(node_array[child], theNode)) break;
+        Place(node_array[child], index);
+        index = child;
+    }
+    Place(theNode, index);
+}  // end NormCCNodeHeap::SiftDown()
+
 
 //////////////////////////////////////////////////////////
 //
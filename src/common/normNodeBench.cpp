@@ -0,0 +1,192 @@
+// The "normNodeBench" program times the NormNodeTree index used for a
+// session's acking node and remote sender tables.  It measures node
+// lookup (as done for each received ACK/NACK) and the ordered iteration
+// passes of a sender watermark flush with a large acking node set.
+//
+// usage: normNodeBench [nodes <count>][rounds <count>][random]
+//
+// Node ids are sequential by default (the worst case for the former
+// unbalanced binary tree) unless "random" is given.
+
+#include "normSession.h"
+#include "normBenchUtil.h"  // for NormBenchElapsedUsec()
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>  // for rand(), atoi()
+#include <string.h>  // for strcmp()
+
+// An ordered pass over all acking nodes in the tree (as a watermark flush
+// made before NormSession kept its dense acking node index and ACK bitmask)
+static unsigned int FlushPass(const NormNodeTree& tree)
+{
+    unsigned int pendingCount = 0;
+    NormNodeTreeIterator iterator(tree);
+    NormAckingNode* next;
+    while (NULL != (next = static_cast<NormAckingNode*>(iterator.GetNextNode())))
+    {
+        if (!next->AckReceived() && next->IsPending())
+        {
+            next->DecrementReqCount();
+            pendingCount++;
+        }
+    }
+    return pendingCount;
+}  // end FlushPass()
+
+int main(int argc, char* argv[])
+{
+    unsigned int nodeCount = 10000;
+    unsigned int roundCount = 100;
+    bool randomIds = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "nodes") && (++i < argc))
+            nodeCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "rounds") && (++i < argc))
+            roundCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "random"))
+            randomIds = true;
+        else
+        {
+            fprintf(stderr, "usage: normNodeBench [nodes <count>][rounds <count>][random]\n");
+            return -1;
+        }
+    }
+    if ((0 == nodeCount) || (0 == roundCount))
+    {
+        fprintf(stderr, "normNodeBench error: invalid node or round count\n");
+        return -1;
+    }
+
+    // A session is needed only as the nodes' owner (it is never opened)
+    ProtoDispatcher dispatcher;
+    NormSessionMgr sessionMgr(dispatcher, dispatcher, &dispatcher);
+    NormSession* session = sessionMgr.NewSession("127.0.0.1", 6003, 1);
+    if (NULL == session)
+    {
+        fprintf(stderr, "normNodeBench error: unable to create session\n");
+        return -1;
+    }
+
+    NormNodeId* idList = new NormNodeId[nodeCount];
+    if (NULL == idList)
+    {
+        perror("normNodeBench new idList error");
+        return -1;
+    }
+    srand(1);
+    for (unsigned int i = 0; i < nodeCount; i++)
+        idList[i] = randomIds ? 
+            (NormNodeId)(((((UINT32)rand() << 16) ^ (UINT32)rand()) % 0x7ffffffe) + 2) : 
+            (NormNodeId)(i + 2);
+
+    NormNodeTree tree;
+    struct timeval startTime;
+
+    // 1) Attach nodes
+    ProtoSystemTime(startTime);
+    unsigned int attachCount = 0;
+    for (unsigned int i = 0; i < nodeCount; i++)
+    {
+        if (NULL != tree.FindNodeById(idList[i])) continue;  // (duplicate random id)
+        NormAckingNode* node = new NormAckingNode(*session, idList[i]);
+        if ((NULL == node) || !tree.AttachNode(node))
+        {
+            fprintf(stderr, "normNodeBench error: unable to attach node\n");
+            return -1;
+        }
+        attachCount++;
+    }
+    double attachTime = NormBenchElapsedUsec(startTime);
+
+    // 2) Lookups of random member ids (as for received ACK/NACK messages)
+    unsigned int lookupCount = nodeCount * roundCount;
+    unsigned int foundCount = 0;
+    ProtoSystemTime(startTime);
+    for (unsigned int i = 0; i < lookupCount; i++)
+    {
+        if (NULL != tree.FindNodeById(idList[rand() % nodeCount])) foundCount++;
+    }
+    double lookupTime = NormBenchElapsedUsec(startTime);
+
+    // 3) Watermark flush rounds: reset all nodes, make a flush pass, receive
+    //    an ACK from every node (in random order), and make a final pass
+    double resetTime = 0.0;
+    double flushTime = 0.0;
+    double ackTime = 0.0;
+    unsigned int flushCount = 0;
+    for (unsigned int r = 0; r < roundCount; r++)
+    {
+        ProtoSystemTime(startTime);
+        NormNodeTreeIterator iterator(tree);
+        NormNode* next;
+        while (NULL != (next = iterator.GetNextNode()))
+            static_cast<NormAckingNode*>(next)->Reset(20);
+        resetTime += NormBenchElapsedUsec(startTime);
+
+        ProtoSystemTime(startTime);
+        FlushPass(tree);
+        flushTime += NormBenchElapsedUsec(startTime);
+        flushCount++;
+
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < nodeCount; i++)
+        {
+            NormAckingNode* node =
+                static_cast<NormAckingNode*>(tree.FindNodeById(idList[(i * 7919) % nodeCount]));
+            if (NULL != node) node->MarkAckReceived();
+        }
+        ackTime += NormBenchElapsedUsec(startTime);
+
+        ProtoSystemTime(startTime);
+        if (0 != FlushPass(tree))
+            fprintf(stderr, "normNodeBench warning: acking incomplete?!\n");
+        flushTime += NormBenchElapsedUsec(startTime);
+        flushCount++;
+    }
+
+    // 4) Resumed iteration (as for NormGetNextAckingNode()), where each
+    //    step finds the previous node by id and continues after it
+    ProtoSystemTime(startTime);
+    NormNodeId prevId = NORM_NODE_NONE;
+    unsigned int stepCount = 0;
+    while (true)
+    {
+        NormNode* prevNode = (NORM_NODE_NONE != prevId) ? tree.FindNodeById(prevId) : NULL;
+        NormNodeTreeIterator iterator(tree, prevNode);
+        NormNode* next = iterator.GetNextNode();
+        if (NULL == next) break;
+        prevId = next->GetId();
+        stepCount++;
+    }
+    double resumeTime = NormBenchElapsedUsec(startTime);
+
+    // 5) Detach all nodes (lowest id first)
+    ProtoSystemTime(startTime);
+    NormNode* node;
+    while (NULL != (node = tree.GetHead()))
+    {
+        tree.DetachNode(node);
+        node->Release();
+    }
+    double detachTime = NormBenchElapsedUsec(startTime);
+
+    printf("normNodeBench: %u %s acking nodes, %u rounds\n",
+           attachCount, randomIds ? "random" : "sequential", roundCount);
+    printf("   attach:          %10.3f usec total, %8.1f nsec/node\n",
+           attachTime, 1000.0 * attachTime / attachCount);
+    printf("   lookup:          %10.3f usec total, %8.1f nsec/lookup (%u found)\n",
+           lookupTime, 1000.0 * lookupTime / lookupCount, foundCount);
+    printf("   watermark reset: %10.3f usec/pass\n", resetTime / roundCount);
+    printf("   watermark flush: %10.3f usec/pass\n", flushTime / flushCount);
+    printf("   ack processing:  %10.3f usec/round, %8.1f nsec/ack\n",
+           ackTime / roundCount, 1000.0 * ackTime / (roundCount * nodeCount));
+    printf("   resumed iterate: %10.3f usec/pass (%u steps)\n", resumeTime, stepCount);
+    printf("   detach:          %10.3f usec total, %8.1f nsec/node\n",
+           detachTime, 1000.0 * detachTime / attachCount);
+
+    delete[] idList;
+    sessionMgr.DeleteSession(session);
+    return 0;
+}  // end main()
@@ -1,5 +1,6 @@
 #include "normObject.h"
 #include "normSession.h"
+#include "normDebug.h"  // for NLOG()
 
 #ifndef _WIN32_WCE
 #include <fcntl.h>
@@ -16,11 +17,10 @@ NormObject::NormObject(NormObject::Type      theType,
    current_block_id(0), next_segment_id(0), 
    max_pending_block(0), max_pending_segment(0),
    info_ptr(NULL), info_len(0), first_pass(true), accepted(false), notify_on_update(true),
-   user_data(NULL)
-#ifndef USE_PROTO_TREE
-   , next(NULL)
-#endif
+   tx_first_pending(false), user_data(NULL)
 {
+    memset(&stats, 0, sizeof(stats));
+    latency_start.tv_sec = latency_start.tv_usec = 0;
     if (theSender)
     {
         nacking_mode = theSender->GetDefaultNackingMode();
@@ -154,7 +154,7 @@ bool NormObject::Open(const NormObjectSize& objectSize,
 
     if (!IsStream()) fec_block_mask = 0;  
     
-    if (!block_buffer.Init(numBlocks.LSB(), 256, fec_block_mask))
+    if (!block_buffer.Init(numBlocks.LSB(), NormBlockBuffer::RING_SIZE_MAX, fec_block_mask))
     {
         PLOG(PL_FATAL, "NormObject::Open() init block_buffer error\n");  
         Close();
@@ -245,6 +245,7 @@ bool NormObject::Open(const NormObjectSize& objectSize,
 
 void NormObject::Close()
 {
+    UpdateStats();  // final snapshot for any app still holding a handle
     NormBlock* block;
     while ((block = block_buffer.Find(block_buffer.RangeLo())))
     {
@@ -1382,6 +1383,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                                      NormBlockId          blockId,
                                      NormSegmentId        segmentId)
 {
+    stats.rx_packets++;
     if (NormMsg::INFO == msgType)
     {
         if (pending_info)
@@ -1415,7 +1417,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
         else
         {
             // (TBD) Verify info hasn't changed?   
-            PLOG(PL_DEBUG, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu "
+            NLOG(PL_DEBUG, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu "
                            "received duplicate info ...\n", 
                             (unsigned long)LocalNodeId(), (unsigned long)sender->GetId(), 
                             (UINT16)transport_id);
@@ -1497,8 +1499,14 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                 // Is this a source symbol or a parity symbol?
                 bool isSourceSymbol = (segmentId < numData);
                 
+                // Stream source symbols are stored (zero-padded) straight into the
+                // stream buffer which then doubles as the cache for decoding, so
+                // the payload is copied once instead of twice (see RetrieveSegment())
+                bool adopted = isSourceSymbol && (NULL != stream) &&
+                               stream->AdoptSegment(blockId, segmentId, data.GetPayload());
+                
                 // Try to cache segment in block buffer in case it's needed for decoding
-                char* segment = (!isSourceSymbol || !sender->SegmentPoolIsEmpty()) ?
+                char* segment = (!adopted && (!isSourceSymbol || !sender->SegmentPoolIsEmpty())) ?
                                     sender->GetFreeSegment(transport_id, blockId) : NULL;
                 
                 if (segment)
@@ -1522,7 +1530,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                 if (isSourceSymbol) 
                 {
                     block->DecrementErasureCount();
-                    if (WriteSegment(blockId, segmentId, data.GetPayload()))
+                    if (adopted || WriteSegment(blockId, segmentId, data.GetPayload()))
                     {
                         objectUpdated = true;
                         // For statistics only (TBD) #ifdef NORM_DEBUG
@@ -1531,7 +1539,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                     else
                     {
                         if (IsStream())
-                            PLOG(PL_DEBUG, "NormObject::HandleObjectMessage() WriteSegment() error\n");
+                            NLOG(PL_DEBUG, "NormObject::HandleObjectMessage() WriteSegment() error\n");
                         else
                             PLOG(PL_ERROR, "NormObject::HandleObjectMessage() WriteSegment() error\n");
                     }
@@ -1546,7 +1554,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                 {
                     // Decode (if pending_mask.FirstSet() < numData)
                     // and write any decoded data segments to object
-                    PLOG(PL_DETAIL, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu blk>%lu "
+                    NLOG(PL_DETAIL, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu blk>%lu "
                                     "completed block ...\n", (unsigned long)LocalNodeId(), 
                                     (unsigned long)sender->GetId(), (UINT16)transport_id, 
                                     (unsigned long)block->GetId().GetValue());
@@ -1603,7 +1611,13 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                     
                     if (erasureCount)
                     {
+                        struct timeval decodeTime[2];
+                        ProtoSystemTime(decodeTime[0]);
                         sender->Decode(block->SegmentList(), numData, erasureCount); 
+                        ProtoSystemTime(decodeTime[1]);
+                        session.AccessLatencyHistogram(NormSession::RX_BLOCK_DECODE).RecordInterval(decodeTime[0], decodeTime[1]);
+                        stats.fec_decodes++;
+                        session.ReceiverCountFecDecode();
                         for (UINT16 i = 0; i < erasureCount; i++) 
                         {
                             NormSegmentId sid = sender->GetErasureLoc(i);
@@ -1619,7 +1633,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                                 else
                                 {
                                     if (IsStream())
-                                        PLOG(PL_DEBUG, "NormObject::HandleObjectMessage() WriteSegment() error\n");
+                                        NLOG(PL_DEBUG, "NormObject::HandleObjectMessage() WriteSegment() error\n");
                                     else
                                         PLOG(PL_ERROR, "NormObject::HandleObjectMessage() WriteSegment() error\n");
                                 } 
@@ -1652,7 +1666,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
             }
             else
             {
-                PLOG(PL_DEBUG, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu "
+                NLOG(PL_DEBUG, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu "
                                 "received duplicate segment blk>%lu segment>%hu...\n", (unsigned long)LocalNodeId(),
                                 (unsigned long)sender->GetId(), (UINT16)transport_id,(unsigned long)blockId.GetValue(),
                                  segmentId);
@@ -1660,7 +1674,7 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
         }
         else
         {
-            PLOG(PL_DEBUG, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu "
+            NLOG(PL_DEBUG, "NormObject::HandleObjectMessage() node>%lu sender>%lu obj>%hu "
                             "received duplicate block message blk>%lu ...\n", (unsigned long)LocalNodeId(),
                             (unsigned long)sender->GetId(), (UINT16)transport_id, (unsigned long)blockId.GetValue());
         }  // end if/else pending_mask.Test(blockId)
@@ -1668,6 +1682,78 @@ void NormObject::HandleObjectMessage(const NormObjectMsg& msg,
                     
 }  // end NormObject::HandleObjectMessage()
 
+bool NormObject::BuildLocalRepairMsg(NormDataMsg&   data,
+                                     NormBlockId    blockId,
+                                     NormSegmentId  segmentId,
+                                     NormNodeId     repairerId)
+{
+    if (!accepted || (NULL == sender)) return false;
+    UINT16 numData = GetBlockSize(blockId);
+    if (segmentId >= (numData + nparity)) return false;
+    if (!IsStream() && (blockId.GetValue() > final_block_id.GetValue())) return false;
+    
+    // First, make sure we actually hold the requested segment
+    NormBlock* block = block_buffer.Find(blockId);
+    const char* segment = NULL;
+    UINT16 payloadLength = 0;
+    if (segmentId >= numData)
+    {
+        // Receivers keep no encoder state, so only parity still cached can be resent
+        if ((NULL == block) || block->IsPending(segmentId)) return false;
+        if (NULL == (segment = block->GetSegment(segmentId))) return false;
+        payloadLength = IsStream() ? (segment_size + NormDataMsg::GetStreamPayloadHeaderLength()) : segment_size;
+    }
+    else if (IsStream())
+    {
+        segment = static_cast<NormStreamObject*>(this)->FindBufferedSegment(blockId, segmentId);
+        if (NULL == segment) return false;
+        payloadLength = NormDataMsg::GetStreamPayloadHeaderLength() + 
+                        NormDataMsg::ReadStreamPayloadLength(segment);
+        if (payloadLength > (segment_size + NormDataMsg::GetStreamPayloadHeaderLength())) return false;
+    }
+    else if (pending_mask.Test(blockId.GetValue()) && ((NULL == block) || block->IsPending(segmentId)))
+    {
+        return false;  // not yet received (source segments are read back from the object below)
+    }
+    
+    data.Init();
+    data.SetFecId(fec_id);
+    data.ResetFlags();
+    switch(type)
+    {
+        case STREAM:
+            data.SetFlag(NormObjectMsg::FLAG_STREAM);
+            break;
+        case FILE:
+            data.SetFlag(NormObjectMsg::FLAG_FILE);
+            break;
+        default:
+            break;
+    }
+    if (NULL != info_ptr) data.SetFlag(NormObjectMsg::FLAG_INFO);
+    data.SetFlag(NormObjectMsg::FLAG_REPAIR);
+    data.SetObjectId(transport_id);
+    // FTI is always included since the requesting peer may not have it yet
+    if (!AttachFtiExtension(&data)) return false;
+    NormLocalRepairExtension ext;
+    data.AttachExtension(ext);
+    ext.SetRepairerId(repairerId);
+    
+    if (NULL != segment)
+    {
+        memcpy(data.AccessPayload(), segment, payloadLength);
+    }
+    else if (0 == (payloadLength = ReadSegment(blockId, segmentId, data.AccessPayload())))
+    {
+        PLOG(PL_DEBUG, "NormObject::BuildLocalRepairMsg() node>%lu ReadSegment() error\n",
+                       (unsigned long)LocalNodeId());
+        return false;
+    }
+    data.SetPayloadLength(payloadLength);
+    data.SetFecPayloadId(fec_id, blockId.GetValue(), segmentId, numData, fec_m);
+    return true;
+}  // end NormObject::BuildLocalRepairMsg()
+
 // Returns source symbol segments to pool for ordinally _first_ block with such resources
 bool NormObject::ReclaimSourceSegments(NormSegmentPool& segmentPool)
 {
@@ -1772,6 +1858,50 @@ NormBlock* NormObject::StealOldestBlock(bool excludeBlock, NormBlockId excludeId
     }
 }  // end NormObject::StealOldestBlock()
 
+bool NormObject::AttachFtiExtension(NormObjectMsg* msg)
+{
+    switch (fec_id)
+    {
+        case 2:
+        {
+            NormFtiExtension2 fti;
+            msg->AttachExtension(fti);
+            fti.SetObjectSize(object_size);
+            fti.SetFecFieldSize(fec_m);
+            fti.SetFecGroupSize(1);
+            fti.SetSegmentSize(segment_size);
+            fti.SetFecMaxBlockLen(ndata);
+            fti.SetFecNumParity(nparity);
+            break;
+        }
+        case 5:
+        {
+            NormFtiExtension5 fti;
+            msg->AttachExtension(fti);
+            fti.SetObjectSize(object_size);
+            fti.SetSegmentSize(segment_size);
+            fti.SetFecMaxBlockLen((UINT8)ndata);
+            fti.SetFecNumParity((UINT8)nparity);
+            break;
+        }
+        case 129:
+        {
+            NormFtiExtension129 fti;
+            msg->AttachExtension(fti);
+            fti.SetObjectSize(object_size);
+            fti.SetFecInstanceId(0);   // ZERO is for legacy MDP/NORM FEC encoder (TBD - use appropriate instanceId)
+            fti.SetSegmentSize(segment_size);
+            fti.SetFecMaxBlockLen(ndata);
+            fti.SetFecNumParity(nparity);
+            break;
+        }
+        default:
+            ASSERT(0);
+            return false;
+    }
+    return true;
+}  // end NormObject::AttachFtiExtension()
+
 bool NormObject::NextSenderMsg(NormObjectMsg* msg)
 {             
     // Init() the message
@@ -1811,45 +1941,7 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
     if ((NormSession::FTI_ALWAYS == ftiMode) || 
         (pending_info && (NormSession::FTI_INFO == ftiMode)))
     {
-        switch (fec_id)
-        {
-            case 2:
-            {
-                NormFtiExtension2 fti;
-                msg->AttachExtension(fti);
-                fti.SetObjectSize(object_size);
-                fti.SetFecFieldSize(fec_m);
-                fti.SetFecGroupSize(1);
-                fti.SetSegmentSize(segment_size);
-                fti.SetFecMaxBlockLen(ndata);
-                fti.SetFecNumParity(nparity);
-                break;
-            }
-            case 5:
-            {
-                NormFtiExtension5 fti;
-                msg->AttachExtension(fti);
-                fti.SetObjectSize(object_size);
-                fti.SetSegmentSize(segment_size);
-                fti.SetFecMaxBlockLen((UINT8)ndata);
-                fti.SetFecNumParity((UINT8)nparity);
-                break;
-            }
-            case 129:
-            {
-                NormFtiExtension129 fti;
-                msg->AttachExtension(fti);
-                fti.SetObjectSize(object_size);
-                fti.SetFecInstanceId(0);   // ZERO is for legacy MDP/NORM FEC encoder (TBD - use appropriate instanceId)
-                fti.SetSegmentSize(segment_size);
-                fti.SetFecMaxBlockLen(ndata);
-                fti.SetFecNumParity(nparity);
-                break;
-            }
-            default:
-                ASSERT(0);
-                return false;
-        }
+        if (!AttachFtiExtension(msg)) return false;
     }
     if (pending_info)
     {
@@ -1897,7 +1989,7 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
         {
            if (NULL == (block = session.SenderGetFreeBlock(transport_id, blockId)))
            {
-                PLOG(PL_INFO, "NormObject::NextSenderMsg() node>%lu warning: sender resource " 
+                NLOG(PL_INFO, "NormObject::NextSenderMsg() node>%lu warning: sender resource " 
                               "constrained (no free blocks).\n", (unsigned long)LocalNodeId());
                 return false; 
            }
@@ -1917,13 +2009,15 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
                 }
                 else
                 {
-                    PLOG(PL_INFO, "NormObject::NextSenderMsg() node>%lu warning: sender resource " 
+                    NLOG(PL_INFO, "NormObject::NextSenderMsg() node>%lu warning: sender resource " 
                                   "constrained (no free segments).\n", (unsigned long)LocalNodeId());
                     session.SenderPutFreeBlock(block);
                     return false;
                 }
            }    
-           block->TxInit(blockId, numData, session.SenderAutoParity());  
+           struct timeval currentTime;
+           session.GetCurrentTime(currentTime);
+           block->TxInit(blockId, numData, session.SenderAutoParity(), ProtoTime(currentTime));  
            //if (blockId < max_pending_block) 
            if (Compare(blockId, max_pending_block) < 0)
                block->SetFlag(NormBlock::IN_REPAIR);
@@ -1939,7 +2033,7 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
                    if (!push && (lowBlock->IsRepairPending() || IsRepairSet(lowBlockId)))
                    {
                        // Pending repairs delaying stream advance
-                       PLOG(PL_DEBUG, "NormObject::NextSenderMsg() node>%lu pending repairs delaying stream progress\n", 
+                       NLOG(PL_DEBUG, "NormObject::NextSenderMsg() node>%lu pending repairs delaying stream progress\n", 
                                         (unsigned long)LocalNodeId());
                        session.SenderPutFreeBlock(block);
                        return false; 
@@ -2069,8 +2163,13 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
         }
     }  // end while (NULL == block)
     block->UnsetPending(segmentId); 
-    //if (block->InRepair()) 
-    //    data->SetFlag(NormObjectMsg::FLAG_REPAIR);
+    stats.tx_packets++;
+    if (block->InRepair()) 
+    {
+        stats.tx_repairs++;
+        session.SenderCountRepair();
+        //data->SetFlag(NormObjectMsg::FLAG_REPAIR);
+    }
     data->SetFecPayloadId(fec_id, blockId.GetValue(), segmentId, numData, fec_m);
     if (!block->IsPending()) 
     {
@@ -2090,11 +2189,11 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
     // mark the "recent" activity for this object or block
     if (session.GetFlowControl() > 0.0)
     {
-        ProtoTime currentTime;
-        currentTime.GetCurrentTime();
-        SetLastNackTime(currentTime);
+        struct timeval currentTime;
+        session.GetCurrentTime(currentTime);
+        SetLastNackTime(ProtoTime(currentTime));
         if (IsStream()) 
-            static_cast<NormStreamObject*>(this)->SetLastNackTime(blockId, currentTime);
+            static_cast<NormStreamObject*>(this)->SetLastNackTime(blockId, ProtoTime(currentTime));
     }
  
     if (!pending_mask.IsSet())
@@ -2110,6 +2209,7 @@ bool NormObject::NextSenderMsg(NormObjectMsg* msg)
         {
             // "First pass" transmission of object (and any auto parity) has completed
             first_pass = false;
+            session.RecordLatency(NormSession::TX_OBJECT_SENT, latency_start);
             session.Notify(NormController::TX_OBJECT_SENT, NULL, this);
         }
     }   
@@ -2775,14 +2875,32 @@ NormStreamObject::NormStreamObject(class NormSession&       theSession,
    flush_pending(false), msg_start(true),
    flush_mode(FLUSH_NONE), push_mode(false),
    stream_broken(false), stream_closing(false),
-   block_pool_threshold(0)
+   read_lease(NULL), read_lease_max(0), read_lease_count(0),
+   api_ring(NULL), block_pool_threshold(0)
 {
 }
 
 NormStreamObject::~NormStreamObject()
 {
     Close();    
+    SetRing(NULL);
     tx_offset = write_offset = read_offset = 0;
+    if (NULL != read_lease)
+    {
+        while (read_lease_count > 0)
+            segment_pool.Put(read_lease[--read_lease_count]);
+        delete[] read_lease;
+        read_lease = NULL;
+        read_lease_max = 0;
+    }
+    EmptyStreamBuffer();
+    stream_buffer.Destroy();    
+    segment_pool.Destroy();
+    block_pool.Destroy();
+}  
+
+void NormStreamObject::EmptyStreamBuffer()
+{
     NormBlock* b;
     while ((b = stream_buffer.Find(stream_buffer.RangeLo())))
     {
@@ -2790,10 +2908,7 @@ NormStreamObject::~NormStreamObject()
         b->EmptyToPool(segment_pool);
         block_pool.Put(b);   
     }
-    stream_buffer.Destroy();    
-    segment_pool.Destroy();
-    block_pool.Destroy();
-}  
+}  // end NormStreamObject::EmptyStreamBuffer()
 
 NormBlockId NormStreamObject::FlushBlockId() const
 {
@@ -2861,6 +2976,25 @@ bool NormStreamObject::Open(UINT32      bufferSize,
     if (doubleBuffer) numBlocks *= 2;
     UINT32 numSegments = numBlocks * numData;
     
+    if ((NULL != sender) && (NULL == read_lease))
+    {
+        // Receive streams reserve an extra block's worth of segments
+        // so that segments leased via ReadAcquire() don't starve reception
+        if (NULL == (read_lease = new char*[numData]))
+        {
+            PLOG(PL_FATAL, "NormStreamObject::Open() new read_lease error: %s\n", GetErrorString());
+            Close();
+            return false;
+        }
+        read_lease_max = numData;
+        read_lease_count = 0;
+    }
+    numSegments += read_lease_max;
+    
+    // Blocks still buffered from any previous Open() are returned before
+    // their pool (and the slab their storage is carved from) is replaced
+    EmptyStreamBuffer();
+    stream_buffer.Destroy();
     if (!block_pool.Init(numBlocks, numData))
     {
         PLOG(PL_FATAL, "NormStreamObject::Open() block_pool init error\n");
@@ -2875,7 +3009,7 @@ bool NormStreamObject::Open(UINT32      bufferSize,
         return false;
     }
     
-    if (!stream_buffer.Init(numBlocks, 256, fec_block_mask))
+    if (!stream_buffer.Init(numBlocks, NormBlockBuffer::RING_SIZE_MAX, fec_block_mask))
     {
         PLOG(PL_FATAL, "NormStreamObject::Open() stream_buffer init error\n");
         Close();
@@ -3171,7 +3305,9 @@ UINT16 NormStreamObject::ReadSegment(NormBlockId      blockId,
                 if (!b->IsPending())
                 {
                     // make sure no recent nacking
-                    double delay = session.GetFlowControlDelay() - b->GetNackAge();
+                    struct timeval currentTime;
+                    session.GetCurrentTime(currentTime);
+                    double delay = session.GetFlowControlDelay() - b->GetNackAge(ProtoTime(currentTime));
                     if (delay < 1.0e-06)
                         
                     {
@@ -3216,6 +3352,14 @@ UINT16 NormStreamObject::ReadSegment(NormBlockId      blockId,
 bool NormStreamObject::WriteSegment(NormBlockId   blockId, 
                                     NormSegmentId segmentId, 
                                     const char*   segment)
+{
+    return StoreSegment(blockId, segmentId, segment, false);
+}  // end NormStreamObject::WriteSegment()
+
+bool NormStreamObject::StoreSegment(NormBlockId   blockId, 
+                                    NormSegmentId segmentId, 
+                                    const char*   segment,
+                                    bool          padSegment)
 {
     UINT32 segmentOffset = NormDataMsg::ReadStreamPayloadOffset(segment);
     if (read_init)
@@ -3232,7 +3376,7 @@ bool NormStreamObject::WriteSegment(NormBlockId   blockId,
     if ((Compare(blockId, read_index.block) < 0) ||
         ((blockId == read_index.block) && (segmentId < read_index.segment))) 
     {
-        PLOG(PL_DEBUG, "NormStreamObject::WriteSegment() block/segment < read_index!?\n");
+        PLOG(PL_DEBUG, "NormStreamObject::StoreSegment() block/segment < read_index!?\n");
         return false;
     }  
     
@@ -3259,7 +3403,7 @@ bool NormStreamObject::WriteSegment(NormBlockId   blockId,
             //if (blockId < block->GetId())
             if (Compare(blockId, block->GetId()) < 0)
             {
-                PLOG(PL_DEBUG, "NormStreamObject::WriteSegment() blockId too old!?\n"); 
+                PLOG(PL_DEBUG, "NormStreamObject::StoreSegment() blockId too old!?\n"); 
                 return false;   
             }
             while (block->IsPending())
@@ -3346,11 +3490,11 @@ bool NormStreamObject::WriteSegment(NormBlockId   blockId,
         }  // end while (block_pool.IsEmpty() || !stream_buffer.CanInsert(blockId))
         if (broken)
         {
-            PLOG(PL_WARN, "NormStreamObject::WriteSegment() node>%lu obj>%hu blk>%lu seg>%hu broken stream ...\n",
+            PLOG(PL_WARN, "NormStreamObject::StoreSegment() node>%lu obj>%hu blk>%lu seg>%hu broken stream ...\n",
                             (unsigned long)LocalNodeId(), (UINT16)transport_id, 
                             (unsigned long)blockId.GetValue(), (UINT16)segmentId);
             if (dataLost)
-                PLOG(PL_ERROR, "NormStreamObject::WriteSegment() broken stream data not read by app!\n");
+                PLOG(PL_ERROR, "NormStreamObject::StoreSegment() broken stream data not read by app!\n");
         }    
         block = block_pool.Get();
         block->SetId(blockId);
@@ -3367,12 +3511,14 @@ bool NormStreamObject::WriteSegment(NormBlockId   blockId,
         char* s = segment_pool.Get();
         ASSERT(s != NULL);  // for now, this should always succeed
         UINT16 payloadLength = NormDataMsg::ReadStreamPayloadLength(segment) + NormDataMsg::GetStreamPayloadHeaderLength();
-#ifdef SIMULATE
         UINT16 payloadMax = segment_size + NormDataMsg::GetStreamPayloadHeaderLength();
+#ifdef SIMULATE
         payloadMax = MIN(SIM_PAYLOAD_MAX, payloadMax);
         payloadLength = MIN(payloadMax, payloadLength);  
 #endif // SIMULATE
         memcpy(s, segment, payloadLength);
+        if (padSegment && (payloadLength < payloadMax))
+            memset(s+payloadLength, 0, payloadMax-payloadLength);
         block->AttachSegment(segmentId, s);
         block->SetPending(segmentId);
         
@@ -3398,7 +3544,7 @@ bool NormStreamObject::WriteSegment(NormBlockId   blockId,
         }
     }
     return true;
-}  // end NormStreamObject::WriteSegment()
+}  // end NormStreamObject::StoreSegment()
 
 void NormStreamObject::Prune(NormBlockId blockId, bool updateStatus)
 {
@@ -3533,9 +3679,48 @@ bool NormStreamObject::Read(char* buffer, unsigned int* buflen, bool seekMsgStar
     return result;
 }  // end NormStreamObject::Read()
 
+bool NormStreamObject::ReadAcquire(const char** bufferArray, unsigned int* lengthArray, unsigned int* count)
+{
+    // Slices are appended to any outstanding lease until ReadRelease() is called
+    if (stream_broken)
+    {
+        *count = 0;
+        stream_broken = false;
+        return false;
+    }
+    unsigned int leaseStart = read_lease_count;
+    unsigned int slicesWanted = read_lease_max - leaseStart;
+    if (*count < slicesWanted) slicesWanted = *count;
+    *count = 0;
+    if (0 == slicesWanted) return true;  // must release outstanding lease first
+    // The first lease retains the stream (and its segment_pool) until ReadRelease()
+    // (retained before reading since ReadPrivate() may delete an ended stream)
+    Retain();
+    unsigned int bytesRead = slicesWanted;
+    bool result = ReadPrivate(NULL, &bytesRead, false, bufferArray, lengthArray);
+    if (!read_ready) notify_on_update = true;
+    *count = read_lease_count - leaseStart;
+    if ((0 != leaseStart) || (0 == *count)) Release();
+    return result;
+}  // end NormStreamObject::ReadAcquire()
+
+void NormStreamObject::ReadRelease()
+{
+    if (0 == read_lease_count) return;
+    while (read_lease_count > 0)
+        segment_pool.Put(read_lease[--read_lease_count]);
+    Release();  // may delete this stream if it was closed while leased
+}  // end NormStreamObject::ReadRelease()
+
 
 // Sequential (in order) read/write routines (TBD) Add a "Seek()" method
-bool NormStreamObject::ReadPrivate(char* buffer, unsigned int* buflen, bool seekMsgStart)
+// When "leaseArray" is non-NULL, "*buflen" is the number of slices wanted and the
+// remainder of each in-order segment is detached and leased rather than copied
+bool NormStreamObject::ReadPrivate(char*            buffer, 
+                                   unsigned int*    buflen, 
+                                   bool             seekMsgStart,
+                                   const char**     leaseArray,
+                                   unsigned int*    leaseLengths)
 {
     if (stream_closing || read_init)
     {
@@ -3547,6 +3732,7 @@ bool NormStreamObject::ReadPrivate(char* buffer, unsigned int* buflen, bool seek
     Retain();
     unsigned int bytesRead = 0;
     unsigned int bytesToRead = *buflen;
+    unsigned int leaseBase = read_lease_count;
     bool brokenStream = false;
     do
     {
@@ -3806,6 +3992,7 @@ bool NormStreamObject::ReadPrivate(char* buffer, unsigned int* buflen, bool seek
                 if (0 == NormDataMsg::ReadStreamPayloadLength(segment))
                 {
                     PLOG(PL_DEBUG, "NormStreamObject::ReadPrivate() stream ended by sender 1\n");
+                    session.RecordLatency(NormSession::RX_OBJECT_COMPLETED, latency_start);
                     session.Notify(NormController::RX_OBJECT_COMPLETED, sender, this);
                     stream_closing = true;
                     sender->DeleteObject(this);
@@ -3835,19 +4022,52 @@ bool NormStreamObject::ReadPrivate(char* buffer, unsigned int* buflen, bool seek
             }            
         }
         UINT16 count = length - read_index.offset;
-        count = MIN(count, bytesToRead);
+        if (NULL != leaseArray)
+        {
+            // Lease the remainder of this segment (one slice per segment)
+            if (0 != count)
+            {
+                ASSERT(read_lease_count < read_lease_max);
+                char* leaseSegment;
+                if (IsPendingSet(read_index.block))
+                {
+                    // The block may still be FEC decoded using this segment (see
+                    // RetrieveSegment()), so it stays attached and a copy is leased
+                    if (NULL == (leaseSegment = segment_pool.Get()))
+                    {
+                        // No spare segment, so return the slices leased so far
+                        *buflen = bytesRead;
+                        Release();
+                        return true;
+                    }
+                    memcpy(leaseSegment, segment, length + NormDataMsg::GetStreamPayloadHeaderLength());
+                }
+                else
+                {
+                    leaseSegment = block->DetachSegment(read_index.segment);
+                }
+                leaseArray[read_lease_count - leaseBase] = leaseSegment+read_index.offset+NormDataMsg::GetStreamPayloadHeaderLength();
+                leaseLengths[read_lease_count - leaseBase] = count;
+                read_lease[read_lease_count++] = leaseSegment;
+                bytesToRead--;
+            }
+        }
+        else
+        {
+            count = MIN(count, bytesToRead);
 #ifdef SIMULATE
-        UINT16 simCount = read_index.offset + count + NormDataMsg::GetStreamPayloadHeaderLength();
-        simCount = (simCount < SIM_PAYLOAD_MAX) ? (SIM_PAYLOAD_MAX - simCount) : 0;
-        memcpy(buffer+bytesRead, segment+read_index.offset+NormDataMsg::GetStreamPayloadHeaderLength(), simCount);
+            UINT16 simCount = read_index.offset + count + NormDataMsg::GetStreamPayloadHeaderLength();
+            simCount = (simCount < SIM_PAYLOAD_MAX) ? (SIM_PAYLOAD_MAX - simCount) : 0;
+            memcpy(buffer+bytesRead, segment+read_index.offset+NormDataMsg::GetStreamPayloadHeaderLength(), simCount);
 #else
-        memcpy(buffer+bytesRead, segment+read_index.offset+NormDataMsg::GetStreamPayloadHeaderLength(), count);
+            memcpy(buffer+bytesRead, segment+read_index.offset+NormDataMsg::GetStreamPayloadHeaderLength(), count);
 #endif // if/else SIMULATE
+            bytesToRead -= count;
+        }
         
         read_index.offset += count;
         bytesRead += count;
         read_offset += count;
-        bytesToRead -= count;
         if (read_index.offset >= length)
         {            
             bool streamEnded = (0 == NormDataMsg::ReadStreamPayloadLength(segment));
@@ -3877,6 +4097,7 @@ bool NormStreamObject::ReadPrivate(char* buffer, unsigned int* buflen, bool seek
             if (streamEnded)
             {
                 PLOG(PL_DEBUG, "NormStreamObject::ReadPrivate() stream ended by sender 2\n");
+                session.RecordLatency(NormSession::RX_OBJECT_COMPLETED, latency_start);
                 session.Notify(NormController::RX_OBJECT_COMPLETED, sender, this);
                 stream_closing = true;
                 sender->DeleteObject(this);  
@@ -4011,12 +4232,14 @@ unsigned int NormStreamObject::GetVacancy(unsigned int wanted)
         poolCount = blocksAllowed;
     nBytes += poolCount * ndata * segment_size;
     
+    struct timeval currentTime;
+    session.GetCurrentTime(currentTime);
     NormBlockBuffer::Iterator iterator(block_buffer);
     while ((NULL != (block = iterator.GetNextBlock())) &&
            (blocksAllowed > 0) &&
            ((0 == wanted) || (nBytes < wanted)))
     {
-        double delay = session.GetFlowControlDelay() - block->GetNackAge();
+        double delay = session.GetFlowControlDelay() - block->GetNackAge(ProtoTime(currentTime));
         if (block->IsPending() || (delay >= 1.0e-06)) break;
         nBytes += (segment_size * ndata);
         blocksAllowed--;
@@ -4062,7 +4285,9 @@ UINT32 NormStreamObject::Write(const char* buffer, UINT32 len, bool eom)
             {
                 block = stream_buffer.Find(stream_buffer.RangeLo());
                 ASSERT(NULL != block);
-                double delay = session.GetFlowControlDelay() - block->GetNackAge();
+                struct timeval currentTime;
+                session.GetCurrentTime(currentTime);
+                double delay = session.GetFlowControlDelay() - block->GetNackAge(ProtoTime(currentTime));
                 if (block->IsPending() || (delay >= 1.0e-06))
                 {
                     write_vacancy = false;
@@ -4189,9 +4414,9 @@ UINT32 NormStreamObject::Write(const char* buffer, UINT32 len, bool eom)
             block->SetPending(write_index.segment);
             if (++write_index.segment >= ndata) 
             {
-                ProtoTime currentTime;
-                currentTime.GetCurrentTime();
-                block->SetLastNackTime(currentTime);
+                struct timeval currentTime;
+                session.GetCurrentTime(currentTime);
+                block->SetLastNackTime(ProtoTime(currentTime));
                 Increment(write_index.block);
                 write_index.segment = 0;
             }
@@ -4288,7 +4513,7 @@ char* NormSimObject::RetrieveSegment(NormBlockId   blockId,
 
 NormObjectTable::NormObjectTable()
 #ifndef USE_PROTO_TREE
- : table((NormObject**)NULL), 
+ : table((NormObject**)NULL), ring_mask(0), slot_storage(NULL),
 #else
  :
 #endif // if/else USE_PROTO_TREE
@@ -4302,21 +4527,12 @@ NormObjectTable::~NormObjectTable()
     Destroy();
 }
 
-bool NormObjectTable::Init(UINT16 rangeMax, UINT16 tableSize)
+bool NormObjectTable::Init(UINT16 rangeMax)
 {
     Destroy();
-    if (!rangeMax || !tableSize) return false;
+    if (0 == rangeMax) return false;
 #ifndef USE_PROTO_TREE
-    // Make sure (rangeMax > 0) and tableSize is greater than 0 and 2^n
-    if (!rangeMax || !tableSize) return false;
-    if (0 != (tableSize & 0x07)) tableSize = (tableSize >> 3) + 1;
-    if (!(table = new NormObject*[tableSize]))
-    {
-        PLOG(PL_FATAL, "NormObjectTable::Init() table allocation error: %s\n", GetErrorString());
-        return false;         
-    }
-    memset(table, 0, tableSize*sizeof(char*));
-    hash_mask = tableSize - 1;
+    if (!Resize(rangeMax)) return false;
 #endif  //  !USE_PROTO_TREE
     range_max = rangeMax;
     count = range = 0;
@@ -4324,8 +4540,11 @@ bool NormObjectTable::Init(UINT16 rangeMax, UINT16 tableSize)
     return true;
 }  // end NormObjectTable::Init()
 
-void NormObjectTable::SetRangeMax(UINT16 rangeMax)
+bool NormObjectTable::SetRangeMax(UINT16 rangeMax)
 {
+#ifndef USE_PROTO_TREE
+    if (!Resize(rangeMax)) return false;
+#endif  //  !USE_PROTO_TREE
     if (rangeMax < range_max)
     {
         // Prune if necessary
@@ -4348,6 +4567,7 @@ void NormObjectTable::SetRangeMax(UINT16 rangeMax)
         }
     }
     range_max = rangeMax;
+    return true;
 }  // end NormObjectTable::SetRangeMax()
 
 #ifdef USE_PROTO_TREE
@@ -4375,15 +4595,58 @@ void NormObjectTable::Destroy()
 }  // end NormObjectTable::Destroy()
 
 #else
+
+// Grows (never shrinks) the ring to the smallest power of two covering 
+// "rangeMax" ids, re-indexing any objects already in the table
+bool NormObjectTable::Resize(UINT16 rangeMax)
+{
+    UINT32 ringSize = 1;
+    while (ringSize < rangeMax) ringSize <<= 1;
+    if ((NULL != table) && (ringSize <= (ring_mask + 1))) return true;
+    NormObject** newTable = new NormObject*[ringSize];
+    if (NULL == newTable)
+    {
+        PLOG(PL_FATAL, "NormObjectTable::Resize() table allocation error: %s\n", GetErrorString());
+        return false;         
+    }
+    memset(newTable, 0, ringSize*sizeof(NormObject*));
+    // Occupied slots are also marked in a bitmask so FindNext() and 
+    // FindPrev() skip empty slots a word at a time
+    UINT32* newStorage = new UINT32[NormBlockMask::GetWordCount(ringSize)];
+    if (NULL == newStorage)
+    {
+        PLOG(PL_FATAL, "NormObjectTable::Resize() slot mask allocation error: %s\n", GetErrorString());
+        delete[] newTable;
+        return false;         
+    }
+    slot_mask.Init(newStorage, ringSize);
+    if (NULL != table)
+    {
+        for (UINT32 i = 0; i <= ring_mask; i++)
+        {
+            NormObject* obj = table[i];
+            if (NULL != obj) 
+            {
+                UINT32 index = ((UINT16)obj->GetId()) & (ringSize - 1);
+                newTable[index] = obj;
+                slot_mask.Set(index);
+            }
+        }
+        delete[] table;
+    }
+    if (NULL != slot_storage) delete[] slot_storage;
+    slot_storage = newStorage;
+    table = newTable;
+    ring_mask = ringSize - 1;
+    return true;
+}  // end NormObjectTable::Resize()
+
 NormObject* NormObjectTable::Find(const NormObjectId& objectId) const
 {
     if (0 != range)
     {
         if ((objectId < range_lo)  || (objectId > range_hi)) return (NormObject*)NULL;
-        NormObject* theObject = table[((UINT16)objectId) & hash_mask];
-        while (theObject && (objectId != theObject->GetId())) 
-            theObject = theObject->next;
-        return theObject;
+        return table[((UINT16)objectId) & ring_mask];
     }
     else
     {
@@ -4391,6 +4654,38 @@ NormObject* NormObjectTable::Find(const NormObjectId& objectId) const
     }   
 }  // end NormObjectTable::Find()
 
+// Returns the object with the lowest id greater than "objectId"
+NormObject* NormObjectTable::FindNext(const NormObjectId& objectId) const
+{
+    if ((0 == range) || (objectId >= range_hi)) return (NormObject*)NULL;
+    if (objectId < range_lo) return table[((UINT16)range_lo) & ring_mask];
+    // The first occupied slot following that of "objectId" (wrapping to
+    // the start of the ring) holds the next object (and there is one 
+    // since range_hi is occupied)
+    UINT32 index = (((UINT16)objectId) + 1) & ring_mask;
+    if (!slot_mask.GetNextSet(index))
+    {
+        index = 0;
+        slot_mask.GetNextSet(index);
+    }
+    return table[index];
+}  // end NormObjectTable::FindNext()
+
+// Returns the object with the highest id less than "objectId"
+NormObject* NormObjectTable::FindPrev(const NormObjectId& objectId) const
+{
+    if ((0 == range) || (objectId <= range_lo)) return (NormObject*)NULL;
+    if (objectId > range_hi) return table[((UINT16)range_hi) & ring_mask];
+    // (as for FindNext(), but range_lo is the occupied bound)
+    UINT32 index = (((UINT16)objectId) - 1) & ring_mask;
+    if (!slot_mask.GetPrevSet(index))
+    {
+        index = ring_mask;
+        slot_mask.GetPrevSet(index);
+    }
+    return table[index];
+}  // end NormObjectTable::FindPrev()
+
 void NormObjectTable::Destroy()
 {
     if (NULL != table)
@@ -4406,6 +4701,10 @@ void NormObjectTable::Destroy()
         }
         delete[] table;
         table = (NormObject**)NULL;
+        slot_mask.Destroy();
+        delete[] slot_storage;
+        slot_storage = NULL;
+        ring_mask = 0;
         count = range = range_max = 0;
     }  
 }  // end NormObjectTable::Destroy()
@@ -4471,20 +4770,10 @@ bool NormObjectTable::Insert(NormObject* theObject)
     ASSERT(NULL == Find(theObject->GetId()));
     tree.Insert(*theObject);
 #else
-    UINT16 index = ((UINT16)objectId) & hash_mask;
-    NormObject* prev = NULL;
-    NormObject* entry = table[index];
-    while (entry && (entry->GetId() < objectId)) 
-    {
-        prev = entry;
-        entry = entry->next;
-    }  
-    if (prev)
-        prev->next = theObject;
-    else
-        table[index] = theObject;
-    ASSERT(((NULL != entry) ? (objectId != entry->GetId()) : true));
-    theObject->next = entry;
+    UINT32 index = ((UINT16)objectId) & ring_mask;
+    ASSERT(NULL == table[index]);
+    table[index] = theObject;
+    slot_mask.Set(index);
 #endif  // if/else USE_PROTO_TREE
     count++;
     size = size + theObject->GetSize();
@@ -4545,88 +4834,24 @@ bool NormObjectTable::Remove(NormObject* theObject)
     if (range)
     {
         if ((objectId < range_lo) || (objectId > range_hi)) return false;
-        UINT16 index = ((UINT16)objectId) & hash_mask;
-        NormObject* prev = NULL;
-        NormObject* entry = table[index];
-        while (entry && (entry->GetId() != objectId))
-        {
-            prev = entry;
-            entry = entry->next;
-        }
-        if (entry != theObject) return false;
-        if (prev)
-            prev->next = entry->next;
-        else
-            table[index] = entry->next;
+        UINT32 index = ((UINT16)objectId) & ring_mask;
+        if (table[index] != theObject) return false;
+        table[index] = NULL;
+        slot_mask.Unset(index);
         if (range > 1)
         {
             if (objectId == range_lo)
             {
-                // Find next entry for range_lo
-                UINT16 i = index;
-                UINT16 endex;
-                if (range <= hash_mask)
-                    endex = (index + range - 1) & hash_mask;
-                else
-                    endex = index;
-                entry = NULL;
-                UINT16 offset = 0;
-                NormObjectId nextId = range_hi;
-                do
-                {
-                    ++i &= hash_mask;
-                    offset++;
-                    if ((entry = table[i]))
-                    {
-                        NormObjectId id = (UINT16)objectId + offset;
-                        while(entry && (entry->GetId() != id)) 
-                        {
-                            if ((entry->GetId() > objectId) && 
-                                (entry->GetId() < nextId)) nextId = entry->GetId();
-                            entry = entry->next;
-                               
-                        }
-                        if (entry) break;    
-                    }
-                } while (i != endex);
-                if (entry)
-                    range_lo = entry->GetId();
-                else
-                    range_lo = nextId;
+                NormObject* next = FindNext(objectId);
+                ASSERT(NULL != next);
+                range_lo = next->GetId();
                 range = range_hi - range_lo + 1;
             }
             else if (objectId == range_hi)
             {
-                // Find prev entry for range_hi
-                UINT16 i = index;
-                UINT16 endex;
-                if (range <= hash_mask)
-                    endex = (index - range + 1) & hash_mask;
-                else
-                    endex = index;
-                entry = NULL;
-                UINT16 offset = 0;
-                NormObjectId prevId = range_lo;
-                do
-                {
-                    --i &= hash_mask;
-                    offset++;
-                    if ((entry = table[i]))
-                    {
-                        NormObjectId id = (UINT16)objectId - offset;
-                        while(entry && (entry->GetId() != id)) 
-                        {
-                            if ((entry->GetId() < objectId) && 
-                                (entry->GetId() > prevId)) prevId = entry->GetId();
-                            entry = entry->next;
-                        }
-                        if (entry) break;    
-                    }
-                } while (i != endex);
-                if (entry)
-                    range_hi = entry->GetId();
-                else
-                    range_hi = prevId;
+                NormObject* prev = FindPrev(objectId);
+                ASSERT(NULL != prev);
+                range_hi = prev->GetId();
                 range = range_hi - range_lo + 1;
             } 
         }
@@ -4733,45 +4958,11 @@ NormObject* NormObjectTable::Iterator::GetNextObject()
     }
     else
     {
-        if (table.range && 
-            (index < table.range_hi) && 
-            (index >= table.range_lo))
-        {
-            // Find next entry _after_ current "index"
-            UINT16 i = index;
-            UINT16 endex;
-            if ((UINT16)(table.range_hi - index) <= table.hash_mask)
-                endex = table.range_hi & table.hash_mask;
-            else
-                endex = index;
-            UINT16 offset = 0;
-            NormObjectId nextId = table.range_hi;
-            do
-            {
-                ++i &= table.hash_mask;
-                offset++;
-                NormObjectId id = (UINT16)index + offset;
-                NormObject* entry = table.table[i];
-                while ((NULL != entry) && (entry->GetId() != id)) 
-                {
-                    if ((entry->GetId() > index) && (entry->GetId() < nextId))
-                        nextId = entry->GetId();
-                    entry = table.Next(entry);
-                }
-                if (entry)
-                {
-                    index = entry->GetId();
-                    return entry;   
-                } 
-            } while (i != endex);
-            // If we get here, use nextId value
-            index = nextId;
-            return table.Find(nextId);
-        }
-        else
-        {
-            return (NormObject*)NULL;
-        }
+        // Find next entry _after_ current "index" (which may
+        // have been removed since it was returned)
+        NormObject* nextObj = table.FindNext(index);
+        if (NULL != nextObj) index = nextObj->GetId();
+        return nextObj;
     }   
 }  // end NormObjectTable::Iterator::GetNextObject()
 
@@ -4792,45 +4983,10 @@ NormObject* NormObjectTable::Iterator::GetPrevObject()
     }
     else
     {
-        if (table.range && 
-            (index <= table.range_hi) && 
-            (index > table.range_lo))
-        {
-            // Find prev entry _before_ current "index"
-            UINT16 i = index;
-            UINT16 endex;
-            if ((UINT16)(index - table.range_lo) <= table.hash_mask)
-                endex = table.range_lo & table.hash_mask;
-            else
-                endex = index;
-            UINT16 offset = 0;
-            NormObjectId nextId = table.range_hi;
-            do
-            {
-                --i &= table.hash_mask;
-                offset--;
-                NormObjectId id = (UINT16)index + offset;
-                NormObject* entry = table.table[i];
-                while ((NULL != entry ) && (entry->GetId() != id)) 
-                {
-                    if ((entry->GetId() > index) && (entry->GetId() < nextId))
-                        nextId = entry->GetId();
-                    entry = table.Next(entry);
-                }
-                if (entry)
-                {
-                    index = entry->GetId();
-                    return entry;   
-                } 
-            } while (i != endex);
-            // If we get here, use nextId value
-            index = nextId;
-            return table.Find(nextId);
-        }
-        else
-        {
-            return (NormObject*)NULL;
-        }
+        // Find prev entry _before_ current "index"
+        NormObject* prevObj = table.FindPrev(index);
+        if (NULL != prevObj) index = prevObj->GetId();
+        return prevObj;
     }
 }  // end NormObjectTable::Iterator::GetPrevObject()
 
@@ -86,11 +86,101 @@ char* NormSegmentPool::Get()
 }  // end NormSegmentPool::GetSegment()
 
 
+////////////////////////////////////////////////////////////
+// NormBlockMask Implementation
+
+bool NormBlockMask::SetBits(UINT32 index, UINT32 count)
+{
+    if (0 == count) return true;
+    if ((index + count) > num_bits) return false;
+    UINT32 w = index >> 5;
+    UINT32 endw = (index + count - 1) >> 5;
+    UINT32 first = 0xffffffff << (index & 31);
+    UINT32 last = 0xffffffff >> (31 - ((index + count - 1) & 31));
+    if (w == endw)
+    {
+        mask[w] |= (first & last);
+    }
+    else
+    {
+        mask[w++] |= first;
+        while (w < endw) mask[w++] = 0xffffffff;
+        mask[endw] |= last;
+    }
+    return true;
+}  // end NormBlockMask::SetBits()
+
+void NormBlockMask::UnsetBits(UINT32 index, UINT32 count)
+{
+    if ((0 == count) || (index >= num_bits)) return;
+    if ((index + count) > num_bits) count = num_bits - index;
+    UINT32 w = index >> 5;
+    UINT32 endw = (index + count - 1) >> 5;
+    UINT32 first = 0xffffffff << (index & 31);
+    UINT32 last = 0xffffffff >> (31 - ((index + count - 1) & 31));
+    if (w == endw)
+    {
+        mask[w] &= ~(first & last);
+    }
+    else
+    {
+        mask[w++] &= ~first;
+        while (w < endw) mask[w++] = 0;
+        mask[endw] &= ~last;
+    }
+}  // end NormBlockMask::UnsetBits()
+
+bool NormBlockMask::GetNextSet(UINT32& index) const
+{
+    if (index >= num_bits) return false;
+    UINT32 w = index >> 5;
+    UINT32 word = mask[w] & (0xffffffff << (index & 31));
+    while (0 == word)
+    {
+        if (++w >= num_words) return false;
+        word = mask[w];
+    }
+    index = (w << 5) + NormCtz32(word);
+    return true;
+}  // end NormBlockMask::GetNextSet()
+
+bool NormBlockMask::GetPrevSet(UINT32& index) const
+{
+    if (0 == num_bits) return false;
+    if (index >= num_bits) index = num_bits - 1;
+    UINT32 w = index >> 5;
+    // (bits 0 through "index & 31" of the word)
+    UINT32 word = mask[w] & (((UINT32)2 << (index & 31)) - 1);
+    while (0 == word)
+    {
+        if (0 == w) return false;
+        word = mask[--w];
+    }
+    index = (w << 5) + (31 - NormClz32(word));
+    return true;
+}  // end NormBlockMask::GetPrevSet()
+
+UINT32 NormBlockMask::GetCount(UINT32 index, UINT32 count) const
+{
+    if ((0 == count) || (index >= num_bits)) return 0;
+    if ((index + count) > num_bits) count = num_bits - index;
+    UINT32 w = index >> 5;
+    UINT32 endw = (index + count - 1) >> 5;
+    UINT32 first = 0xffffffff << (index & 31);
+    UINT32 last = 0xffffffff >> (31 - ((index + count - 1) & 31));
+    if (w == endw) return NormPopcnt32(mask[w] & first & last);
+    UINT32 total = NormPopcnt32(mask[w++] & first);
+    while (w < endw) total += NormPopcnt32(mask[w++]);
+    return (total + NormPopcnt32(mask[endw] & last));
+}  // end NormBlockMask::GetCount()
+
+
 ////////////////////////////////////////////////////////////
 // NormBlock Implementation
 
 NormBlock::NormBlock()
- : size(0), segment_table(NULL), erasure_count(0), parity_count(0), next(NULL)
+ : size(0), segment_table(NULL), erasure_count(0), parity_count(0), 
+   own_storage(NULL), next(NULL)
 {
 }     
 
@@ -99,27 +189,33 @@ NormBlock::~NormBlock()
     Destroy();
 }
 
-bool NormBlock::Init(UINT16 totalSize)
+// Storage is laid out as pending mask words, repair mask words, then the
+// segment table, rounded up to a whole number of cache lines
+unsigned int NormBlock::GetStorageSize(UINT16 totalSize)
+{
+    // (mask words are kept to an even count so the segment table is pointer aligned)
+    unsigned int maskWords = (NormBlockMask::GetWordCount(totalSize) + 1) & ~1;
+    unsigned int storageSize = 2*maskWords*sizeof(UINT32) + totalSize*sizeof(char*);
+    return ((storageSize + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1));
+}  // end NormBlock::GetStorageSize()
+
+bool NormBlock::Init(UINT16 totalSize, char* storage)
 {
     if (segment_table) Destroy();
-    if (!(segment_table = new char*[totalSize]))
+    if (NULL == storage)
     {
-        PLOG(PL_FATAL, "NormBlock::Init() segment_table allocation error: %s\n", GetErrorString());
-        return false;   
+        if (NULL == (own_storage = new char[GetStorageSize(totalSize)]))
+        {
+            PLOG(PL_FATAL, "NormBlock::Init() storage allocation error: %s\n", GetErrorString());
+            return false;   
+        }
+        storage = own_storage;
     }
+    UINT32 maskWords = (NormBlockMask::GetWordCount(totalSize) + 1) & ~1;
+    pending_mask.Init((UINT32*)storage, totalSize);
+    repair_mask.Init(((UINT32*)storage) + maskWords, totalSize);
+    segment_table = (char**)(storage + 2*maskWords*sizeof(UINT32));
     memset(segment_table, 0, totalSize*sizeof(char*));
-    if (!pending_mask.Init(totalSize))
-    {
-        PLOG(PL_FATAL, "NormBlock::Init() pending_mask allocation error: %s\n", GetErrorString());
-        Destroy();
-        return false;   
-    }
-    if (!repair_mask.Init(totalSize))
-    {
-        PLOG(PL_FATAL, "NormBlock::Init() repair_mask allocation error: %s\n", GetErrorString());
-        Destroy();
-        return false;   
-    }
     size = totalSize;
     erasure_count = 0;
     parity_count = 0;
@@ -140,9 +236,13 @@ void NormBlock::Destroy()
             ASSERT(!segment_table[i]);
             if (segment_table[i]) delete []segment_table[i];
         }
-        delete []segment_table;
         segment_table = (char**)NULL;
     }
+    if (NULL != own_storage)
+    {
+        delete[] own_storage;
+        own_storage = NULL;
+    }
     erasure_count = parity_count = size = 0;
 }  // end NormBlock::Destroy()
 
@@ -497,19 +597,8 @@ NormObjectSize NormBlock::GetBytesPending(UINT16      numData,
                                           NormBlockId finalBlockId,
                                           UINT16      finalSegmentSize) const
 {
-    NormObjectSize pendingBytes(0);
-    NormSegmentId nextId;
-    if (GetFirstPending(nextId))
-    {
-        do
-        {
-            if (nextId < numData)
-                pendingBytes += NormObjectSize(segmentSize);
-            else
-                break;
-            nextId++;
-        } while (GetNextPending(nextId));        
-    }
+    NormObjectSize pendingBytes = 
+        NormObjectSize(segmentSize) * NormObjectSize(GetPendingCount(0, numData));
     // Correct for final_segment_size, if applicable
     if ((blk_id == finalBlockId) && IsPending(numData - 1))
     {
@@ -631,7 +720,8 @@ bool NormBlock::AppendRepairRequest(NormNackMsg&    nack,
 }  // end NormBlock::AppendRepairRequest()
          
 NormBlockPool::NormBlockPool()
- : head((NormBlock*)NULL), blk_total(0), blk_count(0), overruns(0), overrun_flag(false)
+ : head((NormBlock*)NULL), blk_total(0), blk_count(0), overruns(0), overrun_flag(false),
+   slab(NULL)
 {
 }
 
@@ -642,13 +732,23 @@ NormBlockPool::~NormBlockPool()
 
 bool NormBlockPool::Init(UINT32 numBlocks, UINT16 segsPerBlock)
 {
-    if (head) Destroy();
+    if (head || slab) Destroy();
+    // The blocks' masks and segment tables are carved from one slab, 
+    // with each block's storage starting on a cache line boundary
+    unsigned long storageSize = NormBlock::GetStorageSize(segsPerBlock);
+    if (NULL == (slab = new char[numBlocks*storageSize + NormBlock::CACHE_LINE_SIZE]))
+    {
+        PLOG(PL_FATAL, "NormBlockPool::Init() slab allocation error: %s\n", GetErrorString());
+        return false;
+    }
+    char* storage = slab + ((NormBlock::CACHE_LINE_SIZE - ((size_t)slab & (NormBlock::CACHE_LINE_SIZE - 1))) &
+                            (NormBlock::CACHE_LINE_SIZE - 1));
     for (UINT32 i = 0; i < numBlocks; i++)
     {
         NormBlock* b = new NormBlock();
         if (b)
         {
-            if (!b->Init(segsPerBlock))
+            if (!b->Init(segsPerBlock, storage + i*storageSize))
             {
                 PLOG(PL_FATAL, "NormBlockPool::Init() block init error\n");
                 delete b;
@@ -672,13 +772,22 @@ bool NormBlockPool::Init(UINT32 numBlocks, UINT16 segsPerBlock)
 
 void NormBlockPool::Destroy()
 {
+    // (blocks must be returned before the slab their storage is carved from is freed)
     ASSERT(blk_total == blk_count);
+    if (blk_total != blk_count)
+        PLOG(PL_ERROR, "NormBlockPool::Destroy() error: %lu blocks outstanding\n", 
+                       (unsigned long)(blk_total - blk_count));
     NormBlock* next;
     while ((next = head))
     {
         head = next->next;
         delete next;   
     }
+    if (NULL != slab)
+    {
+        delete[] slab;
+        slab = NULL;
+    }
     blk_count = blk_total = 0;
 }  // end NormBlockPool::Destroy()
 
@@ -686,7 +795,7 @@ NormBlockBuffer::NormBlockBuffer()
 #ifdef USE_PROTO_TREE
  :
 #else
- : table((NormBlock**)NULL), 
+ : table((NormBlock**)NULL), ring_mask(0), slot_storage(NULL),
 #endif  // if/else USE_PROTO_TREE
    range_max(0), range(0), fec_block_mask(0)
 {
@@ -709,14 +818,28 @@ bool NormBlockBuffer::Init(unsigned long rangeMax, unsigned long tableSize, UINT
         return false;
     }
 #ifndef USE_PROTO_TREE
-    if (0 != (tableSize & 0x07)) tableSize = (tableSize >> 3) + 1;
-    if (!(table = new NormBlock*[tableSize]))
+    // The ring is the smallest power of two covering "rangeMax" (but no 
+    // larger than needed for "tableSize") so a window of blocks up to 
+    // the ring size maps to distinct slots
+    unsigned long ringSize = 1;
+    while ((ringSize < rangeMax) && (ringSize < tableSize)) ringSize <<= 1;
+    if (NULL == (table = new NormBlock*[ringSize]))
     {
         PLOG(PL_FATAL, "NormBlockBuffer::Init() buffer allocation error: %s\n", GetErrorString());
         return false;         
     }
-    memset(table, 0, tableSize*sizeof(char*));
-    hash_mask = tableSize - 1;
+    memset(table, 0, ringSize*sizeof(NormBlock*));
+    // Occupied slots are also marked in a bitmask so FindNext() and 
+    // FindPrev() skip empty slots a word at a time
+    if (NULL == (slot_storage = new UINT32[NormBlockMask::GetWordCount((UINT32)ringSize)]))
+    {
+        PLOG(PL_FATAL, "NormBlockBuffer::Init() slot mask allocation error: %s\n", GetErrorString());
+        delete[] table;
+        table = (NormBlock**)NULL;
+        return false;
+    }
+    slot_mask.Init(slot_storage, (UINT32)ringSize);
+    ring_mask = ringSize - 1;
 #endif // !USE_PROTO_TREE
     range_max = rangeMax;
     range = 0;
@@ -761,6 +884,12 @@ void NormBlockBuffer::Destroy()
         delete []table;
         table = (NormBlock**)NULL;
     }  
+    if (NULL != slot_storage)
+    {
+        slot_mask.Destroy();
+        delete[] slot_storage;
+        slot_storage = NULL;
+    }
     range_max = range = 0;  
 }  // end NormBlockBuffer::Destroy()
 
@@ -771,7 +900,7 @@ NormBlock* NormBlockBuffer::Find(const NormBlockId& blockId) const
         //if ((blockId < range_lo)  || (blockId > range_hi)) 
         if ((Compare(blockId, range_lo) < 0) || (Compare(blockId, range_hi) > 0))
             return (NormBlock*)NULL;
-        NormBlock* theBlock = table[(blockId.GetValue()) & hash_mask];
+        NormBlock* theBlock = table[blockId.GetValue() & ring_mask];
         while ((NULL != theBlock) && (blockId != theBlock->GetId())) 
             theBlock = theBlock->next;
         return theBlock;
@@ -860,7 +989,7 @@ bool NormBlockBuffer::Insert(NormBlock* theBlock)
     ASSERT(NULL == Find(theBlock->GetId()));
     tree.Insert(*theBlock);
 #else
-    UINT32 index = blockId.GetValue() & hash_mask;
+    UINT32 index = blockId.GetValue() & ring_mask;
     NormBlock* prev = NULL;
     NormBlock* entry = table[index];
     // while (entry && (entry->GetId() < blockId)) 
@@ -873,6 +1002,7 @@ bool NormBlockBuffer::Insert(NormBlock* theBlock)
         prev->next = theBlock;
     else
         table[index] = theBlock;
+    slot_mask.Set(index);
     ASSERT((entry ? (blockId != entry->GetId()) : true));
     theBlock->next = entry;
 #endif // if/else USE_PROTO_TREE
@@ -926,120 +1056,155 @@ bool NormBlockBuffer::Remove(NormBlock* theBlock)
 bool NormBlockBuffer::Remove(NormBlock* theBlock)
 {
     ASSERT(NULL != theBlock);
-    if (range)
+    if (0 == range) return false;
+    const NormBlockId& blockId = theBlock->GetId();
+    // if ((blockId < range_lo) || (blockId > range_hi)) 
+    if ((Compare(blockId, range_lo) < 0) || (Compare(blockId, range_hi) > 0))
+        return false;
+    UINT32 index = blockId.GetValue() & ring_mask;
+    NormBlock* prev = NULL;
+    NormBlock* entry = table[index];
+    while ((NULL != entry) && (entry != theBlock))
     {
-        const NormBlockId& blockId = theBlock->GetId();
-        // if ((blockId < range_lo) || (blockId > range_hi)) 
-        if ((Compare(blockId, range_lo) < 0) || (Compare(blockId, range_hi) > 0))
-            return false;
-        UINT32 index = blockId.GetValue() & hash_mask;
-        NormBlock* prev = NULL;
-        NormBlock* entry = table[index];
-        while (entry && (entry->GetId() != blockId))
+        prev = entry;
+        entry = entry->next;
+    }
+    if (NULL == entry) return false;
+    if (NULL != prev)
+        prev->next = entry->next;
+    else if (NULL == (table[index] = entry->next))
+        slot_mask.Unset(index);
+    if (range > 1)
+    {
+        if (blockId == range_lo)
         {
-            prev = entry;
-            entry = entry->next;
+            entry = FindNext(blockId);
+            ASSERT(NULL != entry);
+            range_lo = entry->GetId();
+            range = (UINT32)Difference(range_hi, range_lo) + 1; 
         }
-        if (NULL == entry) return false;
-        if (NULL != prev)
-            prev->next = entry->next;
-        else
-            table[index] = entry->next;
-        
-        if (range > 1)
+        else if (blockId == range_hi)
         {
-            if (blockId == range_lo)
+            entry = FindPrev(blockId);
+            ASSERT(NULL != entry);
+            range_hi = entry->GetId();
+            range = (UINT32)Difference(range_hi, range_lo) + 1;
+        }
+        // else range unchanged
+    }
+    else
+    {
+        range = 0;
+    }  
+    return true;
+}  // end NormBlockBuffer::Remove()
+
+// Returns the buffered block with the lowest id greater than "blockId".
+// Occupied ring slots following that of "blockId" are visited in turn
+// (using the slot mask to skip empty ones), so for a window within the
+// ring size the first occupied slot holds the next block.  When the range
+// exceeds the ring size, the whole ring is visited once and the lowest
+// id seen in the (then shared) slot chains is used.
+NormBlock* NormBlockBuffer::FindNext(const NormBlockId& blockId) const
+{
+    // if ((0 == range) || (blockId >= range_hi))
+    if ((0 == range) || (Compare(blockId, range_hi) >= 0))
+        return (NormBlock*)NULL;
+    // else if (blockId < range_lo)
+    else if (Compare(blockId, range_lo) < 0)
+        return Find(range_lo);
+    UINT32 ringSize = (UINT32)ring_mask + 1;
+    UINT32 span = (UINT32)Difference(range_hi, blockId);
+    if (span > ringSize) span = ringSize;
+    UINT32 start = (blockId.GetValue() + 1) & ring_mask;
+    NormBlock* nextBlock = NULL;
+    UINT32 offset = 0;  // slots visited after "start"
+    while (offset < span)
+    {
+        // Find the next occupied slot up to the end of the ring
+        UINT32 slot = (start + offset) & ring_mask;
+        UINT32 end = slot + (span - offset);
+        if (end > ringSize) end = ringSize;
+        UINT32 next = slot;
+        if (!slot_mask.GetNextSet(next) || (next >= end))
+        {
+            offset += (end - slot);  // (wraps to slot zero)
+            continue;
+        }
+        offset += (next - slot);
+        NormBlockId id = blockId;
+        Increment(id, offset + 1);
+        // (chains are sorted, so the first entry after "blockId" is the lowest)
+        NormBlock* entry = table[next];
+        while (NULL != entry)
+        {
+            // if (entry->GetId() > blockId)
+            if (Compare(entry->GetId(), blockId) > 0)
             {
-                // Find next entry for new range_lo
-                UINT32 i = index;
-                UINT32 endex;
-                if (range <= hash_mask)
-                    endex = (index + range - 1) & hash_mask;
-                else
-                    endex = index;
-                entry = NULL;
-                UINT32 offset = 0;
-                NormBlockId nextId = range_hi;
-                do
-                {
-                    ++i &= hash_mask;
-                    offset++;
-                    if (NULL != (entry = table[i]))
-                    {
-                        // NormBlockId id = blockId + offset;
-                        NormBlockId id = blockId;
-                        Increment(id, offset);
-                        while(entry && (entry->GetId() != id)) 
-                        {
-                            // if ((entry->GetId() > blockId) && (entry->GetId() < nextId)
-                            if ((Compare(entry->GetId(), blockId) > 0) &&
-                                (Compare(entry->GetId(), nextId) < 0))
-                            { 
-                                nextId = entry->GetId();
-                            }
-                            entry = entry->next;
-                        }
-                        if (NULL != entry) break;    
-                    }
-                } while (i != endex);
-                if (NULL != entry)
-                    range_lo = entry->GetId();
-                else
-                    range_lo = nextId;
-                range = (UINT32)Difference(range_hi, range_lo) + 1; 
+                if (id == entry->GetId()) return entry;
+                // if (entry->GetId() < nextBlock->GetId())
+                if ((NULL == nextBlock) || (Compare(entry->GetId(), nextBlock->GetId()) < 0))
+                    nextBlock = entry;
+                break;
             }
-            else if (blockId == range_hi)
-            {
-                // Find prev entry for new range_hi
-                UINT32 i = index;
-                UINT32 endex;
-                if (range <= hash_mask)
-                    endex = (index - range + 1) & hash_mask;
-                else
-                    endex = index;
-                entry = NULL;
-                UINT32 offset = 0;
-                NormBlockId prevId = range_lo;
-                do
-                {
-                    --i &= hash_mask;
-                    offset++;
-                    if ((entry = table[i]))
-                    {
-                        // NormBlockId id = blockId - offset;
-                        NormBlockId id = blockId;
-                        Decrement(id, offset);
-                        while(entry && (entry->GetId() != id)) 
-                        {
-                            // if ((entry->GetId() < blockId) && (entry->GetId() > prevId)) 
-                            if ((Compare(entry->GetId(), blockId) < 0) && 
-                                (Compare(entry->GetId(), prevId) > 0))
-                            {  
-                                prevId = entry->GetId();
-                            }
-                            entry = entry->next;
-                        }
-                        if (NULL != entry) break;    
-                    }
-                } while (i != endex);
-                if (NULL != entry)
-                    range_hi = entry->GetId();
-                else 
-                    range_hi = prevId;
-                range = (UINT32)Difference(range_hi, range_lo) + 1;
-            } 
+            entry = entry->next;
         }
-        else
-        {
-            range = 0;
-        }  
-        return true;
+        offset++;
     }
-    else
+    return nextBlock;
+}  // end NormBlockBuffer::FindNext()
+
+// Returns the buffered block with the highest id less than "blockId"
+// (visiting occupied slots preceding that of "blockId" as FindNext() does)
+NormBlock* NormBlockBuffer::FindPrev(const NormBlockId& blockId) const
+{
+    // if ((0 == range) || (blockId <= range_lo))
+    if ((0 == range) || (Compare(blockId, range_lo) <= 0))
+        return (NormBlock*)NULL;
+    // else if (blockId > range_hi)
+    else if (Compare(blockId, range_hi) > 0)
+        return Find(range_hi);
+    UINT32 ringSize = (UINT32)ring_mask + 1;
+    UINT32 span = (UINT32)Difference(blockId, range_lo);
+    if (span > ringSize) span = ringSize;
+    UINT32 start = (blockId.GetValue() - 1) & ring_mask;
+    NormBlock* prevBlock = NULL;
+    UINT32 offset = 0;  // slots visited before "start"
+    while (offset < span)
     {
-        return false;
+        // Find the previous occupied slot down to the start of the ring
+        UINT32 slot = (start - offset) & ring_mask;
+        UINT32 count = span - offset;
+        UINT32 begin = (count > slot) ? 0 : (slot + 1 - count);
+        UINT32 prev = slot;
+        if (!slot_mask.GetPrevSet(prev) || (prev < begin))
+        {
+            offset += (slot + 1 - begin);  // (wraps to the last slot)
+            continue;
+        }
+        offset += (slot - prev);
+        NormBlockId id = blockId;
+        Decrement(id, offset + 1);
+        // (chains are sorted, so the last entry before "blockId" is the highest)
+        NormBlock* candidate = NULL;
+        NormBlock* entry = table[prev];
+        // while (entry && (entry->GetId() < blockId))
+        while ((NULL != entry) && (Compare(entry->GetId(), blockId) < 0))
+        {
+            candidate = entry;
+            entry = entry->next;
+        }
+        if (NULL != candidate)
+        {
+            if (id == candidate->GetId()) return candidate;
+            // if (candidate->GetId() > prevBlock->GetId())
+            if ((NULL == prevBlock) || (Compare(candidate->GetId(), prevBlock->GetId()) > 0))
+                prevBlock = candidate;
+        }
+        offset++;
     }
-}  // end NormBlockBuffer::Remove()
+    return prevBlock;
+}  // end NormBlockBuffer::FindPrev()
 
 #endif // if/else USE_PROTO_TREE
 
@@ -1092,7 +1257,7 @@ NormBlock* NormBlockBuffer::Iterator::GetNextBlock()
 {
     if (reset)
     {
-        if (buffer.range)
+        if (0 != buffer.range)
         {
             reset = false;
             index = buffer.range_lo;
@@ -1105,54 +1270,11 @@ NormBlock* NormBlockBuffer::Iterator::GetNextBlock()
     }
     else
     {
-        // if (buffer.range && (index < buffer.range_hi) &&  (index >= buffer.range_lo))
-        if ((0 != buffer.range) &&
-            (buffer.Compare(index, buffer.range_hi) < 0) &&
-            (buffer.Compare(index, buffer.range_lo) >= 0))
-        {
-            // Find next entry _after_ current "index"
-            UINT32 i = index.GetValue();;
-            UINT32 endex;
-            // if ((UINT32)(buffer.range_hi - index) <= buffer.hash_mask)
-            if ((UINT32)buffer.Difference(buffer.range_hi, index) <= buffer.hash_mask)
-                endex = buffer.range_hi.GetValue() & buffer.hash_mask;
-            else
-                endex = index.GetValue();
-            UINT32 offset = 0;
-            NormBlockId nextId = buffer.range_hi;
-            do
-            {
-                ++i &= buffer.hash_mask;
-                offset++;
-                // NormBlockId id = (UINT32)index + offset;
-                NormBlockId id = index;
-                buffer.Increment(id, offset);
-                ASSERT(i < 256);
-                NormBlock* entry = buffer.table[i];
-                while ((NULL != entry ) && (entry->GetId() != id)) 
-                {
-                    // if ((entry->GetId() > index) && (entry->GetId() < nextId))
-                    if ((buffer.Compare(entry->GetId(), index) > 0) && 
-                        (buffer.Compare(entry->GetId(), nextId) < 0))
-                    {
-                        nextId = entry->GetId();
-                    }
-                    entry = NormBlockBuffer::Next(entry);
-                }
-                if (entry)
-                {
-                    index = entry->GetId();
-                    return entry;   
-                } 
-            } while (i != endex);
-            // If we get here, use nextId value
-            index = nextId;
-            return buffer.Find(nextId);
-        }
-        else
-        {
-            return (NormBlock*)NULL;
-        }
+        // Find next entry _after_ current "index" (which may have
+        // been removed from the buffer since it was returned)
+        NormBlock* nextBlock = buffer.FindNext(index);
+        if (NULL != nextBlock) index = nextBlock->GetId();
+        return nextBlock;
     }   
 }  // end NormBlockBuffer::Iterator::GetNextBlock()
 
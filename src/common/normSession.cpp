@@ -1,14 +1,26 @@
 #include "normSession.h"
+#include "normDebug.h"  // for NLOG()
 
 #include "normEncoderMDP.h"  // "legacy" MDP Reed-Solomon encoder
 #include "normEncoderRS8.h"  // 8-bit Reed-Solomon encoder of RFC 5510
 #include "normEncoderRS16.h" // 16-bit Reed-Solomon encoder of RFC 5510
 
 #include <time.h>  // for gmtime() in NormTrace()
+#include <stdlib.h>  // for qsort()
 
 #include "protoPktETH.h"
 #include "protoPktIP.h"
 
+#ifdef LINUX
+#include <linux/filter.h>  // for receive fan-out BPF steering
+#endif // LINUX
+
+#if !defined(SIMULATE) && !defined(WIN32) && (defined(SO_TIMESTAMPNS) || defined(SO_TIMESTAMP))
+#define NORM_RX_TIMESTAMP 1
+#include <sys/uio.h>    // for struct iovec
+#include <errno.h>
+#endif // !SIMULATE && !WIN32 && (SO_TIMESTAMPNS || SO_TIMESTAMP)
+
 const UINT8 NormSession::DEFAULT_TTL = 255; 
 const double NormSession::DEFAULT_TRANSMIT_RATE = 64000.0; // bits/sec
 const double NormSession::DEFAULT_GRTT_INTERVAL_MIN = 1.0;        // sec
@@ -40,21 +52,24 @@ enum NormSocketCommand
 };
 
 NormSession::NormSession(NormSessionMgr& sessionMgr, NormNodeId localNodeId) 
- : session_mgr(sessionMgr), notify_pending(false), tx_port(0), tx_port_reuse(false),
+ : session_mgr(sessionMgr), timer_wheel(sessionMgr.GetTimerMgr(), session_clock), notify_pending(false), tx_port(0), tx_port_reuse(false),
    tx_socket_actual(ProtoSocket::UDP), tx_socket(&tx_socket_actual), 
-   rx_socket(ProtoSocket::UDP), rx_cap(NULL), rx_port_reuse(false), local_node_id(localNodeId), 
+   rx_socket(ProtoSocket::UDP), rx_cap(NULL), rx_port_reuse(false), 
+   rx_fanout_index(0), rx_fanout_count(1), rx_timestamping(false), 
+   rx_socket_tstamp(false), tx_socket_tstamp(false), local_node_id(localNodeId), 
    ttl(DEFAULT_TTL), tos(0), loopback(false), mcast_loopback(false), fragmentation(false), ecn_enabled(false), 
    tx_rate(DEFAULT_TRANSMIT_RATE/8.0), tx_rate_min(-1.0), tx_rate_max(-1.0), tx_residual(0),
    backoff_factor(DEFAULT_BACKOFF_FACTOR), is_sender(false), 
    tx_robust_factor(DEFAULT_ROBUST_FACTOR), instance_id(0),
    ndata(DEFAULT_NDATA), nparity(DEFAULT_NPARITY), auto_parity(0), extra_parity(0),
-   sndr_emcon(false), tx_only(false), tx_connect(false), fti_mode(FTI_ALWAYS), encoder(NULL), 
+   sndr_emcon(false), tx_only(false), tx_connect(false), fti_mode(FTI_ALWAYS), tx_nack_batching(false), encoder(NULL), 
    next_tx_object_id(0), 
    tx_cache_count_min(DEFAULT_TX_CACHE_MIN), 
    tx_cache_count_max(DEFAULT_TX_CACHE_MAX),
    tx_cache_size_max(DEFAULT_TX_CACHE_SIZE),
    posted_tx_queue_empty(false), posted_tx_rate_changed(false), posted_send_error(false),
-   acking_node_count(0), acking_auto_populate(TRACK_NONE), watermark_pending(false), watermark_flushes(false),
+   acking_node_count(0), acking_success_count(0), acking_node_index(NULL), acking_index_size(0),
+   acking_mask_words(NULL), acking_node_none(NULL), acking_auto_populate(TRACK_NONE), watermark_pending(false), watermark_flushes(false),
    tx_repair_pending(false), advertise_repairs(false),
    suppress_nonconfirmed(false), suppress_rate(-1.0), suppress_rtt(-1.0),
    probe_proactive(true), probe_pending(false), probe_reset(true), probe_data_check(false),
@@ -69,6 +84,8 @@ NormSession::NormSession(NormSessionMgr& sessionMgr, NormNodeId localNodeId)
    cmd_count(0), cmd_buffer(NULL), cmd_length(0), syn_status(false),
    ack_ex_buffer(NULL), ack_ex_length(0),
    is_receiver(false), rx_robust_factor(DEFAULT_ROBUST_FACTOR), preset_sender(NULL), unicast_nacks(false), 
+   local_repair(false), local_repair_ttl(1), ack_aggregator_id(NORM_NODE_NONE),
+   agg_member_list(NULL), agg_member_count(0), agg_member_max(0),
    receiver_silent(false), rcvr_ignore_info(false), rcvr_max_delay(-1), rcvr_realtime(false),
    default_repair_boundary(NormSenderNode::BLOCK_BOUNDARY), 
    default_nacking_mode(NormObject::NACK_NORMAL), default_sync_policy(NormSenderNode::SYNC_CURRENT),
@@ -78,6 +95,10 @@ NormSession::NormSession(NormSessionMgr& sessionMgr, NormNodeId localNodeId)
    user_data(NULL), next(NULL)
 {
     interface_name[0] = '\0';
+    memset(&stats, 0, sizeof(stats));
+    stats_packet_count = 0;
+    tx_repair_nack_time.tv_sec = tx_repair_nack_time.tv_usec = 0;
+    tx_repair_latency_pending = false;
     tx_socket_actual.SetNotifier(&sessionMgr.GetSocketNotifier());
     tx_socket_actual.SetListener(this, &NormSession::TxSocketRecvHandler);
     tx_address.Invalidate();
@@ -128,6 +149,13 @@ NormSession::NormSession(NormSessionMgr& sessionMgr, NormNodeId localNodeId)
     user_timer.SetListener(this, &NormSession::OnUserTimeout);
     user_timer.SetInterval(0.0);
     user_timer.SetRepeat(0);
+    
+    // This timer publishes statistics snapshots while there is traffic
+    // (It is activated by the send/receive paths and goes idle when
+    //  the traffic stops, see OnStatsTimeout())
+    stats_timer.SetListener(this, &NormSession::OnStatsTimeout);
+    stats_timer.SetInterval(0.1);
+    stats_timer.SetRepeat(-1);
 }
 
 NormSession::~NormSession()
@@ -139,6 +167,12 @@ NormSession::~NormSession()
         preset_sender = NULL;
     }
     Close();
+    if (NULL != agg_member_list)
+    {
+        delete[] agg_member_list;
+        agg_member_list = NULL;
+        agg_member_count = agg_member_max = 0;
+    }
 }
 
 bool NormSession::Open()
@@ -182,6 +216,12 @@ bool NormSession::Open()
                     return false;
                 }
             }
+            if (rx_timestamping)
+            {
+                // (unicast feedback to the sender arrives on the tx_socket)
+                if (!(tx_socket_tstamp = EnableRxTimestamps(*tx_socket)))
+                    PLOG(PL_WARN, "NormSession::Open() warning: unable to enable tx_socket receive timestamps\n");
+            }
         }
         else
         {
@@ -197,7 +237,7 @@ bool NormSession::Open()
             return false;   
         }
         rx_socket.EnableRecvDstAddr();
-        if (rx_port_reuse)
+        if (rx_port_reuse || (rx_fanout_count > 1))
         {
 			// Enable port/addr reuse and bind socket to destination address 
             if (!rx_socket.SetReuse(true))
@@ -236,6 +276,13 @@ bool NormSession::Open()
                 return false;
             }
         }
+        if ((rx_fanout_count > 1) && !AttachRxFanoutFilter())
+            PLOG(PL_WARN, "NormSession::Open() warning: unable to attach rx fan-out filter\n");
+        if (rx_timestamping)
+        {
+            if (!(rx_socket_tstamp = EnableRxTimestamps(rx_socket)))
+                PLOG(PL_WARN, "NormSession::Open() warning: unable to enable rx_socket receive timestamps\n");
+        }
     }
     if (ecn_enabled)
     {
@@ -380,12 +427,14 @@ bool NormSession::Open()
 void NormSession::Close()
 {
     if (report_timer.IsActive()) report_timer.Deactivate();
+    if (stats_timer.IsActive()) stats_timer.Deactivate();
     if (is_sender) StopSender();
     if (is_receiver) StopReceiver();
     if (tx_timer.IsActive()) tx_timer.Deactivate();    
     message_queue.Destroy();
     message_pool.Destroy();
     if (tx_socket->IsOpen()) tx_socket->Close();
+    tx_socket_tstamp = rx_socket_tstamp = false;
     if (rx_socket.IsOpen()) 
     {
         if (address.IsMulticast()) 
@@ -487,6 +536,210 @@ bool NormSession::SetRxPortReuse(bool           enableReuse,
     return result;
 }  // end NormSession::SetRxPortReuse()
 
+// This must be called _before_ receiver is started
+bool NormSession::SetRxFanout(unsigned int memberIndex, unsigned int memberCount)
+{
+    if (0 == memberCount) memberCount = 1;
+    if (memberIndex >= memberCount)
+    {
+        PLOG(PL_ERROR, "NormSession::SetRxFanout() error: invalid member index %u\n", memberIndex);
+        return false;
+    }
+    rx_fanout_index = memberIndex;
+    rx_fanout_count = memberCount;
+    return true;
+}  // end NormSession::SetRxFanout()
+
+// Datagrams are steered by NormSession::GetRxFanoutKey() modulo the group 
+// size.  For unicast, a reuseport program picks the group socket so each
+// remote sender always lands on the same member.  Multicast is delivered to
+// every member socket, so each one instead drops datagrams keyed to other
+// members (and HandleReceiveMessage() does the same where BPF is missing)
+bool NormSession::AttachRxFanoutFilter()
+{
+#ifdef LINUX
+    bool mcast = Address().IsMulticast();
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+    if (!mcast) return false;  // kernel flow hash steering still applies
+#endif // !SO_ATTACH_REUSEPORT_CBPF
+    UINT32 base = mcast ? 8 : 0;  // socket filters see the UDP header, reuseport programs don't
+    struct sock_filter code[] = 
+    {
+        BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, base),                  // 0: message type
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0f),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, NormMsg::NACK, 3, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, NormMsg::ACK, 2, 0),
+        BPF_STMT(BPF_LD  | BPF_W | BPF_ABS, base + 4),              // 4: source id
+        BPF_STMT(BPF_JMP | BPF_JA, 1),
+        BPF_STMT(BPF_LD  | BPF_W | BPF_ABS, base + 8),              // 6: feedback sender id
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, rx_fanout_count),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, rx_fanout_index, 0, 1), // 8: ours?
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+        BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+    struct sock_fprog prog;
+    prog.filter = code;
+    int option = SO_ATTACH_FILTER;
+    if (mcast)
+    {
+        prog.len = sizeof(code) / sizeof(struct sock_filter);
+    }
+    else
+    {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+        // Return the key modulo group size as the group socket index
+        struct sock_filter retA = BPF_STMT(BPF_RET | BPF_A, 0);
+        code[8] = retA;
+        prog.len = 9;
+        option = SO_ATTACH_REUSEPORT_CBPF;
+#endif // SO_ATTACH_REUSEPORT_CBPF
+    }
+    if (0 != setsockopt(rx_socket.GetHandle(), SOL_SOCKET, option, &prog, sizeof(prog)))
+    {
+        PLOG(PL_ERROR, "NormSession::AttachRxFanoutFilter() setsockopt() error: %s\n", GetErrorString());
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif // if/else LINUX
+}  // end NormSession::AttachRxFanoutFilter()
+
+// This must be called _before_ sender or receiver is started
+bool NormSession::SetRxTimestamping(bool enable)
+{
+#ifdef NORM_RX_TIMESTAMP
+    rx_timestamping = enable;
+    return true;
+#else
+    if (enable)
+    {
+        PLOG(PL_ERROR, "NormSession::SetRxTimestamping() error: not supported on this platform\n");
+        return false;
+    }
+    rx_timestamping = false;
+    return true;
+#endif // if/else NORM_RX_TIMESTAMP
+}  // end NormSession::SetRxTimestamping()
+
+// Nanosecond resolution SO_TIMESTAMPNS is preferred with microsecond 
+// SO_TIMESTAMP as a fallback for older kernels.  Either way, the
+// RecvTimestamped() control message parsing handles both.
+bool NormSession::EnableRxTimestamps(ProtoSocket& theSocket)
+{
+#ifdef NORM_RX_TIMESTAMP
+    int enable = 1;
+#ifdef SO_TIMESTAMPNS
+    if (0 == setsockopt(theSocket.GetHandle(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)))
+        return true;
+#endif // SO_TIMESTAMPNS
+#ifdef SO_TIMESTAMP
+    if (0 == setsockopt(theSocket.GetHandle(), SOL_SOCKET, SO_TIMESTAMP, &enable, sizeof(enable)))
+        return true;
+#endif // SO_TIMESTAMP
+    PLOG(PL_ERROR, "NormSession::EnableRxTimestamps() setsockopt() error: %s\n", GetErrorString());
+#endif // NORM_RX_TIMESTAMP
+    return false;
+}  // end NormSession::EnableRxTimestamps()
+
+// This is equivalent to ProtoSocket::RecvFrom() (including the packet
+// destination address when "dstAddr" is non-NULL) but also returns the
+// kernel receive timestamp.  The "rxTime" is left invalid (zero) if the
+// datagram had no timestamp control message.
+bool NormSession::RecvTimestamped(ProtoSocket&    theSocket,
+                                  char*           buffer,
+                                  unsigned int&   numBytes,
+                                  ProtoAddress&   srcAddr,
+                                  ProtoAddress*   dstAddr,
+                                  struct timeval& rxTime)
+{
+    rxTime.tv_sec = rxTime.tv_usec = 0;
+#ifdef NORM_RX_TIMESTAMP
+    struct sockaddr_storage sockAddr;
+    struct iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = numBytes;
+    char cdata[256];  // (room for timestamp and packet info control messages)
+    struct msghdr msgHdr;
+    memset(&msgHdr, 0, sizeof(msgHdr));
+    msgHdr.msg_name = &sockAddr;
+    msgHdr.msg_namelen = sizeof(sockAddr);
+    msgHdr.msg_iov = &iov;
+    msgHdr.msg_iovlen = 1;
+    msgHdr.msg_control = cdata;
+    msgHdr.msg_controllen = sizeof(cdata);
+    ssize_t result = recvmsg(theSocket.GetHandle(), &msgHdr, 0);
+    if (result < 0)
+    {
+        numBytes = 0;
+        switch (errno)
+        {
+            case EINTR:
+            case EAGAIN:
+#if defined(EWOULDBLOCK) && (EWOULDBLOCK != EAGAIN)
+            case EWOULDBLOCK:
+#endif
+                return true;  // no more data to read
+            default:
+                PLOG(PL_ERROR, "NormSession::RecvTimestamped() recvmsg() error: %s\n", GetErrorString());
+                return false;
+        }
+    }
+    numBytes = (unsigned int)result;
+    srcAddr.SetSockAddr(*((struct sockaddr*)&sockAddr));
+    if (NULL != dstAddr) dstAddr->Invalidate();
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgHdr); NULL != cmsg; cmsg = CMSG_NXTHDR(&msgHdr, cmsg))
+    {
+        if (SOL_SOCKET == cmsg->cmsg_level)
+        {
+#ifdef SO_TIMESTAMPNS
+            if (SCM_TIMESTAMPNS == cmsg->cmsg_type)
+            {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                rxTime.tv_sec = ts.tv_sec;
+                rxTime.tv_usec = ts.tv_nsec / 1000;
+            }
+#endif // SO_TIMESTAMPNS
+#ifdef SO_TIMESTAMP
+            if (SCM_TIMESTAMP == cmsg->cmsg_type)
+                memcpy(&rxTime, CMSG_DATA(cmsg), sizeof(rxTime));
+#endif // SO_TIMESTAMP
+        }
+        else if (NULL == dstAddr)
+        {
+            continue;
+        }
+#if defined(IP_PKTINFO)
+        else if ((IPPROTO_IP == cmsg->cmsg_level) && (IP_PKTINFO == cmsg->cmsg_type))
+        {
+            struct in_pktinfo pktInfo;
+            memcpy(&pktInfo, CMSG_DATA(cmsg), sizeof(pktInfo));
+            dstAddr->SetRawHostAddress(ProtoAddress::IPv4, (char*)&pktInfo.ipi_addr, 4);
+        }
+#elif defined(IP_RECVDSTADDR)
+        else if ((IPPROTO_IP == cmsg->cmsg_level) && (IP_RECVDSTADDR == cmsg->cmsg_type))
+        {
+            dstAddr->SetRawHostAddress(ProtoAddress::IPv4, (char*)CMSG_DATA(cmsg), 4);
+        }
+#endif // if/elif IP_PKTINFO/IP_RECVDSTADDR
+#if defined(HAVE_IPV6) && defined(IPV6_PKTINFO)
+        else if ((IPPROTO_IPV6 == cmsg->cmsg_level) && (IPV6_PKTINFO == cmsg->cmsg_type))
+        {
+            struct in6_pktinfo pktInfo;
+            memcpy(&pktInfo, CMSG_DATA(cmsg), sizeof(pktInfo));
+            dstAddr->SetRawHostAddress(ProtoAddress::IPv6, (char*)&pktInfo.ipi6_addr, 16);
+        }
+#endif // HAVE_IPV6 && IPV6_PKTINFO
+    }
+    return true;
+#else
+    return ((NULL != dstAddr) ? 
+                theSocket.RecvFrom(buffer, numBytes, srcAddr, *dstAddr) :
+                theSocket.RecvFrom(buffer, numBytes, srcAddr));
+#endif // if/else NORM_RX_TIMESTAMP
+}  // end NormSession::RecvTimestamped()
+
 bool NormSession::SetTxPort(UINT16 txPort, bool enableReuse, const char* txAddress) 
 {
     tx_port = txPort;
@@ -568,7 +821,7 @@ double NormSession::GetTxRate()
     if (cc_enable && !cc_adjust)
     {
         // Return rate of CLR
-        const NormCCNode* clr = static_cast<const NormCCNode*>(cc_node_list.Head());
+        const NormCCNode* clr = cc_node_heap.Head();
         return ((NULL != clr) ? 8.0 * clr->GetRate() : 0.0);
     }
     else
@@ -928,6 +1181,7 @@ void NormSession::StopSender()
         repair_timer.Deactivate();
         tx_repair_pending = false;
     }
+    tx_repair_plan.Destroy();
     if (flush_timer.IsActive())
         flush_timer.Deactivate();
     if (cmd_timer.IsActive())
@@ -956,7 +1210,20 @@ void NormSession::StopSender()
         encoder = NULL;
     }
     acking_node_tree.Destroy();
-    cc_node_list.Destroy();
+    acking_ack_mask.Destroy();
+    if (NULL != acking_mask_words)
+    {
+        delete[] acking_mask_words;
+        acking_mask_words = NULL;
+    }
+    if (NULL != acking_node_index)
+    {
+        delete[] acking_node_index;
+        acking_node_index = NULL;
+    }
+    acking_index_size = acking_node_count = acking_success_count = 0;
+    acking_node_none = NULL;
+    cc_node_heap.Destroy();
     // Iterate tx_table and release objects
     while (!tx_table.IsEmpty())
     {
@@ -999,13 +1266,13 @@ void NormSession::StopReceiver()
     else
     {
         NormSenderNode* senderNode = 
-            static_cast<NormSenderNode*>(sender_tree.GetRoot());
+            static_cast<NormSenderNode*>(sender_tree.GetHead());
         while (NULL != senderNode)
         {
             sender_tree.DetachNode(senderNode);
             senderNode->Close();
             senderNode->Release();
-            senderNode = static_cast<NormSenderNode*>(sender_tree.GetRoot());
+            senderNode = static_cast<NormSenderNode*>(sender_tree.GetHead());
         }
     }
     is_receiver = false;
@@ -1129,7 +1396,7 @@ void NormSession::Serve()
     bool watermarkJustCompleted = false;
     if (watermark_pending && !flush_timer.IsActive())
     {
-        PLOG(PL_DEBUG, "NormSession::Serve() watermark status check ...\n");
+        NLOG(PL_DEBUG, "NormSession::Serve() watermark status check ...\n");
         // Determine next message (objectId::blockId::segmentId) to be sent
         NormObject* nextObj;
         NormObjectId nextObjectId = next_tx_object_id;
@@ -1166,7 +1433,7 @@ void NormSession::Serve()
                 nextSegmentId = static_cast<NormStreamObject*>(nextObj)->GetNextSegmentId();  
             }           
         }
-        PLOG(PL_DEBUG, "   nextPending index>%hu:%lu:%hu\n", 
+        NLOG(PL_DEBUG, "   nextPending index>%hu:%lu:%hu\n", 
                            (UINT16)nextObjectId, 
                            (unsigned long)nextBlockId.GetValue(), 
                            (UINT16)nextSegmentId);
@@ -1174,7 +1441,7 @@ void NormSession::Serve()
         if (tx_repair_pending)
         {
             
-            PLOG(PL_DEBUG, "   tx_repair index>%hu:%lu:%hu\n", 
+            NLOG(PL_DEBUG, "   tx_repair index>%hu:%lu:%hu\n", 
                                (UINT16)tx_repair_object_min, 
                                (unsigned long)tx_repair_block_min.GetValue(), 
                                (UINT16)tx_repair_segment_min); 
@@ -1188,7 +1455,7 @@ void NormSession::Serve()
                 nextObjectId = tx_repair_object_min;
                 nextBlockId = tx_repair_block_min;
                 nextSegmentId = tx_repair_segment_min;
-                PLOG(PL_DEBUG, "   updated nextPending index>%hu:%lu:%hu\n", 
+                NLOG(PL_DEBUG, "   updated nextPending index>%hu:%lu:%hu\n", 
                                     (UINT16)nextObjectId, 
                                     (unsigned long)nextBlockId.GetValue(), 
                                     (UINT16)nextSegmentId);
@@ -1198,7 +1465,7 @@ void NormSession::Serve()
         
         ASSERT(nextBlockId.GetValue() <= (UINT32)0x00ffffff);
         
-        PLOG(PL_DEBUG, "   watermark>%hu:%lu:%hu check against next pending index>%hu:%lu:%hu\n",
+        NLOG(PL_DEBUG, "   watermark>%hu:%lu:%hu check against next pending index>%hu:%lu:%hu\n",
                            (UINT16)watermark_object_id, (unsigned long)watermark_block_id.GetValue(), (UINT16)watermark_segment_id, 
                            (UINT16)nextObjectId, (unsigned long)nextBlockId.GetValue(), (UINT16)nextSegmentId);
         if ((nextObjectId > watermark_object_id) ||
@@ -1208,7 +1475,7 @@ void NormSession::Serve()
               ((nextBlockId == watermark_block_id) &&
                 (nextSegmentId > watermark_segment_id)))))
         {
-            PLOG(PL_DEBUG, "   calling SenderQueueWatermarkFlush() ...\n");
+            NLOG(PL_DEBUG, "   calling SenderQueueWatermarkFlush() ...\n");
             // The sender tx position is > watermark
             if (SenderQueueWatermarkFlush()) 
             {
@@ -1250,10 +1517,8 @@ void NormSession::Serve()
             if (watermark_active)
             {
                 watermark_active = false;
-                NormNodeTreeIterator iterator(acking_node_tree);
-                NormAckingNode* next;
-                while ((next = static_cast<NormAckingNode*>(iterator.GetNextNode())))
-                    next->ResetReqCount(GetTxRobustFactor());
+                for (unsigned int i = 0; i < acking_node_count; i++)
+                    acking_node_index[i]->ResetReqCount(GetTxRobustFactor());
             }            
         }
     }  // end if (watermark_pending && !flush_timer.IsActive())
@@ -1265,6 +1530,8 @@ void NormSession::Serve()
         {
             if (obj->NextSenderMsg(msg))
             {
+                if (obj->ClearTxFirstPending())
+                    RecordLatency(TX_FIRST_SEND, obj->GetLatencyStart());
                 if (cc_enable && !data_active)
                 {
                     data_active = true;
@@ -1322,7 +1589,7 @@ void NormSession::Serve()
                             else if (GetTxRobustFactor() == flush_count)  
                             {
                                 
-                                PLOG(PL_TRACE, "NormSession::Serve() node>%lu sender stream flush complete ...\n",
+                                NLOG(PL_TRACE, "NormSession::Serve() node>%lu sender stream flush complete ...\n",
                                                 (unsigned long)LocalNodeId());
                                 Notify(NormController::TX_FLUSH_COMPLETED, (NormSenderNode*)NULL, stream);
                                 flush_count++;
@@ -1377,12 +1644,12 @@ void NormSession::Serve()
             if (!tx_repair_pending)  // don't queue flush if repair pending
                 SenderQueueFlush();
             else
-                PLOG(PL_DETAIL, "NormSession::Serve() node>%lu NORM_CMD(FLUSH) deferred by pending repairs ...\n",
+                NLOG(PL_DETAIL, "NormSession::Serve() node>%lu NORM_CMD(FLUSH) deferred by pending repairs ...\n",
                                 (unsigned long)LocalNodeId());
         }   
         else if (GetTxRobustFactor() == flush_count)
         {
-            PLOG(PL_TRACE, "NormSession::Serve() node>%lu sender flush complete ...\n", 
+            NLOG(PL_TRACE, "NormSession::Serve() node>%lu sender flush complete ...\n", 
                             (unsigned long)LocalNodeId());
             Notify(NormController::TX_FLUSH_COMPLETED,
                    (NormSenderNode*)NULL,
@@ -1408,13 +1675,12 @@ bool NormSession::SenderSetWatermark(NormObjectId  objectId,
     watermark_object_id = objectId;
     watermark_block_id = blockId;
     watermark_segment_id = segmentId;
+    // Reset acking node list
     acking_success_count = 0;
-    // Reset acking_node_list
-    NormNodeTreeIterator iterator(acking_node_tree);
-    NormNode* next;
+    acking_ack_mask.Clear();
     int robustFactor = GetTxRobustFactor();
-    while ((next = iterator.GetNextNode()))
-        static_cast<NormAckingNode*>(next)->Reset(robustFactor);
+    for (unsigned int i = 0; i < acking_node_count; i++)
+        acking_node_index[i]->Reset(robustFactor);
     
     if (NULL != appAckReq)
     {
@@ -1455,15 +1721,13 @@ bool NormSession::SenderSetWatermark(NormObjectId  objectId,
 
 void NormSession::SenderResetWatermark()
 {
-    NormNodeTreeIterator iterator(acking_node_tree);
-    NormNode* next;
     int robustFactor = GetTxRobustFactor();
-    while ((next = iterator.GetNextNode()))
+    for (unsigned int i = 0; i < acking_node_count; i++)
     {
-        NormAckingNode* node = static_cast<NormAckingNode*>(next);
+        NormAckingNode* node = acking_node_index[i];
         if ((NORM_NODE_NONE == node->GetId()) || (!node->AckReceived()))
         {
-            node->Reset(robustFactor);
+            SenderResetAckingNode(node, robustFactor);
             watermark_pending = true;
             watermark_active = false;
         }
@@ -1481,12 +1745,50 @@ NormAckingNode* NormSession::SenderAddAckingNode(NormNodeId nodeId, const ProtoA
     NormAckingNode* theNode = static_cast<NormAckingNode*>(acking_node_tree.FindNodeById(nodeId));
     if (NULL == theNode)
     {
+        if (acking_node_count == acking_index_size)
+        {
+            // Grow the dense index and its ACK bitmask
+            unsigned int newSize = (0 != acking_index_size) ? (2 * acking_index_size) : 64;
+            NormAckingNode** newIndex = new NormAckingNode*[newSize];
+            if (NULL == newIndex)
+            {
+                PLOG(PL_ERROR, "NormSession::SenderAddAckingNode() new acking_node_index error: %s\n", GetErrorString());
+                return NULL;
+            }
+            UINT32* newWords = new UINT32[NormBlockMask::GetWordCount(newSize)];
+            if (NULL == newWords)
+            {
+                PLOG(PL_ERROR, "NormSession::SenderAddAckingNode() new acking_mask_words error: %s\n", GetErrorString());
+                delete[] newIndex;
+                return NULL;
+            }
+            acking_ack_mask.Init(newWords, newSize);  // (cleared)
+            if (NULL != acking_node_index)
+            {
+                memcpy(newIndex, acking_node_index, acking_node_count*sizeof(NormAckingNode*));
+                memcpy(newWords, acking_mask_words, NormBlockMask::GetWordCount(acking_index_size)*sizeof(UINT32));
+                delete[] acking_node_index;
+                delete[] acking_mask_words;
+            }
+            acking_node_index = newIndex;
+            acking_mask_words = newWords;
+            acking_index_size = newSize;
+        }
         theNode = new NormAckingNode(*this, nodeId);
         if (NULL != theNode)
         {
             theNode->Reset(GetTxRobustFactor());
-            acking_node_tree.AttachNode(theNode);
+            if (!acking_node_tree.AttachNode(theNode))
+            {
+                PLOG(PL_ERROR, "NormSession::SenderAddAckingNode() acking_node_tree.AttachNode() error\n");
+                theNode->Release();
+                return NULL;
+            }
+            theNode->SetAckingIndex(acking_node_count);
+            acking_node_index[acking_node_count] = theNode;
+            acking_ack_mask.Unset(acking_node_count);
             acking_node_count++;
+            if (NORM_NODE_NONE == nodeId) acking_node_none = theNode;
         }
         else
         {
@@ -1508,11 +1810,23 @@ void NormSession::SenderRemoveAckingNode(NormNodeId nodeId)
         static_cast<NormAckingNode*>(acking_node_tree.FindNodeById(nodeId));
     if (NULL != theNode) 
     {
+        // Move the last indexed node into the removed node's slot
+        unsigned int index = theNode->GetAckingIndex();
+        if (theNode->AckReceived()) acking_success_count--;
+        acking_node_count--;
+        NormAckingNode* lastNode = acking_node_index[acking_node_count];
+        acking_node_index[index] = lastNode;
+        lastNode->SetAckingIndex(index);
+        if (lastNode->AckReceived())
+            acking_ack_mask.Set(index);
+        else
+            acking_ack_mask.Unset(index);
+        acking_ack_mask.Unset(acking_node_count);
+        if (theNode == acking_node_none) acking_node_none = NULL;
         acking_node_tree.DetachNode(theNode);
         theNode->Release();
         // TBD - if a watermark was pending and this is the only
         //       non-pending acker, can we immediately issue WATERMARK_COMPLETED?
-        acking_node_count--;
     }
 }  // end NormSession::RemoveAckingNode()
 
@@ -1556,18 +1870,22 @@ NormSession::AckingStatus NormSession::SenderGetAckingStatus(NormNodeId nodeId)
 }  // end NormSession::SenderGetAckingStatus()
 
 
+// Iterates in acking node index order (i.e., the order nodes were added,
+// except that removal moves the last node into the removed node's place)
 bool NormSession::SenderGetNextAckingNode(NormNodeId& prevNodeId, AckingStatus* ackingStatus)
 {
-    NormNode* prevNode = NULL;
+    unsigned int index = 0;
     if (NORM_NODE_NONE != prevNodeId)
-        prevNode = acking_node_tree.FindNodeById(prevNodeId);
-    NormNodeTreeIterator iterator(acking_node_tree, prevNode);
-    NormAckingNode* nextNode = static_cast<NormAckingNode*>(iterator.GetNextNode());
-    // Note we skip NORM_NODE_NONE even though it may be in the tree
+    {
+        NormAckingNode* prevNode = SenderFindAckingNode(prevNodeId);
+        if (NULL != prevNode) index = prevNode->GetAckingIndex() + 1;
+    }
+    // Note we skip NORM_NODE_NONE even though it may be in the index
     // (This method only returns the id / status of _actual_ nodes)
     // TBD - we could return NORM_NODE_ANY as a proxy id for a NORM_NODE_NONE entry
-    if ((NULL != nextNode) && (NORM_NODE_NONE == nextNode->GetId()))
-        nextNode = static_cast<NormAckingNode*>(iterator.GetNextNode());
+    if ((index < acking_node_count) && (acking_node_none == acking_node_index[index]))
+        index++;
+    NormAckingNode* nextNode = (index < acking_node_count) ? acking_node_index[index] : NULL;
     if (NULL != nextNode)
     {
         prevNodeId = nextNode->GetId();
@@ -1608,6 +1926,16 @@ bool NormSession::SenderGetAckEx(NormNodeId nodeId, char* buffer, unsigned int*
     }
 }  // end NormSession::SenderGetAckEx()
 
+bool NormSession::SenderGetAckingAggregate(NormNodeId nodeId, unsigned int* memberCount, unsigned int* ackedCount)
+{
+    NormAckingNode* theNode = 
+        static_cast<NormAckingNode*>(acking_node_tree.FindNodeById(nodeId));
+    if ((NULL == theNode) || (0 == theNode->GetAggregateMemberCount())) return false;
+    if (NULL != memberCount) *memberCount = theNode->GetAggregateMemberCount();
+    if (NULL != ackedCount) *ackedCount = theNode->GetAggregateAckedCount();
+    return true;
+}  // end NormSession::SenderGetAckingAggregate()
+
 bool NormSession::SenderQueueWatermarkFlush()
 {
     if (flush_timer.IsActive()) return false;
@@ -1640,28 +1968,29 @@ bool NormSession::SenderQueueWatermarkFlush()
             flush->PackExtension(ext);
         }
         
-        NormNodeTreeIterator iterator(acking_node_tree);
-        NormAckingNode* next;
         watermark_pending = false;
+        // Save NORM_NODE_NONE for last
         NormAckingNode* nodeNone = NULL;
-        acking_success_count = 0;
-        while (NULL != (next = static_cast<NormAckingNode*>(iterator.GetNextNode())))
+        if ((NULL != acking_node_none) && !acking_node_none->AckReceived())
         {
-            // Save NORM_NODE_NONE for last
-            if (NORM_NODE_NONE == next->GetId()) 
-            {
-                if (next->IsPending()) 
-                    nodeNone = next;
-                else
-                    acking_success_count++; // implicit success for NORM_NODE_NONE
-                continue;
-            }
-            if (next->AckReceived())
-            {
-                acking_success_count++;     // ACK was received for this node
-            }
-            else if (next->IsPending())
+            if (acking_node_none->IsPending())
+                nodeNone = acking_node_none;
+            else
+                SenderMarkAckReceived(acking_node_none);  // implicit success for NORM_NODE_NONE
+        }
+        // Only nodes with their ACK bit unset are visited (a word at a time)
+        unsigned int wordCount = NormBlockMask::GetWordCount(acking_node_count);
+        bool cmdFull = false;
+        for (unsigned int w = 0; (w < wordCount) && !cmdFull; w++)
+        {
+            UINT32 bits = ~acking_mask_words[w];
+            if (((w + 1) << 5) > acking_node_count)
+                bits &= (((UINT32)0x01 << (acking_node_count & 31)) - 1);  // (last partial word)
+            while (0 != bits)
             {
+                NormAckingNode* next = acking_node_index[(w << 5) + NormCtz32(bits)];
+                bits &= (bits - 1);
+                if ((next == acking_node_none) || !next->IsPending()) continue;
                 // Add node to list     
                 if (flush->AppendAckingNode(next->GetId(), segment_size))
                 {
@@ -1672,6 +2001,7 @@ bool NormSession::SenderQueueWatermarkFlush()
                 {
                     PLOG(PL_FATAL, "NormSession::ServeQueueWatermarkFlush() full cmd ...\n");
                     nodeNone = NULL;
+                    cmdFull = true;
                     break;    
                 }                
             }
@@ -1699,7 +2029,7 @@ bool NormSession::SenderQueueWatermarkFlush()
             PLOG(PL_DEBUG, "NormSession::ServeQueueWatermarkFlush() node>%lu cmd queued ...\n", 
                             (unsigned long)LocalNodeId());
         }
-        else if (NULL != acking_node_tree.GetRoot())
+        else if (!acking_node_tree.IsEmpty())
         {
             ReturnMessageToPool(flush);
             PLOG(PL_DEBUG, "NormSession::ServeQueueWatermarkFlush() node>%lu watermark ack finished.\n",
@@ -1724,6 +2054,24 @@ bool NormSession::SenderQueueWatermarkFlush()
     ActivateTimer(flush_timer);
     return true;
 }  // end NormSession::SenderQueueWatermarkFlush()
+
+void NormSession::SenderMarkAckReceived(NormAckingNode* node)
+{
+    if (node->AckReceived()) return;
+    node->MarkAckReceived();
+    acking_ack_mask.Set(node->GetAckingIndex());
+    acking_success_count++;
+}  // end NormSession::SenderMarkAckReceived()
+
+void NormSession::SenderResetAckingNode(NormAckingNode* node, int robustFactor)
+{
+    if (node->AckReceived())
+    {
+        acking_ack_mask.Unset(node->GetAckingIndex());
+        acking_success_count--;
+    }
+    node->Reset(robustFactor);
+}  // end NormSession::SenderResetAckingNode()
         
 void NormSession::SenderQueueFlush()
 {
@@ -2018,7 +2366,9 @@ bool NormSession::QueueTxObject(NormObject* obj)
         }
         else 
         {
-            double delay = GetFlowControlDelay() - oldest->GetNackAge();
+            struct timeval currentTime;
+            session_clock.GetCurrentTime(currentTime);
+            double delay = GetFlowControlDelay() - oldest->GetNackAge(ProtoTime(currentTime));
             if (delay < 1.0e-06)
             {
                 if (FlowControlIsActive()) DeactivateFlowControl();
@@ -2045,6 +2395,9 @@ bool NormSession::QueueTxObject(NormObject* obj)
     tx_pending_mask.Set(obj->GetId());
     ASSERT(tx_pending_mask.Test(obj->GetId()));
     next_tx_object_id++;
+    struct timeval currentTime;
+    GetCurrentTime(currentTime);
+    obj->SetLatencyStart(currentTime);
     TouchSender();
     return true;
 }  // end NormSession::QueueTxObject()
@@ -2064,6 +2417,9 @@ bool NormSession::RequeueTxObject(NormObject* obj)
         if (tx_pending_mask.Set(objectId))
         {
             obj->TxReset(0, true);
+            struct timeval currentTime;
+            GetCurrentTime(currentTime);
+            obj->SetLatencyStart(currentTime);
             TouchSender();
             return true;
         }        
@@ -2128,14 +2484,16 @@ bool NormSession::SetTxCacheBounds(NormObjectSize  sizeMax,
             countMax = tx_cache_count_max;
         if (countMax != tx_table.GetRangeMax())
         {
-            tx_table.SetRangeMax((UINT16)countMax);
-            result = tx_pending_mask.Resize((UINT32)countMax);
+            result = tx_table.SetRangeMax((UINT16)countMax);
+            result &= tx_pending_mask.Resize((UINT32)countMax);
             result &= tx_repair_mask.Resize((UINT32)countMax);
             if (!result)
             {
                 countMax = tx_pending_mask.GetSize();
                 if (tx_repair_mask.GetSize() < countMax)
                     countMax = tx_repair_mask.GetSize(); 
+                if (tx_table.GetRangeMax() < countMax)
+                    countMax = tx_table.GetRangeMax();
                 if (tx_cache_count_max > countMax)
                     tx_cache_count_max = (unsigned int)countMax;
                 if (tx_cache_count_min > tx_cache_count_max)
@@ -2217,20 +2575,27 @@ void NormSession::TxSocketRecvHandler(ProtoSocket&       theSocket,
 {
     if (ProtoSocket::RECV == theEvent)
     {
+        NormClock::Scope clockScope(session_clock);  // (one clock read per receive batch)
         NormMsg msg;
         unsigned int msgLength = NormMsg::MAX_SIZE;
+        struct timeval rxTime;
         while (true)
         {
-            
-			if (theSocket.RecvFrom(msg.AccessBuffer(),
-                                   msgLength, 
-                                   msg.AccessAddress()))
+            bool result;
+            if (tx_socket_tstamp)
+                result = RecvTimestamped(theSocket, msg.AccessBuffer(), msgLength,
+                                         msg.AccessAddress(), NULL, rxTime);
+            else
+                result = theSocket.RecvFrom(msg.AccessBuffer(),
+                                            msgLength, 
+                                            msg.AccessAddress());
+			if (result)
             {
                 if (0 == msgLength) break;  // no more data to read
                 if (msg.InitFromBuffer(msgLength))
                 {
                     // Since it arrived on the tx_socket, we know it was unicast
-                    HandleReceiveMessage(msg, true);
+                    HandleReceiveMessage(msg, true, false, tx_socket_tstamp ? &rxTime : NULL);
                     msgLength = NormMsg::MAX_SIZE;
                 }
                 else
@@ -2279,16 +2644,24 @@ void NormSession::RxSocketRecvHandler(ProtoSocket&       theSocket,
 {
     if (ProtoSocket::RECV == theEvent)
     {
+        NormClock::Scope clockScope(session_clock);  // (one clock read per receive batch)
         unsigned int recvCount = 0;
         NormMsg msg;
         unsigned int msgLength = NormMsg::MAX_SIZE;
+        struct timeval rxTime;
         while (true)
         {
 			ProtoAddress destAddr;  // we get the pkt destAddr to determine unicast/multicast
-            if (theSocket.RecvFrom(msg.AccessBuffer(),
-                                   msgLength, 
-                                   msg.AccessAddress(),
-                                   destAddr))
+            bool result;
+            if (rx_socket_tstamp)
+                result = RecvTimestamped(theSocket, msg.AccessBuffer(), msgLength,
+                                         msg.AccessAddress(), &destAddr, rxTime);
+            else
+                result = theSocket.RecvFrom(msg.AccessBuffer(),
+                                            msgLength, 
+                                            msg.AccessAddress(),
+                                            destAddr);
+            if (result)
             {
                 if (0 == msgLength) break;
                 if (msg.InitFromBuffer(msgLength))
@@ -2343,7 +2716,7 @@ void NormSession::RxSocketRecvHandler(ProtoSocket&       theSocket,
                         wasUnicast = destAddr.IsUnicast();
                     else
                         wasUnicast = false;
-                    HandleReceiveMessage(msg, wasUnicast, ecnStatus);
+                    HandleReceiveMessage(msg, wasUnicast, ecnStatus, rx_socket_tstamp ? &rxTime : NULL);
                     msgLength = NormMsg::MAX_SIZE;
                 }
                 else
@@ -2395,6 +2768,7 @@ void NormSession::OnPktCapture(ProtoChannel&              theChannel,
 {
     // We only care about NOTIFY_INPUT events (all we should get anyway)
     if (ProtoChannel::NOTIFY_INPUT != notifyType) return;
+    NormClock::Scope clockScope(session_clock);  // (one clock read per capture batch)
     while(1) 
     {
         ProtoCap::Direction direction;
@@ -2728,18 +3102,47 @@ void NormTrace(const struct timeval&    currentTime,
     PLOG(PL_ALWAYS, "len>%hu %s\n", length, clrFlag ? "(CLR)" : "");
 }  // end NormTrace();
 
+void NormSession::TraceMessage(const struct timeval& currentTime, const NormMsg& msg,
+                               bool sent, UINT8 fecM, UINT16 instId)
+{
+    NormTraceRing* traceRing = session_mgr.GetTraceRing();
+    if (NULL != traceRing)
+        traceRing->Trace(currentTime, LocalNodeId(), msg, sent, fecM, instId);
+    else
+        NormTrace(currentTime, LocalNodeId(), msg, sent, fecM, instId);
+}  // end NormSession::TraceMessage()
+
 
-void NormSession::HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecnStatus)
+void NormSession::HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecnStatus, 
+                                       const struct timeval* rxTime)
 {   
     // Ignore messages from ourself unless "loopback" is enabled
     if ((msg.GetSourceId() == LocalNodeId()) && !loopback)
         return;
+    // Receive fan-out members only process traffic of remote senders they own
+    if ((rx_fanout_count > 1) && Address().IsMulticast() &&
+        ((GetRxFanoutKey(msg) % rx_fanout_count) != rx_fanout_index))
+        return;
     // Drop some rx messages for testing
     if ((rx_loss_rate > 0) && (UniformRand(100.0) < rx_loss_rate)) 
         return;
     
+    stats.recv_bytes += msg.GetLength();
+    stats.recv_packets++;
+    if (!stats_timer.IsActive()) ActivateTimer(stats_timer);
+    
     struct timeval currentTime;
-    ::ProtoSystemTime(currentTime);
+    session_clock.GetCurrentTime(currentTime);
+    // The kernel receive timestamp (when available) excludes the time the
+    // message sat queued in the socket buffer, so RTT, GRTT response hold
+    // time, and loss/rate measurements aren't inflated when we are busy.
+    // (it is bounded by the session clock in case of clock steps)
+    if ((NULL != rxTime) && (0 != rxTime->tv_sec) &&
+        ((rxTime->tv_sec < currentTime.tv_sec) ||
+         ((rxTime->tv_sec == currentTime.tv_sec) && (rxTime->tv_usec < currentTime.tv_usec))))
+    {
+        currentTime = *rxTime;
+    }
     
     if (trace) 
     {
@@ -2778,7 +3181,7 @@ void NormSession::HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecnSt
                 instId = 0;
             }
 	    }
-    	NormTrace(currentTime, LocalNodeId(), msg, false, fecM, instId);  // TBD don't assume m == 16 (i.e. for fec_id == 2)
+    	TraceMessage(currentTime, msg, false, fecM, instId);  // TBD don't assume m == 16 (i.e. for fec_id == 2)
     }  // end if (trace)
     
     NormMsg::Type msgType = msg.GetType();
@@ -2877,6 +3280,7 @@ void NormSession::HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecnSt
         case NormMsg::NACK:
             if (IsSender() && (((NormNackMsg&)msg).GetSenderId() == LocalNodeId()))
             { 
+                stats.nacks_received++;
                 SenderHandleNackMessage(currentTime, (NormNackMsg&)msg);
                 if (wasUnicast && (backoff_factor > 0.5) && Address().IsMulticast()) 
                 {
@@ -2885,7 +3289,7 @@ void NormSession::HandleReceiveMessage(NormMsg& msg, bool wasUnicast, bool ecnSt
                     QueueMessage(NULL); // to prompt transmit timeout
                 }
             }
-            if (IsReceiver()) ReceiverHandleNackMessage((NormNackMsg&)msg);
+            if (IsReceiver()) ReceiverHandleNackMessage((NormNackMsg&)msg, wasUnicast);
             break;
         case NormMsg::ACK:
             if (IsSender() && (((NormAckMsg&)msg).GetSenderId() == LocalNodeId())) 
@@ -2905,6 +3309,25 @@ void NormSession::ReceiverHandleObjectMessage(const struct timeval&   currentTim
                                               const NormObjectMsg&    msg,
                                               bool                    ecnStatus)
 {
+    // NORM_DATA resent by a local repair peer on the sender's behalf is
+    // only used for its content (it says nothing about the sender's
+    // address, activity, or the loss and rate of its transmissions)
+    bool localRepair = false;
+    if (msg.HasExtensions() && (NormMsg::DATA == msg.GetType()))
+    {
+        NormLocalRepairExtension ext;
+        while (msg.GetNextExtension(ext))
+        {
+            if (NormHeaderExtension::LOCAL_REPAIR == ext.GetType())
+            {
+                if (IsServerListener() || (ext.GetRepairerId() == LocalNodeId()))
+                    return;  // (ignore our own looped back repairs)
+                localRepair = true;
+                break;
+            }
+        }
+    }
+    
     // Do common updates for senders we already know.
     NormNodeId sourceId = msg.GetSourceId();
     NormSenderNode* theSender; 
@@ -2912,11 +3335,28 @@ void NormSession::ReceiverHandleObjectMessage(const struct timeval&   currentTim
         theSender = client_tree.FindNodeByAddress(msg.GetSource());
     else
         theSender = (NormSenderNode*)sender_tree.FindNodeById(sourceId);
+    if (localRepair)
+    {
+        if ((NULL != theSender) && (msg.GetInstanceId() == theSender->GetInstanceId()))
+        {
+            // (a repair peer holds off its own repairs of the block)
+            if (local_repair)
+            {
+                const NormDataMsg& data = static_cast<const NormDataMsg&>(msg);
+                theSender->NoteLocalRepair(data.GetObjectId(), 
+                                           data.GetFecBlockId(theSender->GetFecFieldSize()),
+                                           currentTime);
+            }
+            theSender->IncrementRecvTotal(msg.GetLength());
+            theSender->HandleObjectMessage(msg);
+        }
+        return;
+    }
     if (theSender)
     {
         if (msg.GetInstanceId() != theSender->GetInstanceId())
         {
-            PLOG(PL_INFO, "NormSession::ReceiverHandleObjectMessage() node>%lu sender>%lu instanceId change - resyncing.\n",
+            NLOG(PL_INFO, "NormSession::ReceiverHandleObjectMessage() node>%lu sender>%lu instanceId change - resyncing.\n",
                          (unsigned long)LocalNodeId(), (unsigned long)theSender->GetId());
             theSender->Close();
             Notify(NormController::REMOTE_SENDER_RESET, theSender, NULL);
@@ -2939,10 +3379,17 @@ void NormSession::ReceiverHandleObjectMessage(const struct timeval&   currentTim
             theSender->SetInstanceId(msg.GetInstanceId());
             theSender->SetAddress(msg.GetSource());
             if (IsServerListener())
+            {
                 client_tree.InsertNode(*theSender);
-            else
-                sender_tree.AttachNode(theSender);
-            PLOG(PL_DEBUG, "NormSession::ReceiverHandleObjectMessage() node>%lu new remote sender:%lu ...\n",
+            }
+            else if (!sender_tree.AttachNode(theSender))
+            {
+                PLOG(PL_ERROR, "NormSession::ReceiverHandleObjectMessage() node>%lu sender_tree.AttachNode() error\n",
+                               (unsigned long)LocalNodeId());
+                theSender->Release();
+                return;
+            }
+            NLOG(PL_DEBUG, "NormSession::ReceiverHandleObjectMessage() node>%lu new remote sender:%lu ...\n",
                            (unsigned long)LocalNodeId(), (unsigned long)msg.GetSourceId());
             Notify(NormController::REMOTE_SENDER_NEW, theSender, NULL);
         }
@@ -2952,10 +3399,17 @@ void NormSession::ReceiverHandleObjectMessage(const struct timeval&   currentTim
             if (theSender->Open(msg.GetInstanceId()))
             {
                 if (IsServerListener())
+                {
                     client_tree.InsertNode(*theSender);
-                else
-                    sender_tree.AttachNode(theSender);
-                PLOG(PL_DEBUG, "NormSession::ReceiverHandleObjectMessage() node>%lu new remote sender:%lu ...\n",
+                }
+                else if (!sender_tree.AttachNode(theSender))
+                {
+                    PLOG(PL_ERROR, "NormSession::ReceiverHandleObjectMessage() node>%lu sender_tree.AttachNode() error\n",
+                                   (unsigned long)LocalNodeId());
+                    theSender->Release();
+                    return;
+                }
+                NLOG(PL_DEBUG, "NormSession::ReceiverHandleObjectMessage() node>%lu new remote sender:%lu ...\n",
                                 (unsigned long)LocalNodeId(), (unsigned long)msg.GetSourceId());
             }
             else
@@ -3007,8 +3461,8 @@ void NormSession::ReceiverHandleCommand(const struct timeval& currentTime,
     {
         if (cmd.GetInstanceId() != theSender->GetInstanceId())
         {
-            PLOG(PL_INFO, "NormSession::ReceiverHandleCommand() node>%lu sender>%lu instanceId change - resyncing.\n",
-                            (unsigned long)LocalNodeId(), theSender->GetId());
+            NLOG(PL_INFO, "NormSession::ReceiverHandleCommand() node>%lu sender>%lu instanceId change - resyncing.\n",
+                            (unsigned long)LocalNodeId(), (unsigned long)theSender->GetId());
             theSender->Close();   
             Notify(NormController::REMOTE_SENDER_RESET, theSender, NULL);
             if (!theSender->Open(cmd.GetInstanceId()))
@@ -3032,10 +3486,17 @@ void NormSession::ReceiverHandleCommand(const struct timeval& currentTime,
             theSender->SetInstanceId(cmd.GetInstanceId());
             theSender->SetAddress(cmd.GetSource());
             if (IsServerListener())
+            {
                 client_tree.InsertNode(*theSender);
-            else
-                sender_tree.AttachNode(theSender);
-            PLOG(PL_DEBUG, "NormSession::ReceiverHandleCommand() node>%lu new remote sender:%lu ...\n",
+            }
+            else if (!sender_tree.AttachNode(theSender))
+            {
+                PLOG(PL_ERROR, "NormSession::ReceiverHandleCommand() node>%lu sender_tree.AttachNode() error\n",
+                               (unsigned long)LocalNodeId());
+                theSender->Release();
+                return;
+            }
+            NLOG(PL_DEBUG, "NormSession::ReceiverHandleCommand() node>%lu new remote sender:%lu ...\n",
                            (unsigned long)LocalNodeId(), (unsigned long)cmd.GetSourceId());
             Notify(NormController::REMOTE_SENDER_NEW, theSender, NULL);
         }
@@ -3045,10 +3506,17 @@ void NormSession::ReceiverHandleCommand(const struct timeval& currentTime,
             if (theSender->Open(cmd.GetInstanceId()))
             {
                 if (IsServerListener())
+                {
                     client_tree.InsertNode(*theSender);
-                else
-                    sender_tree.AttachNode(theSender);
-                PLOG(PL_DEBUG, "NormSession::ReceiverHandleCommand() node>%lu new remote sender:%lu ...\n",
+                }
+                else if (!sender_tree.AttachNode(theSender))
+                {
+                    PLOG(PL_ERROR, "NormSession::ReceiverHandleCommand() node>%lu sender_tree.AttachNode() error\n",
+                                   (unsigned long)LocalNodeId());
+                    theSender->Release();
+                    return;
+                }
+                NLOG(PL_DEBUG, "NormSession::ReceiverHandleCommand() node>%lu new remote sender:%lu ...\n",
                         (unsigned long)LocalNodeId(), (unsigned long)cmd.GetSourceId());
             }
             else
@@ -3106,7 +3574,7 @@ bool NormSession::InsertRemoteSender(NormSenderNode& sender)
     // since it will be "rehandled"
     struct timeval adjustedSendTime;
     struct timeval currentTime;
-    ::ProtoSystemTime(currentTime);
+    session_clock.GetCurrentTime(currentTime);
     sender.CalculateGrttResponse(currentTime, adjustedSendTime);
     cmd.SetSendTime(adjustedSendTime);
     
@@ -3245,7 +3713,7 @@ void NormSession::SenderHandleCCFeedback(struct timeval  currentTime,
     if (!cc_enable) return;
     
     // Adjust ccRtt if we already have state on this nodeId
-    NormCCNode* node = (NormCCNode*)cc_node_list.FindNodeById(nodeId);
+    NormCCNode* node = cc_node_heap.FindNodeById(nodeId);
     if (node) ccRtt = node->UpdateRtt(ccRtt);
     
     bool ccSlowStart = (0 != (ccFlags & NormCC::START));
@@ -3278,9 +3746,8 @@ void NormSession::SenderHandleCCFeedback(struct timeval  currentTime,
                     (unsigned long)nodeId, ccRate * 8.0 / 1000.0, ccRtt, ccLoss, (0 != (ccFlags & NormCC::START)), 
                     (0 != (ccFlags & NormCC::LIMIT)));
     
-    // Keep the active CLR (if there is one) at the head of the list
-    NormNodeListIterator iterator(cc_node_list);
-    NormCCNode* next = (NormCCNode*)iterator.GetNextNode();
+    // Keep the active CLR (if there is one) at the head of the heap
+    NormCCNode* next = cc_node_heap.Head();
     // 1) Does this response replace the active CLR?
     if (next && next->IsActive())
     {
@@ -3343,7 +3810,7 @@ void NormSession::SenderHandleCCFeedback(struct timeval  currentTime,
         {
             if ((next  = new NormCCNode(*this, nodeId)))
             {
-                cc_node_list.Append(next);
+                cc_node_heap.Append(next);
             }
             else
             {
@@ -3366,49 +3833,27 @@ void NormSession::SenderHandleCCFeedback(struct timeval  currentTime,
         return;
     }
     
-    // 2) Go through cc_node_list and find lowest priority candidate
-    NormCCNode* candidate = NULL;
-    if (cc_node_list.GetCount() < 5)
+    // 2) Use this node's candidate entry, a new entry, or the lowest priority candidate
+    NormCCNode* candidate = cc_node_heap.FindNodeById(nodeId);
+    if ((NULL == candidate) || (candidate == cc_node_heap.Head()))
     {
-        if ((candidate = new NormCCNode(*this, nodeId)))
+        candidate = NULL;
+        if (!cc_node_heap.IsFull())
         {
-            cc_node_list.Append(candidate);
-        }   
-        else
-        {
-            PLOG(PL_FATAL, "NormSession::SenderHandleCCFeedback() memory allocation error: %s\n",
-                            GetErrorString()); 
-        }
-    }
-    else
-    {
-        while ((next = (NormCCNode*)iterator.GetNextNode()))
-        {
-            if (next->GetId() == nodeId)
+            if ((candidate = new NormCCNode(*this, nodeId)))
             {
-                candidate = next;
-                break;
-            }
-            else if (candidate)
-            {
-                if (candidate->IsActive() && !next->IsActive())
-                {
-                    candidate = next;
-                    continue;   
-                }
-                if (!next->HasRtt() && candidate->HasRtt()) 
-                    continue;
-                else if (!candidate->HasRtt() && next->HasRtt())
-                    candidate = next;
-                else if (candidate->GetRate() < next->GetRate())
-                    candidate = next;
-            }
+                cc_node_heap.Append(candidate);
+            }   
             else
             {
-                candidate = next;
-                continue;
+                PLOG(PL_FATAL, "NormSession::SenderHandleCCFeedback() memory allocation error: %s\n",
+                                GetErrorString()); 
             }
         }
+        else
+        {
+            candidate = cc_node_heap.GetWeakest();
+        }
     }
     
     // 3) Replace candidate if this response is higher precedence
@@ -3439,6 +3884,7 @@ void NormSession::SenderHandleCCFeedback(struct timeval  currentTime,
             candidate->SetRate(ccRate);
             candidate->SetCCSequence(ccSequence);
             candidate->SetActive(true);
+            cc_node_heap.Update(candidate);
         }
     }
 }  // end NormSession::SenderHandleCCFeedback()
@@ -3450,7 +3896,7 @@ void NormSession::SenderHandleAckMessage(const struct timeval& currentTime, cons
     struct timeval grttResponse;
     ack.GetGrttResponse(grttResponse);
     double receiverRtt = CalculateRtt(currentTime, grttResponse);
-    PLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() node>%lu sender received ACK from node>%lu rtt>%lf\n",
+    NLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() node>%lu sender received ACK from node>%lu rtt>%lf\n",
                     (unsigned long)LocalNodeId(), (unsigned long)ack.GetSourceId(), receiverRtt);
     
     if (receiverRtt >= 0.0) SenderUpdateGrttEstimate(receiverRtt);
@@ -3520,7 +3966,35 @@ void NormSession::SenderHandleAckMessage(const struct timeval& currentTime, cons
                                     }
                                 }
                             }
-                            acker->MarkAckReceived(); 
+                            // An ACK aggregator's ACK only counts when all of its members have acknowledged
+                            bool aggregateComplete = true;
+                            NormAggregateAckExtension aggExt;
+                            while (ack.GetNextExtension(aggExt))
+                            {
+                                if (NormHeaderExtension::AGG_ACK == aggExt.GetType())
+                                {
+                                    acker->SetAggregateCounts(aggExt.GetMemberCount(), aggExt.GetAckedCount());
+                                    aggregateComplete = (aggExt.GetAckedCount() >= aggExt.GetMemberCount());
+                                    break;
+                                }
+                            }
+                            if (aggregateComplete)
+                            {
+                                SenderMarkAckReceived(acker); 
+                                if ((acking_success_count == acking_node_count) && flush_timer.IsActive())
+                                {
+                                    // Everyone has acknowledged, so the watermark is completed 
+                                    // without waiting for the flush timeout
+                                    flush_timer.Deactivate();
+                                    PromptSender();
+                                }
+                            }
+                            else
+                            {
+                                NLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() node>%lu aggregator>%lu reports %hu of %hu members acknowledged\n",
+                                               (unsigned long)LocalNodeId(), (unsigned long)ack.GetSourceId(),
+                                               acker->GetAggregateAckedCount(), acker->GetAggregateMemberCount());
+                            }
                             /*  This code was an attempt to expedite delivery of the TX_WATERMARK_COMPLETED
                                 notification to the application, but breaks some other desired behavior.
                             watermark_pending = false;
@@ -3536,7 +4010,7 @@ void NormSession::SenderHandleAckMessage(const struct timeval& currentTime, cons
                             }
                             if (!watermark_pending)
                             {
-                                PLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() node>%lu watermark ack finished.\n",
+                                NLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() node>%lu watermark ack finished.\n",
                                                 (unsigned long)LocalNodeId());
                                 Notify(NormController::TX_WATERMARK_COMPLETED, (NormSenderNode*)NULL, (NormObject*)NULL);
                             }
@@ -3546,12 +4020,12 @@ void NormSession::SenderHandleAckMessage(const struct timeval& currentTime, cons
                         {
                             // This can happen when new watermarks are set when an old watermark is still
                             // pending (i.e. receivers may still be in the process of replying)
-                            PLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() received old/wrong watermark ACK?!\n");    
+                            NLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() received old/wrong watermark ACK?!\n");    
                         }
                     }
                     else
                     {
-                        PLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() received redundant watermark ACK?!\n");
+                        NLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() received redundant watermark ACK?!\n");
                     }
                 }
                 else
@@ -3561,7 +4035,7 @@ void NormSession::SenderHandleAckMessage(const struct timeval& currentTime, cons
             }
             else
             {
-                PLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() received unsolicited watermark ACK?!\n");
+                NLOG(PL_DEBUG, "NormSession::SenderHandleAckMessage() received unsolicited watermark ACK?!\n");
             }
             break;
             
@@ -3578,7 +4052,8 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
     struct timeval grttResponse;
     nack.GetGrttResponse(grttResponse);
     double receiverRtt = CalculateRtt(currentTime, grttResponse);
-    if (GetDebugLevel() >=  PL_DEBUG)
+    // (logged synchronously since LogRepairContent() output follows)
+    if ((PL_DEBUG <= NORM_DEBUG_MAX) && (GetDebugLevel() >=  PL_DEBUG))
     {
         PLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu sender received NACK message from node>%lu rtt>%lf (tactive>%d) with content:\n", 
                         (unsigned long)LocalNodeId(), (unsigned long)nack.GetSourceId(), receiverRtt, repair_timer.IsActive());
@@ -3608,8 +4083,23 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
         break;
     }
     
-    // Parse and process NACK 
+    bool holdoff = (repair_timer.IsActive() && !repair_timer.GetRepeatCount());
     UINT16 requestOffset = 0;
+    if (tx_nack_batching && !holdoff)
+    {
+        // Collect the NACK content for merged processing at the end
+        // of the NACK aggregation period (see SenderDispatchRepairPlan())
+        bool batched = SenderBatchRepairContent(nack, requestOffset);
+        if (!tx_repair_plan.IsEmpty() && !repair_timer.IsActive())
+            SenderStartRepairAggregation();
+        if (batched) return;
+        // The repair plan is full, so the rest of this NACK is processed
+        // immediately below (as it is without batching)
+        PLOG(PL_WARN, "NormSession::SenderHandleNackMessage() node>%lu repair plan overflow, "
+                      "processing remaining NACK content immediately\n", (unsigned long)LocalNodeId());
+    }
+    
+    // Parse and process NACK 
     UINT16 requestLength = 0;
     NormRepairRequest req;
     NormObject* object = NULL;
@@ -3651,7 +4141,6 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
         txBlockIndex = 0;
     }
     
-    bool holdoff = (repair_timer.IsActive() && !repair_timer.GetRepeatCount());    
     enum NormRequestLevel {SEGMENT, BLOCK, INFO, OBJECT};
     while (0 != (requestLength = nack.UnpackRepairRequest(req, requestOffset)))
     {
@@ -3717,7 +4206,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                     freshBlock = true;
                     if (!(object = tx_table.Find(nextObjectId)))
                     {
-                        PLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu recvd repair request "
+                        NLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu recvd repair request "
                                        "for unknown object ...\n", (unsigned long)LocalNodeId());
                         if (!squelchQueued) 
                         {
@@ -3776,7 +4265,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                 switch (requestLevel)
                 {
                     case OBJECT:
-                        PLOG(PL_DETAIL, "NormSession::SenderHandleNackMessage(OBJECT) objs>%hu:%hu\n", 
+                        NLOG(PL_DETAIL, "NormSession::SenderHandleNackMessage(OBJECT) objs>%hu:%hu\n", 
                                 (UINT16)nextObjectId, (UINT16)lastObjectId);
                         if (holdoff)
                         {
@@ -3817,7 +4306,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                         if (nextObjectId > lastObjectId) inRange = false;
                         break;
                     case BLOCK:
-                        PLOG(PL_DETAIL, "NormSession::SenderHandleNackMessage(BLOCK) obj>%hu blks>%lu:%lu\n", 
+                        NLOG(PL_DETAIL, "NormSession::SenderHandleNackMessage(BLOCK) obj>%hu blks>%lu:%lu\n", 
                                         (UINT16)nextObjectId, 
                                         (unsigned long)nextBlockId.GetValue(), 
                                         (unsigned long)lastBlockId.GetValue());
@@ -3855,7 +4344,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                             {
                                 if (!((NormStreamObject*)object)->LockBlocks(firstLockId, lastBlockId, currentTime))
                                 {
-                                    PLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu LockBlocks() failure\n",
+                                    NLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu LockBlocks() failure\n",
                                                     (unsigned long)LocalNodeId());
                                     if (!squelchQueued) 
                                     {
@@ -3931,7 +4420,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                         }
                         break;
                     case SEGMENT:
-                        PLOG(PL_DETAIL, "NormSession::SenderHandleNackMessage(SEGMENT) obj>%hu blk>%lu segs>%hu:%hu\n", 
+                        NLOG(PL_DETAIL, "NormSession::SenderHandleNackMessage(SEGMENT) obj>%hu blk>%lu segs>%hu:%hu\n", 
                                         (UINT16)nextObjectId, (unsigned long)nextBlockId.GetValue(),
                                         (UINT16)nextSegmentId, (UINT16)lastSegmentId);
                         inRange = false;  // SEGMENT repairs are also handled in one pass
@@ -3947,7 +4436,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                                 if (object->IsPendingSet(nextBlockId))
                                 {
                                     // Entire block already tx pending, don't worry about individual segments
-                                    PLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu "
+                                    NLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu "
                                             "recvd SEGMENT repair request for pending block.\n",
                                             (unsigned long)LocalNodeId());
                                     continue;   
@@ -3959,7 +4448,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                                     {
                                         if (NormObject::STREAM == object->GetType())
                                         {
-                                            PLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu "
+                                            NLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu "
                                                     "recvd repair request for old stream block(%lu) ...\n",
                                                     (unsigned long)LocalNodeId(), 
                                                     (unsigned long)nextBlockId.GetValue());
@@ -3972,7 +4461,7 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
                                         else
                                         {
                                             // Resource constrained, move on to next repair request
-                                            PLOG(PL_INFO, "NormSession::SenderHandleNackMessage() node>%lu "
+                                            NLOG(PL_INFO, "NormSession::SenderHandleNackMessage() node>%lu "
                                                     "Warning - sender is resource constrained ...\n",
                                                     (unsigned long)LocalNodeId());
                                         }  
@@ -4150,29 +4639,377 @@ void NormSession::SenderHandleNackMessage(const struct timeval& currentTime, Nor
         }  // end while(NextRepairItem())
     }  // end while(UnpackRepairRequest())
     if (startTimer && !repair_timer.IsActive())
+        SenderStartRepairAggregation();
+}  // end NormSession::SenderHandleNackMessage()
+
+void NormSession::SenderStartRepairAggregation()
+{
+    // BACKOFF related code
+    double aggregateInterval = address.IsMulticast() ? 
+                                grtt_advertised * (backoff_factor + 1.0) : 0.0;
+    // Uncommenting the line below treats ((0 == ndata) && 0.0 == backoff_factor)
+    // as a special case (sets zero sender aggregateInterval)
+    aggregateInterval = ((0 != nparity) || (backoff_factor > 0.0)) ? aggregateInterval : 0.0;
+    
+    // TBD - why did we do this thing here to limit the min aggregateInterval???
+    // (I think to allow "11th hour NACKs to be incorporated .. so this should be
+    //  for mcast only)
+    if (tx_timer.IsActive() && address.IsMulticast())
     {
-        // BACKOFF related code
-        double aggregateInterval = address.IsMulticast() ? 
-                                    grtt_advertised * (backoff_factor + 1.0) : 0.0;
-        // Uncommenting the line below treats ((0 == ndata) && 0.0 == backoff_factor)
-        // as a special case (sets zero sender aggregateInterval)
-        aggregateInterval = ((0 != nparity) || (backoff_factor > 0.0)) ? aggregateInterval : 0.0;
+        double txTimeout = tx_timer.GetTimeRemaining() - 1.0e-06;
+        aggregateInterval = MAX(txTimeout, aggregateInterval);   
+    } 
+    repair_timer.SetInterval(aggregateInterval);  
+    GetCurrentTime(tx_repair_nack_time);  // (for TX_REPAIR latency)
+    tx_repair_latency_pending = false;
+    PLOG(PL_DEBUG, "NormSession::SenderStartRepairAggregation() node>%lu starting sender "
+                   "NACK aggregation timer (%lf sec)...\n", 
+                    (unsigned long)LocalNodeId(), aggregateInterval);
+    ActivateTimer(repair_timer); 
+}  // end NormSession::SenderStartRepairAggregation()
+
+bool NormSession::SenderBatchRepairContent(NormNackMsg& nack, UINT16& requestOffset)
+{
+    UINT16 requestLength = 0;
+    NormRepairRequest req;
+    bool freshBlock = true;
+    NormObjectId prevObjectId = 0;
+    NormBlockId prevBlockId = 0;
+    UINT16 numErasures = extra_parity;
+    while (0 != (requestLength = nack.UnpackRepairRequest(req, requestOffset)))
+    {
+        NormRepairRequest::Form requestForm = req.GetForm();
+        UINT16 requestStart = requestOffset;  // (where a plan overflow resumes)
+        requestOffset += requestLength;
+        NormRepairPlan::Level requestLevel;
+        if (req.FlagIsSet(NormRepairRequest::SEGMENT))
+        {
+            requestLevel = NormRepairPlan::SEGMENT;
+        }
+        else if (req.FlagIsSet(NormRepairRequest::BLOCK))
+        {
+            requestLevel = NormRepairPlan::BLOCK;
+        }
+        else if (req.FlagIsSet(NormRepairRequest::OBJECT))
+        {
+            requestLevel = NormRepairPlan::OBJECT;
+        }
+        else if (req.FlagIsSet(NormRepairRequest::INFO))
+        {
+            requestLevel = NormRepairPlan::INFO;
+        }
+        else
+        {
+            PLOG(PL_ERROR, "NormSession::SenderBatchRepairContent() node>%lu recvd repair request w/ invalid repair level\n",
+                            (unsigned long)LocalNodeId());
+            continue;
+        }
+        bool infoRequest = req.FlagIsSet(NormRepairRequest::INFO);
         
-        // TBD - why did we do this thing here to limit the min aggregateInterval???
-        // (I think to allow "11th hour NACKs to be incorporated .. so this should be
-        //  for mcast only)
-        if (tx_timer.IsActive() && address.IsMulticast())
+        NormRepairRequest::Iterator iterator(req, fec_id, fec_m);
+        NormObjectId nextObjectId, lastObjectId;
+        NormBlockId nextBlockId, lastBlockId;
+        UINT16 nextBlockLen, lastBlockLen;
+        NormSegmentId nextSegmentId, lastSegmentId;
+        while (iterator.NextRepairItem(&nextObjectId, &nextBlockId, 
+                                       &nextBlockLen, &nextSegmentId))
         {
-            double txTimeout = tx_timer.GetTimeRemaining() - 1.0e-06;
-            aggregateInterval = MAX(txTimeout, aggregateInterval);   
-        } 
-        repair_timer.SetInterval(aggregateInterval);  
-        PLOG(PL_DEBUG, "NormSession::SenderHandleNackMessage() node>%lu starting sender "
-                       "NACK aggregation timer (%lf sec)...\n", 
-                        (unsigned long)LocalNodeId(), aggregateInterval);
-        ActivateTimer(repair_timer); 
+            if (NormRepairRequest::RANGES == requestForm)
+            {
+                if (!iterator.NextRepairItem(&lastObjectId, &lastBlockId, 
+                                             &lastBlockLen, &lastSegmentId))
+                {
+                    PLOG(PL_ERROR, "NormSession::SenderBatchRepairContent() node>%lu recvd incomplete RANGE request!\n",
+                                    (unsigned long)LocalNodeId());
+                    continue;
+                }  
+            }
+            else
+            {
+                lastObjectId = nextObjectId;
+                lastBlockId = nextBlockId;
+                lastBlockLen = nextBlockLen;
+                lastSegmentId = nextSegmentId;
+            }
+            switch (requestLevel)
+            {
+                case NormRepairPlan::OBJECT:
+                case NormRepairPlan::INFO:
+                    while (true)
+                    {
+                        if (!tx_repair_plan.Append(requestLevel, nextObjectId, 0, 0, 0, 0, 0))
+                        {
+                            requestOffset = requestStart;
+                            return false;
+                        }
+                        if (NULL != tx_table.Find(nextObjectId))
+                            SenderUpdateRepairMin(nextObjectId, 0, 0, true);
+                        nextObjectId++;
+                        if (nextObjectId > lastObjectId) break;
+                    }
+                    break;
+                case NormRepairPlan::BLOCK:
+                    if (infoRequest && !tx_repair_plan.Append(NormRepairPlan::INFO, nextObjectId, 0, 0, 0, 0, 0))
+                    {
+                        requestOffset = requestStart;
+                        return false;
+                    }
+                    if (!tx_repair_plan.Append(NormRepairPlan::BLOCK, nextObjectId, nextBlockId, lastBlockId, 0, 0, 0))
+                    {
+                        requestOffset = requestStart;
+                        return false;
+                    }
+                    if (NULL != tx_table.Find(nextObjectId))
+                        SenderUpdateRepairMin(nextObjectId, nextBlockId, 0, infoRequest);
+                    break;
+                case NormRepairPlan::SEGMENT:
+                {
+                    if (infoRequest && !tx_repair_plan.Append(NormRepairPlan::INFO, nextObjectId, 0, 0, 0, 0, 0))
+                    {
+                        requestOffset = requestStart;
+                        return false;
+                    }
+                    // "numErasures" totals the missing segments of each block in this NACK
+                    if (freshBlock || (nextObjectId != prevObjectId) || (nextBlockId != prevBlockId))
+                    {
+                        freshBlock = false;
+                        prevObjectId = nextObjectId;
+                        prevBlockId = nextBlockId;
+                        numErasures = extra_parity;
+                    }
+                    numErasures += (lastSegmentId - nextSegmentId + 1);
+                    if (!tx_repair_plan.Append(NormRepairPlan::SEGMENT, nextObjectId, nextBlockId, nextBlockId,
+                                               nextSegmentId, lastSegmentId, numErasures))
+                    {
+                        requestOffset = requestStart;
+                        return false;
+                    }
+                    NormObject* object = tx_table.Find(nextObjectId);
+                    if (NULL != object)
+                    {
+                        UINT16 nextBlockSize = object->GetBlockSize(nextBlockId);
+                        NormSegmentId segmentMin = (nextSegmentId < nextBlockSize) ?
+                                                        nextSegmentId : (nextBlockSize - 1);
+                        SenderUpdateRepairMin(nextObjectId, nextBlockId, segmentMin, infoRequest);
+                    }
+                    break;
+                }
+            }  // end switch(requestLevel)
+        }  // end while(NextRepairItem())
+    }  // end while(UnpackRepairRequest())
+    return true;
+}  // end NormSession::SenderBatchRepairContent()
+
+// Maintains the minimum (object, block, segment) index of pending repairs
+void NormSession::SenderUpdateRepairMin(NormObjectId  objectId,
+                                        NormBlockId   blockId,
+                                        NormSegmentId segmentId,
+                                        bool          wholeObject)
+{
+    if (wholeObject)
+    {
+        blockId = 0;
+        segmentId = 0;
     }
-}  // end NormSession::SenderHandleNackMessage()
+    if (!tx_repair_pending || (objectId < tx_repair_object_min))
+    {
+        tx_repair_pending = true;
+        tx_repair_object_min = objectId;
+        tx_repair_block_min = blockId;
+        tx_repair_segment_min = segmentId;
+    }
+    else if (objectId == tx_repair_object_min)
+    {
+        int result = wholeObject ? -1 : Compare(blockId, tx_repair_block_min);
+        if (result < 0)
+        {
+            tx_repair_block_min = blockId;
+            tx_repair_segment_min = segmentId;
+        }
+        else if ((0 == result) && (segmentId < tx_repair_segment_min))
+        {
+            tx_repair_segment_min = segmentId;
+        }
+    }
+}  // end NormSession::SenderUpdateRepairMin()
+
+// Applies the merged NACK content of a NACK aggregation period, in
+// (object, level, block, segment) order, in a single pass
+void NormSession::SenderDispatchRepairPlan(const struct timeval& currentTime)
+{
+    if (tx_repair_plan.IsEmpty()) return;
+    tx_repair_plan.Merge(tx_table.IsEmpty() ? next_tx_object_id : tx_table.RangeLo(), 
+                         fec_block_mask);
+    PLOG(PL_DEBUG, "NormSession::SenderDispatchRepairPlan() node>%lu dispatching %u merged repair items ...\n",
+                    (unsigned long)LocalNodeId(), tx_repair_plan.GetCount());
+    bool squelchQueued = false;
+    NormObject* object = NULL;
+    bool freshObject = true;
+    NormObjectId prevObjectId = 0;
+    unsigned int count = tx_repair_plan.GetCount();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const NormRepairPlan::Item& item = tx_repair_plan.GetItem(i);
+        NormObjectId objectId = item.GetObjectId();
+        if (freshObject || (objectId != prevObjectId))
+        {
+            freshObject = false;
+            prevObjectId = objectId;
+            if (NULL != (object = tx_table.Find(objectId)))
+            {
+                object->SetLastNackTime(ProtoTime(currentTime));
+            }
+            else
+            {
+                PLOG(PL_DEBUG, "NormSession::SenderDispatchRepairPlan() node>%lu recvd repair request "
+                               "for unknown object ...\n", (unsigned long)LocalNodeId());
+                if (!squelchQueued) 
+                {
+                    SenderQueueSquelch(objectId);
+                    squelchQueued = true;
+                }
+            }
+        }
+        if (NULL == object) continue;
+        switch (item.GetLevel())
+        {
+            case NormRepairPlan::OBJECT:
+                tx_repair_mask.Set(objectId);
+                // The entire object will be reset, so skip its remaining items
+                while (((i + 1) < count) && (objectId == tx_repair_plan.GetItem(i + 1).GetObjectId()))
+                    i++;
+                break;
+                
+            case NormRepairPlan::INFO:
+                object->HandleInfoRequest(false);
+                break;
+                
+            case NormRepairPlan::BLOCK:
+            {
+                NormBlockId firstBlockId = item.GetFirstBlockId();
+                NormBlockId lastBlockId = item.GetLastBlockId();
+                if (object->IsStream())
+                {
+                    // mark nack time for potential flow control
+                    static_cast<NormStreamObject*>(object)->SetLastNackTime(firstBlockId, ProtoTime(currentTime));
+                    if (!static_cast<NormStreamObject*>(object)->LockBlocks(firstBlockId, lastBlockId, currentTime))
+                    {
+                        PLOG(PL_DEBUG, "NormSession::SenderDispatchRepairPlan() node>%lu LockBlocks() failure\n",
+                                        (unsigned long)LocalNodeId());
+                        if (!squelchQueued) 
+                        {
+                            SenderQueueSquelch(objectId);
+                            squelchQueued = true;
+                        }
+                        break;
+                    } 
+                }
+                if (!object->HandleBlockRequest(firstBlockId, lastBlockId))
+                {
+                    if (!squelchQueued) 
+                    {
+                        SenderQueueSquelch(objectId);
+                        squelchQueued = true;
+                    }
+                }
+                break;
+            }
+            
+            case NormRepairPlan::SEGMENT:
+            {
+                // Find the run of merged segment intervals for this block
+                // and the largest erasure count reported for it
+                NormBlockId blockId = item.GetFirstBlockId();
+                UINT16 erasureCount = item.GetErasureCount();
+                unsigned int end = i + 1;
+                while (end < count)
+                {
+                    const NormRepairPlan::Item& next = tx_repair_plan.GetItem(end);
+                    if ((objectId != next.GetObjectId()) || (blockId != next.GetFirstBlockId())) break;
+                    if (next.GetErasureCount() > erasureCount) erasureCount = next.GetErasureCount();
+                    end++;
+                }
+                NormBlock* block = NULL;
+                if (object->IsRepairSet(blockId))
+                {
+                    // Entire block already repair pending
+                }
+                else if (NULL == (block = object->FindBlock(blockId)))
+                {
+                    if (object->IsPendingSet(blockId))
+                    {
+                        // Entire block already tx pending, don't worry about individual segments
+                        PLOG(PL_DEBUG, "NormSession::SenderDispatchRepairPlan() node>%lu "
+                                "recvd SEGMENT repair request for pending block.\n",
+                                (unsigned long)LocalNodeId());
+                    }
+                    else if (NULL == (block = object->SenderRecoverBlock(blockId)))
+                    {
+                        if (object->IsStream())
+                        {
+                            PLOG(PL_DEBUG, "NormSession::SenderDispatchRepairPlan() node>%lu "
+                                    "recvd repair request for old stream block(%lu) ...\n",
+                                    (unsigned long)LocalNodeId(), (unsigned long)blockId.GetValue());
+                            if (!squelchQueued) 
+                            {
+                                SenderQueueSquelch(objectId);
+                                squelchQueued = true;
+                            }
+                        }
+                        else
+                        {
+                            PLOG(PL_INFO, "NormSession::SenderDispatchRepairPlan() node>%lu "
+                                    "Warning - sender is resource constrained ...\n",
+                                    (unsigned long)LocalNodeId());
+                        }
+                    }
+                }
+                if (NULL != block)
+                {
+                    UINT16 blockSize = object->GetBlockSize(blockId);
+                    if (object->IsStream())
+                        static_cast<NormStreamObject*>(object)->SetLastNackTime(blockId, ProtoTime(currentTime));
+                    for (unsigned int j = i; j < end; j++)
+                    {
+                        const NormRepairPlan::Item& next = tx_repair_plan.GetItem(j);
+                        NormSegmentId firstId = next.GetFirstSegmentId();
+                        NormSegmentId lastId = next.GetLastSegmentId();
+                        // If stream && explicit data repair, lock the data for retransmission
+                        // (TBD) this use of "ndata" needs to be replaced for dynamically shortened blocks
+                        if (object->IsStream() && (firstId < ndata))
+                        {
+                            NormSegmentId lastLockId = ndata - 1;
+                            lastLockId = MIN(lastLockId, lastId);
+                            if (!static_cast<NormStreamObject*>(object)->LockSegments(blockId, firstId, lastLockId))
+                            {
+                                PLOG(PL_ERROR, "NormSession::SenderDispatchRepairPlan() node>%lu "
+                                               "LockSegments() failure\n", (unsigned long)LocalNodeId());
+                                if (!squelchQueued) 
+                                {
+                                    SenderQueueSquelch(objectId);
+                                    squelchQueued = true;
+                                }
+                                break;
+                            }
+                        }
+                        // Merged intervals may span data and parity, so request those separately
+                        if (firstId < blockSize)
+                        {
+                            NormSegmentId lastDataId = (lastId < blockSize) ? lastId : (blockSize - 1);
+                            block->HandleSegmentRequest(firstId, lastDataId, blockSize, nparity, erasureCount);
+                            if (lastId < blockSize) continue;
+                            firstId = blockSize;
+                        }
+                        block->HandleSegmentRequest(firstId, lastId, blockSize, nparity, erasureCount);
+                    }
+                }
+                i = end - 1;
+                break;
+            }
+        }  // end switch(item.GetLevel())
+    }  // end for (i < count)
+    tx_repair_plan.Clear();
+}  // end NormSession::SenderDispatchRepairPlan()
 
 
 void NormSession::ReceiverHandleAckMessage(const NormAckMsg& ack)
@@ -4189,12 +5026,15 @@ void NormSession::ReceiverHandleAckMessage(const NormAckMsg& ack)
     }
 }  // end NormSession::ReceiverHandleAckMessage()
 
-void NormSession::ReceiverHandleNackMessage(const NormNackMsg& nack)
+void NormSession::ReceiverHandleNackMessage(const NormNackMsg& nack, bool wasUnicast)
 {
     NormSenderNode* theSender = (NormSenderNode*)sender_tree.FindNodeById(nack.GetSenderId());
     if (theSender)
     {
         theSender->HandleNackMessage(nack);
+        // NACKs sent directly to us (as a local repair peer) are relayed
+        if (local_repair)
+            theSender->HandleLocalRepairRequest(nack, wasUnicast && Address().IsMulticast());
     }
     else if (nack.GetSenderId() != LocalNodeId())
     {
@@ -4203,6 +5043,80 @@ void NormSession::ReceiverHandleNackMessage(const NormNackMsg& nack)
     }
 }  // end NormSession::ReceiverHandleNackMessage()
 
+bool NormSession::ReceiverAddAggregateMember(NormNodeId nodeId)
+{
+    if ((NORM_NODE_NONE == nodeId) || (NORM_NODE_ANY == nodeId)) return false;
+    if (ReceiverGetAggregateMemberIndex(nodeId) >= 0) return true;  // already a member
+    if (agg_member_count == agg_member_max)
+    {
+        if (0xffff == agg_member_max)
+        {
+            PLOG(PL_ERROR, "NormSession::ReceiverAddAggregateMember() error: member list full\n");
+            return false;
+        }
+        unsigned int newMax = (0 != agg_member_max) ? (2 * agg_member_max) : 32;
+        if (newMax > 0xffff) newMax = 0xffff;
+        NormNodeId* newList = new NormNodeId[newMax];
+        if (NULL == newList)
+        {
+            PLOG(PL_ERROR, "NormSession::ReceiverAddAggregateMember() new member list error: %s\n", GetErrorString());
+            return false;
+        }
+        if (NULL != agg_member_list)
+        {
+            memcpy(newList, agg_member_list, agg_member_count*sizeof(NormNodeId));
+            delete[] agg_member_list;
+        }
+        agg_member_list = newList;
+        agg_member_max = (UINT16)newMax;
+    }
+    // Insertion keeps the list sorted for lookup by binary search
+    UINT16 index = agg_member_count;
+    while ((index > 0) && (agg_member_list[index - 1] > nodeId))
+    {
+        agg_member_list[index] = agg_member_list[index - 1];
+        index--;
+    }
+    agg_member_list[index] = nodeId;
+    agg_member_count++;
+    // (member indices above "index" changed)
+    NormNodeTreeIterator iterator(sender_tree);
+    NormNode* next;
+    while (NULL != (next = iterator.GetNextNode()))
+        static_cast<NormSenderNode*>(next)->UpdateAggregateMember(index, true);
+    return true;
+}  // end NormSession::ReceiverAddAggregateMember()
+
+void NormSession::ReceiverRemoveAggregateMember(NormNodeId nodeId)
+{
+    int index = ReceiverGetAggregateMemberIndex(nodeId);
+    if (index < 0) return;
+    agg_member_count--;
+    for (UINT16 i = (UINT16)index; i < agg_member_count; i++)
+        agg_member_list[i] = agg_member_list[i + 1];
+    NormNodeTreeIterator iterator(sender_tree);
+    NormNode* next;
+    while (NULL != (next = iterator.GetNextNode()))
+        static_cast<NormSenderNode*>(next)->UpdateAggregateMember((UINT16)index, false);
+}  // end NormSession::ReceiverRemoveAggregateMember()
+
+int NormSession::ReceiverGetAggregateMemberIndex(NormNodeId nodeId) const
+{
+    int lo = 0;
+    int hi = (int)agg_member_count - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) >> 1;
+        if (agg_member_list[mid] < nodeId)
+            lo = mid + 1;
+        else if (agg_member_list[mid] > nodeId)
+            hi = mid - 1;
+        else
+            return mid;
+    }
+    return -1;
+}  // end NormSession::ReceiverGetAggregateMemberIndex()
+
 
 bool NormSession::SenderQueueSquelch(NormObjectId objectId)
 {
@@ -4430,6 +5344,7 @@ void NormSession::ActivateFlowControl(double delay, NormObjectId objectId, NormC
 
 bool NormSession::OnFlowControlTimeout(ProtoTimer& theTimer)
 {
+    NormClock::Scope clockScope(session_clock);
     NormObject* object = tx_table.Find(flow_control_object);
     if (NULL == object)
     {
@@ -4438,6 +5353,8 @@ bool NormSession::OnFlowControlTimeout(ProtoTimer& theTimer)
         //Notify(NormController::TX_QUEUE_EMPTY, (NormSenderNode*)NULL, (NormObject*)NULL);
         return true;
     }
+    struct timeval currentTime;
+    session_clock.GetCurrentTime(currentTime);
     double deltaTime;
     if (object->IsStream())
     {
@@ -4451,7 +5368,7 @@ bool NormSession::OnFlowControlTimeout(ProtoTimer& theTimer)
             Notify(NormController::TX_QUEUE_EMPTY, (NormSenderNode*)NULL, object);//(NormObject*)NULL);
             return true;
         }
-        deltaTime = GetFlowControlDelay() - block->GetNackAge();
+        deltaTime = GetFlowControlDelay() - block->GetNackAge(ProtoTime(currentTime));
         if (deltaTime < 1.0e-06)
         {
             // no recent NACKing for "oldest block", so post EMPTY/VACANCY if non-pending
@@ -4467,7 +5384,7 @@ bool NormSession::OnFlowControlTimeout(ProtoTimer& theTimer)
     else
     {
         // The tx cache (queue) is being flow controlled ...
-        deltaTime = GetFlowControlDelay() - object->GetNackAge();
+        deltaTime = GetFlowControlDelay() - object->GetNackAge(ProtoTime(currentTime));
         if (deltaTime < 1.0e-06)
         {
             // no recent NACKing, so if non-pending, dispatch queue EMPTY or VACANCY
@@ -4601,12 +5518,19 @@ bool NormSession::SenderBuildRepairAdv(NormCmdRepairAdvMsg& cmd)
 
 bool NormSession::OnRepairTimeout(ProtoTimer& /*theTimer*/)
 {
+    NormClock::Scope clockScope(session_clock);
     tx_repair_pending = false;
     if (0 != repair_timer.GetRepeatCount())
     {
         // NACK aggregation period has ended. (incorporate accumulated repair requests)
         PLOG(PL_DEBUG, "NormSession::OnRepairTimeout() node>%lu sender NACK aggregation time ended.\n",
                         (unsigned long)LocalNodeId()); 
+        if (!tx_repair_plan.IsEmpty())
+        {
+            struct timeval currentTime;
+            session_clock.GetCurrentTime(currentTime);
+            SenderDispatchRepairPlan(currentTime);
+        }
         NormObjectTable::Iterator iterator(tx_table);
         NormObject* obj;
         while ((obj = iterator.GetNextObject()))
@@ -4642,6 +5566,7 @@ bool NormSession::OnRepairTimeout(ProtoTimer& /*theTimer*/)
             } 
         }  // end while (iterator.GetNextObject())   
         PromptSender();
+        tx_repair_latency_pending = true;  // (recorded upon first repair sent)
         // BACKOFF related code
         // Holdoff initiation of new repair cycle for one GRTT 
         // (TBD) for unicast sessions, use CLR RTT ???
@@ -4666,6 +5591,7 @@ bool NormSession::OnRepairTimeout(ProtoTimer& /*theTimer*/)
 //       for more efficiency ...
 bool NormSession::OnTxTimeout(ProtoTimer& /*theTimer*/)
 {
+    NormClock::Scope clockScope(session_clock);
 	NormMsg* msg;  
     
     // Note: sometimes need RepairAdv even when cc_enable is false ...                        
@@ -4826,6 +5752,8 @@ NormSession::MessageStatus NormSession::SendMessage(NormMsg& msg)
                 case NormCmdMsg::CC:
                 {
                     NormCmdCCMsg& ccMsg = static_cast<NormCmdCCMsg&>(cmd);
+                    // (the probe send time is read directly since a sender's
+                    //  GRTT measurement depends on its precision)
                     struct timeval currentTime;
                     ProtoSystemTime(currentTime); 
                     ccMsg.SetSendTime(currentTime); 
@@ -4852,7 +5780,7 @@ NormSession::MessageStatus NormSession::SendMessage(NormMsg& msg)
             fecM = theSender->GetFecFieldSize();
 	        instId = theSender->GetInstanceId();
             struct timeval currentTime;
-            ProtoSystemTime(currentTime); 
+            session_clock.GetCurrentTime(currentTime);
             struct timeval grttResponse;
             theSender->CalculateGrttResponse(currentTime, grttResponse);
             nack.SetGrttResponse(grttResponse);
@@ -4873,7 +5801,7 @@ NormSession::MessageStatus NormSession::SendMessage(NormMsg& msg)
 	        instId = theSender->GetInstanceId();
             struct timeval grttResponse;
             struct timeval currentTime;
-            ProtoSystemTime(currentTime); 
+            session_clock.GetCurrentTime(currentTime);
             theSender->CalculateGrttResponse(currentTime, grttResponse);
             ack.SetGrttResponse(grttResponse);
             break;
@@ -4905,8 +5833,8 @@ NormSession::MessageStatus NormSession::SendMessage(NormMsg& msg)
         if (trace) 
         {
             struct timeval currentTime;
-            ProtoSystemTime(currentTime); 
-            NormTrace(currentTime, LocalNodeId(), msg, true, fecM, instId);
+            session_clock.GetCurrentTime(currentTime);
+            TraceMessage(currentTime, msg, true, fecM, instId);
         }
         // Update sent rate tracker even if dropped (for testing/debugging)
         sent_accumulator.Increment(msgSize);
@@ -4931,13 +5859,17 @@ NormSession::MessageStatus NormSession::SendMessage(NormMsg& msg)
                 if (trace) 
                 {
                     struct timeval currentTime;
-                    ProtoSystemTime(currentTime); 
-                    NormTrace(currentTime, LocalNodeId(), msg, true, fecM, instId);
+                    session_clock.GetCurrentTime(currentTime);
+                    TraceMessage(currentTime, msg, true, fecM, instId);
                 }
                 // To keep track of _actual_ sent rate 
                 sent_accumulator.Increment(msgSize);
                 // Update nominal packet size
                 nominal_packet_size += 0.01 * (((double)msgSize) - nominal_packet_size); 
+                stats.sent_bytes += msgSize;
+                stats.sent_packets++;
+                if (!stats_timer.IsActive()) ActivateTimer(stats_timer);
+                if (NormMsg::NACK == msg.GetType()) stats.nacks_sent++;
             }
             else
             {
@@ -4989,6 +5921,44 @@ NormSession::MessageStatus NormSession::SendMessage(NormMsg& msg)
     return MSG_SEND_OK;
 }  // end NormSession::SendMessage()
 
+// Sends a message built by a local repair peer on behalf of another node
+// (i.e., unlike SendMessage(), the message header is left as-is)
+bool NormSession::ReceiverSendLocalRepairMsg(NormMsg& msg, UINT8 theTTL)
+{
+    if (receiver_silent) return true;
+    bool scoped = msg.GetDestination().IsMulticast() && (theTTL != ttl);
+    if (scoped && !tx_socket->SetTTL(theTTL))
+        PLOG(PL_WARN, "NormSession::ReceiverSendLocalRepairMsg() tx_socket.SetTTL() error\n");
+    UINT16 msgSize = msg.GetLength();
+    unsigned int numBytes = msgSize;
+    bool result = tx_socket->SendTo(msg.GetBuffer(), numBytes, msg.GetDestination());
+    if (scoped) tx_socket->SetTTL(ttl);
+    if (result && (numBytes == msgSize))
+    {
+        if (trace) 
+        {
+            struct timeval currentTime;
+            session_clock.GetCurrentTime(currentTime);
+            NormSenderNode* theSender = NULL;
+            if (NormMsg::NACK == msg.GetType())
+                theSender = (NormSenderNode*)sender_tree.FindNodeById(static_cast<NormNackMsg&>(msg).GetSenderId());
+            else
+                theSender = (NormSenderNode*)sender_tree.FindNodeById(msg.GetSourceId());
+            if (NULL != theSender)
+                TraceMessage(currentTime, msg, true, 
+                             theSender->GetFecFieldSize(), theSender->GetInstanceId());
+        }
+        sent_accumulator.Increment(msgSize);
+        stats.sent_bytes += msgSize;
+        stats.sent_packets++;
+        if (!stats_timer.IsActive()) ActivateTimer(stats_timer);
+        return true;
+    }
+    PLOG(PL_WARN, "NormSession::ReceiverSendLocalRepairMsg() sendto(%s/%hu) warning: %s\n",
+                   msg.GetDestination().GetHostString(), msg.GetDestination().GetPort(), GetErrorString());
+    return false;
+}  // end NormSession::ReceiverSendLocalRepairMsg()
+
 void NormSession::SetGrttProbingInterval(double intervalMin, double intervalMax)
 {
     if ((intervalMin < 0.0) || (intervalMax < 0.0)) return;
@@ -5067,6 +6037,7 @@ void NormSession::SetGrttProbingMode(ProbingMode probingMode)
 
 bool NormSession::OnProbeTimeout(ProtoTimer& /*theTimer*/)
 {
+    NormClock::Scope clockScope(session_clock);
     // 1) Temporarily kill probe_timer if CMD(CC) not yet tx'd
     //    (or if data has not been sent since last probe)
     if (probe_pending || (data_active && probe_data_check) || (0.0 == tx_rate))
@@ -5086,7 +6057,7 @@ bool NormSession::OnProbeTimeout(ProtoTimer& /*theTimer*/)
     // world operating systems, they're aren't the same and
     // sometimes not even close.
     struct timeval currentTime;
-    ProtoSystemTime(currentTime);
+    session_clock.GetCurrentTime(currentTime);
     if ((0 == probe_time_last.tv_sec) && (0 == probe_time_last.tv_usec))
     {
         grtt_age += probe_timer.GetInterval();
@@ -5196,11 +6167,11 @@ bool NormSession::OnProbeTimeout(ProtoTimer& /*theTimer*/)
         
     if (cc_enable)
     {
-        // Iterate over cc_node_list and append cc_nodes ...
+        // Iterate over cc_node_heap and append cc_nodes ...
         // (we also check cc_node "activity status here)
-        NormNodeListIterator iterator(cc_node_list);
+        bool deactivated = false;
         NormCCNode* next;
-        while ((next = (NormCCNode*)iterator.GetNextNode()))
+        for (unsigned int i = 0; NULL != (next = cc_node_heap.GetNode(i)); i++)
         {
             if (next->IsActive())
             {
@@ -5245,9 +6216,11 @@ bool NormSession::OnProbeTimeout(ProtoTimer& /*theTimer*/)
                     PLOG(PL_DEBUG, "Deactivating cc node feedbackAge:%lf sec maxAge:%lf sec ccSeqDelta:%u\n",
                             feedbackAge, maxFeedbackAge, ccSeqDelta);
                     next->SetActive(false);
+                    deactivated = true;
                 }
             }             
         }
+        if (deactivated) cc_node_heap.Heapify();
         AdjustRate(false);
     }  // end if (cc_enable)
     
@@ -5275,7 +6248,7 @@ double NormSession::GetProbeInterval()
 {
     if (cc_enable && data_active)
     {
-        const NormCCNode* clr = static_cast<const NormCCNode*>(cc_node_list.Head());
+        const NormCCNode* clr = cc_node_heap.Head();
         if (NULL != clr)
         {
             double probeInterval = (clr->IsActive() ? MIN(grtt_advertised, clr->GetRtt()) : grtt_advertised);
@@ -5317,7 +6290,7 @@ double NormSession::GetProbeInterval()
 
 void NormSession::AdjustRate(bool onResponse)
 {
-    const NormCCNode* clr = (const NormCCNode*)cc_node_list.Head();
+    const NormCCNode* clr = cc_node_heap.Head();
     double ccRtt = clr ? clr->GetRtt() : grtt_measured;
     double ccLoss = clr ? clr->GetLoss() : 0.0;
     double txRate = tx_rate;
@@ -5462,7 +6435,7 @@ void NormSession::AdjustRate(bool onResponse)
     }
     
     struct timeval currentTime;
-    ::ProtoSystemTime(currentTime);
+    session_clock.GetCurrentTime(currentTime);
     double theTime = (double)currentTime.tv_sec + 1.0e-06 * ((double)currentTime.tv_usec);
     PLOG(PL_DEBUG, "SenderRateTracking time>%lf rate>%lf rtt>%lf loss>%lf\n", theTime, 8.0e-03*txRate, ccRtt, ccLoss);
     //TRACE("SenderRateTracking time>%lf rate>%lf rtt>%lf loss>%lf\n", theTime, 8.0e-03*txRate, ccRtt, ccLoss);
@@ -5510,7 +6483,7 @@ bool NormSession::OnReportTimeout(ProtoTimer& /*theTimer*/)
                 8.0e-03*tx_rate, sentRate, grtt_advertised);
         if (cc_enable)
         {
-            const NormCCNode* clr = (const NormCCNode*)cc_node_list.Head(); 
+            const NormCCNode* clr = cc_node_heap.Head(); 
             if (clr)  
             {
                 PLOG(reportDebugLevel, "   clr>%lu rate>%9.3lf rtt>%lf loss>%lf %s\n", 
@@ -5561,6 +6534,46 @@ bool NormSession::OnReportTimeout(ProtoTimer& /*theTimer*/)
     return true;
 }  // end NormSession::OnReportTimeout()
 
+void NormSession::UpdateStats()
+{
+    // Refresh the gauges, then publish
+    stats.buffer_usage = segment_size * segment_pool.CurrentUsage();
+    stats.buffer_peak = segment_size * segment_pool.PeakUsage();
+    stats.buffer_overruns = segment_pool.OverunCount() + block_pool.OverrunCount();
+    stats.tx_rate = tx_rate;
+    stats.grtt = grtt_advertised;
+    const NormCCNode* clr = cc_enable ? cc_node_heap.Head() : NULL;
+    stats.cc_rtt = (NULL != clr) ? clr->GetRtt() : 0.0;
+    stats.cc_loss = (NULL != clr) ? clr->GetLoss() : 0.0;
+    stats.timer_lag = timer_wheel.GetLag();
+    stats.timer_lag_max = timer_wheel.GetLagMax();
+    stats_lock.BeginUpdate() = stats;
+    stats_lock.EndUpdate();
+}  // end NormSession::UpdateStats()
+
+bool NormSession::OnStatsTimeout(ProtoTimer& /*theTimer*/)
+{
+    UpdateStats();
+    NormObjectTable::Iterator txIterator(tx_table);
+    NormObject* obj;
+    while (NULL != (obj = txIterator.GetNextObject()))
+        obj->UpdateStats();
+    NormNodeTreeIterator iterator(sender_tree);
+    NormNode* node;
+    while (NULL != (node = iterator.GetNextNode()))
+        static_cast<NormSenderNode*>(node)->UpdateStats();
+    // Go idle once the traffic stops (the final snapshot has been
+    // published above, and the next packet sent or received restarts us)
+    unsigned long long packetCount = stats.sent_packets + stats.recv_packets;
+    if (packetCount == stats_packet_count)
+    {
+        stats_timer.Deactivate();
+        return false;
+    }
+    stats_packet_count = packetCount;
+    return true;
+}  // end NormSession::OnStatsTimeout()
+
 bool NormSession::OnUserTimeout(ProtoTimer& /*theTimer*/)
 {
     Notify(NormController::USER_TIMEOUT, (NormSenderNode*)NULL, (NormObject*)NULL);
@@ -5573,7 +6586,7 @@ NormSessionMgr::NormSessionMgr(ProtoTimerMgr&           timerMgr,
                                ProtoSocket::Notifier&   socketNotifier,
                                ProtoChannel::Notifier*  channelNotifier)
  : timer_mgr(timerMgr), socket_notifier(socketNotifier), channel_notifier(channelNotifier),
-   controller(NULL), data_free_func(NULL), top_session(NULL)
+   controller(NULL), data_free_func(NULL), top_session(NULL), trace_ring(NULL)
 {
 }
 
@@ -5651,3 +6664,160 @@ void NormSessionMgr::DeleteSession(class NormSession* theSession)
     }
 }  // end NormSessionMgr::DeleteSession()
 
+
+NormRepairPlan::NormRepairPlan()
+ : item_list(NULL), item_count(0), item_size(0), item_seq(0)
+{
+}
+
+NormRepairPlan::~NormRepairPlan()
+{
+    Destroy();
+}
+
+void NormRepairPlan::Destroy()
+{
+    if (NULL != item_list)
+    {
+        delete[] item_list;
+        item_list = NULL;
+    }
+    item_count = item_size = 0;
+}  // end NormRepairPlan::Destroy()
+
+bool NormRepairPlan::Append(Level           level,
+                            NormObjectId    objectId,
+                            NormBlockId     firstBlockId,
+                            NormBlockId     lastBlockId,
+                            NormSegmentId   firstSegmentId,
+                            NormSegmentId   lastSegmentId,
+                            UINT16          erasureCount)
+{
+    if (item_count == item_size)
+    {
+        unsigned int newSize = (0 != item_size) ? (2 * item_size) : 64;
+        Item* newList = new Item[newSize];
+        if (NULL == newList)
+        {
+            PLOG(PL_FATAL, "NormRepairPlan::Append() new item_list error: %s\n", GetErrorString());
+            return false;
+        }
+        for (unsigned int i = 0; i < item_count; i++)
+            newList[i] = item_list[i];
+        if (NULL != item_list) delete[] item_list;
+        item_list = newList;
+        item_size = newSize;
+    }
+    if (0 == item_count) item_seq = 0;
+    Item& item = item_list[item_count++];
+    item.seq = item_seq++;
+    item.object_key = 0;
+    item.block_key = item.block_key_last = 0;
+    item.block_first = firstBlockId.GetValue();
+    item.block_last = lastBlockId.GetValue();
+    item.object_id = (UINT16)objectId;
+    item.segment_first = firstSegmentId;
+    item.segment_last = lastSegmentId;
+    item.erasure_count = erasureCount;
+    item.level = (UINT8)level;
+    return true;
+}  // end NormRepairPlan::Append()
+
+// Orders items by object (relative to the plan "base"), then level, then arrival
+int NormRepairPlan::CompareObject(const void* a, const void* b)
+{
+    const Item* itemA = (const Item*)a;
+    const Item* itemB = (const Item*)b;
+    if (itemA->object_key != itemB->object_key)
+        return ((itemA->object_key < itemB->object_key) ? -1 : 1);
+    if (itemA->level != itemB->level)
+        return ((itemA->level < itemB->level) ? -1 : 1);
+    if (itemA->seq != itemB->seq)
+        return ((itemA->seq < itemB->seq) ? -1 : 1);
+    return 0;
+}  // end NormRepairPlan::CompareObject()
+
+// Orders the items of an (object, level) group by block, then segment
+int NormRepairPlan::CompareBlock(const void* a, const void* b)
+{
+    const Item* itemA = (const Item*)a;
+    const Item* itemB = (const Item*)b;
+    if (itemA->block_key != itemB->block_key)
+        return ((itemA->block_key < itemB->block_key) ? -1 : 1);
+    if (itemA->segment_first != itemB->segment_first)
+        return ((itemA->segment_first < itemB->segment_first) ? -1 : 1);
+    if (itemA->seq != itemB->seq)
+        return ((itemA->seq < itemB->seq) ? -1 : 1);
+    return 0;
+}  // end NormRepairPlan::CompareBlock()
+
+void NormRepairPlan::Merge(NormObjectId objectBase, UINT32 blockMask)
+{
+    if (0 == item_count) return;
+    // Sort keys are precomputed so the comparisons need no shared state
+    for (unsigned int i = 0; i < item_count; i++)
+        item_list[i].object_key = (UINT16)(item_list[i].object_id - (UINT16)objectBase);
+    qsort(item_list, item_count, sizeof(Item), CompareObject);
+    unsigned int outCount = 0;
+    unsigned int i = 0;
+    while (i < item_count)
+    {
+        // Find the group of items for the same object and level
+        unsigned int end = i + 1;
+        while ((end < item_count) && 
+               (item_list[end].object_key == item_list[i].object_key) &&
+               (item_list[end].level == item_list[i].level))
+        {
+            end++;
+        }
+        if (item_list[i].level <= INFO)
+        {
+            // Only one OBJECT or INFO item per object is needed
+            item_list[outCount++] = item_list[i];
+            i = end;
+            continue;
+        }
+        // Block ids are ordered relative to the group's earliest arriving item
+        NormBlockId blockBase(item_list[i].block_first);
+        for (unsigned int j = i; j < end; j++)
+        {
+            item_list[j].block_key = NormBlockId::Difference(item_list[j].block_first, blockBase, blockMask);
+            item_list[j].block_key_last = NormBlockId::Difference(item_list[j].block_last, blockBase, blockMask);
+        }
+        qsort(item_list + i, end - i, sizeof(Item), CompareBlock);
+        // Merge overlapping or adjacent block (or segment) intervals
+        Item* current = item_list + outCount++;
+        *current = item_list[i];
+        for (unsigned int j = i + 1; j < end; j++)
+        {
+            const Item& next = item_list[j];
+            if (BLOCK == next.level)
+            {
+                if (next.block_key <= (current->block_key_last + 1))
+                {
+                    if (next.block_key_last > current->block_key_last)
+                    {
+                        current->block_key_last = next.block_key_last;
+                        current->block_last = next.block_last;
+                    }
+                    continue;
+                }
+            }
+            else if (next.block_key == current->block_key)
+            {
+                if ((UINT32)next.segment_first <= ((UINT32)current->segment_last + 1))
+                {
+                    if (next.segment_last > current->segment_last)
+                        current->segment_last = next.segment_last;
+                    if (next.erasure_count > current->erasure_count)
+                        current->erasure_count = next.erasure_count;
+                    continue;
+                }
+            }
+            current = item_list + outCount++;
+            *current = next;
+        }
+        i = end;
+    }
+    item_count = outCount;
+}  // end NormRepairPlan::Merge()
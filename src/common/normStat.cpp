@@ -0,0 +1,308 @@
+// The "normStat" tool monitors the shared memory metrics segments (see
+// normMetrics.h and NormSetMetricsExport()) of the NORM processes on a
+// host, printing for each session and remote sender the send/receive
+// rates computed from its counter deltas, repair ratios, loss estimates,
+// and buffer occupancy.  Segments are found by scanning "/dev/shm" for
+// "norm.*" names unless specific segment names are given.
+//
+// usage: normStat [interval <sec>][count <reports>][verbose][segment <name>]...
+
+#include "normMetrics.h"
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>   // for atof(), atoi()
+#include <string.h>   // for strcmp(), strncmp()
+#include <dirent.h>   // for opendir()
+#include <signal.h>   // for kill()
+#include <errno.h>
+#include <time.h>     // for nanosleep(), gmtime_r()
+
+class StatMonitor
+{
+    public:
+        StatMonitor();
+        ~StatMonitor();
+
+        bool Open(const char* segmentName);
+        void Report(bool verbose);
+
+        NormMetrics                 metrics;
+        NormMetrics::SessionEntry*  prev_session;  // previous entries for rates
+        NormMetrics::SenderEntry*   prev_sender;
+        bool                        found;         // seen in latest scan
+        StatMonitor*                next;
+};  // end class StatMonitor
+
+StatMonitor::StatMonitor()
+ : prev_session(NULL), prev_sender(NULL), found(true), next(NULL)
+{
+}
+
+StatMonitor::~StatMonitor()
+{
+    if (NULL != prev_session) delete[] prev_session;
+    if (NULL != prev_sender) delete[] prev_sender;
+}
+
+bool StatMonitor::Open(const char* segmentName)
+{
+    if (!metrics.Open(segmentName)) return false;
+    const NormMetrics::Header* header = metrics.GetHeader();
+    prev_session = new NormMetrics::SessionEntry[header->session_max];
+    prev_sender = new NormMetrics::SenderEntry[header->sender_max];
+    if ((NULL == prev_session) || (NULL == prev_sender))
+    {
+        perror("normStat new previous entries error");
+        return false;
+    }
+    memset(prev_session, 0, header->session_max * sizeof(NormMetrics::SessionEntry));
+    memset(prev_sender, 0, header->sender_max * sizeof(NormMetrics::SenderEntry));
+    return true;
+}  // end StatMonitor::Open()
+
+// Rate (kbps) from a byte counter delta, or negative if unknown
+static double RateKbps(unsigned long long bytes, unsigned long long prevBytes, double interval)
+{
+    if ((interval <= 0.0) || (bytes < prevBytes)) return -1.0;
+    return (8.0e-03 * (double)(bytes - prevBytes) / interval);
+}  // end RateKbps()
+
+static void PrintRate(const char* label, double rate)
+{
+    if (rate < 0.0)
+        printf(" %s>%9s", label, "-");
+    else
+        printf(" %s>%9.3lf", label, rate);
+}  // end PrintRate()
+
+void StatMonitor::Report(bool verbose)
+{
+    const NormMetrics::Header* header = metrics.GetHeader();
+    bool alive = (0 == kill((pid_t)header->process_id, 0)) || (EPERM == errno);
+    printf("segment>%s pid>%lu shards>%lu interval>%.3lf sec%s\n", metrics.GetName(),
+           (unsigned long)header->process_id, (unsigned long)header->shard_count,
+           1.0e-03 * header->interval_msec, alive ? "" : " (stale)");
+    if (!alive) return;
+    for (unsigned int i = 0; i < header->session_max; i++)
+    {
+        NormMetrics::SessionEntry entry;
+        metrics.GetSessionSlot(i)->Read(entry);
+        NormMetrics::SessionEntry& prev = prev_session[i];
+        if (0 == entry.in_use)
+        {
+            prev.in_use = 0;
+            continue;
+        }
+        // (rates need a previous entry of the same session)
+        double interval = -1.0;
+        if ((0 != prev.in_use) && (entry.local_id == prev.local_id) &&
+            (0 == strcmp(entry.address, prev.address)))
+            interval = entry.update_time - prev.update_time;
+        printf("   session>%s node>%lu shard>%lu%s%s\n", entry.address,
+               (unsigned long)entry.local_id, (unsigned long)entry.shard,
+               (0 != (entry.flags & NormMetrics::SESSION_SENDER)) ? " sender" : "",
+               (0 != (entry.flags & NormMetrics::SESSION_RECEIVER)) ? " receiver" : "");
+        printf("     ");
+        PrintRate("txRate", 8.0e-03 * entry.tx_rate);
+        PrintRate("sentRate", RateKbps(entry.sent_bytes, prev.sent_bytes, interval));
+        PrintRate("recvRate", RateKbps(entry.recv_bytes, prev.recv_bytes, interval));
+        printf(" kbps grtt>%lf\n", entry.grtt);
+        if (0 != (entry.flags & NormMetrics::SESSION_SENDER))
+        {
+            // Repair ratio of packets sent during the interval (or overall)
+            unsigned long long packets = entry.sent_packets;
+            unsigned long long repairs = entry.tx_repairs;
+            if ((interval > 0.0) && (packets >= prev.sent_packets) && (repairs >= prev.tx_repairs))
+            {
+                packets -= prev.sent_packets;
+                repairs -= prev.tx_repairs;
+            }
+            double repairRatio = (0 != packets) ? ((double)repairs / (double)packets) : 0.0;
+            printf("      repairs>%llu (%.2lf%%) nacksReceived>%llu clrRtt>%lf clrLoss>%lf\n",
+                   entry.tx_repairs, 100.0 * repairRatio, entry.nacks_received,
+                   entry.cc_rtt, entry.cc_loss);
+            printf("      bufferUsage> current>%llu peak>%llu overruns>%llu\n",
+                   entry.buffer_usage, entry.buffer_peak, entry.buffer_overruns);
+        }
+        if (0 != (entry.flags & NormMetrics::SESSION_RECEIVER))
+        {
+            printf("      senders>%lu nacks>%llu suppressed>%llu fecDecodes>%llu timerLag> current>%lf max>%lf\n",
+                   (unsigned long)entry.sender_count, entry.nacks_sent, entry.nacks_suppressed,
+                   entry.fec_decodes, entry.timer_lag, entry.timer_lag_max);
+        }
+        memcpy(&prev, &entry, sizeof(NormMetrics::SessionEntry));
+
+        for (unsigned int j = 0; j < header->sender_max; j++)
+        {
+            NormMetrics::SenderEntry senderEntry;
+            metrics.GetSenderSlot(j)->Read(senderEntry);
+            NormMetrics::SenderEntry& senderPrev = prev_sender[j];
+            if ((0 == senderEntry.in_use) || (i != senderEntry.session)) continue;
+            double senderInterval = -1.0;
+            if ((0 != senderPrev.in_use) && (senderEntry.node_id == senderPrev.node_id) &&
+                (senderEntry.session == senderPrev.session))
+                senderInterval = senderEntry.update_time - senderPrev.update_time;
+            printf("      remote sender>%lu addr>%s grtt>%lf rtt>%lf loss>%lf\n",
+                   (unsigned long)senderEntry.node_id, senderEntry.address,
+                   senderEntry.grtt, senderEntry.rtt, senderEntry.loss);
+            printf("        ");
+            PrintRate("rxRate", RateKbps(senderEntry.recv_bytes, senderPrev.recv_bytes, senderInterval));
+            PrintRate("rxGoodput", RateKbps(senderEntry.goodput_bytes, senderPrev.goodput_bytes, senderInterval));
+            PrintRate("ccRate", 8.0e-03 * senderEntry.send_rate);
+            printf(" kbps\n");
+            printf("         rxObjects> completed>%llu pending>%llu failed>%llu resyncs>%llu\n",
+                   senderEntry.objects_completed, senderEntry.objects_pending,
+                   senderEntry.objects_failed, senderEntry.resyncs);
+            printf("         nacks>%llu suppressed>%llu fecDecodes>%llu\n",
+                   senderEntry.nacks_sent, senderEntry.nacks_suppressed, senderEntry.fec_decodes);
+            if (verbose || (0 != senderEntry.buffer_overruns) || (0 != senderEntry.stream_overruns))
+            {
+                printf("         fecBufferUsage> current>%llu peak>%llu overruns>%llu\n",
+                       senderEntry.buffer_usage, senderEntry.buffer_peak, senderEntry.buffer_overruns);
+                printf("         strBufferUsage> current>%llu peak>%llu overruns>%llu\n",
+                       senderEntry.stream_usage, senderEntry.stream_peak, senderEntry.stream_overruns);
+            }
+            memcpy(&senderPrev, &senderEntry, sizeof(NormMetrics::SenderEntry));
+        }
+    }
+}  // end StatMonitor::Report()
+
+// Opens any newly found "norm.*" segments and drops the ones removed
+static void ScanSegments(StatMonitor*& monitorList)
+{
+    StatMonitor* monitor;
+    for (monitor = monitorList; NULL != monitor; monitor = monitor->next)
+        monitor->found = false;
+    DIR* dir = opendir("/dev/shm");
+    if (NULL == dir)
+    {
+        perror("normStat opendir(/dev/shm) error");
+        return;
+    }
+    struct dirent* item;
+    while (NULL != (item = readdir(dir)))
+    {
+        if (0 != strncmp(item->d_name, NORM_METRICS_PREFIX, strlen(NORM_METRICS_PREFIX)))
+            continue;
+        for (monitor = monitorList; NULL != monitor; monitor = monitor->next)
+        {
+            if (0 == strcmp(monitor->metrics.GetName() + 1, item->d_name))  // (skip '/')
+            {
+                monitor->found = true;
+                break;
+            }
+        }
+        if (NULL != monitor) continue;
+        if (NULL == (monitor = new StatMonitor))
+        {
+            perror("normStat new StatMonitor error");
+            break;
+        }
+        if (!monitor->Open(item->d_name))
+        {
+            delete monitor;
+            continue;
+        }
+        monitor->next = monitorList;
+        monitorList = monitor;
+    }
+    closedir(dir);
+    StatMonitor* prev = NULL;
+    monitor = monitorList;
+    while (NULL != monitor)
+    {
+        StatMonitor* nextMonitor = monitor->next;
+        if (monitor->found)
+        {
+            prev = monitor;
+        }
+        else
+        {
+            if (NULL != prev)
+                prev->next = nextMonitor;
+            else
+                monitorList = nextMonitor;
+            delete monitor;
+        }
+        monitor = nextMonitor;
+    }
+}  // end ScanSegments()
+
+int main(int argc, char* argv[])
+{
+    double interval = 1.0;
+    int reportCount = -1;  // (forever)
+    bool verbose = false;
+    StatMonitor* monitorList = NULL;
+    bool scan = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "interval") && (++i < argc))
+        {
+            interval = atof(argv[i]);
+        }
+        else if (!strcmp(argv[i], "count") && (++i < argc))
+        {
+            reportCount = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "verbose"))
+        {
+            verbose = true;
+        }
+        else if (!strcmp(argv[i], "segment") && (++i < argc))
+        {
+            StatMonitor* monitor = new StatMonitor;
+            if ((NULL == monitor) || !monitor->Open(argv[i]))
+            {
+                fprintf(stderr, "normStat error: unable to open segment \"%s\"\n", argv[i]);
+                return -1;
+            }
+            monitor->next = monitorList;
+            monitorList = monitor;
+            scan = false;
+        }
+        else
+        {
+            fprintf(stderr, "usage: normStat [interval <sec>][count <reports>][verbose][segment <name>]...\n");
+            return -1;
+        }
+    }
+    if (interval <= 0.0)
+    {
+        fprintf(stderr, "normStat error: invalid interval\n");
+        return -1;
+    }
+
+    while (0 != reportCount)
+    {
+        if (scan) ScanSegments(monitorList);
+        struct timeval currentTime;
+        ProtoSystemTime(currentTime);
+        time_t secs = (time_t)currentTime.tv_sec;
+        struct tm timeStruct;
+        struct tm* ct = gmtime_r(&secs, &timeStruct);
+        printf("REPORT time>%02d:%02d:%02d.%06lu ***************************************\n",
+               ct->tm_hour, ct->tm_min, ct->tm_sec, (unsigned long)currentTime.tv_usec);
+        if (NULL == monitorList) printf("(no NORM metrics segments found)\n");
+        for (StatMonitor* monitor = monitorList; NULL != monitor; monitor = monitor->next)
+            monitor->Report(verbose);
+        fflush(stdout);
+        if (reportCount > 0) reportCount--;
+        if (0 != reportCount)
+        {
+            struct timespec delay;
+            delay.tv_sec = (time_t)interval;
+            delay.tv_nsec = (long)(1.0e+09 * (interval - (double)delay.tv_sec));
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    while (NULL != monitorList)
+    {
+        StatMonitor* monitor = monitorList;
+        monitorList = monitor->next;
+        delete monitor;
+    }
+    return 0;
+}  // end main()
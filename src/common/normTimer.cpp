@@ -0,0 +1,371 @@
+#include "normTimer.h"
+
+#include <string.h>  // for memset()
+
+// Converts a timer interval to wheel ticks (rounded up)
+static UINT32 NormTimerTicks(double interval)
+{
+    double ticks = interval * (1.0e+06 / NormTimerWheel::TICK_USEC);
+    if (ticks >= (double)0x3fffffff) return 0x3fffffff;
+    UINT32 tickCount = (UINT32)ticks;
+    if ((double)tickCount < ticks) tickCount++;
+    return tickCount;
+}  // end NormTimerTicks()
+
+NormClock::NormClock()
+ : cached(false)
+#ifdef NORM_CLOCK_TSC
+   , tsc_base(0), tsc_per_usec(0.0)
+#endif // NORM_CLOCK_TSC
+{
+    cached_time.tv_sec = cached_time.tv_usec = 0;
+#ifdef NORM_CLOCK_TSC
+    time_base.tv_sec = time_base.tv_usec = 0;
+#endif // NORM_CLOCK_TSC
+}
+
+void NormClock::Update()
+{
+    struct timeval currentTime;
+#ifdef NORM_CLOCK_TSC
+    ReadTsc(currentTime);
+#else
+    ::ProtoSystemTime(currentTime);
+#endif // if/else NORM_CLOCK_TSC
+    double delta = 1.0e+06 * (double)(currentTime.tv_sec - cached_time.tv_sec) +
+                   (double)(currentTime.tv_usec - cached_time.tv_usec);
+    if ((delta > 0.0) || (delta < -(double)BACKSTEP_MAX))
+        cached_time = currentTime;
+    cached = true;
+}  // end NormClock::Update()
+
+#ifdef NORM_CLOCK_TSC
+void NormClock::ReadTsc(struct timeval& currentTime)
+{
+    unsigned long long tsc = NormReadTsc();
+    if (tsc_per_usec > 0.0)
+    {
+        double usec = (double)(tsc - tsc_base) / tsc_per_usec;
+        if (usec < (double)CALIBRATION_INTERVAL)
+        {
+            unsigned long offset = (unsigned long)usec + (unsigned long)time_base.tv_usec;
+            currentTime.tv_sec = time_base.tv_sec + (offset / 1000000);
+            currentTime.tv_usec = offset % 1000000;
+            return;
+        }
+    }
+    // (Re)calibrate the counter rate against the system clock
+    ::ProtoSystemTime(currentTime);
+    if (0 != tsc_base)
+    {
+        double usec = 1.0e+06 * (double)(currentTime.tv_sec - time_base.tv_sec) +
+                      (double)(currentTime.tv_usec - time_base.tv_usec);
+        if (usec >= (double)CALIBRATION_MIN)
+            tsc_per_usec = (double)(tsc - tsc_base) / usec;
+        else if (usec >= 0.0)
+            return;  // keep accumulating the calibration interval
+    }
+    tsc_base = tsc;
+    time_base = currentTime;
+}  // end NormClock::ReadTsc()
+#endif // NORM_CLOCK_TSC
+
+
+NormTimer::NormTimer()
+ : listener(NULL), interval(1.0), repeat(0), repeat_count(0),
+   wheel(NULL), expire_tick(0), level(-1), slot(0), prev(NULL), next(NULL)
+{
+}
+
+NormTimer::~NormTimer()
+{
+    Deactivate();
+    if (NULL != listener)
+    {
+        delete listener;
+        listener = NULL;
+    }
+}
+
+void NormTimer::Deactivate()
+{
+    if (NULL != wheel) wheel->DeactivateTimer(*this);
+}  // end NormTimer::Deactivate()
+
+void NormTimer::Reschedule()
+{
+    if (NULL != wheel) wheel->RescheduleTimer(*this);
+}  // end NormTimer::Reschedule()
+
+
+NormTimerWheel::NormTimerWheel(ProtoTimerMgr& timerMgr, NormClock& theClock)
+ : timer_mgr(timerMgr), wheel_clock(theClock), wake_tick(0), current_tick(0),
+   advancing(false), timer_count(0), lag_ticks(0), lag_max_ticks(0)
+{
+    wheel_timer.SetListener(this, &NormTimerWheel::OnWheelTimeout);
+    wheel_timer.SetInterval(0.0);
+    wheel_timer.SetRepeat(0);
+    memset(slot_mask, 0, sizeof(slot_mask));
+    memset(slot_list, 0, sizeof(slot_list));
+}
+
+NormTimerWheel::~NormTimerWheel()
+{
+    if (wheel_timer.IsActive()) wheel_timer.Deactivate();
+    // Orphan any timers still in the wheel
+    for (unsigned int level = 0; level < LEVEL_COUNT; level++)
+    {
+        for (unsigned int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            NormTimer* timer;
+            while (NULL != (timer = slot_list[level][slot]))
+            {
+                Remove(*timer);
+                timer->wheel = NULL;
+            }
+        }
+    }
+    timer_count = 0;
+}
+
+void NormTimerWheel::ActivateTimer(NormTimer& timer)
+{
+    if (timer.IsActive()) timer.Deactivate();
+    timer.repeat_count = timer.repeat;
+    timer.wheel = this;
+    timer_count++;
+    ScheduleTimer(timer);
+}  // end NormTimerWheel::ActivateTimer()
+
+void NormTimerWheel::DeactivateTimer(NormTimer& timer)
+{
+    ASSERT(this == timer.wheel);
+    Remove(timer);
+    timer.wheel = NULL;
+    timer_count--;
+    // (the wheel_timer is left as is and just won't be rearmed if idle)
+}  // end NormTimerWheel::DeactivateTimer()
+
+void NormTimerWheel::RescheduleTimer(NormTimer& timer)
+{
+    ASSERT(this == timer.wheel);
+    Remove(timer);
+    ScheduleTimer(timer);
+}  // end NormTimerWheel::RescheduleTimer()
+
+// Schedules a timer to expire its interval from now
+void NormTimerWheel::ScheduleTimer(NormTimer& timer)
+{
+    struct timeval currentTime;
+    wheel_clock.GetCurrentTime(currentTime);
+    UINT32 nowTick = GetTick(currentTime);
+    UINT32 eventTick;
+    if (!advancing)
+    {
+        // Bring the wheel up to the current time when that passes over no
+        // pending event so the timer is placed at the lowest level possible
+        if (!GetNextEvent(eventTick) || ((eventTick - current_tick) > (nowTick - current_tick)))
+            current_tick = nowTick;
+    }
+    timer.expire_tick = nowTick + NormTimerTicks(timer.interval);
+    eventTick = Insert(timer);
+    if (!advancing) UpdateWakeup(eventTick, currentTime);
+}  // end NormTimerWheel::ScheduleTimer()
+
+// Places the timer in the slot for its "expire_tick" and returns the tick at
+// which the wheel must next process that slot (its expiration or cascade)
+UINT32 NormTimerWheel::Insert(NormTimer& timer, bool cascade)
+{
+    UINT32 delta = timer.expire_tick - current_tick;
+    if ((delta > 0x7fffffff) || ((0 == delta) && !cascade))
+    {
+        // Overdue, so expire on the next tick (a timer cascaded down at its
+        // expiration tick is put in the current slot, which is expired next)
+        timer.expire_tick = current_tick + 1;
+        delta = 1;
+    }
+    unsigned int level = 0;
+    unsigned int slot;
+    UINT32 eventTick;
+    if (delta < SLOT_COUNT)
+    {
+        slot = timer.expire_tick & (SLOT_COUNT - 1);
+        eventTick = timer.expire_tick;
+    }
+    else
+    {
+        UINT32 slotDelta = 0;
+        for (level = 1; level < LEVEL_COUNT; level++)
+        {
+            unsigned int shift = level * LEVEL_BITS;
+            slotDelta = ((timer.expire_tick >> shift) - (current_tick >> shift)) & (0xffffffff >> shift);
+            if (slotDelta < SLOT_COUNT) break;
+        }
+        if (LEVEL_COUNT == level)
+        {
+            // Beyond the wheel span, so park it in the farthest top level
+            // slot where it will be re-cascaded
+            level = LEVEL_COUNT - 1;
+            slotDelta = SLOT_COUNT - 1;
+        }
+        unsigned int shift = level * LEVEL_BITS;
+        UINT32 slotTick = (current_tick >> shift) + slotDelta;
+        slot = slotTick & (SLOT_COUNT - 1);
+        eventTick = slotTick << shift;
+    }
+    timer.level = (int)level;
+    timer.slot = slot;
+    timer.prev = NULL;
+    timer.next = slot_list[level][slot];
+    if (NULL != timer.next) timer.next->prev = &timer;
+    slot_list[level][slot] = &timer;
+    slot_mask[level] |= ((UINT32)0x01 << slot);
+    return eventTick;
+}  // end NormTimerWheel::Insert()
+
+void NormTimerWheel::Remove(NormTimer& timer)
+{
+    if (timer.level < 0) return;  // not in a slot
+    if (NULL != timer.prev)
+    {
+        timer.prev->next = timer.next;
+    }
+    else
+    {
+        slot_list[timer.level][timer.slot] = timer.next;
+        if (NULL == timer.next)
+            slot_mask[timer.level] &= ~((UINT32)0x01 << timer.slot);
+    }
+    if (NULL != timer.next) timer.next->prev = timer.prev;
+    timer.prev = timer.next = NULL;
+    timer.level = -1;
+}  // end NormTimerWheel::Remove()
+
+void NormTimerWheel::Cascade(unsigned int level, unsigned int slot)
+{
+    NormTimer* next = slot_list[level][slot];
+    slot_list[level][slot] = NULL;
+    slot_mask[level] &= ~((UINT32)0x01 << slot);
+    while (NULL != next)
+    {
+        NormTimer* timer = next;
+        next = timer->next;
+        timer->prev = timer->next = NULL;
+        timer->level = -1;
+        Insert(*timer, true);
+    }
+}  // end NormTimerWheel::Cascade()
+
+// Expires the timers in the given level 0 slot (all have "current_tick" expiration)
+void NormTimerWheel::Expire(unsigned int slot)
+{
+    NormTimer* timer;
+    while (NULL != (timer = slot_list[0][slot]))
+    {
+        Remove(*timer);
+        // Note the timer remains "active" while its handler is invoked and
+        // a "false" return means the handler deactivated (or deleted) it
+        if (timer->DoTimeout() && timer->IsActive() && (timer->level < 0))
+        {
+            if (0 != timer->repeat_count)
+            {
+                if (timer->repeat_count > 0) timer->repeat_count--;
+                timer->expire_tick = current_tick + NormTimerTicks(timer->interval);
+                Insert(*timer);
+            }
+            else
+            {
+                DeactivateTimer(*timer);
+            }
+        }
+    }
+}  // end NormTimerWheel::Expire()
+
+// Finds the next tick at which a wheel slot needs processing
+bool NormTimerWheel::GetNextEvent(UINT32& eventTick) const
+{
+    bool found = false;
+    UINT32 eventDelta = 0;
+    for (unsigned int level = 0; level < LEVEL_COUNT; level++)
+    {
+        UINT32 mask = slot_mask[level];
+        if (0 == mask) continue;
+        // Rotate the occupancy mask so bit 0 is the slot following the current one
+        unsigned int shift = level * LEVEL_BITS;
+        unsigned int start = ((current_tick >> shift) + 1) & (SLOT_COUNT - 1);
+        if (0 != start) mask = (mask >> start) | (mask << (SLOT_COUNT - start));
+        UINT32 slotTick = (current_tick >> shift) + 1 + NormCtz32(mask);
+        UINT32 delta = (slotTick << shift) - current_tick;
+        if (!found || (delta < eventDelta))
+        {
+            eventDelta = delta;
+            found = true;
+        }
+    }
+    if (found) eventTick = current_tick + eventDelta;
+    return found;
+}  // end NormTimerWheel::GetNextEvent()
+
+// Processes wheel events through "nowTick", jumping over empty intervals
+void NormTimerWheel::Advance(UINT32 nowTick)
+{
+    if ((nowTick - current_tick) > 0x7fffffff) return;  // system clock moved backwards
+    advancing = true;
+    UINT32 eventTick;
+    while (GetNextEvent(eventTick) && ((eventTick - current_tick) <= (nowTick - current_tick)))
+    {
+        current_tick = eventTick;
+        // Cascade any higher level slots starting at this tick (lowest level first)
+        for (unsigned int level = 1; level < LEVEL_COUNT; level++)
+        {
+            unsigned int shift = level * LEVEL_BITS;
+            if (0 != (current_tick & (((UINT32)0x01 << shift) - 1))) break;
+            Cascade(level, (current_tick >> shift) & (SLOT_COUNT - 1));
+        }
+        unsigned int slot = current_tick & (SLOT_COUNT - 1);
+        if (NULL != slot_list[0][slot])
+        {
+            // How late (in ticks) these timers are being expired
+            lag_ticks = nowTick - current_tick;
+            if (lag_ticks > lag_max_ticks) lag_max_ticks = lag_ticks;
+        }
+        Expire(slot);
+    }
+    current_tick = nowTick;
+    advancing = false;
+}  // end NormTimerWheel::Advance()
+
+// Makes sure the wheel_timer fires no later than "eventTick"
+void NormTimerWheel::UpdateWakeup(UINT32 eventTick, const struct timeval& currentTime)
+{
+    if (wheel_timer.IsActive() && ((wake_tick - current_tick) <= (eventTick - current_tick)))
+        return;  // already scheduled in time
+    double delay = 0.0;
+    UINT32 delta = eventTick - GetTick(currentTime);
+    if ((0 != delta) && (delta <= 0x7fffffff))
+        delay = 1.0e-06 * ((double)delta * TICK_USEC - (double)(currentTime.tv_usec % TICK_USEC));
+    wheel_timer.SetInterval(delay);
+    if (wheel_timer.IsActive())
+        wheel_timer.Reschedule();
+    else
+        timer_mgr.ActivateTimer(wheel_timer);
+    wake_tick = eventTick;
+}  // end NormTimerWheel::UpdateWakeup()
+
+bool NormTimerWheel::OnWheelTimeout(ProtoTimer& /*theTimer*/)
+{
+    struct timeval currentTime;
+    {
+        NormClock::Scope clockScope(wheel_clock);
+        wheel_clock.GetCurrentTime(currentTime);
+        Advance(GetTick(currentTime));
+    }
+    if (wheel_timer.IsActive()) wheel_timer.Deactivate();
+    UINT32 eventTick;
+    if (GetNextEvent(eventTick))
+    {
+        wheel_clock.GetCurrentTime(currentTime);  // (timeout handlers may have taken a while)
+        UpdateWakeup(eventTick, currentTime);
+    }
+    return false;  // since we manually deactivated (and possibly reactivated) the timer
+}  // end NormTimerWheel::OnWheelTimeout()
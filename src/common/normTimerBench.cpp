@@ -0,0 +1,234 @@
+// The "normTimerBench" program compares the NormTimerWheel a NormSession
+// uses for its remote senders' protocol timers with scheduling the same
+// timers directly in the ProtoTimerMgr (as was formerly done).  Each simulated
+// remote sender has four timers (activity, repair, cc, and ack) and the
+// benchmark measures their activation, the NACK/feedback backoff style
+// "churn" (deactivate/reactivate or reschedule with a new interval), the
+// expiration processing, and deactivation.
+//
+// usage: normTimerBench [senders <count>][rounds <count>]
+
+#include "normTimer.h"
+#include "normBenchUtil.h"  // for NormBenchElapsedUsec()
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>  // for rand(), atoi()
+#include <string.h>  // for strcmp()
+
+// Remote sender timer intervals (seconds) typical of a GRTT of 0.1 sec
+static double RandomInterval(unsigned int timerIndex)
+{
+    double range = (0 == timerIndex) ? 10.0 : 0.4;   // activity or backoff
+    return ((0 == timerIndex) ? 2.0 : 0.0) + range * ((double)rand() / (double)RAND_MAX);
+}  // end RandomInterval()
+
+class BenchSender
+{
+    public:
+        enum {TIMER_COUNT = 4};
+        BenchSender();
+        bool OnProtoTimeout(ProtoTimer& /*theTimer*/)
+        {
+            timeout_count++;
+            return true;
+        }
+        bool OnNormTimeout(NormTimer& /*theTimer*/)
+        {
+            timeout_count++;
+            return true;
+        }
+        ProtoTimer      proto_timer[TIMER_COUNT];
+        NormTimer       norm_timer[TIMER_COUNT];
+        static unsigned int timeout_count;
+};  // end class BenchSender
+
+unsigned int BenchSender::timeout_count = 0;
+
+BenchSender::BenchSender()
+{
+    for (unsigned int i = 0; i < TIMER_COUNT; i++)
+    {
+        proto_timer[i].SetListener(this, &BenchSender::OnProtoTimeout);
+        proto_timer[i].SetRepeat(0);
+        norm_timer[i].SetListener(this, &BenchSender::OnNormTimeout);
+        norm_timer[i].SetRepeat(0);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int senderCount = 1000;
+    unsigned int roundCount = 100;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "senders") && (++i < argc))
+            senderCount = atoi(argv[i]);
+        else if (!strcmp(argv[i], "rounds") && (++i < argc))
+            roundCount = atoi(argv[i]);
+        else
+        {
+            fprintf(stderr, "usage: normTimerBench [senders <count>][rounds <count>]\n");
+            return -1;
+        }
+    }
+    if ((0 == senderCount) || (0 == roundCount))
+    {
+        fprintf(stderr, "normTimerBench error: invalid sender or round count\n");
+        return -1;
+    }
+
+    BenchSender* senderList = new BenchSender[senderCount];
+    if (NULL == senderList)
+    {
+        perror("normTimerBench new senderList error");
+        return -1;
+    }
+    // Precomputed random intervals and churn (sender, timer) choices
+    unsigned int timerCount = senderCount * BenchSender::TIMER_COUNT;
+    unsigned int churnCount = timerCount * roundCount;
+    double* intervalList = new double[timerCount];
+    unsigned int* churnList = new unsigned int[churnCount];
+    if ((NULL == intervalList) || (NULL == churnList))
+    {
+        perror("normTimerBench new intervalList/churnList error");
+        return -1;
+    }
+    srand(1);
+    for (unsigned int i = 0; i < timerCount; i++)
+        intervalList[i] = RandomInterval(i % BenchSender::TIMER_COUNT);
+    for (unsigned int i = 0; i < churnCount; i++)
+        churnList[i] = (unsigned int)rand() % timerCount;
+
+    ProtoDispatcher dispatcher;
+    NormClock wheelClock;
+    NormTimerWheel wheel(dispatcher, wheelClock);
+
+    double activateTime[2], churnTime[2], expireTime[2], deactivateTime[2];
+    unsigned int expireCount[2];
+    struct timeval startTime;
+    for (unsigned int mode = 0; mode < 2; mode++)
+    {
+        bool useWheel = (1 == mode);
+
+        // 1) Activate all sender timers
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < timerCount; i++)
+        {
+            BenchSender& sender = senderList[i / BenchSender::TIMER_COUNT];
+            unsigned int index = i % BenchSender::TIMER_COUNT;
+            if (useWheel)
+            {
+                sender.norm_timer[index].SetInterval(intervalList[i]);
+                wheel.ActivateTimer(sender.norm_timer[index]);
+            }
+            else
+            {
+                sender.proto_timer[index].SetInterval(intervalList[i]);
+                dispatcher.ActivateTimer(sender.proto_timer[index]);
+            }
+        }
+        activateTime[mode] = NormBenchElapsedUsec(startTime);
+
+        // 2) Churn, alternating deactivate/reactivate and reschedule of
+        //    random timers with a new interval
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < churnCount; i++)
+        {
+            unsigned int t = churnList[i];
+            BenchSender& sender = senderList[t / BenchSender::TIMER_COUNT];
+            unsigned int index = t % BenchSender::TIMER_COUNT;
+            double interval = intervalList[(t + i) % timerCount];
+            if (useWheel)
+            {
+                NormTimer& timer = sender.norm_timer[index];
+                timer.SetInterval(interval);
+                if (0 != (i & 0x01))
+                {
+                    timer.Reschedule();
+                }
+                else
+                {
+                    timer.Deactivate();
+                    wheel.ActivateTimer(timer);
+                }
+            }
+            else
+            {
+                ProtoTimer& timer = sender.proto_timer[index];
+                timer.SetInterval(interval);
+                if (0 != (i & 0x01))
+                {
+                    timer.Reschedule();
+                }
+                else
+                {
+                    timer.Deactivate();
+                    dispatcher.ActivateTimer(timer);
+                }
+            }
+        }
+        churnTime[mode] = NormBenchElapsedUsec(startTime);
+
+        // 3) Deactivate all
+        ProtoSystemTime(startTime);
+        for (unsigned int i = 0; i < timerCount; i++)
+        {
+            BenchSender& sender = senderList[i / BenchSender::TIMER_COUNT];
+            unsigned int index = i % BenchSender::TIMER_COUNT;
+            if (useWheel)
+                sender.norm_timer[index].Deactivate();
+            else
+                sender.proto_timer[index].Deactivate();
+        }
+        deactivateTime[mode] = NormBenchElapsedUsec(startTime);
+
+        // 4) Expiration of all timers activated with short (0-5 msec) intervals
+        for (unsigned int i = 0; i < timerCount; i++)
+        {
+            BenchSender& sender = senderList[i / BenchSender::TIMER_COUNT];
+            unsigned int index = i % BenchSender::TIMER_COUNT;
+            double interval = 0.005 * intervalList[i] / 12.0;
+            if (useWheel)
+            {
+                sender.norm_timer[index].SetInterval(interval);
+                wheel.ActivateTimer(sender.norm_timer[index]);
+            }
+            else
+            {
+                sender.proto_timer[index].SetInterval(interval);
+                dispatcher.ActivateTimer(sender.proto_timer[index]);
+            }
+        }
+        ProtoSystemTime(startTime);
+        while (NormBenchElapsedUsec(startTime) < 10000.0);  // (wait for all to be due)
+        BenchSender::timeout_count = 0;
+        ProtoSystemTime(startTime);
+        dispatcher.DoSystemTimeout();
+        expireTime[mode] = NormBenchElapsedUsec(startTime);
+        expireCount[mode] = BenchSender::timeout_count;
+    }
+
+    printf("normTimerBench: %u senders (%u timers), %u churn rounds\n",
+           senderCount, timerCount, roundCount);
+    const char* modeName[2] = {"ProtoTimerMgr", "NormTimerWheel"};
+    for (unsigned int mode = 0; mode < 2; mode++)
+    {
+        printf("   %s:\n", modeName[mode]);
+        printf("      activate:     %10.3f usec total, %8.1f nsec/timer\n",
+               activateTime[mode], 1000.0 * activateTime[mode] / timerCount);
+        printf("      churn:        %10.3f usec total, %8.1f nsec/op\n",
+               churnTime[mode], 1000.0 * churnTime[mode] / churnCount);
+        printf("      deactivate:   %10.3f usec total, %8.1f nsec/timer\n",
+               deactivateTime[mode], 1000.0 * deactivateTime[mode] / timerCount);
+        printf("      expire:       %10.3f usec total, %8.1f nsec/timer (%u expired)\n",
+               expireTime[mode], 1000.0 * expireTime[mode] / timerCount, expireCount[mode]);
+    }
+    if (wheel.GetTimerCount() != 0)
+        fprintf(stderr, "normTimerBench warning: %u wheel timers still active?!\n", wheel.GetTimerCount());
+
+    delete[] churnList;
+    delete[] intervalList;
+    delete[] senderList;
+    return 0;
+}  // end main()
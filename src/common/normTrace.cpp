@@ -0,0 +1,346 @@
+#include "normTrace.h"
+
+#include <string.h>  // for memset(), memcpy()
+
+NormTraceRing::NormTraceRing()
+ : buffer(NULL), mask(0), head(0), tail(0),
+   drop_count(0), drop_written(0), next(NULL)
+{
+}
+
+NormTraceRing::~NormTraceRing()
+{
+    Destroy();
+}
+
+bool NormTraceRing::Init(unsigned int numRecords)
+{
+    Destroy();
+    // Round "numRecords" up to a power of 2 (of at most 2^31)
+    if (numRecords > 0x80000000)
+    {
+        PLOG(PL_ERROR, "NormTraceRing::Init() error: %u records too many\n", numRecords);
+        return false;
+    }
+    unsigned int size = 1;
+    while (size < numRecords) size <<= 1;
+    if (NULL == (buffer = new NormTraceRecord[size]))
+    {
+        PLOG(PL_FATAL, "NormTraceRing::Init() new buffer error: %s\n", GetErrorString());
+        return false;
+    }
+    mask = size - 1;
+    head = tail = 0;
+    drop_count = drop_written = 0;
+    return true;
+}  // end NormTraceRing::Init()
+
+void NormTraceRing::Destroy()
+{
+    if (NULL != buffer)
+    {
+        delete[] buffer;
+        buffer = NULL;
+    }
+    mask = 0;
+}  // end NormTraceRing::Destroy()
+
+void NormTraceRing::Trace(const struct timeval&    currentTime,
+                          NormNodeId               localId,
+                          const NormMsg&           msg,
+                          bool                     sent,
+                          UINT8                    fecM,
+                          UINT16                   instId)
+{
+    UINT32 index = head;  // (we are its only writer)
+    if ((index - NORM_ATOMIC_LOAD(tail)) > mask)
+    {
+        // Ring is full, so drop this record rather than wait
+        NORM_ATOMIC_STORE(drop_count, drop_count + 1);
+        return;
+    }
+    NormTraceRecord& record = buffer[index & mask];
+    memset(&record, 0, sizeof(NormTraceRecord));
+    record.sec = (UINT32)currentTime.tv_sec;
+    record.usec = (UINT32)currentTime.tv_usec;
+    record.local_id = (UINT32)localId;
+    record.length = msg.GetLength();
+    if (sent) record.flags |= NormTraceRecord::FLAG_SENT;
+    const ProtoAddress& addr = sent ? msg.GetDestination() : msg.GetSource();
+    switch (addr.GetType())
+    {
+        case ProtoAddress::IPv4:
+            record.addr_type = NormTraceRecord::ADDR_IPV4;
+            memcpy(record.addr, addr.GetRawHostAddress(), 4);
+            break;
+        case ProtoAddress::IPv6:
+            record.addr_type = NormTraceRecord::ADDR_IPV6;
+            memcpy(record.addr, addr.GetRawHostAddress(), 16);
+            break;
+        default:
+            break;
+    }
+    record.port = addr.GetPort();
+
+    NormMsg::Type msgType = msg.GetType();
+    record.msg_type = (UINT8)msgType;
+    switch (msgType)
+    {
+        case NormMsg::INFO:
+        {
+            const NormInfoMsg& info = (const NormInfoMsg&)msg;
+            record.instance_id = info.GetInstanceId();
+            record.sequence = msg.GetSequence();
+            record.object_id = (UINT16)info.GetObjectId();
+            break;
+        }
+        case NormMsg::DATA:
+        {
+            const NormDataMsg& data = (const NormDataMsg&)msg;
+            record.instance_id = data.GetInstanceId();
+            record.sequence = msg.GetSequence();
+            record.object_id = (UINT16)data.GetObjectId();
+            record.block_id = data.GetFecBlockId(fecM).GetValue();
+            record.symbol_id = (UINT16)data.GetFecSymbolId(fecM);
+            if (data.IsStream())
+            {
+                record.flags |= NormTraceRecord::FLAG_STREAM;
+                record.aux = NormDataMsg::ReadStreamPayloadOffset(data.GetPayload());
+            }
+            break;
+        }
+        case NormMsg::CMD:
+        {
+            const NormCmdMsg& cmd = static_cast<const NormCmdMsg&>(msg);
+            NormCmdMsg::Flavor flavor = cmd.GetFlavor();
+            record.instance_id = cmd.GetInstanceId();
+            record.sequence = msg.GetSequence();
+            record.sub_type = (UINT8)flavor;
+            switch (flavor)
+            {
+                case NormCmdMsg::ACK_REQ:
+                    record.aux = ((const NormCmdAckReqMsg&)msg).GetAckType();
+                    break;
+                case NormCmdMsg::SQUELCH:
+                {
+                    const NormCmdSquelchMsg& squelch =
+                        static_cast<const NormCmdSquelchMsg&>(msg);
+                    record.object_id = (UINT16)squelch.GetObjectId();
+                    record.block_id = squelch.GetFecBlockId(fecM).GetValue();
+                    record.symbol_id = (UINT16)squelch.GetFecSymbolId(fecM);
+                    break;
+                }
+                case NormCmdMsg::FLUSH:
+                {
+                    const NormCmdFlushMsg& flush =
+                        static_cast<const NormCmdFlushMsg&>(msg);
+                    record.object_id = (UINT16)flush.GetObjectId();
+                    record.block_id = flush.GetFecBlockId(fecM).GetValue();
+                    record.symbol_id = (UINT16)flush.GetFecSymbolId(fecM);
+                    if (0 != flush.GetAckingNodeCount())
+                        record.flags |= NormTraceRecord::FLAG_WATERMARK;
+                    break;
+                }
+                case NormCmdMsg::CC:
+                {
+                    const NormCmdCCMsg& cc = static_cast<const NormCmdCCMsg&>(msg);
+                    record.aux = cc.GetCCSequence();
+                    NormHeaderExtension ext;
+                    while (cc.GetNextExtension(ext))
+                    {
+                        if (NormHeaderExtension::CC_RATE == ext.GetType())
+                        {
+                            record.cc_rate = ((NormCCRateExtension&)ext).GetSendRate();
+                            record.flags |= NormTraceRecord::FLAG_RATE;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+            break;
+        }
+        case NormMsg::ACK:
+        case NormMsg::NACK:
+        {
+            record.instance_id = instId;
+            NormHeaderExtension ext;
+            while (msg.GetNextExtension(ext))
+            {
+                if (NormHeaderExtension::CC_FEEDBACK == ext.GetType())
+                {
+                    if (((NormCCFeedbackExtension&)ext).CCFlagIsSet(NormCC::CLR))
+                        record.flags |= NormTraceRecord::FLAG_CLR;
+                    break;
+                }
+            }
+            if (NormMsg::ACK == msgType)
+            {
+                const NormAckMsg& ack = static_cast<const NormAckMsg&>(msg);
+                record.sub_type = (UINT8)ack.GetAckType();
+                if (NormAck::FLUSH == ack.GetAckType())
+                {
+                    const NormAckFlushMsg& flushAck = static_cast<const NormAckFlushMsg&>(ack);
+                    record.object_id = (UINT16)flushAck.GetObjectId();
+                    record.block_id = flushAck.GetFecBlockId(fecM).GetValue();
+                    record.symbol_id = (UINT16)flushAck.GetFecSymbolId(fecM);
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }  // end switch (msgType)
+    NORM_ATOMIC_STORE(head, index + 1);
+}  // end NormTraceRing::Trace()
+
+bool NormTraceRing::Drain(FILE* filePtr)
+{
+    UINT32 index = tail;  // (we are its only writer)
+    UINT32 end = NORM_ATOMIC_LOAD(head);
+    while (index != end)
+    {
+        // Write contiguous run up to "end" or the end of the buffer
+        UINT32 offset = index & mask;
+        UINT32 count = end - index;
+        if (count > (mask + 1 - offset)) count = mask + 1 - offset;
+        if (count != fwrite(buffer + offset, sizeof(NormTraceRecord), count, filePtr))
+        {
+            PLOG(PL_ERROR, "NormTraceRing::Drain() fwrite() error: %s\n", GetErrorString());
+            return false;
+        }
+        index += count;
+        NORM_ATOMIC_STORE(tail, index);  // frees space for the producer
+    }
+    UINT32 dropCount = NORM_ATOMIC_LOAD(drop_count);
+    if (dropCount != drop_written)
+    {
+        NormTraceRecord record;
+        memset(&record, 0, sizeof(NormTraceRecord));
+        struct timeval currentTime;
+        ProtoSystemTime(currentTime);
+        record.sec = (UINT32)currentTime.tv_sec;
+        record.usec = (UINT32)currentTime.tv_usec;
+        record.flags = NormTraceRecord::FLAG_DROP;
+        record.aux = dropCount - drop_written;
+        if (1 != fwrite(&record, sizeof(NormTraceRecord), 1, filePtr))
+        {
+            PLOG(PL_ERROR, "NormTraceRing::Drain() fwrite() error: %s\n", GetErrorString());
+            return false;
+        }
+        drop_written = dropCount;
+    }
+    return true;
+}  // end NormTraceRing::Drain()
+
+#ifndef SIMULATE
+NormTraceLog::NormTraceLog()
+ : file_ptr(NULL), ring_list(NULL)
+{
+    drain_timer.SetListener(this, &NormTraceLog::OnDrainTimeout);
+    drain_timer.SetInterval(1.0e-03 * DEFAULT_INTERVAL_MSEC);
+    drain_timer.SetRepeat(-1);
+}
+
+NormTraceLog::~NormTraceLog()
+{
+    Close();
+}
+
+bool NormTraceLog::Open(const char* path, double drainInterval)
+{
+    Close();
+    if (NULL == (file_ptr = fopen(path, "wb")))
+    {
+        PLOG(PL_ERROR, "NormTraceLog::Open() fopen(%s) error: %s\n", path, GetErrorString());
+        return false;
+    }
+    NormTraceHeader header;
+    memset(&header, 0, sizeof(NormTraceHeader));
+    header.magic = NORM_TRACE_MAGIC;
+    header.version = NORM_TRACE_VERSION;
+    header.record_size = sizeof(NormTraceRecord);
+    if (1 != fwrite(&header, sizeof(NormTraceHeader), 1, file_ptr))
+    {
+        PLOG(PL_ERROR, "NormTraceLog::Open() fwrite() error: %s\n", GetErrorString());
+        fclose(file_ptr);
+        file_ptr = NULL;
+        return false;
+    }
+    drain_timer.SetInterval(drainInterval);
+    dispatcher.ActivateTimer(drain_timer);
+    if (!dispatcher.StartThread())
+    {
+        PLOG(PL_ERROR, "NormTraceLog::Open() error starting drain thread\n");
+        drain_timer.Deactivate();
+        fclose(file_ptr);
+        file_ptr = NULL;
+        return false;
+    }
+    return true;
+}  // end NormTraceLog::Open()
+
+void NormTraceLog::Close()
+{
+    if (NULL == file_ptr) return;
+    dispatcher.Stop();
+    if (drain_timer.IsActive()) drain_timer.Deactivate();
+    Drain();  // (final records)
+    unsigned long dropCount = 0;
+    NormTraceRing* ring;
+    while (NULL != (ring = ring_list))
+    {
+        dropCount += ring->GetDropCount();
+        ring_list = ring->next;
+        delete ring;
+    }
+    if (0 != dropCount)
+        PLOG(PL_WARN, "NormTraceLog::Close() warning: %lu trace records dropped\n", dropCount);
+    fclose(file_ptr);
+    file_ptr = NULL;
+}  // end NormTraceLog::Close()
+
+NormTraceRing* NormTraceLog::AddRing(unsigned int numRecords)
+{
+    if (NULL == file_ptr) return NULL;
+    NormTraceRing* ring = new NormTraceRing();
+    if (NULL == ring)
+    {
+        PLOG(PL_FATAL, "NormTraceLog::AddRing() new ring error: %s\n", GetErrorString());
+        return NULL;
+    }
+    if (!ring->Init(numRecords))
+    {
+        PLOG(PL_FATAL, "NormTraceLog::AddRing() ring init error\n");
+        delete ring;
+        return NULL;
+    }
+    if (!dispatcher.SuspendThread())
+    {
+        PLOG(PL_ERROR, "NormTraceLog::AddRing() error suspending drain thread\n");
+        delete ring;
+        return NULL;
+    }
+    ring->next = ring_list;
+    ring_list = ring;
+    dispatcher.ResumeThread();
+    return ring;
+}  // end NormTraceLog::AddRing()
+
+bool NormTraceLog::OnDrainTimeout(ProtoTimer& /*theTimer*/)
+{
+    Drain();
+    return true;
+}  // end NormTraceLog::OnDrainTimeout()
+
+void NormTraceLog::Drain()
+{
+    for (NormTraceRing* ring = ring_list; NULL != ring; ring = ring->next)
+    {
+        if (!ring->Drain(file_ptr)) break;
+    }
+    fflush(file_ptr);
+}  // end NormTraceLog::Drain()
+#endif // !SIMULATE
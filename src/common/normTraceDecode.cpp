@@ -0,0 +1,376 @@
+// The "normTraceDecode" tool converts a binary NORM message trace file (see
+// normTrace.h and NormSetMessageTraceFile()) to the same "trace>" text
+// lines NormTrace() logs or, with the "mgen" option, to the pseudo MGEN log
+// format the "n2m" tool produces from those lines (including its "data
+// <blkSize>" sequencing mode) for "trpr" analyses.  Records are written in
+// the order each NORM thread's ring was drained, so the "sort" option time
+// orders the records of multi-threaded (sharded) instances.
+//
+// usage: normTraceDecode [mgen][data <blkSize>][sort][input <traceFile>][output <file>]
+
+#include "normTrace.h"
+#include "protokit.h"
+
+#include <stdio.h>
+#include <stdlib.h>   // for atoi(), qsort()
+#include <string.h>   // for strcmp()
+#include <time.h>     // for gmtime()
+
+static const char* MSG_NAME[] =
+{
+    "INVALID",
+    "INFO",
+    "DATA",
+    "CMD",
+    "NACK",
+    "ACK",
+    "REPORT"
+};
+static const char* CMD_NAME[] =
+{
+    "CMD(INVALID)",
+    "CMD(FLUSH)",
+    "CMD(EOT)",
+    "CMD(SQUELCH)",
+    "CMD(CC)",
+    "CMD(REPAIR_ADV)",
+    "CMD(ACK_REQ)",
+    "CMD(APP)"
+};
+static const char* REQ_NAME[] =
+{
+    "INVALID",
+    "WATERMARK",
+    "RTT",
+    "APP"
+};
+
+static void Usage()
+{
+    fprintf(stderr, "usage: normTraceDecode [mgen][data <blkSize>][sort][input <traceFile>][output <file>]\n");
+}
+
+// Formats the record's "<addr>/<port>"
+static void GetAddressString(const NormTraceRecord& record, char* buffer, unsigned int buflen)
+{
+    ProtoAddress addr;
+    switch (record.addr_type)
+    {
+        case NormTraceRecord::ADDR_IPV4:
+            addr.SetRawHostAddress(ProtoAddress::IPv4, (const char*)record.addr, 4);
+            break;
+        case NormTraceRecord::ADDR_IPV6:
+            addr.SetRawHostAddress(ProtoAddress::IPv6, (const char*)record.addr, 16);
+            break;
+        default:
+            break;
+    }
+    snprintf(buffer, buflen, "%s/%hu", addr.IsValid() ? addr.GetHostString() : "?", record.port);
+}  // end GetAddressString()
+
+// Prints the record exactly as NormTrace() would have
+static void PrintText(FILE* outfile, const NormTraceRecord& record)
+{
+    time_t secs = (time_t)record.sec;
+    struct tm* ct = gmtime(&secs);
+    char addrString[64];
+    GetAddressString(record, addrString, 64);
+    fprintf(outfile, "trace>%02d:%02d:%02d.%06lu ",
+            (int)ct->tm_hour, (int)ct->tm_min, (int)ct->tm_sec, (unsigned long)record.usec);
+    fprintf(outfile, "node>%lu %s>%s ", (unsigned long)record.local_id,
+            (0 != (record.flags & NormTraceRecord::FLAG_SENT)) ? "dst" : "src", addrString);
+    switch (record.msg_type)
+    {
+        case NormMsg::INFO:
+            fprintf(outfile, "inst>%hu seq>%hu INFO obj>%hu ",
+                    record.instance_id, record.sequence, record.object_id);
+            break;
+        case NormMsg::DATA:
+            fprintf(outfile, "inst>%hu seq>%hu DATA obj>%hu blk>%lu seg>%hu ",
+                    record.instance_id, record.sequence, record.object_id,
+                    (unsigned long)record.block_id, record.symbol_id);
+            if (0 != (record.flags & NormTraceRecord::FLAG_STREAM))
+                fprintf(outfile, "offset>%lu ", (unsigned long)record.aux);
+            break;
+        case NormMsg::CMD:
+        {
+            unsigned int flavor = (record.sub_type <= NormCmdMsg::APPLICATION) ? record.sub_type : 0;
+            fprintf(outfile, "inst>%hu seq>%hu %s ", record.instance_id, record.sequence, CMD_NAME[flavor]);
+            switch (flavor)
+            {
+                case NormCmdMsg::ACK_REQ:
+                    fprintf(outfile, "(%s) ", REQ_NAME[(record.aux < 3) ? record.aux : 3]);
+                    break;
+                case NormCmdMsg::SQUELCH:
+                    fprintf(outfile, " obj>%hu blk>%lu seg>%hu ", record.object_id,
+                            (unsigned long)record.block_id, record.symbol_id);
+                    break;
+                case NormCmdMsg::FLUSH:
+                    fprintf(outfile, " obj>%hu blk>%lu seg>%hu ", record.object_id,
+                            (unsigned long)record.block_id, record.symbol_id);
+                    if (0 != (record.flags & NormTraceRecord::FLAG_WATERMARK))
+                        fprintf(outfile, "(WATERMARK) ");
+                    break;
+                case NormCmdMsg::CC:
+                    fprintf(outfile, " seq>%u ", (unsigned int)record.aux);
+                    if (0 != (record.flags & NormTraceRecord::FLAG_RATE))
+                        fprintf(outfile, " rate>%f ", 8.0e-03 * NormUnquantizeRate(record.cc_rate));
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        case NormMsg::ACK:
+        case NormMsg::NACK:
+            fprintf(outfile, "inst>%hu ", record.instance_id);
+            if (NormMsg::ACK == record.msg_type)
+            {
+                if (NormAck::FLUSH == record.sub_type)
+                    fprintf(outfile, "ACK(FLUSH) obj>%hu blk>%lu seg>%hu ", record.object_id,
+                            (unsigned long)record.block_id, record.symbol_id);
+                else if (NormAck::CC == record.sub_type)
+                    fprintf(outfile, "ACK(CC) ");
+                else
+                    fprintf(outfile, "ACK(ZZZ) ");
+            }
+            else
+            {
+                fprintf(outfile, "NACK ");
+            }
+            break;
+        default:
+            fprintf(outfile, "%s ", MSG_NAME[(record.msg_type <= NormMsg::REPORT) ? record.msg_type : 0]);
+            break;
+    }
+    fprintf(outfile, "len>%hu %s\n", record.length,
+            (0 != (record.flags & NormTraceRecord::FLAG_CLR)) ? "(CLR)" : "");
+}  // end PrintText()
+
+// Converts records to "n2m" pseudo MGEN log lines (its 16-bit sequence
+// unwrapping and DATA-only "blk * blkSize + seg" sequencing included)
+class MgenWriter
+{
+    public:
+        MgenWriter(int blkSize)
+         : block_size(blkSize), first_send(true), first_recv(true),
+           last_send_seq(0), last_recv_seq(0), send_seq_offset(0), recv_seq_offset(0) {}
+
+        void Print(FILE* outfile, const NormTraceRecord& record);
+
+    private:
+        int             block_size;  // (0 uses message sequence)
+        bool            first_send;
+        bool            first_recv;
+        unsigned int    last_send_seq;
+        unsigned int    last_recv_seq;
+        unsigned int    send_seq_offset;
+        unsigned int    recv_seq_offset;
+};  // end class MgenWriter
+
+void MgenWriter::Print(FILE* outfile, const NormTraceRecord& record)
+{
+    bool recvEvent = (0 == (record.flags & NormTraceRecord::FLAG_SENT));
+    unsigned int seq;
+    switch (record.msg_type)
+    {
+        case NormMsg::INFO:
+        case NormMsg::DATA:
+        case NormMsg::CMD:
+            seq = record.sequence;
+            break;
+        default:
+            seq = recvEvent ? last_recv_seq : last_send_seq;  // (no "seq>" in text)
+            break;
+    }
+    bool& first = recvEvent ? first_recv : first_send;
+    unsigned int& lastSeq = recvEvent ? last_recv_seq : last_send_seq;
+    unsigned int& seqOffset = recvEvent ? recv_seq_offset : send_seq_offset;
+    if (first)
+    {
+        first = false;
+        seqOffset = 0;
+    }
+    else
+    {
+        int delta = seq - lastSeq;
+        if ((delta < -100) || (delta > 32000))
+            seqOffset += 65536;
+    }
+    lastSeq = seq;
+    seq += seqOffset;
+    if (0 != block_size)
+    {
+        // Only use DATA packets (this is only good for a single object!)
+        if (NormMsg::DATA != record.msg_type) return;
+        seq = record.block_id * block_size + record.symbol_id;
+    }
+    time_t secs = (time_t)record.sec;
+    struct tm* ct = gmtime(&secs);
+    unsigned int hr = ct->tm_hour;
+    unsigned int min = ct->tm_min;
+    double sec = (double)ct->tm_sec + 1.0e-06 * (double)record.usec;
+    char addr[64];
+    GetAddressString(record, addr, 64);
+    if (recvEvent)
+        fprintf(outfile, "%u:%u:%lf RECV flow>0 seq>%u src>%s/0 dst>127.0.0.1/0 sent>%u:%u:%lf size>%u\n",
+                hr, min, sec, seq, addr, hr, min, sec, (unsigned int)record.length);
+    else
+        fprintf(outfile, "%u:%u:%lf SEND flow>0 seq>%u dst>%s/0 size>%u\n",
+                hr, min, sec, seq, addr, (unsigned int)record.length);
+}  // end MgenWriter::Print()
+
+static const NormTraceRecord* sort_records = NULL;
+
+static int CompareRecords(const void* a, const void* b)
+{
+    UINT32 indexA = *((const UINT32*)a);
+    UINT32 indexB = *((const UINT32*)b);
+    const NormTraceRecord& recA = sort_records[indexA];
+    const NormTraceRecord& recB = sort_records[indexB];
+    if (recA.sec != recB.sec) return ((recA.sec < recB.sec) ? -1 : 1);
+    if (recA.usec != recB.usec) return ((recA.usec < recB.usec) ? -1 : 1);
+    return ((indexA < indexB) ? -1 : ((indexA > indexB) ? 1 : 0));  // (keeps it stable)
+}  // end CompareRecords()
+
+int main(int argc, char* argv[])
+{
+    bool mgen = false;
+    int blkSize = 0;
+    bool sort = false;
+    FILE* infile = stdin;
+    FILE* outfile = stdout;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "mgen"))
+        {
+            mgen = true;
+        }
+        else if (!strcmp(argv[i], "data") && (++i < argc))
+        {
+            mgen = true;
+            if ((blkSize = atoi(argv[i])) <= 0)
+            {
+                fprintf(stderr, "normTraceDecode error: invalid block size\n");
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "sort"))
+        {
+            sort = true;
+        }
+        else if (!strcmp(argv[i], "input") && (++i < argc))
+        {
+            if (NULL == (infile = fopen(argv[i], "rb")))
+            {
+                perror("normTraceDecode: error opening input file");
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "output") && (++i < argc))
+        {
+            if (NULL == (outfile = fopen(argv[i], "w")))
+            {
+                perror("normTraceDecode: error opening output file");
+                return -1;
+            }
+        }
+        else
+        {
+            Usage();
+            return -1;
+        }
+    }
+
+    NormTraceHeader header;
+    if (1 != fread(&header, sizeof(NormTraceHeader), 1, infile))
+    {
+        fprintf(stderr, "normTraceDecode error: unable to read trace file header\n");
+        return -1;
+    }
+    if (NORM_TRACE_MAGIC != header.magic)
+    {
+        fprintf(stderr, "normTraceDecode error: not a NORM trace file (or from a host of different byte order)\n");
+        return -1;
+    }
+    if ((NORM_TRACE_VERSION != header.version) || (sizeof(NormTraceRecord) != header.record_size))
+    {
+        fprintf(stderr, "normTraceDecode error: unsupported trace file version %hu\n", header.version);
+        return -1;
+    }
+
+    // Read records (all of them when sorting)
+    unsigned int recordMax = sort ? 65536 : 1024;
+    NormTraceRecord* recordList = new NormTraceRecord[recordMax];
+    if (NULL == recordList)
+    {
+        perror("normTraceDecode: new recordList error");
+        return -1;
+    }
+    MgenWriter mgenWriter(blkSize);
+    unsigned long dropCount = 0;
+    unsigned int recordCount = 0;
+    size_t result;
+    do
+    {
+        if (sort && (recordCount == recordMax))
+        {
+            NormTraceRecord* newList = new NormTraceRecord[2*recordMax];
+            if (NULL == newList)
+            {
+                perror("normTraceDecode: new recordList error");
+                return -1;
+            }
+            memcpy(newList, recordList, recordCount * sizeof(NormTraceRecord));
+            delete[] recordList;
+            recordList = newList;
+            recordMax *= 2;
+        }
+        result = fread(recordList + recordCount, sizeof(NormTraceRecord), recordMax - recordCount, infile);
+        recordCount += (unsigned int)result;
+        if (sort && (0 != result)) continue;
+
+        UINT32* indexList = NULL;
+        if (sort && (0 != recordCount))
+        {
+            if (NULL == (indexList = new UINT32[recordCount]))
+            {
+                perror("normTraceDecode: new indexList error");
+                return -1;
+            }
+            for (UINT32 i = 0; i < recordCount; i++) indexList[i] = i;
+            sort_records = recordList;
+            qsort(indexList, recordCount, sizeof(UINT32), CompareRecords);
+        }
+        for (unsigned int i = 0; i < recordCount; i++)
+        {
+            const NormTraceRecord& record = recordList[(NULL != indexList) ? indexList[i] : i];
+            if (0 != (record.flags & NormTraceRecord::FLAG_DROP))
+            {
+                time_t secs = (time_t)record.sec;
+                struct tm* ct = gmtime(&secs);
+                fprintf(stderr, "normTraceDecode warning: %lu records dropped before %02d:%02d:%02d.%06lu\n",
+                        (unsigned long)record.aux, (int)ct->tm_hour, (int)ct->tm_min, (int)ct->tm_sec,
+                        (unsigned long)record.usec);
+                dropCount += record.aux;
+            }
+            else if (mgen)
+            {
+                mgenWriter.Print(outfile, record);
+            }
+            else
+            {
+                PrintText(outfile, record);
+            }
+        }
+        if (NULL != indexList) delete[] indexList;
+        recordCount = 0;
+    } while (0 != result);
+    if (ferror(infile)) perror("normTraceDecode: error reading trace file");
+    if (0 != dropCount)
+        fprintf(stderr, "normTraceDecode warning: %lu records were dropped in total\n", dropCount);
+    delete[] recordList;
+    if (stdin != infile) fclose(infile);
+    if (stdout != outfile) fclose(outfile);
+    return 0;
+}  // end main()
@@ -0,0 +1,404 @@
+// The "normVsim" simulator runs one NORM sender and N receivers (as
+// NormSimAgents) in a single process over a VsimNetwork with a virtual
+// clock, so large groups can be studied deterministically (for a given
+// "seed") and much faster than real time.  For each receiver group size
+// in the "receivers" list, the sender transmits "count" objects of "size"
+// bytes and a CSV line of results is printed when every receiver has
+// completed them (or the virtual "duration" expires):
+//
+//   complete_mean/p50/p99/max - receiver completion time (virtual sec)
+//   repair_ratio              - sender repair segments per source segment
+//   feedback_msgs             - messages received by the sender (NACKs, ACKs, CC)
+//   nacks_sent/suppressed     - totals over all receivers
+//   speedup                   - virtual time per wall clock time
+//
+// With "check", a run also fails (exit code 1) if the sender traffic
+// columns, or with loss configured the repair and NACK columns, are zero.
+//
+// usage: normVsim [receivers <count>[,...]][groups <count>][size <bytes>]
+//                 [count <objects>][rate <bps>][segment <bytes>][block <count>]
+//                 [parity <count>][cc on|off][core <delay>:<loss>:<bps>:<queue>]
+//                 [edge <delay>:<loss>:<bps>:<queue>][agent "<cmd> [<val>] ..."]
+//                 [seed <value>][duration <sec>][check][noheader][debug <level>]
+//
+// (Link delays are in sec and loss in percent, a rate of 0 is unlimited.
+//  The "agent" commands are NormSimAgent commands given to every agent.)
+
+#include "vsimNormAgent.h"
+#include "normHistogram.h"  // for NormSortSamples(), NormSamplePercentile()
+
+#include <stdio.h>
+#include <stdlib.h>    // for atoi(), atof(), srand()
+#include <string.h>    // for strcmp(), strchr()
+#include <sys/time.h>  // for gettimeofday() (ProtoSystemTime() is virtual here)
+
+// A parsed comma-separated list of receiver counts
+class CountList
+{
+    public:
+        enum {VALUE_MAX = 16};
+
+        CountList() : count(0) {}
+        bool Parse(const char* text);
+
+        unsigned int    value[VALUE_MAX];
+        unsigned int    count;
+};  // end class CountList
+
+bool CountList::Parse(const char* text)
+{
+    count = 0;
+    while ('\0' != *text)
+    {
+        if (VALUE_MAX == count) return false;
+        if ((1 != sscanf(text, "%u", &value[count])) || (0 == value[count])) return false;
+        count++;
+        const char* next = strchr(text, ',');
+        if (NULL == next) break;
+        text = next + 1;
+    }
+    return (0 != count);
+}  // end CountList::Parse()
+
+// Parses "<delay>:<loss>:<bps>:<queue>" (trailing fields may be omitted)
+static bool ParseLink(const char* text, VsimNetwork::LinkParams& params)
+{
+    int result = sscanf(text, "%lf:%lf:%lf:%u", &params.delay, &params.loss,
+                        &params.rate, &params.queue_bytes);
+    return ((result >= 1) && (params.delay >= 0.0) &&
+            (params.loss >= 0.0) && (params.loss <= 100.0) && (params.rate >= 0.0));
+}  // end ParseLink()
+
+// Run parameters
+struct VsimConfig
+{
+    unsigned int                receiverCount;
+    unsigned int                groupCount;
+    unsigned int                size;
+    unsigned int                count;
+    double                      rate;
+    unsigned int                segment;
+    unsigned int                block;
+    unsigned int                parity;
+    bool                        cc;
+    VsimNetwork::LinkParams     coreLink;
+    VsimNetwork::LinkParams     edgeLink;
+    int                         agentArgc;
+    const char*                 agentArgv[64];
+    UINT32                      seed;
+    double                      duration;
+    bool                        check;
+};  // end struct VsimConfig
+
+static double WallTime()
+{
+    struct timeval currentTime;
+    gettimeofday(&currentTime, NULL);
+    return (currentTime.tv_sec + 1.0e-06*currentTime.tv_usec);
+}  // end WallTime()
+
+static bool Configure(VsimNormAgent& agent, const VsimConfig& config)
+{
+    char rate[32], segment[16], block[16], parity[16];
+    sprintf(rate, "%f", config.rate);
+    sprintf(segment, "%u", config.segment);
+    sprintf(block, "%u", config.block);
+    sprintf(parity, "%u", config.parity);
+    const char* argv[] =
+    {
+        "address", "224.1.2.3/6003",
+        "rate", rate,
+        "cc", config.cc ? "on" : "off",
+        "segment", segment,
+        "block", block,
+        "parity", parity
+    };
+    return (agent.ProcessCommands(sizeof(argv) / sizeof(const char*), argv) &&
+            agent.ProcessCommands(config.agentArgc, config.agentArgv));
+}  // end Configure()
+
+// Reports a "check" failure if "value" is zero
+static bool CheckNonZero(const char* column, unsigned long long value, unsigned int receiverCount)
+{
+    if (0 != value) return true;
+    fprintf(stderr, "normVsim error: receivers %u check failed: %s is zero\n", receiverCount, column);
+    return false;
+}  // end CheckNonZero()
+
+// Runs one group size and prints its CSV line (returns false on timeout
+// or a failed "check")
+static bool RunSimulation(const VsimConfig& config, bool& error)
+{
+    error = false;
+    VsimNetwork network;
+    if (!network.Init(config.receiverCount + 1, config.groupCount,
+                      config.coreLink, config.edgeLink, config.seed))
+    {
+        error = true;
+        return false;
+    }
+    srand(config.seed);  // (NORM's own randomization)
+
+    VsimNormAgent** agentList = new VsimNormAgent*[config.receiverCount + 1];
+    double* completeList = new double[config.receiverCount];
+    if ((NULL == agentList) || (NULL == completeList))
+    {
+        PLOG(PL_FATAL, "normVsim error: new agent list error: %s\n", GetErrorString());
+        if (NULL != agentList) delete[] agentList;
+        error = true;
+        return false;
+    }
+    memset(agentList, 0, (config.receiverCount + 1) * sizeof(VsimNormAgent*));
+    unsigned int pendingCount = config.receiverCount;
+    double wallStart = WallTime();
+    unsigned long long startTime = network.GetCurrentTime();
+    // Receivers first, then the sender
+    for (unsigned int i = config.receiverCount + 1; i-- > 0; )
+    {
+        VsimNormAgent* agent = new VsimNormAgent(network, i);
+        if (NULL == agent)
+        {
+            PLOG(PL_FATAL, "normVsim error: new VsimNormAgent error: %s\n", GetErrorString());
+            error = true;
+            break;
+        }
+        agentList[i] = agent;
+        if (!Configure(*agent, config))
+        {
+            error = true;
+            break;
+        }
+        if (0 != i)
+        {
+            agent->SetCompletionTarget(config.count, &pendingCount);
+            const char* argv[] = {"start", "receiver"};
+            error = !agent->ProcessCommands(2, argv);
+        }
+        else
+        {
+            char repeat[16], size[16];
+            sprintf(repeat, "%u", config.count - 1);
+            sprintf(size, "%u", config.size);
+            const char* argv[] = {"repeat", repeat, "start", "sender", "sendFile", size};
+            error = !agent->ProcessCommands(6, argv);
+        }
+        if (error) break;
+    }
+    bool result = false;
+    if (!error)
+    {
+        network.Run(startTime + (unsigned long long)(1.0e+06 * config.duration));
+        result = (0 == pendingCount);
+        double wallTime = WallTime() - wallStart;
+        double virtualTime = 1.0e-06 * (double)(network.GetCurrentTime() - startTime);
+
+        // Gather sender and receiver statistics (each session's snapshot is
+        // published first since the virtual clock has stopped, possibly
+        // before its stats timer's last timeout)
+        NormSession::Stats stats;
+        memset(&stats, 0, sizeof(NormSession::Stats));
+        NormSession* session = agentList[0]->GetSession();
+        if (NULL != session)
+        {
+            session->UpdateStats();
+            session->GetStats(stats);
+        }
+        unsigned long nacksSent = 0;
+        unsigned long nacksSuppressed = 0;
+        unsigned long socketDrops = 0;
+        unsigned int completeCount = 0;
+        double completeSum = 0.0;
+        for (unsigned int i = 1; i <= config.receiverCount; i++)
+        {
+            NormSession::Stats rxStats;
+            memset(&rxStats, 0, sizeof(NormSession::Stats));
+            NormSession* rxSession = agentList[i]->GetSession();
+            if (NULL != rxSession)
+            {
+                rxSession->UpdateStats();
+                rxSession->GetStats(rxStats);
+            }
+            nacksSent += rxStats.nacks_sent;
+            nacksSuppressed += rxStats.nacks_suppressed;
+            socketDrops += agentList[i]->GetSocketDrops();
+            if (0 != agentList[i]->GetCompletionTime())
+            {
+                double completeTime = 1.0e-06 * (double)(agentList[i]->GetCompletionTime() - startTime);
+                completeList[completeCount++] = completeTime;
+                completeSum += completeTime;
+            }
+        }
+        NormSortSamples(completeList, completeCount);
+        unsigned long long sourceSegments =
+            (unsigned long long)config.count * ((config.size + config.segment - 1) / config.segment);
+        double repairRatio = (0 != sourceSegments) ? ((double)stats.tx_repairs / (double)sourceSegments) : 0.0;
+
+        printf("%u,%u,%u,%u,%.0f,%.6f,%.6f,%.3f,%u,%s,%.6f,%.6f,%.6f,%.6f,"
+               "%llu,%llu,%llu,%.4f,%llu,%lu,%lu,%lu,%lu,%lu,%lu,%llu,%.3f,%.1f\n",
+               config.receiverCount, config.groupCount, config.size, config.count, config.rate,
+               config.coreLink.loss, config.edgeLink.loss, virtualTime,
+               completeCount, result ? "ok" : "timeout",
+               (0 != completeCount) ? (completeSum / completeCount) : 0.0,
+               NormSamplePercentile(completeList, completeCount, 50.0),
+               NormSamplePercentile(completeList, completeCount, 99.0),
+               (0 != completeCount) ? completeList[completeCount - 1] : 0.0,
+               stats.sent_packets, stats.sent_bytes, stats.tx_repairs, repairRatio,
+               stats.recv_packets, stats.nacks_received, nacksSent, nacksSuppressed,
+               network.GetLossDrops(), network.GetQueueDrops(), socketDrops,
+               network.GetEventCount(), wallTime,
+               (wallTime > 0.0) ? (virtualTime / wallTime) : 0.0);
+        fflush(stdout);
+
+        if (config.check)
+        {
+            bool ok = CheckNonZero("tx_packets", stats.sent_packets, config.receiverCount);
+            ok &= CheckNonZero("tx_bytes", stats.sent_bytes, config.receiverCount);
+            if ((config.coreLink.loss > 0.0) || (config.edgeLink.loss > 0.0))
+            {
+                // (repair_ratio is non-zero when tx_repairs is)
+                ok &= CheckNonZero("tx_repairs", stats.tx_repairs, config.receiverCount);
+                ok &= CheckNonZero("feedback_msgs", stats.recv_packets, config.receiverCount);
+                ok &= CheckNonZero("nacks_received", stats.nacks_received, config.receiverCount);
+                ok &= CheckNonZero("nacks_sent", nacksSent, config.receiverCount);
+                if (config.receiverCount > 1)
+                    ok &= CheckNonZero("nacks_suppressed", nacksSuppressed, config.receiverCount);
+            }
+            if (!ok) result = false;
+        }
+    }
+    for (unsigned int i = 0; i <= config.receiverCount; i++)
+    {
+        if (NULL != agentList[i]) delete agentList[i];
+    }
+    delete[] agentList;
+    delete[] completeList;
+    return result;
+}  // end RunSimulation()
+
+static void Usage()
+{
+    fprintf(stderr, "usage: normVsim [receivers <count>[,...]][groups <count>][size <bytes>]\n"
+                    "                [count <objects>][rate <bps>][segment <bytes>][block <count>]\n"
+                    "                [parity <count>][cc on|off][core <delay>:<loss>:<bps>:<queue>]\n"
+                    "                [edge <delay>:<loss>:<bps>:<queue>][agent \"<cmd> [<val>] ...\"]\n"
+                    "                [seed <value>][duration <sec>][check][noheader][debug <level>]\n");
+}  // end Usage()
+
+int main(int argc, char* argv[])
+{
+    VsimConfig config;
+    memset(&config, 0, sizeof(VsimConfig));
+    config.groupCount = 10;
+    config.size = 1000000;
+    config.count = 10;
+    config.rate = 10.0e+06;
+    config.segment = 1400;
+    config.block = 64;
+    config.parity = 16;
+    config.cc = false;
+    config.coreLink.delay = 0.010;
+    config.coreLink.queue_bytes = 1000000;
+    config.edgeLink.delay = 0.005;
+    config.edgeLink.loss = 1.0;
+    config.edgeLink.queue_bytes = 100000;
+    config.seed = 1;
+    config.duration = 3600.0;
+    bool header = true;
+    char agentText[1024];
+    agentText[0] = '\0';
+
+    CountList receiverList;
+    receiverList.Parse("10,100,1000");
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* cmd = argv[i];
+        bool noArg = (!strcmp(cmd, "noheader") || !strcmp(cmd, "check"));
+        if (!noArg && (++i >= argc))
+        {
+            Usage();
+            return -1;
+        }
+        const char* val = noArg ? NULL : argv[i];
+        bool result = true;
+        if (!strcmp(cmd, "noheader"))
+            header = false;
+        else if (!strcmp(cmd, "check"))
+            config.check = true;
+        else if (!strcmp(cmd, "receivers"))
+            result = receiverList.Parse(val);
+        else if (!strcmp(cmd, "groups"))
+            config.groupCount = atoi(val);
+        else if (!strcmp(cmd, "size"))
+            result = (0 != (config.size = atoi(val)));
+        else if (!strcmp(cmd, "count"))
+            result = (0 != (config.count = atoi(val)));
+        else if (!strcmp(cmd, "rate"))
+            result = ((config.rate = atof(val)) > 0.0);
+        else if (!strcmp(cmd, "segment"))
+            result = (0 != (config.segment = atoi(val)));
+        else if (!strcmp(cmd, "block"))
+            result = (0 != (config.block = atoi(val)));
+        else if (!strcmp(cmd, "parity"))
+            config.parity = atoi(val);
+        else if (!strcmp(cmd, "cc"))
+            result = ((config.cc = !strcmp(val, "on")) || !strcmp(val, "off"));
+        else if (!strcmp(cmd, "core"))
+            result = ParseLink(val, config.coreLink);
+        else if (!strcmp(cmd, "edge"))
+            result = ParseLink(val, config.edgeLink);
+        else if (!strcmp(cmd, "agent"))
+        {
+            // Split into the "agentArgv" tokens
+            result = (strlen(val) < 1024);
+            if (result)
+            {
+                strcpy(agentText, val);
+                config.agentArgc = 0;
+                char* ptr = strtok(agentText, " \t");
+                while ((NULL != ptr) && result)
+                {
+                    if (64 == config.agentArgc)
+                        result = false;
+                    else
+                        config.agentArgv[config.agentArgc++] = ptr;
+                    ptr = strtok(NULL, " \t");
+                }
+            }
+        }
+        else if (!strcmp(cmd, "seed"))
+            config.seed = (UINT32)atoi(val);
+        else if (!strcmp(cmd, "duration"))
+            result = ((config.duration = atof(val)) > 0.0);
+        else if (!strcmp(cmd, "debug"))
+            SetDebugLevel(atoi(val));
+        else
+            result = false;
+        if (!result)
+        {
+            fprintf(stderr, "normVsim error: invalid \"%s\" option\n", cmd);
+            Usage();
+            return -1;
+        }
+    }
+
+    if (header)
+        printf("receivers,groups,size,count,rate,core_loss,edge_loss,virtual_time,"
+               "completed,status,complete_mean,complete_p50,complete_p99,complete_max,"
+               "tx_packets,tx_bytes,tx_repairs,repair_ratio,feedback_msgs,nacks_received,"
+               "nacks_sent,nacks_suppressed,loss_drops,queue_drops,socket_drops,"
+               "events,wall_sec,speedup\n");
+
+    int exitCode = 0;
+    for (unsigned int r = 0; r < receiverList.count; r++)
+    {
+        config.receiverCount = receiverList.value[r];
+        bool error;
+        if (!RunSimulation(config, error))
+        {
+            if (error) return -1;
+            exitCode = 1;
+        }
+    }
+    return exitCode;
+}  // end main()
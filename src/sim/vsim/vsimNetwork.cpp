@@ -0,0 +1,459 @@
+#include "vsimNetwork.h"
+
+#include <new>       // for placement new
+#include <string.h>  // for memcpy()
+
+// The virtual clock starts at a (nonzero) fixed epoch
+#define VSIM_EPOCH_USEC  (1000000000ULL * 1000000ULL)
+
+VsimNetwork* VsimNetwork::active_network = NULL;
+
+// In the "normVsim" build, this is the time source for ProtoTimerMgr and NORM
+void ProtoSystemTime(struct timeval& theTime)
+{
+    VsimNetwork* network = VsimNetwork::GetActive();
+    unsigned long long currentTime = (NULL != network) ? network->GetCurrentTime() : VSIM_EPOCH_USEC;
+    theTime.tv_sec = (long)(currentTime / 1000000);
+    theTime.tv_usec = (long)(currentTime % 1000000);
+}  // end ProtoSystemTime()
+
+VsimPacket::VsimPacket()
+ : reference_count(1), length(0)
+{
+}
+
+VsimPacket* VsimPacket::Create(const char*         buffer,
+                               unsigned int        length,
+                               const ProtoAddress& srcAddr,
+                               const ProtoAddress& dstAddr)
+{
+    char* block = new char[sizeof(VsimPacket) + length];
+    if (NULL == block)
+    {
+        PLOG(PL_FATAL, "VsimPacket::Create() new packet error: %s\n", GetErrorString());
+        return NULL;
+    }
+    VsimPacket* packet = new (block) VsimPacket();
+    packet->length = length;
+    packet->src_addr = srcAddr;
+    packet->dst_addr = dstAddr;
+    memcpy(block + sizeof(VsimPacket), buffer, length);
+    return packet;
+}  // end VsimPacket::Create()
+
+void VsimPacket::Release()
+{
+    if (0 == --reference_count)
+    {
+        this->~VsimPacket();
+        delete[] (char*)this;
+    }
+}  // end VsimPacket::Release()
+
+VsimLink::VsimLink()
+ : delay(0), loss(0.0), rate(0.0), queue_limit(0),
+   loss_drops(0), queue_drops(0)
+{
+    busy_until[UP] = busy_until[DOWN] = 0;
+}
+
+void VsimLink::SetParams(double delaySec, double lossPercent, double bitRate, unsigned int queueBytes)
+{
+    delay = (unsigned long long)(1.0e+06 * delaySec + 0.5);
+    loss = 0.01 * lossPercent;
+    rate = 1.0e-06 * bitRate / 8.0;
+    queue_limit = queueBytes;
+}  // end VsimLink::SetParams()
+
+unsigned long long VsimLink::Transmit(VsimNetwork&          network,
+                                      unsigned long long    sendTime,
+                                      unsigned int          length,
+                                      Direction             direction)
+{
+    if ((loss > 0.0) && (network.UniformRand() < loss))
+    {
+        loss_drops++;
+        return 0;
+    }
+    unsigned long long txTime = sendTime;
+    if (rate > 0.0)
+    {
+        // FIFO queue with "queue_limit" bytes of backlog (drop-tail)
+        unsigned long long& busyUntil = busy_until[direction];
+        if (busyUntil > sendTime)
+        {
+            if (((double)(busyUntil - sendTime) * rate) > (double)queue_limit)
+            {
+                queue_drops++;
+                return 0;
+            }
+            txTime = busyUntil;
+        }
+        txTime += (unsigned long long)((double)length / rate + 0.5);
+        busyUntil = txTime;
+    }
+    return (txTime + delay);
+}  // end VsimLink::Transmit()
+
+VsimNode::VsimNode()
+ : parent(NULL), child_head(NULL), sibling(NULL), depth(0),
+   host(NULL), host_index(0)
+{
+}
+
+VsimNetwork::VsimNetwork()
+ : current_time(VSIM_EPOCH_USEC), next_sequence(0),
+   event_heap(NULL), event_count_current(0), event_heap_size(0),
+   stopped(false), rand_state(1),
+   node_list(NULL), node_count(0), node_max(0), root(NULL),
+   host_list(NULL), host_count(0), event_count(0), packet_count(0)
+{
+}
+
+VsimNetwork::~VsimNetwork()
+{
+    Destroy();
+}
+
+VsimNode* VsimNetwork::NewNode(VsimNode* parent, const LinkParams& params)
+{
+    ASSERT(node_count < node_max);
+    VsimNode* node = new VsimNode();
+    if (NULL == node)
+    {
+        PLOG(PL_FATAL, "VsimNetwork::NewNode() new node error: %s\n", GetErrorString());
+        return NULL;
+    }
+    node_list[node_count++] = node;
+    if (NULL != parent)
+    {
+        node->parent = parent;
+        node->depth = parent->depth + 1;
+        node->sibling = parent->child_head;
+        parent->child_head = node;
+        node->link.SetParams(params.delay, params.loss, params.rate, params.queue_bytes);
+    }
+    return node;
+}  // end VsimNetwork::NewNode()
+
+bool VsimNetwork::Init(unsigned int      hostCount,
+                       unsigned int      groupCount,
+                       const LinkParams& coreLink,
+                       const LinkParams& edgeLink,
+                       UINT32            seed)
+{
+    Destroy();
+    if (hostCount < 2)
+    {
+        PLOG(PL_FATAL, "VsimNetwork::Init() error: need at least 2 hosts\n");
+        return false;
+    }
+    if (groupCount > (hostCount - 1)) groupCount = hostCount - 1;
+    node_max = 1 + groupCount + hostCount;
+    node_list = new VsimNode*[node_max];
+    host_list = new VsimNode*[hostCount];
+    event_heap_size = 4 * hostCount;
+    event_heap = new Event[event_heap_size];
+    if ((NULL == node_list) || (NULL == host_list) || (NULL == event_heap))
+    {
+        PLOG(PL_FATAL, "VsimNetwork::Init() new state error: %s\n", GetErrorString());
+        Destroy();
+        return false;
+    }
+    LinkParams rootParams;
+    memset(&rootParams, 0, sizeof(LinkParams));
+    if (NULL == (root = NewNode(NULL, rootParams)))
+    {
+        Destroy();
+        return false;
+    }
+    unsigned int groupStart = node_count;
+    for (unsigned int i = 0; i < groupCount; i++)
+    {
+        if (NULL == NewNode(root, coreLink))
+        {
+            Destroy();
+            return false;
+        }
+    }
+    for (unsigned int i = 0; i < hostCount; i++)
+    {
+        // (receiver hosts are spread evenly across the groups)
+        VsimNode* parent = root;
+        if ((0 != i) && (0 != groupCount))
+            parent = node_list[groupStart + ((i - 1) % groupCount)];
+        VsimNode* node = NewNode(parent, (root == parent) && (0 == i) ? coreLink : edgeLink);
+        if (NULL == node)
+        {
+            Destroy();
+            return false;
+        }
+        node->host_index = i;
+        host_list[i] = node;
+        host_count++;
+    }
+    rand_state = (0 != seed) ? seed : 1;
+    current_time = VSIM_EPOCH_USEC;
+    next_sequence = 0;
+    stopped = false;
+    event_count = packet_count = 0;
+    active_network = this;
+    return true;
+}  // end VsimNetwork::Init()
+
+void VsimNetwork::Destroy()
+{
+    if (NULL != event_heap)
+    {
+        for (unsigned int i = 0; i < event_count_current; i++)
+        {
+            if (NULL != event_heap[i].packet) event_heap[i].packet->Release();
+        }
+        delete[] event_heap;
+        event_heap = NULL;
+    }
+    event_count_current = event_heap_size = 0;
+    if (NULL != node_list)
+    {
+        for (unsigned int i = 0; i < node_count; i++)
+            delete node_list[i];
+        delete[] node_list;
+        node_list = NULL;
+    }
+    node_count = node_max = 0;
+    root = NULL;
+    if (NULL != host_list)
+    {
+        delete[] host_list;
+        host_list = NULL;
+    }
+    host_count = 0;
+    if (this == active_network) active_network = NULL;
+}  // end VsimNetwork::Destroy()
+
+void VsimNetwork::GetHostAddress(unsigned int hostIndex, ProtoAddress& theAddress)
+{
+    UINT32 addr = htonl((10UL << 24) | ((hostIndex + 1) & 0x00ffffff));
+    theAddress.SetRawHostAddress(ProtoAddress::IPv4, (char*)&addr, 4);
+}  // end VsimNetwork::GetHostAddress()
+
+bool VsimNetwork::GetHostIndex(const ProtoAddress& theAddress, unsigned int& hostIndex)
+{
+    if (ProtoAddress::IPv4 != theAddress.GetType()) return false;
+    UINT32 addr;
+    memcpy(&addr, theAddress.GetRawHostAddress(), 4);
+    addr = ntohl(addr);
+    if ((10 != (addr >> 24)) || (0 == (addr & 0x00ffffff))) return false;
+    hostIndex = (addr & 0x00ffffff) - 1;
+    return true;
+}  // end VsimNetwork::GetHostIndex()
+
+unsigned long VsimNetwork::GetLossDrops() const
+{
+    unsigned long drops = 0;
+    for (unsigned int i = 0; i < node_count; i++)
+        drops += node_list[i]->link.GetLossDrops();
+    return drops;
+}  // end VsimNetwork::GetLossDrops()
+
+unsigned long VsimNetwork::GetQueueDrops() const
+{
+    unsigned long drops = 0;
+    for (unsigned int i = 0; i < node_count; i++)
+        drops += node_list[i]->link.GetQueueDrops();
+    return drops;
+}  // end VsimNetwork::GetQueueDrops()
+
+bool VsimNetwork::ScheduleEvent(Event& theEvent)
+{
+    if (event_count_current == event_heap_size)
+    {
+        unsigned int newSize = 2 * event_heap_size;
+        Event* newHeap = new Event[newSize];
+        if (NULL == newHeap)
+        {
+            PLOG(PL_FATAL, "VsimNetwork::ScheduleEvent() new event_heap error: %s\n", GetErrorString());
+            return false;
+        }
+        memcpy(newHeap, event_heap, event_count_current * sizeof(Event));
+        delete[] event_heap;
+        event_heap = newHeap;
+        event_heap_size = newSize;
+    }
+    theEvent.sequence = next_sequence++;
+    // Sift up
+    unsigned int index = event_count_current++;
+    while (index > 0)
+    {
+        unsigned int parent = (index - 1) >> 1;
+        if (!EventIsEarlier(theEvent, event_heap[parent])) break;
+        event_heap[index] = event_heap[parent];
+        index = parent;
+    }
+    event_heap[index] = theEvent;
+    return true;
+}  // end VsimNetwork::ScheduleEvent()
+
+void VsimNetwork::ScheduleTimer(VsimHost* host, double delay, UINT32 timerSeq)
+{
+    // (at least 1 usec ahead so the clock always advances)
+    unsigned long long delayUsec = (delay > 0.0) ? (unsigned long long)(1.0e+06 * delay + 0.999) : 1;
+    if (0 == delayUsec) delayUsec = 1;
+    Event theEvent;
+    theEvent.time = current_time + delayUsec;
+    theEvent.host = host;
+    theEvent.packet = NULL;
+    theEvent.timer_seq = timerSeq;
+    theEvent.type = EVENT_TIMER;
+    ScheduleEvent(theEvent);
+}  // end VsimNetwork::ScheduleTimer()
+
+void VsimNetwork::Deliver(VsimNode* node, unsigned long long arrivalTime, VsimPacket* packet)
+{
+    if (NULL == node->host) return;  // (no agent attached)
+    Event theEvent;
+    theEvent.time = arrivalTime;
+    theEvent.host = node->host;
+    theEvent.packet = packet;
+    theEvent.timer_seq = 0;
+    theEvent.type = EVENT_PACKET;
+    packet->Retain();
+    if (!ScheduleEvent(theEvent)) packet->Release();
+}  // end VsimNetwork::Deliver()
+
+void VsimNetwork::Flood(VsimNode*           node,
+                        VsimNode*           prevNode,
+                        unsigned long long  sendTime,
+                        VsimPacket*         packet,
+                        VsimHost*           srcHost)
+{
+    // Up to the parent (unless we came from there) ...
+    if ((NULL != node->parent) && (prevNode != node->parent))
+    {
+        unsigned long long arrivalTime =
+            node->link.Transmit(*this, sendTime, packet->GetLength(), VsimLink::UP);
+        if (0 != arrivalTime) Flood(node->parent, node, arrivalTime, packet, srcHost);
+    }
+    // ... and down to the children
+    for (VsimNode* child = node->child_head; NULL != child; child = child->sibling)
+    {
+        if (child == prevNode) continue;
+        unsigned long long arrivalTime =
+            child->link.Transmit(*this, sendTime, packet->GetLength(), VsimLink::DOWN);
+        if (0 == arrivalTime) continue;
+        if (NULL != child->host)
+        {
+            if (child->host != srcHost) Deliver(child, arrivalTime, packet);
+        }
+        else
+        {
+            Flood(child, node, arrivalTime, packet, srcHost);
+        }
+    }
+}  // end VsimNetwork::Flood()
+
+void VsimNetwork::SendPacket(unsigned int        srcIndex,
+                             const char*         buffer,
+                             unsigned int        length,
+                             const ProtoAddress& srcAddr,
+                             const ProtoAddress& dstAddr)
+{
+    if (srcIndex >= host_count) return;
+    VsimNode* srcNode = host_list[srcIndex];
+    unsigned int dstIndex = 0;
+    if (!dstAddr.IsMulticast() && (!GetHostIndex(dstAddr, dstIndex) || (dstIndex >= host_count)))
+    {
+        PLOG(PL_DEBUG, "VsimNetwork::SendPacket() unknown destination %s\n", dstAddr.GetHostString());
+        return;
+    }
+    VsimPacket* packet = VsimPacket::Create(buffer, length, srcAddr, dstAddr);
+    if (NULL == packet) return;
+    packet_count++;
+    if (dstAddr.IsMulticast())
+    {
+        Flood(srcNode, NULL, current_time, packet, srcNode->host);
+    }
+    else if (dstIndex == srcIndex)
+    {
+        Deliver(srcNode, current_time, packet);  // (to self)
+    }
+    else
+    {
+        // Up from the source to the common ancestor, then down to the
+        // destination (whose downward path is collected first)
+        VsimNode* dstNode = host_list[dstIndex];
+        VsimNode* downPath[64];
+        unsigned int downCount = 0;
+        VsimNode* up = srcNode;
+        VsimNode* down = dstNode;
+        while (up != down)
+        {
+            if (up->depth >= down->depth)
+            {
+                up = up->parent;
+            }
+            else
+            {
+                ASSERT(downCount < 64);
+                downPath[downCount++] = down;
+                down = down->parent;
+            }
+        }
+        VsimNode* ancestor = up;
+        unsigned long long sendTime = current_time;
+        for (VsimNode* node = srcNode; node != ancestor; node = node->parent)
+        {
+            if (0 == (sendTime = node->link.Transmit(*this, sendTime, length, VsimLink::UP)))
+                break;
+        }
+        while ((0 != sendTime) && (downCount > 0))
+        {
+            VsimNode* node = downPath[--downCount];
+            sendTime = node->link.Transmit(*this, sendTime, length, VsimLink::DOWN);
+        }
+        if (0 != sendTime) Deliver(dstNode, sendTime, packet);
+    }
+    packet->Release();
+}  // end VsimNetwork::SendPacket()
+
+void VsimNetwork::Run(unsigned long long endTime)
+{
+    stopped = false;
+    active_network = this;
+    while (!stopped && (event_count_current > 0))
+    {
+        Event theEvent = event_heap[0];
+        if (theEvent.time > endTime)
+        {
+            current_time = endTime;
+            break;
+        }
+        // Remove the heap top (sift down the last event)
+        Event& last = event_heap[--event_count_current];
+        unsigned int index = 0;
+        while (true)
+        {
+            unsigned int child = (index << 1) + 1;
+            if (child >= event_count_current) break;
+            if (((child + 1) < event_count_current) &&
+                EventIsEarlier(event_heap[child + 1], event_heap[child]))
+                child++;
+            if (!EventIsEarlier(event_heap[child], last)) break;
+            event_heap[index] = event_heap[child];
+            index = child;
+        }
+        if (event_count_current > 0) event_heap[index] = last;
+
+        current_time = theEvent.time;
+        event_count++;
+        if (EVENT_TIMER == theEvent.type)
+        {
+            theEvent.host->OnTimerEvent(theEvent.timer_seq);
+        }
+        else
+        {
+            theEvent.host->OnPacketEvent(*theEvent.packet);
+            theEvent.packet->Release();
+        }
+    }
+}  // end VsimNetwork::Run()
@@ -0,0 +1,223 @@
+#ifndef _VSIM_NETWORK
+#define _VSIM_NETWORK
+
+// vsimNetwork.h - Discrete-event virtual network for the standalone
+// "normVsim" simulator.  The VsimNetwork keeps the (integer microsecond)
+// virtual clock that ProtoSystemTime() returns in this SIMULATE build and
+// an event queue of host timeouts and packet deliveries.  Hosts are the
+// leaves of a tree of routers where each tree edge is a link with its own
+// delay, loss, rate and queue limit (per direction).  Multicast packets
+// are flooded down the tree (so a loss on a shared link is seen by every
+// host below it) and unicast packets follow the tree path.
+//
+// (Packet transmission over a path is computed when the packet is sent,
+//  so link queueing is approximate for cross traffic from other senders)
+
+#include "protokit.h"  // for ProtoAddress, UINT32, etc
+
+class VsimPacket
+{
+    public:
+        static VsimPacket* Create(const char*         buffer,
+                                  unsigned int        length,
+                                  const ProtoAddress& srcAddr,
+                                  const ProtoAddress& dstAddr);
+        void Retain()
+            {reference_count++;}
+        void Release();
+
+        const char* GetBuffer() const
+            {return ((const char*)this + sizeof(VsimPacket));}
+        unsigned int GetLength() const
+            {return length;}
+        const ProtoAddress& GetSource() const
+            {return src_addr;}
+        const ProtoAddress& GetDestination() const
+            {return dst_addr;}
+
+    private:
+        VsimPacket();  // (use Create())
+        unsigned int    reference_count;
+        unsigned int    length;
+        ProtoAddress    src_addr;
+        ProtoAddress    dst_addr;
+        // (packet content follows)
+};  // end class VsimPacket
+
+// A simulated host (see VsimNormAgent)
+class VsimHost
+{
+    public:
+        virtual ~VsimHost() {}
+        virtual void OnTimerEvent(UINT32 timerSeq) = 0;
+        virtual void OnPacketEvent(VsimPacket& packet) = 0;
+};  // end class VsimHost
+
+// Link (tree edge) parameters and per-direction queue state
+class VsimLink
+{
+    public:
+        VsimLink();
+
+        void SetParams(double delay, double lossPercent, double rate, unsigned int queueBytes);
+
+        enum Direction {UP = 0, DOWN = 1};  // (toward or away from the root)
+        // Returns the time (usec) "length" bytes sent at "sendTime" arrive
+        // at the other end, or zero if dropped
+        unsigned long long Transmit(class VsimNetwork&    network,
+                                    unsigned long long    sendTime,
+                                    unsigned int          length,
+                                    Direction             direction);
+
+        unsigned long GetLossDrops() const
+            {return loss_drops;}
+        unsigned long GetQueueDrops() const
+            {return queue_drops;}
+
+    private:
+        unsigned long long  delay;            // usec
+        double              loss;             // probability
+        double              rate;             // bytes/usec (0.0 = unlimited)
+        unsigned int        queue_limit;      // bytes
+        unsigned long long  busy_until[2];    // usec (per Direction)
+        unsigned long       loss_drops;
+        unsigned long       queue_drops;
+};  // end class VsimLink
+
+// Tree node (router, or host when "host" is non-NULL).  Hosts are leaves.
+class VsimNode
+{
+    friend class VsimNetwork;
+
+    public:
+        VsimHost* GetHost() const
+            {return host;}
+
+    private:
+        VsimNode();
+
+        VsimNode*       parent;
+        VsimLink        link;       // to parent
+        VsimNode*       child_head;
+        VsimNode*       sibling;
+        unsigned int    depth;
+        VsimHost*       host;
+        UINT32          host_index;
+};  // end class VsimNode
+
+class VsimNetwork
+{
+    public:
+        VsimNetwork();
+        ~VsimNetwork();
+
+        // Topology: "hostCount" hosts with the first (the sender) attached
+        // to the root over a "core" link.  The others attach to one of
+        // "groupCount" routers (each attached to the root over a "core"
+        // link) over an "edge" link, or directly to the root if "groupCount"
+        // is zero (i.e., a star).
+        struct LinkParams
+        {
+            double          delay;        // sec
+            double          loss;         // percent
+            double          rate;         // bits/sec (0.0 = unlimited)
+            unsigned int    queue_bytes;
+        };
+        bool Init(unsigned int      hostCount,
+                  unsigned int      groupCount,
+                  const LinkParams& coreLink,
+                  const LinkParams& edgeLink,
+                  UINT32            seed);
+        void Destroy();
+
+        void AttachHost(unsigned int hostIndex, VsimHost* host)
+            {host_list[hostIndex]->host = host;}
+        unsigned int GetHostCount() const
+            {return host_count;}
+
+        // Hosts use addresses 10.x.y.z (from "hostIndex + 1")
+        static void GetHostAddress(unsigned int hostIndex, ProtoAddress& theAddress);
+        static bool GetHostIndex(const ProtoAddress& theAddress, unsigned int& hostIndex);
+
+        // Virtual clock (usec)
+        unsigned long long GetCurrentTime() const
+            {return current_time;}
+        static VsimNetwork* GetActive()
+            {return active_network;}
+
+        // Events
+        void ScheduleTimer(VsimHost* host, double delay, UINT32 timerSeq);
+        void SendPacket(unsigned int        srcIndex,
+                        const char*         buffer,
+                        unsigned int        length,
+                        const ProtoAddress& srcAddr,
+                        const ProtoAddress& dstAddr);
+        // Runs events until "Stop()" or the given virtual "endTime" (usec)
+        void Run(unsigned long long endTime);
+        void Stop()
+            {stopped = true;}
+
+        double UniformRand()  // [0.0, 1.0)
+        {
+            // (xorshift32, so runs are repeatable for a given seed)
+            rand_state ^= rand_state << 13;
+            rand_state ^= rand_state >> 17;
+            rand_state ^= rand_state << 5;
+            return ((double)rand_state / 4294967296.0);
+        }
+
+        // Statistics
+        unsigned long long GetEventCount() const
+            {return event_count;}
+        unsigned long long GetPacketCount() const
+            {return packet_count;}
+        unsigned long GetLossDrops() const;
+        unsigned long GetQueueDrops() const;
+
+    private:
+        enum EventType {EVENT_TIMER, EVENT_PACKET};
+        struct Event
+        {
+            unsigned long long  time;      // usec
+            unsigned long long  sequence;  // (FIFO order for equal times)
+            VsimHost*           host;
+            VsimPacket*         packet;    // EVENT_PACKET
+            UINT32              timer_seq; // EVENT_TIMER
+            UINT8               type;
+        };
+        bool ScheduleEvent(Event& theEvent);
+        static bool EventIsEarlier(const Event& a, const Event& b)
+        {
+            return ((a.time < b.time) ||
+                    ((a.time == b.time) && (a.sequence < b.sequence)));
+        }
+        void Flood(VsimNode*           node,
+                   VsimNode*           prevNode,
+                   unsigned long long  sendTime,
+                   VsimPacket*         packet,
+                   VsimHost*           srcHost);
+        void Deliver(VsimNode* node, unsigned long long arrivalTime, VsimPacket* packet);
+        VsimNode* NewNode(VsimNode* parent, const LinkParams& params);
+
+        static VsimNetwork* active_network;  // (whose clock ProtoSystemTime() returns)
+
+        unsigned long long  current_time;
+        unsigned long long  next_sequence;
+        Event*              event_heap;
+        unsigned int        event_count_current;
+        unsigned int        event_heap_size;
+        bool                stopped;
+        UINT32              rand_state;
+
+        VsimNode**          node_list;      // (all nodes, for deletion)
+        unsigned int        node_count;
+        unsigned int        node_max;
+        VsimNode*           root;
+        VsimNode**          host_list;
+        unsigned int        host_count;
+
+        unsigned long long  event_count;
+        unsigned long long  packet_count;
+};  // end class VsimNetwork
+
+#endif // _VSIM_NETWORK
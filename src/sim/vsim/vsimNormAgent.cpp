@@ -0,0 +1,347 @@
+#include "vsimNormAgent.h"
+
+#include <string.h>  // for memcpy(), strcmp()
+
+VsimNormAgent::VsimNormAgent(VsimNetwork& theNetwork, unsigned int hostIndex)
+ : NormSimAgent(GetTimerMgr(), GetSocketNotifier()),
+   network(theNetwork), host_index(hostIndex), timer_seq(0),
+   proxy_list(NULL), next_port(5000), completion_target(0),
+   pending_count(NULL), completion_count(0), completion_time(0),
+   socket_drops(0)
+{
+    network.AttachHost(hostIndex, this);
+}
+
+VsimNormAgent::~VsimNormAgent()
+{
+    OnShutdown();
+    network.AttachHost(host_index, NULL);
+}
+
+void VsimNormAgent::OnShutdown()
+{
+    NormSimAgent::Stop();
+    timer_seq++;  // (cancels any pending timer event)
+}  // end VsimNormAgent::OnShutdown()
+
+bool VsimNormAgent::ProcessCommands(int argc, const char*const* argv)
+{
+    int i = 0;
+    while (i < argc)
+    {
+        NormSimAgent::CmdType cmdType = CommandType(argv[i]);
+        switch (cmdType)
+        {
+            case NormSimAgent::CMD_NOARG:
+                if (!ProcessCommand(argv[i], NULL))
+                {
+                    PLOG(PL_FATAL, "VsimNormAgent::ProcessCommands() ProcessCommand(%s) error\n",
+                         argv[i]);
+                    return false;
+                }
+                i++;
+                break;
+
+            case NormSimAgent::CMD_ARG:
+                if ((i + 1) >= argc)
+                {
+                    PLOG(PL_FATAL, "VsimNormAgent::ProcessCommands() ProcessCommand(%s) error: missing argument\n",
+                         argv[i]);
+                    return false;
+                }
+                if (!ProcessCommand(argv[i], argv[i+1]))
+                {
+                    PLOG(PL_FATAL, "VsimNormAgent::ProcessCommands() ProcessCommand(%s, %s) error\n",
+                         argv[i], argv[i+1]);
+                    return false;
+                }
+                i += 2;
+                break;
+
+            case NormSimAgent::CMD_INVALID:
+                PLOG(PL_FATAL, "VsimNormAgent::ProcessCommands() invalid command: %s\n", argv[i]);
+                return false;
+        }
+    }
+    return true;
+}  // end VsimNormAgent::ProcessCommands()
+
+bool VsimNormAgent::GetLocalAddress(ProtoAddress& localAddr)
+{
+    VsimNetwork::GetHostAddress(host_index, localAddr);
+    return true;
+}  // end VsimNormAgent::GetLocalAddress()
+
+bool VsimNormAgent::UpdateSystemTimer(ProtoTimer::Command command, double delay)
+{
+    // Each update supersedes any previously scheduled timer event
+    timer_seq++;
+    switch (command)
+    {
+        case ProtoTimer::INSTALL:
+        case ProtoTimer::MODIFY:
+            network.ScheduleTimer(this, delay, timer_seq);
+            break;
+        case ProtoTimer::REMOVE:
+            break;
+    }
+    return true;
+}  // end VsimNormAgent::UpdateSystemTimer()
+
+void VsimNormAgent::OnTimerEvent(UINT32 timerSeq)
+{
+    if (timerSeq == timer_seq) OnSystemTimeout();
+}  // end VsimNormAgent::OnTimerEvent()
+
+void VsimNormAgent::OnPacketEvent(VsimPacket& packet)
+{
+    const ProtoAddress& dstAddr = packet.GetDestination();
+    UINT16 dstPort = dstAddr.GetPort();
+    bool isMulticast = dstAddr.IsMulticast();
+    for (UdpSocketProxy* proxy = proxy_list; NULL != proxy; proxy = proxy->next)
+    {
+        if (dstPort != proxy->GetPort()) continue;
+        if (isMulticast && !proxy->IsGroupMember(dstAddr)) continue;
+        if (!proxy->Enqueue(packet)) socket_drops++;
+    }
+    // Notify sockets with input (by position since the proxy_list may
+    // change during notification) until their queues are drained or their
+    // reads stop making progress, so no datagram is left waiting for a
+    // later packet event
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        unsigned int index = 0;
+        while (true)
+        {
+            UdpSocketProxy* proxy = proxy_list;
+            for (unsigned int i = 0; (i < index) && (NULL != proxy); i++)
+                proxy = proxy->next;
+            if (NULL == proxy) break;
+            index++;
+            unsigned int inputCount = proxy->GetInputCount();
+            if (0 == inputCount) continue;
+            proxy->GetSocket()->OnNotify(ProtoSocket::NOTIFY_INPUT);
+            // (the proxy may have been closed during notification)
+            if (IsOpenProxy(proxy) && (proxy->GetInputCount() < inputCount))
+                progress = true;
+        }
+    }
+}  // end VsimNormAgent::OnPacketEvent()
+
+bool VsimNormAgent::IsOpenProxy(const UdpSocketProxy* theProxy) const
+{
+    for (UdpSocketProxy* proxy = proxy_list; NULL != proxy; proxy = proxy->next)
+    {
+        if (theProxy == proxy) return true;
+    }
+    return false;
+}  // end VsimNormAgent::IsOpenProxy()
+
+ProtoSocket::Proxy* VsimNormAgent::OpenSocket(ProtoSocket& theSocket)
+{
+    if (ProtoSocket::UDP != theSocket.GetProtocol())
+    {
+        PLOG(PL_FATAL, "VsimNormAgent::OpenSocket() error: only UDP sockets are supported\n");
+        return NULL;
+    }
+    UdpSocketProxy* proxy = new UdpSocketProxy(*this, theSocket);
+    if (NULL == proxy)
+    {
+        PLOG(PL_FATAL, "VsimNormAgent::OpenSocket() new UdpSocketProxy error: %s\n", GetErrorString());
+        return NULL;
+    }
+    proxy->next = proxy_list;
+    proxy_list = proxy;
+    return proxy;
+}  // end VsimNormAgent::OpenSocket()
+
+void VsimNormAgent::CloseSocket(ProtoSocket& theSocket)
+{
+    UdpSocketProxy* prev = NULL;
+    UdpSocketProxy* proxy = proxy_list;
+    while (NULL != proxy)
+    {
+        if (&theSocket == proxy->GetSocket())
+        {
+            if (NULL != prev)
+                prev->next = proxy->next;
+            else
+                proxy_list = proxy->next;
+            delete proxy;
+            return;
+        }
+        prev = proxy;
+        proxy = proxy->next;
+    }
+}  // end VsimNormAgent::CloseSocket()
+
+void VsimNormAgent::Notify(NormController::Event event,
+                           class NormSessionMgr* sessionMgr,
+                           class NormSession*    session,
+                           class NormSenderNode* sender,
+                           class NormObject*     object)
+{
+    NormSimAgent::Notify(event, sessionMgr, session, sender, object);
+    if (RX_OBJECT_COMPLETED == event)
+    {
+        completion_count++;
+        if ((0 != completion_target) && (completion_count == completion_target))
+        {
+            completion_time = network.GetCurrentTime();
+            if ((NULL != pending_count) && (0 != *pending_count))
+            {
+                if (0 == --(*pending_count)) network.Stop();
+            }
+        }
+    }
+}  // end VsimNormAgent::Notify()
+
+VsimNormAgent::UdpSocketProxy::UdpSocketProxy(VsimNormAgent& theAgent, ProtoSocket& theSocket)
+ : next(NULL), agent(theAgent), port(0), group_count(0), rx_head(0), rx_count(0)
+{
+    proto_socket = &theSocket;
+}
+
+VsimNormAgent::UdpSocketProxy::~UdpSocketProxy()
+{
+    while (rx_count > 0)
+    {
+        rx_queue[rx_head]->Release();
+        rx_head = (rx_head + 1) % RX_QUEUE_MAX;
+        rx_count--;
+    }
+}
+
+bool VsimNormAgent::UdpSocketProxy::Bind(UINT16& thePort)
+{
+    if (0 == thePort)
+    {
+        // Pick an ephemeral port not in use by another proxy
+        bool inUse = true;
+        while (inUse)
+        {
+            thePort = agent.next_port++;
+            if (0 == agent.next_port) agent.next_port = 5000;
+            inUse = false;
+            for (UdpSocketProxy* proxy = agent.proxy_list; NULL != proxy; proxy = proxy->next)
+            {
+                if (thePort == proxy->port)
+                {
+                    inUse = true;
+                    break;
+                }
+            }
+        }
+    }
+    // (ports may be shared as with SO_REUSEPORT)
+    port = thePort;
+    return true;
+}  // end VsimNormAgent::UdpSocketProxy::Bind()
+
+bool VsimNormAgent::UdpSocketProxy::Connect(const ProtoAddress& /*theAddress*/)
+{
+    return false;  // (not supported)
+}  // end VsimNormAgent::UdpSocketProxy::Connect()
+
+bool VsimNormAgent::UdpSocketProxy::Accept(ProtoSocket* /*theSocket*/)
+{
+    return false;  // (not supported)
+}  // end VsimNormAgent::UdpSocketProxy::Accept()
+
+bool VsimNormAgent::UdpSocketProxy::Listen(UINT16 /*thePort*/)
+{
+    return false;  // (not supported)
+}  // end VsimNormAgent::UdpSocketProxy::Listen()
+
+bool VsimNormAgent::UdpSocketProxy::SendTo(const char*         buffer,
+                                           unsigned int&       numBytes,
+                                           const ProtoAddress& dstAddr)
+{
+    if (0 == port)
+    {
+        UINT16 thePort = 0;
+        Bind(thePort);
+    }
+    ProtoAddress srcAddr;
+    VsimNetwork::GetHostAddress(agent.host_index, srcAddr);
+    srcAddr.SetPort(port);
+    agent.network.SendPacket(agent.host_index, buffer, numBytes, srcAddr, dstAddr);
+    return true;
+}  // end VsimNormAgent::UdpSocketProxy::SendTo()
+
+bool VsimNormAgent::UdpSocketProxy::RecvFrom(char*         buffer,
+                                             unsigned int& numBytes,
+                                             ProtoAddress& srcAddr)
+{
+    ProtoAddress dstAddr;
+    return RecvFrom(buffer, numBytes, srcAddr, dstAddr);
+}  // end VsimNormAgent::UdpSocketProxy::RecvFrom()
+
+bool VsimNormAgent::UdpSocketProxy::RecvFrom(char*         buffer,
+                                             unsigned int& numBytes,
+                                             ProtoAddress& srcAddr,
+                                             ProtoAddress& dstAddr)
+{
+    if (0 == rx_count)
+    {
+        numBytes = 0;  // (nothing more to read)
+        return true;
+    }
+    VsimPacket* packet = rx_queue[rx_head];
+    rx_head = (rx_head + 1) % RX_QUEUE_MAX;
+    rx_count--;
+    // (datagrams larger than the buffer are truncated)
+    unsigned int length = packet->GetLength();
+    if (length > numBytes) length = numBytes;
+    memcpy(buffer, packet->GetBuffer(), length);
+    numBytes = length;
+    srcAddr = packet->GetSource();
+    dstAddr = packet->GetDestination();
+    packet->Release();
+    return true;
+}  // end VsimNormAgent::UdpSocketProxy::RecvFrom()
+
+bool VsimNormAgent::UdpSocketProxy::JoinGroup(const ProtoAddress& groupAddr)
+{
+    if (IsGroupMember(groupAddr)) return true;
+    if (GROUP_MAX == group_count)
+    {
+        PLOG(PL_ERROR, "VsimNormAgent::UdpSocketProxy::JoinGroup() error: too many groups\n");
+        return false;
+    }
+    group_list[group_count++] = groupAddr;
+    return true;
+}  // end VsimNormAgent::UdpSocketProxy::JoinGroup()
+
+bool VsimNormAgent::UdpSocketProxy::LeaveGroup(const ProtoAddress& groupAddr)
+{
+    for (unsigned int i = 0; i < group_count; i++)
+    {
+        if (groupAddr.HostIsEqual(group_list[i]))
+        {
+            group_list[i] = group_list[--group_count];
+            return true;
+        }
+    }
+    return false;
+}  // end VsimNormAgent::UdpSocketProxy::LeaveGroup()
+
+bool VsimNormAgent::UdpSocketProxy::IsGroupMember(const ProtoAddress& groupAddr) const
+{
+    for (unsigned int i = 0; i < group_count; i++)
+    {
+        if (groupAddr.HostIsEqual(group_list[i])) return true;
+    }
+    return false;
+}  // end VsimNormAgent::UdpSocketProxy::IsGroupMember()
+
+bool VsimNormAgent::UdpSocketProxy::Enqueue(VsimPacket& packet)
+{
+    if (RX_QUEUE_MAX == rx_count) return false;
+    packet.Retain();
+    rx_queue[(rx_head + rx_count) % RX_QUEUE_MAX] = &packet;
+    rx_count++;
+    return true;
+}  // end VsimNormAgent::UdpSocketProxy::Enqueue()
@@ -0,0 +1,145 @@
+#ifndef _VSIM_NORM_AGENT
+#define _VSIM_NORM_AGENT
+
+// vsimNormAgent.h - NormSimAgent attachment to the "normVsim" virtual
+// network (much like the ns-2 NsNormAgent and OPNET OpnetNormProcess)
+
+#include "vsimNetwork.h"
+#include "protoSimAgent.h"  // from Protolib
+#include "normSimAgent.h"
+
+class VsimNormAgent : public ProtoSimAgent, public NormSimAgent, public VsimHost
+{
+    public:
+        VsimNormAgent(VsimNetwork& theNetwork, unsigned int hostIndex);
+        ~VsimNormAgent();
+
+        // Processes "cmd [value]" argument sequences as the NsNormAgent does
+        bool ProcessCommands(int argc, const char*const* argv);
+        void OnShutdown();
+
+        // Receivers count the objects they complete and, upon completing
+        // "objectCount", decrement the shared "pendingCount" (and stop the
+        // network when it reaches zero)
+        void SetCompletionTarget(unsigned int objectCount, unsigned int* pendingCount)
+        {
+            completion_target = objectCount;
+            pending_count = pendingCount;
+        }
+        unsigned int GetCompletionCount() const
+            {return completion_count;}
+        unsigned long long GetCompletionTime() const  // usec (0 if incomplete)
+            {return completion_time;}
+        unsigned long GetSocketDrops() const
+            {return socket_drops;}
+
+        // ProtoSimAgent overrides
+        bool GetLocalAddress(ProtoAddress& localAddr);
+
+        // NormSimAgent overrides
+        unsigned long GetAgentId()
+            {return (unsigned long)(host_index + 1);}
+        bool HandleMessage(const char* txBuffer, unsigned int len, const ProtoAddress& srcAddr)
+            {return NormSimAgent::SendMessage(len, txBuffer);}
+
+        // VsimHost overrides
+        void OnTimerEvent(UINT32 timerSeq);
+        void OnPacketEvent(VsimPacket& packet);
+
+    protected:
+        // ProtoSimAgent overrides
+        bool UpdateSystemTimer(ProtoTimer::Command command, double delay);
+        ProtoSocket::Proxy* OpenSocket(ProtoSocket& theSocket);
+        void CloseSocket(ProtoSocket& theSocket);
+
+        // NormController override (counts completed objects)
+        void Notify(NormController::Event event,
+                    class NormSessionMgr* sessionMgr,
+                    class NormSession*    session,
+                    class NormSenderNode* sender,
+                    class NormObject*     object);
+
+    private:
+        class UdpSocketProxy : public ProtoSimAgent::SocketProxy
+        {
+            public:
+                UdpSocketProxy(VsimNormAgent& theAgent, ProtoSocket& theSocket);
+                ~UdpSocketProxy();
+
+                bool Bind(UINT16& thePort);
+                bool Connect(const ProtoAddress& theAddress);
+                bool Accept(ProtoSocket* theSocket);
+                bool Listen(UINT16 thePort);
+                bool SendTo(const char*         buffer,
+                            unsigned int&       numBytes,
+                            const ProtoAddress& dstAddr);
+                bool RecvFrom(char*             buffer,
+                              unsigned int&     numBytes,
+                              ProtoAddress&     srcAddr);
+                bool RecvFrom(char*             buffer,
+                              unsigned int&     numBytes,
+                              ProtoAddress&     srcAddr,
+                              ProtoAddress&     dstAddr);
+                bool JoinGroup(const ProtoAddress& groupAddr);
+                bool LeaveGroup(const ProtoAddress& groupAddr);
+                bool SetTTL(unsigned char ttl)
+                    {return true;}
+                bool SetLoopback(bool loopback)
+                    {return true;}
+                bool SetBroadcast(bool broadcast)
+                    {return true;}
+                bool SetEcnCapable(bool state)
+                    {return true;}
+                bool GetEcnStatus() const
+                    {return false;}  // (links don't mark packets)
+                bool SetTxBufferSize(unsigned int bufferSize)
+                    {return true;}
+                unsigned int GetTxBufferSize()
+                    {return 0;}
+                bool SetRxBufferSize(unsigned int bufferSize)
+                    {return true;}
+                unsigned int GetRxBufferSize()
+                    {return (RX_QUEUE_MAX * 8192);}
+
+                ProtoSocket* GetSocket() const
+                    {return proto_socket;}
+                UINT16 GetPort() const
+                    {return port;}
+                bool IsGroupMember(const ProtoAddress& groupAddr) const;
+                bool HasInput() const
+                    {return (rx_count > 0);}
+                unsigned int GetInputCount() const
+                    {return rx_count;}
+                // Returns false if the rx queue is full
+                bool Enqueue(VsimPacket& packet);
+
+                UdpSocketProxy*  next;  // (VsimNormAgent::proxy_list)
+
+            private:
+                enum {RX_QUEUE_MAX = 64, GROUP_MAX = 4};
+
+                VsimNormAgent&   agent;
+                UINT16           port;
+                ProtoAddress     group_list[GROUP_MAX];
+                unsigned int     group_count;
+                VsimPacket*      rx_queue[RX_QUEUE_MAX];
+                unsigned int     rx_head;
+                unsigned int     rx_count;
+        };  // end class VsimNormAgent::UdpSocketProxy
+
+        UdpSocketProxy* FindProxy(ProtoSocket& theSocket);
+        bool IsOpenProxy(const UdpSocketProxy* theProxy) const;
+
+        VsimNetwork&        network;
+        unsigned int        host_index;
+        UINT32              timer_seq;     // (stale timer events are ignored)
+        UdpSocketProxy*     proxy_list;
+        UINT16              next_port;     // for ephemeral Bind()
+        unsigned int        completion_target;
+        unsigned int*       pending_count;
+        unsigned int        completion_count;
+        unsigned long long  completion_time;
+        unsigned long       socket_drops;
+};  // end class VsimNormAgent
+
+#endif // _VSIM_NORM_AGENT